@@ -58,7 +58,7 @@ typedef unsigned long  HANDLE; /* for compatability with operating system */
 #endif
 
 
-#define MAX_COMPORT_DEVICES     10
+#define MAX_COMPORT_DEVICES     256
 #ifdef WIN32
 #define COMP_PORT_PREFIX_1      "COM"
 #define COMP_PORT_PREFIX_2      "COM"
@@ -67,6 +67,41 @@ typedef unsigned long  HANDLE; /* for compatability with operating system */
 #define COMP_PORT_PREFIX_2      "ttyUSB"
 #endif
 
+/* Remote serial ports: "tcp:host:port" (raw) or "rfc2217:host:port" */
+#define COMP_PORT_PREFIX_TCP        "tcp:"
+#define COMP_PORT_PREFIX_RFC2217    "rfc2217:"
+#define COMP_PORT_IS_REMOTE(name)   \
+	((strncmp((name), COMP_PORT_PREFIX_TCP,                 \
+		  strlen(COMP_PORT_PREFIX_TCP)) == 0) ||        \
+	 (strncmp((name), COMP_PORT_PREFIX_RFC2217,             \
+		  strlen(COMP_PORT_PREFIX_RFC2217)) == 0))
+
+/* Modem control lines, see ComPortSetModemLines() */
+#define COMPORT_LINE_DTR        0x01
+#define COMPORT_LINE_RTS        0x02
+
+/* Serial port enumeration */
+#define MAX_COMPORT_NAME_SIZE   32
+#define MAX_COMPORT_SERIAL_SIZE 64
+#define MAX_COMPORT_ENUM        512
+
+struct COMPORT_INFO {
+	char	Name[MAX_COMPORT_NAME_SIZE];	/* Device name, e.g. ttyUSB0     */
+	char	Driver[MAX_COMPORT_NAME_SIZE];	/* Kernel driver name            */
+	BOOLEAN	IsUsb;				/* USB fields below are valid    */
+	UINT16	VendorId;			/* USB idVendor                  */
+	UINT16	ProductId;			/* USB idProduct                 */
+	char	Serial[MAX_COMPORT_SERIAL_SIZE];/* USB serial number, may be ""  */
+};
+
+/* A part of the data read by ComPortReadScatter() */
+#define COMP_MAX_IOV            8
+
+struct COMP_IOV {
+	UINT8	*Buffer;
+	UINT32	BufSize;
+};
+
 struct COMPORT_FIELDS {
 	UINT32	BaudRate;	/* Baudrate at which running               */
 	UINT8	ByteSize;	/* Number of bits/byte, 4-8                */
@@ -82,9 +117,12 @@ struct COMPORT_FIELDS {
  *
  * Purpose:  Open the specified ComPort device.
  *
- *  Params:   ComPortDeviceName - The name of the device to open
+ *  Params:   ComPortDeviceName - The name of the device to open, or a
+ *                               remote port ("tcp:host:port",
+ *                               "rfc2217:host:port").
  *           ComPortFildes - a struct filled with Comport settings, see
  *                           definition above.
+ *           Verbose - display the port tuning messages.
  *
  * Returns:  INVALID_HANDLE_VALUE (-1) - invalid handle.
  *           Other value - Handle to be used in other Comport APIs
@@ -95,7 +133,7 @@ struct COMPORT_FIELDS {
  *---------------------------------------------------------------------------
  */
 HANDLE ComPortOpen(const char *ComPortDeviceName,
-		   struct COMPORT_FIELDS ComPortFildes);
+		   struct COMPORT_FIELDS ComPortFildes, BOOLEAN Verbose);
 
 /*---------------------------------------------------------------------------
  * Function: HANDLE ConfigureUart()
@@ -167,6 +205,26 @@ UINT32 ComPortReadBin(HANDLE nDeviceID, const UINT8 *Buffer, UINT32 BufSize);
 UINT32 ComPortReadBin(HANDLE nDeviceID, UINT8 *Buffer, UINT32 BufSize);
 #endif
 
+/*---------------------------------------------------------------------------
+ * Function: UINT32 ComPortReadScatter()
+ *
+ * Purpose:  Read a binary data from Comport into several buffers
+ *
+ * Params:   nDeviceID - the opened handle returned by ComPortOpen()
+ *           Iov - buffers, filled one after the other
+ *           IovCnt - number of buffers, up to COMP_MAX_IOV
+ *
+ * Returns:  The number of bytes read.
+ *
+ * Comments: Meant for data already received, see
+ *           ComPortWaitForReadTimeout(): a packet is split into its header,
+ *           payload and trailer with no intermediate copy.
+ *
+ *---------------------------------------------------------------------------
+ */
+UINT32 ComPortReadScatter(HANDLE nDeviceID, const struct COMP_IOV *Iov,
+			  UINT32 IovCnt);
+
 /*---------------------------------------------------------------------------
  * Function: UINT32 ComPortWaitForRead()
  *
@@ -180,6 +238,71 @@ UINT32 ComPortReadBin(HANDLE nDeviceID, UINT8 *Buffer, UINT32 BufSize);
  */
 UINT32 ComPortWaitForRead(HANDLE nDeviceID);
 
+/*---------------------------------------------------------------------------
+ * Function: UINT32 ComPortWaitForReadTimeout()
+ *
+ * Purpose:  Wait until a byte is received for read, or a timeout expires
+ *
+ * Params:   nDeviceID - the opened handle returned by ComPortOpen()
+ *           Timeout - maximum time to wait, in milliseconds
+ *
+ * Returns:  The number of bytes that are waiting in RX queue, 0 on timeout.
+ *
+ *---------------------------------------------------------------------------
+ */
+UINT32 ComPortWaitForReadTimeout(HANDLE nDeviceID, UINT32 Timeout);
+
+/*---------------------------------------------------------------------------
+ * Function: BOOLEAN ComPortSetModemLines()
+ *
+ * Purpose:  Assert or release modem control lines, e.g. wired to the board
+ *           reset and boot strap.
+ *
+ * Params:   nDeviceID - the opened handle returned by ComPortOpen()
+ *           Lines - COMPORT_LINE_* mask of the lines to change
+ *           Assert - TRUE to assert the lines, FALSE to release them
+ *
+ * Returns:  1 if successful
+ *           0 in the case of an error.
+ *
+ *---------------------------------------------------------------------------
+ */
+BOOLEAN ComPortSetModemLines(HANDLE nDeviceID, UINT32 Lines, BOOLEAN Assert);
+
+#ifndef WIN32
+/*---------------------------------------------------------------------------
+ * Function: UINT32 ComPortEnumerate()
+ *
+ * Purpose:  List the serial ports present in the system.
+ *
+ * Params:   Ports - array filled with the found ports, sorted by name
+ *           MaxPorts - number of entries in Ports
+ *
+ * Returns:  The number of ports found.
+ *
+ * Comments: Only devices bound to a real serial driver are listed, that is,
+ *           virtual consoles and unpopulated legacy UART slots are skipped.
+ *
+ *---------------------------------------------------------------------------
+ */
+UINT32 ComPortEnumerate(struct COMPORT_INFO *Ports, UINT32 MaxPorts);
+
+/*---------------------------------------------------------------------------
+ * Function: BOOLEAN ComPortSetCustomBaudRate()
+ *
+ * Purpose:  Set a baud rate that has no Bxxx termios constant.
+ *
+ * Params:   nDeviceID - the opened handle returned by ComPortOpen()
+ *           BaudRate - requested baud rate
+ *
+ * Returns:  1 if successful
+ *           0 in the case of an error.
+ *
+ *---------------------------------------------------------------------------
+ */
+BOOLEAN ComPortSetCustomBaudRate(HANDLE nDeviceID, UINT32 BaudRate);
+#endif
+
 #endif  /* COMPORT_IF_H */
 
 #ifdef __cplusplus
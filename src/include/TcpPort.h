@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   TcpPort.h
+ *            This file defines the TCP (raw / RFC 2217) remote serial
+ *            transport used behind the ComPort interface.
+ *  Project:
+ *            UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#ifndef _TCP_PORT_H_
+#define _TCP_PORT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------
+ * Constant definitions
+ *---------------------------------------------------------------------------
+ */
+#define MAX_TCP_PORTS           64
+
+/*---------------------------------------------------------------------------
+ * Function: HANDLE TcpPortOpen()
+ *
+ * Purpose:  Connect to a remote serial port (console server).
+ *
+ * Params:   hostPort - "host:port" string ("[addr]:port" for IPv6).
+ *           ComPortFields - serial settings, applied remotely in RFC 2217
+ *                           mode.
+ *           rfc2217 - TRUE to negotiate RFC 2217 (telnet COM-PORT-OPTION),
+ *                     FALSE for a raw byte stream.
+ *
+ * Returns:  INVALID_HANDLE_VALUE (-1) - invalid handle.
+ *           Other value - Handle to be used in other Comport APIs
+ *
+ *---------------------------------------------------------------------------
+ */
+HANDLE  TcpPortOpen(const char *hostPort,
+		    struct COMPORT_FIELDS ComPortFields,
+		    BOOLEAN rfc2217);
+
+/*---------------------------------------------------------------------------
+ * Function: BOOLEAN TcpPortIsHandle()
+ *
+ * Purpose:  Check whether a handle was returned by TcpPortOpen().
+ *
+ *---------------------------------------------------------------------------
+ */
+BOOLEAN TcpPortIsHandle(HANDLE nDeviceID);
+
+BOOLEAN TcpPortConfigure(HANDLE nDeviceID,
+			 struct COMPORT_FIELDS ComPortFields);
+BOOLEAN TcpPortClose(HANDLE nDeviceID);
+BOOLEAN TcpPortSetModemLines(HANDLE nDeviceID, UINT32 Lines, BOOLEAN Assert);
+BOOLEAN TcpPortWriteBin(HANDLE nDeviceID, const UINT8 *Buffer, UINT32 BufSize);
+UINT32  TcpPortReadBin(HANDLE nDeviceID, UINT8 *Buffer, UINT32 BufSize);
+UINT32  TcpPortWaitForRead(HANDLE nDeviceID, UINT32 timeout_ms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _TCP_PORT_H_ */
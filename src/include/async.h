@@ -0,0 +1,170 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   async.h
+ *	This file defines the asynchronous operations of a session: they are
+ *	queued, and then run a packet at a time as the caller polls.
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#ifndef _ASYNC_H_
+#define _ASYNC_H_
+
+#include "uut_types.h"
+#include "lib_uut.h"
+
+/* Defined in session.h */
+struct UUT_SESSION;
+
+/*---------------------------------------------------------------------------
+ * Global types
+ *---------------------------------------------------------------------------
+ */
+enum ASYNC_OP_TYPE {
+	ASYNC_OP_READ,
+	ASYNC_OP_WRITE,
+	ASYNC_OP_CALL
+};
+
+struct ASYNC_OP {
+	UINT32			id;
+	enum ASYNC_OP_TYPE	type;
+	UINT32			addr;
+	UINT8			*dst;		/* Read data, call response */
+	const UINT8		*src;		/* Write data */
+	UINT32			size;
+	UINT32			offset;		/* Bytes done so far */
+	struct UUT_ASYNC_CB	cb;
+	BOOLEAN			cancel;
+	struct ASYNC_OP		*next;
+};
+
+struct ASYNC_QUEUE {
+	struct ASYNC_OP		*head;		/* Running, then queued */
+	struct ASYNC_OP		*tail;
+	UINT32			numOps;
+	UINT32			nextId;
+
+	/* The packet of the head operation awaiting its response */
+	BOOLEAN			busy;
+	UINT32			pktLen;		/* Data bytes */
+	UINT32			respSize;
+	UINT32			rxLen;
+	UINT32			trial;
+
+	/* Late answers dropped until the line is quiet, before a resend */
+	BOOLEAN			draining;
+
+	unsigned long long	deadlineUs;	/* Of the response or drain */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------
+ * Functions prototypes
+ *---------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------------
+ * Function:	ASYNC_Submit
+ *
+ * Parameters:	session - session to run the operation on.
+ *		type    - operation.
+ *		addr    - device memory address.
+ *		dst     - read data or call response buffer.
+ *		src     - write data.
+ *		size    - data size, ignored for a call.
+ *		cb      - callbacks, NULL for none.
+ *		opId    - returned operation id.
+ * Returns:	EC_OK if queued, otherwise the EXIT_CODE of the failure.
+ * Side effects: Allocates the session queue on first use.
+ * Description:
+ *	Queue an operation, to run after those queued before it.
+ *---------------------------------------------------------------------------
+ */
+UINT32	ASYNC_Submit(struct UUT_SESSION *session, enum ASYNC_OP_TYPE type,
+		     UINT32 addr, UINT8 *dst, const UINT8 *src, UINT32 size,
+		     const struct UUT_ASYNC_CB *cb, UINT32 *opId);
+
+/*---------------------------------------------------------------------------
+ * Function:	ASYNC_Poll
+ *
+ * Parameters:	session   - session whose operations are run.
+ *		timeoutMs - longest wait for the device, 0 not to wait.
+ * Returns:	The number of operations not done yet.
+ * Side effects: Calls the operation callbacks.
+ * Description:
+ *	Send packets and handle their responses until no operation is left,
+ *	or nothing more can be done within timeoutMs. Each response done
+ *	reports the operation progress; a cancelled, failed or finished
+ *	operation reports its result and is dropped.
+ *---------------------------------------------------------------------------
+ */
+UINT32	ASYNC_Poll(struct UUT_SESSION *session, UINT32 timeoutMs);
+
+/*---------------------------------------------------------------------------
+ * Function:	ASYNC_Cancel
+ *
+ * Parameters:	session - session the operation was submitted to.
+ *		opId    - operation id.
+ * Returns:	EC_OK, or EC_OPR_MUM_ERR for an unknown operation.
+ * Side effects:
+ * Description:
+ *	Mark an operation cancelled. It ends with EC_CANCEL_ERR on the next
+ *	poll, or once the response of its packet on the way is handled; its
+ *	buffers are not used any more from now on.
+ *---------------------------------------------------------------------------
+ */
+UINT32	ASYNC_Cancel(struct UUT_SESSION *session, UINT32 opId);
+
+/*---------------------------------------------------------------------------
+ * Function:	ASYNC_Pending
+ *
+ * Parameters:	session - session to check.
+ * Returns:	The number of operations not done yet.
+ * Side effects:
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+UINT32	ASYNC_Pending(const struct UUT_SESSION *session);
+
+/*---------------------------------------------------------------------------
+ * Function:	ASYNC_NextDeadline
+ *
+ * Parameters:	session - session to check.
+ * Returns:	Milliseconds until ASYNC_Poll has work without any input: 0
+ *		when a packet is to be sent or its answer is overdue, -1 when
+ *		nothing is pending. While the input is drained before a
+ *		resend, the time until the line is deemed quiet.
+ * Side effects:
+ * Description:
+ *	The timer of an event loop which waits for the session port to be
+ *	readable, see UUT_NextDeadline.
+ *---------------------------------------------------------------------------
+ */
+INT32	ASYNC_NextDeadline(const struct UUT_SESSION *session);
+
+/*---------------------------------------------------------------------------
+ * Function:	ASYNC_Free
+ *
+ * Parameters:	session - session whose operations are dropped.
+ * Returns:	none
+ * Side effects: Ends every operation with EC_CANCEL_ERR, frees the queue.
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+void	ASYNC_Free(struct UUT_SESSION *session);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ASYNC_H_ */
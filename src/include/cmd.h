@@ -47,31 +47,37 @@ struct ComandNode {
 	UINT32 respSize;
 };
 
+/* Defined in session.h */
+struct UUT_SESSION;
+
 /*---------------------------------------------------------------------------
  * Functions prototypes
  *---------------------------------------------------------------------------
  */
+/* Stateless commands, usable without a session */
 void    CMD_CreateSetDevPortToHigh(UINT8  *cmdInfo, UINT32 *cmdLen);
 void    CMD_CreateSync(UINT8 *cmdInfo, UINT32 *cmdLen);
-void    CMD_CreateWrite(UINT32 addr, UINT32 size, UINT8 *dataBuf,
+
+void    CMD_CreateWrite(const struct UUT_SESSION *session,
+			UINT32 addr, UINT32 size, const UINT8 *dataBuf,
 			UINT8 *cmdInfo, UINT32 *cmdLen);
-void    CMD_CreateRead(UINT32 addr, UINT8 size, UINT8 *cmdInfo, UINT32 *cmdLen);
-void    CMD_CreateExec(UINT32 addr, UINT8 *cmdInfo, UINT32 *cmdLen);
+void    CMD_CreateRead(const struct UUT_SESSION *session,
+		       UINT32 addr, UINT8 size, UINT8 *cmdInfo, UINT32 *cmdLen);
+void    CMD_CreateExec(const struct UUT_SESSION *session,
+		       UINT32 addr, UINT8 *cmdInfo, UINT32 *cmdLen);
 
-void    CMD_BuildSetDevPortToHigh(struct ComandNode *cmdBuf, UINT32 *cmdNum);
-void    CMD_BuildSync(struct ComandNode *cmdBuf, UINT32 *cmdNum);
-void    CMD_BuildExecExit(UINT32 addr,
-			  struct ComandNode *cmdBuf,
+void    CMD_BuildSetDevPortToHigh(struct UUT_SESSION *session, UINT32 *cmdNum);
+void    CMD_BuildSync(struct UUT_SESSION *session, UINT32 *cmdNum);
+void    CMD_BuildExecExit(struct UUT_SESSION *session, UINT32 addr,
 			  UINT32 *cmdNum);
-void    CMD_BuildExecRet(UINT32 addr,
-			 struct ComandNode *cmdBuf,
+void    CMD_BuildExecRet(struct UUT_SESSION *session, UINT32 addr,
 			 UINT32 *cmdNum);
 void    CMD_BuildRomCfg(struct ComandNode *cmdBuf, UINT32 *cmdNum);
 
 BOOLEAN CMD_DispSync(UINT8 *respBuf);
-BOOLEAN CMD_DispWrite(UINT8 *respBuf, UINT32 respSize,
+BOOLEAN CMD_DispWrite(const struct UUT_SESSION *session, UINT32 respSize,
 		      UINT32 respNum, UINT32 totalSize);
-BOOLEAN CMD_DispRead(UINT8 *respBuf, UINT32 respSize,
+BOOLEAN CMD_DispRead(const struct UUT_SESSION *session, UINT32 respSize,
 		     UINT32 respNum, UINT32 totalSize);
 void    CMD_DispData(UINT8 *respBuf, UINT32 respSize);
 void    CMD_DispFlashEraseDev(UINT8 *respBuf, UINT32 devNum);
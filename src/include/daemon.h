@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   daemon.h
+ *	This file defines the daemon mode: an opened and synchronized port
+ *	serving script lines (jobs) received over a Unix domain socket.
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#ifndef _DAEMON_H_
+#define _DAEMON_H_
+
+#include "uut_types.h"
+
+/* Defined in session.h */
+struct UUT_SESSION;
+
+/*---------------------------------------------------------------------------
+ * Constant definitions
+ *---------------------------------------------------------------------------
+ */
+#define DAEMON_BACKLOG          8
+
+/* Daemon-only jobs, besides the script operations */
+#define DAEMON_JOB_CD           "cd"    /* Change the daemon directory      */
+#define DAEMON_JOB_SYNC         "sync"  /* Synchronize Host/Device again    */
+#define DAEMON_JOB_RESET        "reset" /* Run -reset, synchronize again    */
+#define DAEMON_JOB_QUIT         "quit"  /* Close the port and stop          */
+
+/* Job replies, followed by the EXIT_CODE of the job */
+#define DAEMON_REPLY_OK         "OK"
+#define DAEMON_REPLY_ERR        "ERR"
+
+/*---------------------------------------------------------------------------
+ * Functions prototypes
+ *---------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------------
+ * Function:	DAEMON_Run
+ *
+ * Parameters:	session  - session to serve.
+ *		sockPath - Unix domain socket path to listen on.
+ * Returns:	EC_OK when stopped by a quit job or a signal, otherwise the
+ *		EXIT_CODE of the failure.
+ * Side effects: Uses the session port, opened and synchronized by the
+ *		 caller.
+ * Description:
+ *	Serve clients one at a time. Every line a client sends is a job,
+ *	answered by a "OK <code>" or "ERR <code>" line. The socket is
+ *	created with mode 0600. An existing socket is replaced only when no
+ *	daemon answers on it.
+ *---------------------------------------------------------------------------
+ */
+UINT32	DAEMON_Run(struct UUT_SESSION *session, const char *sockPath);
+
+/*---------------------------------------------------------------------------
+ * Function:	DAEMON_Client
+ *
+ * Parameters:	sockPath - Unix domain socket path of the daemon.
+ *		job      - a single job line, NULL to send scriptName.
+ *		scriptName - script file whose lines are sent as jobs.
+ * Returns:	EC_OK if all the jobs succeeded, otherwise the EXIT_CODE of
+ *		the first failing job.
+ * Side effects:
+ * Description:
+ *	Submit jobs to a running daemon. Relative file names are resolved
+ *	against the client's current directory.
+ *---------------------------------------------------------------------------
+ */
+UINT32	DAEMON_Client(const char *sockPath, const char *job,
+		      const char *scriptName);
+
+#endif /* _DAEMON_H_ */
@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   farm.h
+ *	This file defines the farm mode: boards are programmed as their
+ *	serial ports are plugged in.
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#ifndef _FARM_H_
+#define _FARM_H_
+
+#include "uut_types.h"
+
+/* Defined in session.h */
+struct UUT_SESSION;
+
+/*---------------------------------------------------------------------------
+ * Constant definitions
+ *---------------------------------------------------------------------------
+ */
+#define FARM_MAX_BOARDS		64	/* Ports present at once */
+#define FARM_WORKERS		32	/* Boards programmed at once */
+#define FARM_MAX_DONE		1024	/* USB serials remembered as done */
+#define FARM_SETTLE_TIME	200L	/* ms, from plug in to port open */
+#define FARM_DEFAULT_PORTS	"ttyUSB*,ttyACM*"
+#define FARM_UEVENT_SIZE	8192
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------
+ * Functions prototypes
+ *---------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------------
+ * Function:	FARM_Run
+ *
+ * Parameters:	proto       - session whose settings (baud rate, CRC) are
+ *			      copied to each board.
+ *		ports       - comma separated port name patterns to serve,
+ *			      NULL for FARM_DEFAULT_PORTS.
+ *		scriptName  - script run on each board, see SCRIPT_RunFile.
+ *		metricsFile - file kept up to date with the farm metrics in
+ *			      Prometheus text format, NULL for none.
+ * Returns:	EC_OK when stopped by a signal, otherwise the EXIT_CODE of the
+ *		failure.
+ * Side effects: Opens, synchronizes and closes the board ports.
+ * Description:
+ *	Watch the kernel device events and run the script on every serial
+ *	port which appears, up to FARM_WORKERS boards at once. Ports present
+ *	at start are served too. A port is served once until it is removed,
+ *	and a USB board which passed is known by its serial number, so it
+ *	is not programmed again when it re-enumerates, e.g. as its new
+ *	firmware boots. Unplugging a board cancels its job. Each job result
+ *	is printed as it ends.
+ *---------------------------------------------------------------------------
+ */
+UINT32	FARM_Run(const struct UUT_SESSION *proto, const char *ports,
+		 const char *scriptName, const char *metricsFile);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _FARM_H_ */
@@ -0,0 +1,114 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   imgcache.h
+ *	This file defines the image cache: image files are read and encoded
+ *	once, and then shared by all the sessions and threads using them.
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#ifndef _IMGCACHE_H_
+#define _IMGCACHE_H_
+
+#include "uut_types.h"
+
+/* Defined in session.h and pktstream.h */
+struct UUT_SESSION;
+struct PKT_STREAM;
+
+/*---------------------------------------------------------------------------
+ * Constant definitions
+ *---------------------------------------------------------------------------
+ */
+#define IMG_MAX_PATH		512
+#define IMG_CACHE_MAX_ENTRIES	8
+#define IMG_MAX_STREAMS		4	/* Encodings kept per image */
+
+/*---------------------------------------------------------------------------
+ * Global types
+ *---------------------------------------------------------------------------
+ */
+struct IMG_ENTRY {
+	/* Key: the file, as it is now */
+	char			path[IMG_MAX_PATH];	/* As first opened */
+	unsigned long long	dev;
+	unsigned long long	ino;
+	long long		mtimeSec;
+	long			mtimeNsec;
+
+	/* Read only once cached, no lock needed */
+	const UINT8		*data;		/* File content */
+	UINT32			size;
+
+	/* Guarded by the cache lock */
+	struct PKT_STREAM	*streams[IMG_MAX_STREAMS];
+	UINT32			refCount;
+	BOOLEAN			cached;		/* FALSE once replaced */
+	UINT32			lastUse;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------
+ * Functions prototypes
+ *---------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------------
+ * Function:	IMG_CacheGet
+ *
+ * Parameters:	path - image file name.
+ * Returns:	The image with a reference taken, NULL on failure.
+ * Side effects: Reads the file, unless already cached.
+ * Description:
+ *	Look the image up by device and inode, and check its size and
+ *	modification time, so any path to the file hits. A file which
+ *	changed since it was cached is read again, the old entry lives on
+ *	until its last user is done. The image is a copy of the file: the
+ *	file may be rewritten while the image is in use.
+ *---------------------------------------------------------------------------
+ */
+struct IMG_ENTRY *IMG_CacheGet(const char *path);
+
+/*---------------------------------------------------------------------------
+ * Function:	IMG_CacheStream
+ *
+ * Parameters:	entry   - cached image.
+ *		session - session whose CRC type is used.
+ *		addr    - image start address.
+ * Returns:	The WRITE packets of the image with a reference taken, to be
+ *		dropped by PKT_StreamPut; NULL when out of memory.
+ * Side effects: Encodes the image, unless already encoded for addr.
+ * Description:
+ *	Get the packet stream writing the image to addr.
+ *---------------------------------------------------------------------------
+ */
+struct PKT_STREAM *IMG_CacheStream(struct IMG_ENTRY *entry,
+				   const struct UUT_SESSION *session,
+				   UINT32 addr);
+
+/*---------------------------------------------------------------------------
+ * Function:	IMG_CachePut
+ *
+ * Parameters:	entry - cached image.
+ * Returns:	none
+ * Side effects: Frees a replaced image with its last reference.
+ * Description:
+ *	Drop a reference taken by IMG_CacheGet. The image stays cached.
+ *---------------------------------------------------------------------------
+ */
+void	IMG_CachePut(struct IMG_ENTRY *entry);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _IMGCACHE_H_ */
@@ -15,15 +15,34 @@
  #define _LIB_UUT_H_
 
  /*---------------------------------------------------------------------------
- * Functions prototypes
+ * Global types
  *----------------------------------------------------------------------------
  */
 #pragma once
 
+/* A memory range of a vectored read or write */
+struct UUT_IOVEC {
+	UINT32	addr;
+	UINT8	*buf;
+	UINT32	len;
+};
+
+ /*---------------------------------------------------------------------------
+ * Functions prototypes
+ *----------------------------------------------------------------------------
+ */
+#ifdef WIN32
 __declspec(dllexport) int Init(UINT32 baudRate);
 __declspec(dllexport) int OPR_WriteMem_DLL(UINT32 addr, const UINT8* buff, UINT32 size);
 __declspec(dllexport) int OPR_ReadMem_DLL(UINT32 addr, UINT8* buff, UINT32 size);
 __declspec(dllexport) int OPR_ExecuteReturn_DLL(UINT32 addr, UINT8* resp);
+__declspec(dllexport) int OPR_WriteMemV_DLL(const struct UUT_IOVEC* vec, UINT32 count);
+__declspec(dllexport) int OPR_ReadMemV_DLL(const struct UUT_IOVEC* vec, UINT32 count);
+__declspec(dllexport) int OPR_SetPipeline_DLL(UINT32 depth);
+__declspec(dllexport) int OPR_SetWriteCache_DLL(UINT32 size);
+__declspec(dllexport) int OPR_Flush_DLL(void);
+__declspec(dllexport) int OPR_SetReadCache_DLL(UINT32 size, UINT32 maxAgeMs);
+__declspec(dllexport) void OPR_Invalidate_DLL(UINT32 addr, UINT32 size);
 
 /*---------------------------------------------------------------------------
 * Functions types
@@ -33,5 +52,413 @@ typedef int(*UUT_LIB_INIT)     (UINT32 baudRate);
 typedef int(*UUT_LIB_WRITE)    (UINT32 addr, const UINT8* buff, UINT32 size);
 typedef int(*UUT_LIB_READ)     (UINT32 addr, UINT8* buff, UINT32 size);
 typedef int(*UUT_LIB_CALL)     (UINT32 addr, UINT8* resp);
+typedef int(*UUT_LIB_WRITEV)   (const struct UUT_IOVEC* vec, UINT32 count);
+typedef int(*UUT_LIB_READV)    (const struct UUT_IOVEC* vec, UINT32 count);
+typedef int(*UUT_LIB_PIPE)     (UINT32 depth);
+typedef int(*UUT_LIB_WCACHE)   (UINT32 size);
+typedef int(*UUT_LIB_FLUSH)    (void);
+typedef int(*UUT_LIB_RCACHE)   (UINT32 size, UINT32 maxAgeMs);
+typedef void(*UUT_LIB_INVAL)   (UINT32 addr, UINT32 size);
+
+#else
+/*---------------------------------------------------------------------------
+ * Linux shared library (libuut.so): every call takes the session it runs on,
+ * so several devices may be driven at once, each from its own thread.
+ *---------------------------------------------------------------------------
+ */
+#include "uut_types.h"
+
+#define UUT_API	__attribute__((visibility("default")))
+
+/* Defined in session.h */
+struct UUT_SESSION;
+typedef struct UUT_SESSION	*UUT_HANDLE;
+
+/* Asynchronous operation callbacks, called from UUT_Poll() */
+typedef void (*UUT_PROGRESS_FN)(UINT32 opId, UINT32 done, UINT32 total,
+				void *arg);
+typedef void (*UUT_DONE_FN)(UINT32 opId, int result, void *arg);
+
+struct UUT_ASYNC_CB {
+	UUT_PROGRESS_FN	progress;	/* After each packet, may be NULL */
+	UUT_DONE_FN	done;		/* With the EXIT_CODE, may be NULL */
+	void		*arg;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------
+ * Function:	UUT_Open
+ *
+ * Parameters:	portName - port to open, e.g. ttyUSB0 or tcp:host:port; NULL
+ *			   or "" to find the device, as Init() does: the
+ *			   last port found is tried before a full scan.
+ *		baudRate - host baud rate.
+ *		handle   - returned session handle.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects: Opens the port, and keeps it open until UUT_Close.
+ * Description:
+ *	Open the port and synchronize with the device. The session is
+ *	quiet: only errors are printed.
+ *---------------------------------------------------------------------------
+ */
+UUT_API int	UUT_Open(const char *portName, UINT32 baudRate,
+			 UUT_HANDLE *handle);
+
+/*---------------------------------------------------------------------------
+ * Function:	UUT_Close
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ * Returns:	none
+ * Side effects: Flushes the write cache, closes the port and frees the
+ *		 session.
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+UUT_API void	UUT_Close(UUT_HANDLE handle);
+
+/*---------------------------------------------------------------------------
+ * Function:	UUT_WriteMem
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ *		addr   - Memory address to write to.
+ *		buff   - data buffer to write.
+ *		size   - Data size to write.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects:
+ * Description:
+ *	Write a buffer to the device memory. With the write cache on, a
+ *	write smaller than a packet is only cached, see UUT_SetWriteCache.
+ *---------------------------------------------------------------------------
+ */
+UUT_API int	UUT_WriteMem(UUT_HANDLE handle, UINT32 addr,
+			     const UINT8 *buff, UINT32 size);
+
+/*---------------------------------------------------------------------------
+ * Function:	UUT_ReadMem
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ *		addr   - Memory address to read from.
+ *		buff   - data buffer that was read.
+ *		size   - Data size to read.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects:
+ * Description:
+ *	Read the device memory into a buffer.
+ *---------------------------------------------------------------------------
+ */
+UUT_API int	UUT_ReadMem(UUT_HANDLE handle, UINT32 addr, UINT8 *buff,
+			    UINT32 size);
+
+/*---------------------------------------------------------------------------
+ * Function:	UUT_ExecuteReturn
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ *		addr   - Start address to execute from.
+ *		resp   - Responce code of the executed command.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects:
+ * Description:
+ *	Execute returnable code on the device.
+ *---------------------------------------------------------------------------
+ */
+UUT_API int	UUT_ExecuteReturn(UUT_HANDLE handle, UINT32 addr, UINT8 *resp);
+
+/*---------------------------------------------------------------------------
+ * Function:	UUT_WriteMemV
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ *		vec    - memory ranges to write, must not overlap.
+ *		count  - number of ranges.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects:
+ * Description:
+ *	Write several buffers to the device memory in one transfer, see
+ *	UUT_ReadMemV.
+ *---------------------------------------------------------------------------
+ */
+UUT_API int	UUT_WriteMemV(UUT_HANDLE handle, const struct UUT_IOVEC *vec,
+			      UINT32 count);
+
+/*---------------------------------------------------------------------------
+ * Function:	UUT_ReadMemV
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ *		vec    - memory ranges to read, each into its buffer.
+ *		count  - number of ranges.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects:
+ * Description:
+ *	Read several device memory ranges in one transfer. The ranges are
+ *	sorted and adjacent ones are merged into full packets, so many small
+ *	ranges cost one round trip per packet rather than one each, and
+ *	fewer with UUT_SetPipeline.
+ *---------------------------------------------------------------------------
+ */
+UUT_API int	UUT_ReadMemV(UUT_HANDLE handle, const struct UUT_IOVEC *vec,
+			     UINT32 count);
+
+/*---------------------------------------------------------------------------
+ * Function:	UUT_SetPipeline
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ *		depth  - packets sent before reading their responses, 1 to
+ *			 MAX_PIPE_DEPTH, 1 by default.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects:
+ * Description:
+ *	Pipeline the packets of the vectored calls. The ROM answers one
+ *	packet at a time: only raise the depth for a device known to buffer
+ *	several commands, over a link which does not lose bytes, since the
+ *	responses carry no packet number to match them with.
+ *---------------------------------------------------------------------------
+ */
+UUT_API int	UUT_SetPipeline(UUT_HANDLE handle, UINT32 depth);
+
+/*---------------------------------------------------------------------------
+ * Function:	UUT_SetTimeout
+ *
+ * Parameters:	handle    - session handle from UUT_Open.
+ *		timeoutMs - longest wait for a response, 400000 ms by default
+ *			    since a flash erase may take that long.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects:
+ * Description:
+ *	Set the response timeout of the session packets. A lost response
+ *	is only noticed, and the packet resent, once the timeout expires.
+ *---------------------------------------------------------------------------
+ */
+UUT_API int	UUT_SetTimeout(UUT_HANDLE handle, UINT32 timeoutMs);
+
+/*---------------------------------------------------------------------------
+ * Function:	UUT_SetRetries
+ *
+ * Parameters:	handle  - session handle from UUT_Open.
+ *		retries - resends of a failed packet, 0 by default.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects:
+ * Description:
+ *	Set how many times a packet that timed out or was answered wrongly
+ *	is resent before the operation fails, for the blocking, vectored
+ *	and asynchronous calls alike.
+ *---------------------------------------------------------------------------
+ */
+UUT_API int	UUT_SetRetries(UUT_HANDLE handle, UINT32 retries);
+
+/*---------------------------------------------------------------------------
+ * Function:	UUT_SubmitRead
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ *		addr   - Memory address to read from.
+ *		buff   - data buffer, filled as the operation goes on.
+ *		size   - Data size to read.
+ *		cb     - callbacks, NULL for none.
+ *		opId   - returned operation id.
+ * Returns:	EXIT_CODE of the submission.
+ * Side effects:
+ * Description:
+ *	Queue a read and return at once. Operations run in the order they
+ *	were submitted, as UUT_Poll() is called. buff must stay valid until
+ *	the done callback. The blocking calls fail with
+ *	EC_UNSUPPORTED_CMD_ERR while operations are queued.
+ *---------------------------------------------------------------------------
+ */
+UUT_API int	UUT_SubmitRead(UUT_HANDLE handle, UINT32 addr, UINT8 *buff,
+			       UINT32 size, const struct UUT_ASYNC_CB *cb,
+			       UINT32 *opId);
+
+/*---------------------------------------------------------------------------
+ * Function:	UUT_SubmitWrite
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ *		addr   - Memory address to write to.
+ *		buff   - data buffer to write, valid until the done callback.
+ *		size   - Data size to write.
+ *		cb     - callbacks, NULL for none.
+ *		opId   - returned operation id.
+ * Returns:	EXIT_CODE of the submission.
+ * Side effects:
+ * Description:
+ *	Queue a write and return at once, see UUT_SubmitRead.
+ *---------------------------------------------------------------------------
+ */
+UUT_API int	UUT_SubmitWrite(UUT_HANDLE handle, UINT32 addr,
+				const UINT8 *buff, UINT32 size,
+				const struct UUT_ASYNC_CB *cb, UINT32 *opId);
+
+/*---------------------------------------------------------------------------
+ * Function:	UUT_SubmitCall
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ *		addr   - Start address to execute from.
+ *		resp   - Responce code, set before the done callback.
+ *		cb     - callbacks, NULL for none.
+ *		opId   - returned operation id.
+ * Returns:	EXIT_CODE of the submission.
+ * Side effects:
+ * Description:
+ *	Queue the execution of returnable code and return at once, see
+ *	UUT_SubmitRead.
+ *---------------------------------------------------------------------------
+ */
+UUT_API int	UUT_SubmitCall(UUT_HANDLE handle, UINT32 addr, UINT8 *resp,
+			       const struct UUT_ASYNC_CB *cb, UINT32 *opId);
+
+/*---------------------------------------------------------------------------
+ * Function:	UUT_Poll
+ *
+ * Parameters:	handle    - session handle from UUT_Open.
+ *		timeoutMs - longest wait for the device, 0 not to wait.
+ * Returns:	The number of operations not done yet.
+ * Side effects: Calls the operation callbacks, from the calling thread.
+ * Description:
+ *	Run the queued operations until none is left, or nothing more can
+ *	be done within timeoutMs. The callbacks may submit and cancel
+ *	operations, but must not poll or close the session.
+ *---------------------------------------------------------------------------
+ */
+UUT_API int	UUT_Poll(UUT_HANDLE handle, UINT32 timeoutMs);
+
+/*---------------------------------------------------------------------------
+ * Function:	UUT_Cancel
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ *		opId   - operation id from a UUT_Submit call.
+ * Returns:	EC_OK, or EC_OPR_MUM_ERR when the operation is already done.
+ * Side effects:
+ * Description:
+ *	Cancel an operation. Its done callback reports EC_CANCEL_ERR from
+ *	the next UUT_Poll(), once the packet on the way, if any, is
+ *	answered. Operations still queued on UUT_Close() are cancelled.
+ *	Once UUT_Cancel returns EC_OK the library neither reads nor writes
+ *	the operation data buffer any more, so it may be released at once;
+ *	no progress callback follows. The callback argument must stay valid
+ *	until the done callback.
+ *---------------------------------------------------------------------------
+ */
+UUT_API int	UUT_Cancel(UUT_HANDLE handle, UINT32 opId);
+
+/*---------------------------------------------------------------------------
+ * Function:	UUT_SetWriteCache
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ *		size   - cache size in bytes, 0 to write through (default).
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects: Flushes the cache in use first.
+ * Description:
+ *	Keep the writes smaller than a packet on the host, merged by
+ *	address, so that register programming or table uploads made of many
+ *	small writes go out as a few full packets. The cache is flushed
+ *	when full, by UUT_Flush, and before any read, call, vectored write,
+ *	submission or close. Until then the device does not see the data,
+ *	and a byte written twice is sent once, with its last value: flush
+ *	between writes whose order matters to the device.
+ *---------------------------------------------------------------------------
+ */
+UUT_API int	UUT_SetWriteCache(UUT_HANDLE handle, UINT32 size);
+
+/*---------------------------------------------------------------------------
+ * Function:	UUT_Flush
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ * Returns:	EXIT_CODE of the cached writes, which are kept to be flushed
+ *		again when they fail.
+ * Side effects:
+ * Description:
+ *	Send the cached writes.
+ *---------------------------------------------------------------------------
+ */
+UUT_API int	UUT_Flush(UUT_HANDLE handle);
+
+/*---------------------------------------------------------------------------
+ * Function:	UUT_SetReadCache
+ *
+ * Parameters:	handle   - session handle from UUT_Open.
+ *		size     - cache size in bytes, 0 to read through (default).
+ *		maxAgeMs - longest time a page is served without reading it
+ *			   again, 0 for no limit.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects: Drops the cache in use.
+ * Description:
+ *	Keep the memory read by UUT_ReadMem on the host, in 256-byte pages,
+ *	so that reading the same tables again costs no transfer. A read
+ *	brings in the whole pages it touches, in one vectored transfer:
+ *	never cache memory whose reading has side effects, such as FIFO
+ *	registers. The pages written through the session are dropped, and
+ *	so are all the pages on a call, a UUT_Invalidate, or once older
+ *	than maxAgeMs. Reads larger than the cache are not cached.
+ *---------------------------------------------------------------------------
+ */
+UUT_API int	UUT_SetReadCache(UUT_HANDLE handle, UINT32 size,
+				 UINT32 maxAgeMs);
+
+/*---------------------------------------------------------------------------
+ * Function:	UUT_Invalidate
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ *		addr   - first address of the range.
+ *		size   - range size, 0 for all the memory.
+ * Returns:	none
+ * Side effects:
+ * Description:
+ *	Drop the cached pages of a range the device may have changed.
+ *---------------------------------------------------------------------------
+ */
+UUT_API void	UUT_Invalidate(UUT_HANDLE handle, UINT32 addr, UINT32 size);
+
+/*---------------------------------------------------------------------------
+ * Function:	UUT_GetFd
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ * Returns:	The file descriptor of the session port, serial or socket.
+ * Side effects:
+ * Description:
+ *	The descriptor to watch for reading in an event loop (poll, epoll,
+ *	libuv, asio...) which runs the queued operations with UUT_Process.
+ *	It stays owned by the session: it must not be read, written or
+ *	closed by the caller.
+ *---------------------------------------------------------------------------
+ */
+UUT_API int	UUT_GetFd(UUT_HANDLE handle);
+
+/*---------------------------------------------------------------------------
+ * Function:	UUT_Process
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ * Returns:	The number of operations not done yet.
+ * Side effects: Calls the operation callbacks, from the calling thread.
+ * Description:
+ *	Handle what the device sent so far and send the next packets,
+ *	without waiting: UUT_Poll with a zero timeout. Call it when the
+ *	descriptor of UUT_GetFd is readable, when the UUT_NextDeadline
+ *	timer expires, and after submitting or cancelling operations. It
+ *	reads all the data available, so a level-triggered watch is enough.
+ *---------------------------------------------------------------------------
+ */
+UUT_API int	UUT_Process(UUT_HANDLE handle);
+
+/*---------------------------------------------------------------------------
+ * Function:	UUT_NextDeadline
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ * Returns:	Milliseconds until UUT_Process must be called even though the
+ *		descriptor is not readable: 0 for now, -1 when no operation
+ *		is queued.
+ * Side effects:
+ * Description:
+ *	The timeout to give the event loop wait: the response timeout of the
+ *	packet on the way, after which it is resent or its operation fails,
+ *	or the few milliseconds of quiet line awaited before a resend.
+ *---------------------------------------------------------------------------
+ */
+UUT_API int	UUT_NextDeadline(UUT_HANDLE handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WIN32 */
 
 #endif /* _LIB_UUT_H_ */
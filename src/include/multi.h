@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   multi.h
+ *	This file defines the multi-board mode: one image is written to (or
+ *	verified on) several boards at once, each one on its own port.
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#ifndef _MULTI_H_
+#define _MULTI_H_
+
+#include <pthread.h>
+
+#include "uut_types.h"
+#include "ComPort.h"
+#include "program.h"
+#include "session.h"
+
+/* Defined in pktstream.h */
+struct PKT_STREAM;
+
+/*---------------------------------------------------------------------------
+ * Constant definitions
+ *---------------------------------------------------------------------------
+ */
+#define MULTI_MAX_BOARDS	64
+#define MULTI_PORT_SEPS		","
+#define MULTI_GLOB_CHARS	"*?["
+
+/*---------------------------------------------------------------------------
+ * Global types
+ *---------------------------------------------------------------------------
+ */
+enum MULTI_ENGINE {
+	MULTI_ENGINE_THREAD = 0,	/* One thread per board */
+	MULTI_ENGINE_URING		/* One io_uring loop for all the boards */
+};
+
+struct MULTI_JOB {
+	const char	*opr;
+	const UINT8	*image;		/* Read once, shared */
+	UINT32		size;
+	UINT32		addr;
+};
+
+struct MULTI_BOARD {
+	struct UUT_SESSION	session;
+	const struct MULTI_JOB	*job;
+	struct PKT_STREAM	*stream;	/* wr: shared, encoded once */
+	pthread_t		thread;
+	BOOLEAN			started;
+	UINT32			result;		/* EXIT_CODE */
+	unsigned long long	elapsedUs;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------
+ * Functions prototypes
+ *---------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------------
+ * Function:	MULTI_Run
+ *
+ * Parameters:	proto    - session whose settings (baud rate, CRC) are
+ *			   copied to each board.
+ *		ports    - comma separated port names, each one may be a
+ *			   /dev glob pattern, e.g. "ttyUSB*" or
+ *			   "ttyUSB0,ttyUSB1".
+ *		oprName  - OPR_WRITE_MEM or OPR_VERIFY_MEM.
+ *		fileName - image file.
+ *		addr     - start memory address.
+ *		engine   - MULTI_ENGINE_THREAD, or MULTI_ENGINE_URING to drive
+ *			   all the (local) ports from a single thread.
+ * Returns:	EC_OK when all the boards passed, otherwise the EXIT_CODE of
+ *		the first board which failed.
+ * Side effects: Opens, synchronizes and closes every port.
+ * Description:
+ *	Run the operation on all the boards at once, each board with its own
+ *	session. The image comes from the image cache, and a write sends its
+ *	packet stream, encoded once and shared. Write packets which are not
+ *	acknowledged within proto->cmdTimeout are resent up to
+ *	proto->maxRetries times (-timeout and -retries, none by default).
+ *	Prints a per-board summary: result, time, throughput and resent
+ *	packets.
+ *---------------------------------------------------------------------------
+ */
+UINT32	MULTI_Run(const struct UUT_SESSION *proto, const char *ports,
+		  const char *oprName, const char *fileName, UINT32 addr,
+		  enum MULTI_ENGINE engine);
+
+/*---------------------------------------------------------------------------
+ * Function:	MULTI_InitSession
+ *
+ * Parameters:	session  - board session to set up.
+ *		proto    - session whose settings (baud rate, CRC) are copied.
+ *		portName - board port name.
+ * Returns:	none
+ * Side effects:
+ * Description:
+ *	Set up the session of one of several boards: quiet, with the command
+ *	timeout and packet resends of proto. A board flashing may be busy
+ *	for the whole default timeout, so there is no shorter one here.
+ *---------------------------------------------------------------------------
+ */
+void	MULTI_InitSession(struct UUT_SESSION *session,
+			  const struct UUT_SESSION *proto,
+			  const char *portName);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _MULTI_H_ */
@@ -28,10 +28,21 @@
 /* Baud rate scan steps: */
 #define BR_BIG_STEP         20		/* in percents from current baud rate           */
 #define BR_MEDIUM_STEP      10		/* in percents from current baud rate           */
+#define BR_FINE_STEP        6		/* in percents, within the UART clock tolerance */
 #define BR_SMALL_STEP       1		/* in percents from current baud rate           */
 #define BR_MIN_STEP         5		/* in absolut baud rate units                   */
 #define BR_LOW_LIMIT        400		/* Automatic BR detection starts at this value  */
 #define BR_HIGH_LIMIT       150000	/* Automatic BR detection ends at this value    */
+#define BR_SYNC_TIMEOUT_MIN 20		/* ms, SYNC answer wait during BR detection     */
+#define BR_RATIO_STEP       5		/* in 1/1000, garbled SYNC model resolution     */
+#define BR_MAX_ESTIMATES    16		/* Rates estimated from garbled SYNC responses  */
+
+/* Host/Device synchronization: */
+#define SYNC_BURST_TIMEOUT  20L		/* ms, first SYNC answer wait, doubles          */
+#define SYNC_MAX_TIMEOUT    200L	/* ms, longest SYNC answer wait                 */
+#define SYNC_DEADLINE       1000L	/* ms, overall synchronization deadline         */
+#define SYNC_DRAIN_QUIET    5L		/* ms, silence ending an input drain            */
+#define SYNC_WRONG_LIMIT    3		/* Garbled answers before giving up             */
 
 
 #define OPR_WRITE_MEM       "wr"     /* Write To Memory/Flash                        */
@@ -40,6 +51,7 @@
 #define OPR_EXECUTE_CONT    "call"   /* Execute returnable code                      */
 #define OPR_SCAN            "scan"   /* scan COM port                                */
 #define OPR_SET_HRATE       "srhigh" /* Set serial bauderate to high baudrate        */
+#define OPR_VERIFY_MEM      "verify" /* Compare Memory/Flash with a file (script)    */
 
 enum SYNC_RESULT {
 	SR_OK           =   0x00,
@@ -48,11 +60,12 @@ enum SYNC_RESULT {
 	SR_ERROR        =   0x03
 };
 
-/*----------------------------------------------------------------------------
- * External Variables
- *---------------------------------------------------------------------------
- */
-extern struct COMPORT_FIELDS	PortCfg;
+/* Defined in session.h */
+struct UUT_SESSION;
+/* Defined in pktstream.h */
+struct PKT_STREAM;
+/* Defined in lib_uut.h */
+struct UUT_IOVEC;
 
 /*---------------------------------------------------------------------------
  * Functions prototypes
@@ -60,24 +73,46 @@ extern struct COMPORT_FIELDS	PortCfg;
  */
 
 void		OPR_Usage(void);
-BOOLEAN		OPR_ClosePort(void);
-BOOLEAN		OPR_OpenPort(const char *port_name,
-			     struct COMPORT_FIELDS portCfg);
-void		OPR_WriteMem(char *inputFileName, UINT32 addr, UINT32 size);
-void		OPR_ReadMem(char *outputFileName, UINT32 addr, UINT32 size);
-void		OPR_FlashEraseDevice(UINT32 devNum);
-void		OPR_FlashEraseSector(UINT32 devNum, UINT32 addr);
-void		OPR_ExecuteExit(UINT32 addr);
-void		OPR_ExecuteReturn(UINT32 addr);
-void		OPR_PrintFlashId(UINT32 devNum);
-void		OPR_PrintFlashSts(UINT32 devNum);
-void		OPR_UnlockFlash(UINT32 devNum);
-BOOLEAN		OPR_WaitTillReady(UINT32 devNum);
-void		OPR_GetFlashSts(UINT32 devNum);
-BOOLEAN		OPR_ScanBaudRate(void);
-enum SYNC_RESULT	OPR_CheckSync(UINT32 bdRate);
-void		OPR_ReadStatusMsg(char *outputFileName);
-BOOLEAN		OPR_ScanPort(struct COMPORT_FIELDS portCfg, char * port);
-BOOLEAN		OPR_SetDevicePortHighRate(void);
+BOOLEAN		OPR_ClosePort(struct UUT_SESSION *session);
+BOOLEAN		OPR_OpenPort(struct UUT_SESSION *session,
+			     const char *port_name);
+BOOLEAN		OPR_WriteMem(struct UUT_SESSION *session,
+			     char *inputFileName, UINT32 addr, UINT32 size);
+BOOLEAN		OPR_ReadMem(struct UUT_SESSION *session,
+			    char *outputFileName, UINT32 addr, UINT32 size);
+BOOLEAN		OPR_VerifyMem(struct UUT_SESSION *session,
+			      char *inputFileName, UINT32 addr, UINT32 size);
+UINT32		OPR_WriteBuf(struct UUT_SESSION *session, UINT32 addr,
+			     const UINT8 *buff, UINT32 size);
+UINT32		OPR_WriteStream(struct UUT_SESSION *session,
+				const struct PKT_STREAM *stream);
+UINT32		OPR_ReadBuf(struct UUT_SESSION *session, UINT32 addr,
+			    UINT8 *buff, UINT32 size);
+UINT32		OPR_WriteVec(struct UUT_SESSION *session,
+			     const struct UUT_IOVEC *vec, UINT32 count);
+UINT32		OPR_ReadVec(struct UUT_SESSION *session,
+			    const struct UUT_IOVEC *vec, UINT32 count);
+void		OPR_FlashEraseDevice(struct UUT_SESSION *session,
+				     UINT32 devNum);
+void		OPR_FlashEraseSector(struct UUT_SESSION *session,
+				     UINT32 devNum, UINT32 addr);
+BOOLEAN		OPR_ExecuteExit(struct UUT_SESSION *session, UINT32 addr);
+BOOLEAN		OPR_ExecuteReturn(struct UUT_SESSION *session, UINT32 addr);
+UINT32		OPR_ExecuteCall(struct UUT_SESSION *session, UINT32 addr,
+				UINT8 *resp);
+void		OPR_PrintFlashId(struct UUT_SESSION *session, UINT32 devNum);
+void		OPR_PrintFlashSts(struct UUT_SESSION *session, UINT32 devNum);
+void		OPR_UnlockFlash(struct UUT_SESSION *session, UINT32 devNum);
+BOOLEAN		OPR_WaitTillReady(struct UUT_SESSION *session, UINT32 devNum);
+void		OPR_GetFlashSts(struct UUT_SESSION *session, UINT32 devNum);
+BOOLEAN		OPR_ScanBaudRate(struct UUT_SESSION *session);
+enum SYNC_RESULT	OPR_CheckSync(struct UUT_SESSION *session,
+				      UINT32 bdRate);
+void		OPR_ReadStatusMsg(struct UUT_SESSION *session,
+				  char *outputFileName);
+BOOLEAN		OPR_ScanPort(struct UUT_SESSION *session, char * port);
+BOOLEAN		OPR_FindPort(struct UUT_SESSION *session, char *port);
+BOOLEAN		OPR_SetDevicePortHighRate(struct UUT_SESSION *session);
+BOOLEAN		OPR_ResetDevice(struct UUT_SESSION *session);
 
 #endif /* _OPR_H_ */
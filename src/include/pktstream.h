@@ -0,0 +1,99 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   pktstream.h
+ *	This file defines the packet stream: the WRITE commands of an image,
+ *	encoded once and shared, read only, by all the sessions sending it.
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#ifndef _PKTSTREAM_H_
+#define _PKTSTREAM_H_
+
+#include "uut_types.h"
+
+/* Defined in session.h */
+struct UUT_SESSION;
+
+/*---------------------------------------------------------------------------
+ * Constant definitions
+ *---------------------------------------------------------------------------
+ */
+#define PKT_MAX_PAYLOAD		256
+#define PKT_WRITE_OVERHEAD	8	/* cmd, size, address and CRC */
+
+/*---------------------------------------------------------------------------
+ * Global types
+ *---------------------------------------------------------------------------
+ */
+struct PKT_STREAM {
+	UINT8	*data;		/* All the packets, back to back */
+	UINT32	*offsets;	/* Packet i is data[offsets[i]..offsets[i+1]) */
+	UINT32	numPackets;
+	UINT32	addr;		/* Image start address */
+	UINT32	size;		/* Image size */
+	UINT32	crcType;	/* CRC the packets were encoded with */
+	UINT32	refCount;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------
+ * Functions prototypes
+ *---------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------------
+ * Function:	PKT_StreamCreate
+ *
+ * Parameters:	session - session whose CRC type is used.
+ *		addr    - image start address.
+ *		image   - image data, not referenced after the call.
+ *		size    - image size.
+ * Returns:	The stream holding one reference, NULL when out of memory.
+ * Side effects:
+ * Description:
+ *	Encode the image into PKT_MAX_PAYLOAD bytes WRITE commands.
+ *---------------------------------------------------------------------------
+ */
+struct PKT_STREAM *PKT_StreamCreate(const struct UUT_SESSION *session,
+				    UINT32 addr, const UINT8 *image,
+				    UINT32 size);
+
+/*---------------------------------------------------------------------------
+ * Function:	PKT_StreamGet
+ *
+ * Parameters:	stream - packet stream.
+ * Returns:	stream, with one more reference.
+ * Side effects:
+ * Description:
+ *	Take a reference, e.g. for each thread sending the stream.
+ *---------------------------------------------------------------------------
+ */
+struct PKT_STREAM *PKT_StreamGet(struct PKT_STREAM *stream);
+
+/*---------------------------------------------------------------------------
+ * Function:	PKT_StreamPut
+ *
+ * Parameters:	stream - packet stream.
+ * Returns:	none
+ * Side effects: Frees the stream with its last reference.
+ * Description:
+ *	Drop a reference taken by PKT_StreamCreate or PKT_StreamGet.
+ *---------------------------------------------------------------------------
+ */
+void	PKT_StreamPut(struct PKT_STREAM *stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _PKTSTREAM_H_ */
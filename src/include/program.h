@@ -32,24 +32,31 @@ enum EXIT_CODE {
 	EC_SCAN_ERR             = 0x09,
 	EC_SIZE_ERR             = 0x10,
 	EC_SEND_CMD_ERR         = 0x11,
-	EC_CRC_ERR              = 0x12
+	EC_CRC_ERR              = 0x12,
+	EC_VERIFY_ERR           = 0x13,
+	EC_CANCEL_ERR           = 0x14
 };
 
 /*---------------------------------------------------------------------------
  * Constant definitions
  *---------------------------------------------------------------------------
  */
-#define MAX_PARAM_SIZE		32
+#define MAX_PARAM_SIZE		128
 
  /* Default values */
 #define DEFAULT_BAUD_RATE	115200
 #define DEFAULT_DEV_NUM		0
 #ifdef WIN32
 #define DEFAULT_PORT_NAME	"COM1"
+#define strtok_r		strtok_s	/* Same arguments in MSVC */
+#define setenv(name, value, overwrite)	_putenv_s(name, value)
 #else
 #define DEFAULT_PORT_NAME	"ttyS0"
 #endif
 
+#define GET_BASE(str)		(((str[0] == 'x') || (str[1] == 'x')) ? \
+								BASE_HEXADECIMAL : BASE_DECIMAL)
+
 #define SUCCESS		TRUE
 #define FAIL		FALSE
 
@@ -106,6 +113,18 @@ void displayColorMsg(BOOLEAN success, char *fmt, ...);
  */
 void displayMsg(char *fmt, ...);
 
+/*---------------------------------------------------------------------------
+ * Function:	getTimeUs
+ *
+ * Parameters:	none
+ * Returns:	Monotonic time in micro-seconds.
+ * Side effects:
+ * Description:
+ *		The clock of all the timeouts, deadlines and durations.
+ *---------------------------------------------------------------------------
+ */
+unsigned long long getTimeUs(void);
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   rcache.h
+ *	This file defines the read cache of a session: device memory pages
+ *	already read are served from the host, until written or aged out.
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#ifndef _RCACHE_H_
+#define _RCACHE_H_
+
+#include "uut_types.h"
+
+/* Defined in session.h */
+struct UUT_SESSION;
+
+/*---------------------------------------------------------------------------
+ * Constant definitions
+ *---------------------------------------------------------------------------
+ */
+#define RCACHE_PAGE_SIZE	256	/* Data bytes of a READ packet */
+#define RCACHE_MAX_SIZE		(1024 * 1024)
+
+/*---------------------------------------------------------------------------
+ * Global types
+ *---------------------------------------------------------------------------
+ */
+
+/* An aligned page of device memory */
+struct RCACHE_PAGE {
+	UINT32			addr;
+	BOOLEAN			valid;
+	unsigned long long	fetchUs;	/* When it was read */
+	UINT8			data[RCACHE_PAGE_SIZE];
+};
+
+/* Direct mapped: page n of the memory may only be in pages[n % numPages] */
+struct RCACHE {
+	struct RCACHE_PAGE	*pages;
+	UINT32			numPages;
+	UINT32			maxAgeMs;	/* 0: until written */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------
+ * Functions prototypes
+ *---------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------------
+ * Function:	RCACHE_Enable
+ *
+ * Parameters:	session  - session to cache the reads of.
+ *		size     - cache size in bytes, rounded up to whole pages, 0
+ *			   to read through.
+ *		maxAgeMs - longest time a page is served without being read
+ *			   again, 0 for no limit.
+ * Returns:	EC_OK, or the EXIT_CODE of the allocation.
+ * Side effects: Drops the cache in use.
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+UINT32	RCACHE_Enable(struct UUT_SESSION *session, UINT32 size,
+		      UINT32 maxAgeMs);
+
+/*---------------------------------------------------------------------------
+ * Function:	RCACHE_Read
+ *
+ * Parameters:	session - session to use.
+ *		addr    - Memory address to read from.
+ *		buff    - data buffer that was read.
+ *		size    - Data size to read.
+ * Returns:	EC_OK, or the EXIT_CODE of the device read.
+ * Side effects: Replaces the pages mapped to the same slots.
+ * Description:
+ *	Read memory through the session cache. Each page touched is served
+ *	from the cache when there, the missing ones are read whole from the
+ *	device in one vectored read, so a small read brings in its entire
+ *	page. Reads larger than the cache, and all reads with no cache, go
+ *	straight to the device.
+ *---------------------------------------------------------------------------
+ */
+UINT32	RCACHE_Read(struct UUT_SESSION *session, UINT32 addr, UINT8 *buff,
+		    UINT32 size);
+
+/*---------------------------------------------------------------------------
+ * Function:	RCACHE_Invalidate
+ *
+ * Parameters:	session - session to use.
+ *		addr    - first address of the range.
+ *		size    - range size, 0 for all the memory.
+ * Returns:	none
+ * Side effects:
+ * Description:
+ *	Drop the cached pages overlapping the range, for the memory is
+ *	written or may be changed by the device.
+ *---------------------------------------------------------------------------
+ */
+void	RCACHE_Invalidate(struct UUT_SESSION *session, UINT32 addr,
+			  UINT32 size);
+
+/*---------------------------------------------------------------------------
+ * Function:	RCACHE_Free
+ *
+ * Parameters:	session - session whose cache is dropped.
+ * Returns:	none
+ * Side effects:
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+void	RCACHE_Free(struct UUT_SESSION *session);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _RCACHE_H_ */
@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   script.h
+ *	This file defines the batch script operations, running several
+ *	operations over a single port open and synchronization.
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#ifndef _SCRIPT_H_
+#define _SCRIPT_H_
+
+#include "uut_types.h"
+
+/* Defined in session.h */
+struct UUT_SESSION;
+
+/*---------------------------------------------------------------------------
+ * Constant definitions
+ *---------------------------------------------------------------------------
+ */
+#define MAX_SCRIPT_LINE_SIZE    1024
+#define SCRIPT_COMMENT_CHAR     '#'
+
+/*---------------------------------------------------------------------------
+ * Functions prototypes
+ *---------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------------
+ * Function:	SCRIPT_ExecLine
+ *
+ * Parameters:	session - session to use.
+ *		line - a single script line, e.g.
+ *		       "wr -file helper.bin -addr 0x10000".
+ *		       The line is altered by the parsing.
+ * Returns:	EC_OK on success, otherwise the EXIT_CODE of the failure.
+ * Side effects: Uses the session port, opened and synchronized by the
+ *		 caller.
+ * Description:
+ *	Run one operation: wr, rd, call, go, verify or srhigh, with the
+ *	-file, -addr, -size and -baudrate parameters of the command line.
+ *	Empty lines and comments are accepted and do nothing.
+ *---------------------------------------------------------------------------
+ */
+UINT32	SCRIPT_ExecLine(struct UUT_SESSION *session, char *line);
+
+/*---------------------------------------------------------------------------
+ * Function:	SCRIPT_RunFile
+ *
+ * Parameters:	session  - session to use.
+ *		fileName - script file, one operation per line.
+ * Returns:	EC_OK if all the lines succeeded, otherwise the EXIT_CODE of
+ *		the first failing line.
+ * Side effects: Uses the session port, opened and synchronized by the
+ *		 caller.
+ * Description:
+ *	Run the script lines in order, stopping at the first failure.
+ *---------------------------------------------------------------------------
+ */
+UINT32	SCRIPT_RunFile(struct UUT_SESSION *session, const char *fileName);
+
+#endif /* _SCRIPT_H_ */
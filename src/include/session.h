@@ -0,0 +1,105 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   session.h
+ *	This file defines the session: the state of the conversation with a
+ *	single device. Sessions share nothing, so each one may be driven by
+ *	its own thread.
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#ifndef _SESSION_H_
+#define _SESSION_H_
+
+#include "uut_types.h"
+#include "ComPort.h"
+#include "program.h"
+#include "cmd.h"
+
+/* Defined in async.h */
+struct ASYNC_QUEUE;
+
+/* Defined in wcache.h */
+struct WCACHE;
+
+/* Defined in rcache.h */
+struct RCACHE;
+
+/*---------------------------------------------------------------------------
+ * Constant definitions
+ *---------------------------------------------------------------------------
+ */
+#define DEFAULT_CRC_TYPE	16
+#define DEFAULT_CMD_TIMEOUT	400000L	/* ms, flash erase may be that long */
+#define DEFAULT_MAX_RETRIES	0
+#define DEFAULT_PIPE_DEPTH	1	/* Stop-and-wait, as the ROM expects */
+#define MAX_PIPE_DEPTH		MAX_CMD_BUF_SIZE
+
+/* Verbose control messages display, per session */
+#define SESSION_MSG(session, msg)				\
+	do {							\
+		if ((session)->verbose)				\
+			printf msg;				\
+	} while (0)
+
+/*---------------------------------------------------------------------------
+ * Global types
+ *---------------------------------------------------------------------------
+ */
+struct UUT_SESSION {
+	HANDLE			portHandle;
+	struct COMPORT_FIELDS	portCfg;
+	char			portName[MAX_PARAM_SIZE];
+	char			resetSeq[MAX_PARAM_SIZE]; /* See OPR_ResetDevice */
+	struct ComandNode	cmdBuf[MAX_CMD_BUF_SIZE];
+	UINT8			respBuf[MAX_RESP_BUF_SIZE];
+	UINT32			crcType;	/* 16/32 */
+	BOOLEAN			console;	/* Data from/to console */
+	BOOLEAN			verbose;
+	UINT32			syncRttUs;	/* Last SYNC round trip */
+	UINT32			cmdTimeout;	/* ms, wait for a response */
+	UINT32			maxRetries;	/* Resends of a failed packet */
+	UINT32			retries;	/* Resends done so far */
+	UINT32			pipeDepth;	/* Vectored packets in flight */
+	UINT32			txBytes;	/* Commands sent so far */
+	UINT32			rxBytes;	/* Responses received so far */
+	volatile BOOLEAN	cancel;		/* Set by another thread */
+	struct ASYNC_QUEUE	*async;		/* Library operations, or NULL */
+	struct WCACHE		*wcache;	/* Library writes, or NULL */
+	struct RCACHE		*rcache;	/* Library reads, or NULL */
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------
+ * Functions prototypes
+ *---------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------------
+ * Function:	SESSION_Init
+ *
+ * Parameters:	session  - session to initialize.
+ *		baudRate - host baud rate.
+ * Returns:	none
+ * Side effects:
+ * Description:
+ *	Set the session defaults: no port opened, 8N1 at baudRate, CRC16,
+ *	file mode, verbose messages, no packet retries and no pipelining.
+ *---------------------------------------------------------------------------
+ */
+void	SESSION_Init(struct UUT_SESSION *session, UINT32 baudRate);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _SESSION_H_ */
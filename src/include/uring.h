@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   uring.h
+ *	This file defines the io_uring multi-board engine: all the boards
+ *	are driven from a single thread, each by its own protocol state
+ *	machine advanced on I/O completions.
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#ifndef _URING_H_
+#define _URING_H_
+
+#include "uut_types.h"
+
+/* Defined in multi.h */
+struct MULTI_BOARD;
+
+/*---------------------------------------------------------------------------
+ * Constant definitions
+ *---------------------------------------------------------------------------
+ */
+#define URING_OPS_PER_BOARD	3	/* WRITE, READ and its LINK_TIMEOUT */
+#define URING_DRAIN_SIZE	64
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------
+ * Functions prototypes
+ *---------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------------
+ * Function:	URING_Run
+ *
+ * Parameters:	boards    - boards to program, with their session and job
+ *			    set up, see MULTI_Run.
+ *		numBoards - number of boards.
+ * Returns:	TRUE once all the boards are done, each with its result and
+ *		time set. FALSE when the engine cannot run, e.g. io_uring is
+ *		not available or a port is remote; no board was touched then.
+ * Side effects: Opens, synchronizes and closes every port, drops the board
+ *		 references to the packet stream.
+ * Description:
+ *	Run the job of every board from the calling thread: synchronize,
+ *	then send the WRITE packets or the verify READ commands. Each
+ *	command goes out as a linked WRITE, READ and LINK_TIMEOUT chain,
+ *	and the board state machine moves on when the chain completes. The
+ *	timeouts and retries are those of the thread engine.
+ *---------------------------------------------------------------------------
+ */
+BOOLEAN	URING_Run(struct MULTI_BOARD *boards, UINT32 numBoards);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _URING_H_ */
@@ -0,0 +1,386 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   uut.hpp
+ *	This file defines the C++20 interface of the Linux shared library: a
+ *	session object owning its port, with span based calls. It is a thin
+ *	header only layer over lib_uut.h; the data goes straight between
+ *	the caller buffers and the library, with no copy.
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#ifndef _UUT_HPP_
+#define _UUT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "uut_types.h"
+#include "program.h"
+#include "lib_uut.h"
+
+namespace uut {
+
+/*---------------------------------------------------------------------------
+ * Errors
+ *---------------------------------------------------------------------------
+ */
+
+/* Thrown by Result::value() when there is no value */
+class Error : public std::runtime_error {
+public:
+	explicit Error(EXIT_CODE code)
+		: std::runtime_error("UART update tool error " +
+				     std::to_string(static_cast<int>(code))),
+		  code_(code) {}
+
+	EXIT_CODE code() const noexcept { return code_; }
+
+private:
+	EXIT_CODE	code_;
+};
+
+/*
+ * The value of an operation, or the EXIT_CODE of its failure. It follows
+ * std::expected<T, EXIT_CODE>, which is not available before C++23.
+ */
+template <class T>
+class Result {
+public:
+	Result(const T &value) : value_(value), error_(EC_OK), ok_(true) {}
+	Result(T &&value) : value_(std::move(value)), error_(EC_OK), ok_(true) {}
+	Result(EXIT_CODE error) : value_(), error_(error), ok_(false) {}
+
+	bool has_value() const noexcept { return ok_; }
+	explicit operator bool() const noexcept { return ok_; }
+	EXIT_CODE error() const noexcept { return error_; }
+
+	T &value() &
+	{
+		if (!ok_)
+			throw Error(error_);
+		return value_;
+	}
+
+	T &&value() &&
+	{
+		if (!ok_)
+			throw Error(error_);
+		return std::move(value_);
+	}
+
+	T &operator*() & noexcept { return value_; }
+	T &&operator*() && noexcept { return std::move(value_); }
+	T *operator->() noexcept { return &value_; }
+
+	template <class U>
+	T value_or(U &&other) const &
+	{
+		return ok_ ? value_ : static_cast<T>(std::forward<U>(other));
+	}
+
+private:
+	T		value_;
+	EXIT_CODE	error_;
+	bool		ok_;
+};
+
+template <>
+class Result<void> {
+public:
+	Result() : error_(EC_OK) {}
+	Result(EXIT_CODE error) : error_(error) {}
+
+	bool has_value() const noexcept { return error_ == EC_OK; }
+	explicit operator bool() const noexcept { return error_ == EC_OK; }
+	EXIT_CODE error() const noexcept { return error_; }
+
+	void value() const
+	{
+		if (error_ != EC_OK)
+			throw Error(error_);
+	}
+
+private:
+	EXIT_CODE	error_;
+};
+
+/*---------------------------------------------------------------------------
+ * Memory regions of the vectored calls
+ *---------------------------------------------------------------------------
+ */
+
+/* A device range read into data */
+struct Region {
+	std::uint32_t		addr;
+	std::span<std::byte>	data;
+};
+
+/* A device range written from data */
+struct ConstRegion {
+	std::uint32_t			addr;
+	std::span<const std::byte>	data;
+
+	ConstRegion(std::uint32_t a, std::span<const std::byte> d)
+		: addr(a), data(d) {}
+	ConstRegion(const Region &r) : addr(r.addr), data(r.data) {}
+};
+
+/*---------------------------------------------------------------------------
+ * Session
+ *---------------------------------------------------------------------------
+ */
+
+/*
+ * An open and synchronized device port. The port is closed when the
+ * session is destroyed or closed; a moved from session is empty. A session
+ * must be used from one thread at a time, different sessions run in
+ * parallel.
+ */
+class Session {
+public:
+	Session() noexcept = default;
+
+	Session(Session &&other) noexcept
+		: handle_(std::exchange(other.handle_, nullptr)) {}
+
+	Session &operator=(Session &&other) noexcept
+	{
+		if (this != &other) {
+			close();
+			handle_ = std::exchange(other.handle_, nullptr);
+		}
+		return *this;
+	}
+
+	Session(const Session &) = delete;
+	Session &operator=(const Session &) = delete;
+
+	~Session() { close(); }
+
+	/*
+	 * Open the port and synchronize with the device, an empty port name
+	 * finds it as UUT_Open does.
+	 */
+	static Result<Session> open(const std::string &port = {},
+				    std::uint32_t baudRate = DEFAULT_BAUD_RATE)
+	{
+		UUT_HANDLE	h;
+		int		ec;
+
+		ec = UUT_Open(port.empty() ? nullptr : port.c_str(), baudRate,
+			      &h);
+		if (ec != EC_OK)
+			return static_cast<EXIT_CODE>(ec);
+
+		return Session(h);
+	}
+
+	void close() noexcept
+	{
+		if (handle_ != nullptr)
+			UUT_Close(std::exchange(handle_, nullptr));
+	}
+
+	explicit operator bool() const noexcept { return handle_ != nullptr; }
+
+	/* For the lib_uut.h calls with no counterpart here */
+	UUT_HANDLE native_handle() const noexcept { return handle_; }
+
+	/* Read device memory straight into buf */
+	Result<void> read(std::uint32_t addr, std::span<std::byte> buf)
+	{
+		if (handle_ == nullptr)
+			return EC_PORT_ERR;
+		if (!fits(buf.size()))
+			return EC_SIZE_ERR;
+
+		return status(UUT_ReadMem(handle_, addr,
+					  reinterpret_cast<UINT8 *>(buf.data()),
+					  static_cast<UINT32>(buf.size())));
+	}
+
+	/* Write buf to device memory */
+	Result<void> write(std::uint32_t addr, std::span<const std::byte> buf)
+	{
+		if (handle_ == nullptr)
+			return EC_PORT_ERR;
+		if (!fits(buf.size()))
+			return EC_SIZE_ERR;
+
+		return status(UUT_WriteMem(handle_, addr,
+				reinterpret_cast<const UINT8 *>(buf.data()),
+				static_cast<UINT32>(buf.size())));
+	}
+
+	/* Execute returnable code, the result is its response code */
+	Result<std::uint8_t> call(std::uint32_t addr)
+	{
+		UINT8	resp = 0;
+		int	ec;
+
+		if (handle_ == nullptr)
+			return EC_PORT_ERR;
+
+		ec = UUT_ExecuteReturn(handle_, addr, &resp);
+		if (ec != EC_OK)
+			return static_cast<EXIT_CODE>(ec);
+
+		return static_cast<std::uint8_t>(resp);
+	}
+
+	/*
+	 * Cache the writes smaller than a packet, up to size bytes, 0 to write
+	 * through, see UUT_SetWriteCache.
+	 */
+	Result<void> set_write_cache(std::uint32_t size)
+	{
+		if (handle_ == nullptr)
+			return EC_PORT_ERR;
+
+		return status(UUT_SetWriteCache(handle_, size));
+	}
+
+	/* Send the cached writes */
+	Result<void> flush()
+	{
+		if (handle_ == nullptr)
+			return EC_PORT_ERR;
+
+		return status(UUT_Flush(handle_));
+	}
+
+	/*
+	 * Cache the memory read, up to size bytes, each page for maxAgeMs at
+	 * most (0 for no limit), see UUT_SetReadCache.
+	 */
+	Result<void> set_read_cache(std::uint32_t size,
+				    std::uint32_t maxAgeMs = 0)
+	{
+		if (handle_ == nullptr)
+			return EC_PORT_ERR;
+
+		return status(UUT_SetReadCache(handle_, size, maxAgeMs));
+	}
+
+	/* Drop the cached pages of a range, by default all of them */
+	void invalidate(std::uint32_t addr = 0, std::uint32_t size = 0) noexcept
+	{
+		if (handle_ != nullptr)
+			UUT_Invalidate(handle_, addr, size);
+	}
+
+	/*
+	 * Packets of the vectored calls sent before reading their responses,
+	 * see UUT_SetPipeline.
+	 */
+	Result<void> set_pipeline(std::uint32_t depth)
+	{
+		if (handle_ == nullptr)
+			return EC_PORT_ERR;
+
+		return status(UUT_SetPipeline(handle_, depth));
+	}
+
+	/* Longest wait for a response, see UUT_SetTimeout */
+	Result<void> set_timeout(std::uint32_t timeout_ms)
+	{
+		if (handle_ == nullptr)
+			return EC_PORT_ERR;
+
+		return status(UUT_SetTimeout(handle_, timeout_ms));
+	}
+
+	/* Resends of a failed packet, see UUT_SetRetries */
+	Result<void> set_retries(std::uint32_t retries)
+	{
+		if (handle_ == nullptr)
+			return EC_PORT_ERR;
+
+		return status(UUT_SetRetries(handle_, retries));
+	}
+
+	/* Read a range of Region in one transfer, see UUT_ReadMemV */
+	template <std::ranges::input_range R>
+		requires std::convertible_to<std::ranges::range_reference_t<R>,
+					     Region>
+	Result<void> read(R &&regions)
+	{
+		std::vector<UUT_IOVEC>	vec;
+
+		if (handle_ == nullptr)
+			return EC_PORT_ERR;
+
+		for (Region r : regions) {
+			if (!fits(r.data.size()))
+				return EC_SIZE_ERR;
+			vec.push_back({r.addr,
+				       reinterpret_cast<UINT8 *>(r.data.data()),
+				       static_cast<UINT32>(r.data.size())});
+		}
+
+		return status(UUT_ReadMemV(handle_, vec.data(),
+					   static_cast<UINT32>(vec.size())));
+	}
+
+	/*
+	 * Write a range of ConstRegion (or Region) in one transfer, see
+	 * UUT_WriteMemV.
+	 */
+	template <std::ranges::input_range R>
+		requires std::convertible_to<std::ranges::range_reference_t<R>,
+					     ConstRegion>
+	Result<void> write(R &&regions)
+	{
+		std::vector<UUT_IOVEC>	vec;
+
+		if (handle_ == nullptr)
+			return EC_PORT_ERR;
+
+		for (ConstRegion r : regions) {
+			if (!fits(r.data.size()))
+				return EC_SIZE_ERR;
+			/* UUT_IOVEC is shared with reads, the data is not written */
+			vec.push_back({r.addr,
+				       const_cast<UINT8 *>(
+				       reinterpret_cast<const UINT8 *>(r.data.data())),
+				       static_cast<UINT32>(r.data.size())});
+		}
+
+		return status(UUT_WriteMemV(handle_, vec.data(),
+					    static_cast<UINT32>(vec.size())));
+	}
+
+private:
+	explicit Session(UUT_HANDLE handle) noexcept : handle_(handle) {}
+
+	static bool fits(std::size_t size) noexcept
+	{
+		return size <= std::numeric_limits<UINT32>::max();
+	}
+
+	static Result<void> status(int ec) noexcept
+	{
+		return static_cast<EXIT_CODE>(ec);
+	}
+
+	UUT_HANDLE	handle_ = nullptr;
+};
+
+} /* namespace uut */
+
+#endif /* _UUT_HPP_ */
@@ -0,0 +1,543 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   uut_coro.hpp
+ *	This file defines the C++20 coroutine interface of the Linux shared
+ *	library: device operations are awaited, so a board test is written
+ *	as a plain sequence, while a single thread runs the tests of many
+ *	boards through the asynchronous calls of lib_uut.h.
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#ifndef _UUT_CORO_HPP_
+#define _UUT_CORO_HPP_
+
+#include <poll.h>
+
+#include <algorithm>
+#include <chrono>
+#include <coroutine>
+#include <deque>
+#include <exception>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "uut.hpp"
+
+namespace uut {
+
+template <class T = void>
+class Task;
+
+namespace detail {
+
+/*---------------------------------------------------------------------------
+ * Task promise
+ *---------------------------------------------------------------------------
+ */
+struct PromiseBase {
+	/* Resumed when the task ends: the awaiting task, or back to the loop */
+	std::coroutine_handle<>	cont_ = std::noop_coroutine();
+	std::exception_ptr	exc_;
+
+	struct FinalAwaiter {
+		bool await_ready() const noexcept { return false; }
+
+		template <class P>
+		std::coroutine_handle<>
+		await_suspend(std::coroutine_handle<P> h) const noexcept
+		{
+			return h.promise().cont_;
+		}
+
+		void await_resume() const noexcept {}
+	};
+
+	std::suspend_always initial_suspend() const noexcept { return {}; }
+	FinalAwaiter final_suspend() const noexcept { return {}; }
+	void unhandled_exception() noexcept { exc_ = std::current_exception(); }
+};
+
+template <class T>
+struct Promise : PromiseBase {
+	std::optional<T>	value_;
+
+	Task<T> get_return_object() noexcept;
+
+	template <class U>
+	void return_value(U &&value) { value_.emplace(std::forward<U>(value)); }
+
+	T take()
+	{
+		if (exc_)
+			std::rethrow_exception(exc_);
+		return std::move(*value_);
+	}
+};
+
+template <>
+struct Promise<void> : PromiseBase {
+	Task<void> get_return_object() noexcept;
+
+	void return_void() const noexcept {}
+
+	void take() const
+	{
+		if (exc_)
+			std::rethrow_exception(exc_);
+	}
+};
+
+} /* namespace detail */
+
+/*---------------------------------------------------------------------------
+ * Task
+ *---------------------------------------------------------------------------
+ */
+
+/*
+ * A coroutine returning T. It starts when awaited, or when spawned on a
+ * Loop, and resumes its awaiter when done; an exception goes to the
+ * awaiter as well.
+ */
+template <class T>
+class Task {
+public:
+	using promise_type = detail::Promise<T>;
+
+	Task(Task &&other) noexcept : h_(std::exchange(other.h_, nullptr)) {}
+
+	Task &operator=(Task &&other) noexcept
+	{
+		if (this != &other) {
+			if (h_)
+				h_.destroy();
+			h_ = std::exchange(other.h_, nullptr);
+		}
+		return *this;
+	}
+
+	Task(const Task &) = delete;
+	Task &operator=(const Task &) = delete;
+
+	~Task()
+	{
+		if (h_)
+			h_.destroy();
+	}
+
+	bool done() const noexcept { return !h_ || h_.done(); }
+
+	auto operator co_await() && noexcept
+	{
+		struct Awaiter {
+			std::coroutine_handle<promise_type>	h;
+
+			bool await_ready() const noexcept { return h.done(); }
+
+			std::coroutine_handle<>
+			await_suspend(std::coroutine_handle<> awaiter) noexcept
+			{
+				h.promise().cont_ = awaiter;
+				return h;
+			}
+
+			T await_resume() { return h.promise().take(); }
+		};
+
+		return Awaiter{h_};
+	}
+
+private:
+	friend promise_type;
+	friend class Loop;
+
+	explicit Task(std::coroutine_handle<promise_type> h) noexcept : h_(h) {}
+
+	std::coroutine_handle<promise_type>	h_;
+};
+
+namespace detail {
+
+template <class T>
+Task<T> Promise<T>::get_return_object() noexcept
+{
+	return Task<T>(std::coroutine_handle<Promise<T>>::from_promise(*this));
+}
+
+inline Task<void> Promise<void>::get_return_object() noexcept
+{
+	return Task<void>(
+		std::coroutine_handle<Promise<void>>::from_promise(*this));
+}
+
+} /* namespace detail */
+
+/*---------------------------------------------------------------------------
+ * Loop
+ *---------------------------------------------------------------------------
+ */
+
+/*
+ * Runs the spawned tasks from the calling thread: it waits for the ports of
+ * the sessions with operations queued, runs them with UUT_Process, and
+ * resumes the tasks whose operation is done. Tasks, sessions and timers of
+ * a loop must all be used from that thread.
+ */
+class Loop {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	Loop() = default;
+	Loop(const Loop &) = delete;
+	Loop &operator=(const Loop &) = delete;
+
+	/* Start task on the next run(), the loop owns it until it is done */
+	void spawn(Task<void> task)
+	{
+		ready_.push_back(task.h_);
+		tasks_.push_back(std::move(task));
+	}
+
+	/*
+	 * Run until every spawned task is done, or none can go on. The first
+	 * exception a task ended with is thrown once the others are done.
+	 */
+	void run()
+	{
+		std::exception_ptr	exc;
+
+		for (;;) {
+			while (!ready_.empty()) {
+				std::coroutine_handle<> h = ready_.front();
+
+				ready_.pop_front();
+				h.resume();
+			}
+
+			reap(exc);
+			if (tasks_.empty() || !wait())
+				break;
+		}
+
+		if (exc)
+			std::rethrow_exception(exc);
+	}
+
+	/* Awaitable resuming the task after the given time */
+	auto sleep_for(Clock::duration time)
+	{
+		struct Awaiter {
+			Loop			&loop;
+			Clock::time_point	when;
+
+			bool await_ready() const noexcept
+			{
+				return Clock::now() >= when;
+			}
+
+			void await_suspend(std::coroutine_handle<> h)
+			{
+				loop.timers_.push_back({when, h});
+			}
+
+			void await_resume() const noexcept {}
+		};
+
+		return Awaiter{*this, Clock::now() + time};
+	}
+
+	/* Used by the session operations, see AsyncSession */
+	void attach(UUT_HANDLE handle) { sessions_.push_back(handle); }
+
+	void detach(UUT_HANDLE handle)
+	{
+		sessions_.erase(std::remove(sessions_.begin(), sessions_.end(),
+					    handle),
+				sessions_.end());
+	}
+
+	void resume_later(std::coroutine_handle<> h) { ready_.push_back(h); }
+
+private:
+	struct Timer {
+		Clock::time_point	when;
+		std::coroutine_handle<>	h;
+	};
+
+	/* Drop the tasks done, keeping the first exception */
+	void reap(std::exception_ptr &exc)
+	{
+		auto it = tasks_.begin();
+
+		while (it != tasks_.end()) {
+			if (!it->done()) {
+				++it;
+				continue;
+			}
+			try {
+				it->h_.promise().take();
+			} catch (...) {
+				if (!exc)
+					exc = std::current_exception();
+			}
+			it = tasks_.erase(it);
+		}
+	}
+
+	/*
+	 * Wait for a port or a timer, then run the sessions and the timers.
+	 * FALSE when nothing is awaited, the remaining tasks never go on.
+	 */
+	bool wait()
+	{
+		std::vector<struct pollfd>	fds;
+		std::vector<UUT_HANDLE>		busy;
+		Clock::time_point		now = Clock::now();
+		int				timeout = -1;
+		int				ms;
+
+		for (UUT_HANDLE h : sessions_) {
+			ms = UUT_NextDeadline(h);
+			if (ms < 0)
+				continue;
+			fds.push_back({UUT_GetFd(h), POLLIN, 0});
+			busy.push_back(h);
+			timeout = (timeout < 0) ? ms : std::min(timeout, ms);
+		}
+
+		for (const Timer &t : timers_) {
+			ms = (t.when <= now) ? 0 : static_cast<int>(
+				std::chrono::ceil<std::chrono::milliseconds>(
+					t.when - now).count());
+			timeout = (timeout < 0) ? ms : std::min(timeout, ms);
+		}
+
+		if (busy.empty() && timers_.empty())
+			return false;
+
+		::poll(fds.data(), fds.size(), timeout);
+
+		/* The done callbacks queue their tasks on ready_ */
+		for (UUT_HANDLE h : busy)
+			UUT_Process(h);
+
+		now = Clock::now();
+		for (auto it = timers_.begin(); it != timers_.end();) {
+			if (it->when <= now) {
+				ready_.push_back(it->h);
+				it = timers_.erase(it);
+			} else {
+				++it;
+			}
+		}
+
+		return true;
+	}
+
+	std::vector<Task<void>>			tasks_;
+	std::deque<std::coroutine_handle<>>	ready_;
+	std::vector<UUT_HANDLE>			sessions_;
+	std::vector<Timer>			timers_;
+};
+
+namespace detail {
+
+/*---------------------------------------------------------------------------
+ * Session operations
+ *---------------------------------------------------------------------------
+ */
+
+/*
+ * The state of a submitted operation. It is not kept in the coroutine
+ * frame: a frame destroyed with its operation queued cancels it, so the
+ * library no longer touches the frame buffers, and the done callback,
+ * still to come, frees the state then.
+ */
+struct AsyncOp {
+	Loop			*loop;
+	std::coroutine_handle<>	waiter;
+	int			result = EC_OK;
+	UINT8			resp = 0;
+	bool			done = false;
+	bool			orphan = false;
+
+	static void onDone(UINT32, int result, void *arg)
+	{
+		AsyncOp	*op = static_cast<AsyncOp *>(arg);
+
+		if (op->orphan) {
+			delete op;
+			return;
+		}
+
+		op->result = result;
+		op->done   = true;
+		op->loop->resume_later(op->waiter);
+	}
+};
+
+enum class OpType { Read, Write, Call };
+
+template <class T>
+class OpAwaiter {
+public:
+	OpAwaiter(Loop &loop, UUT_HANDLE handle, OpType type,
+		  std::uint32_t addr, std::byte *dst, const std::byte *src,
+		  std::size_t size) noexcept
+		: loop_(loop), handle_(handle), type_(type), addr_(addr),
+		  dst_(dst), src_(src), size_(size) {}
+
+	OpAwaiter(const OpAwaiter &) = delete;
+	OpAwaiter &operator=(const OpAwaiter &) = delete;
+
+	~OpAwaiter()
+	{
+		if (op_ == nullptr)
+			return;
+
+		if (op_->done) {
+			delete op_;
+		} else {
+			op_->orphan = true;
+			UUT_Cancel(handle_, id_);
+		}
+	}
+
+	bool await_ready() const noexcept { return false; }
+
+	/* Submit the operation, FALSE goes on at once with its error */
+	bool await_suspend(std::coroutine_handle<> h)
+	{
+		struct UUT_ASYNC_CB	cb;
+		int			ec;
+
+		op_ = new AsyncOp{&loop_, h};
+		cb  = {nullptr, &AsyncOp::onDone, op_};
+
+		if (handle_ == nullptr)
+			ec = EC_PORT_ERR;
+		else if (size_ > std::numeric_limits<UINT32>::max())
+			ec = EC_SIZE_ERR;
+		else if (type_ == OpType::Read)
+			ec = UUT_SubmitRead(handle_, addr_,
+					    reinterpret_cast<UINT8 *>(dst_),
+					    static_cast<UINT32>(size_), &cb, &id_);
+		else if (type_ == OpType::Write)
+			ec = UUT_SubmitWrite(handle_, addr_,
+					reinterpret_cast<const UINT8 *>(src_),
+					static_cast<UINT32>(size_), &cb, &id_);
+		else
+			ec = UUT_SubmitCall(handle_, addr_, &op_->resp, &cb,
+					    &id_);
+
+		if (ec != EC_OK) {
+			op_->result = ec;
+			op_->done   = true;
+			return false;
+		}
+
+		return true;
+	}
+
+	T await_resume() const
+	{
+		if (op_->result != EC_OK)
+			return static_cast<EXIT_CODE>(op_->result);
+
+		if constexpr (std::is_same_v<T, Result<std::uint8_t>>)
+			return static_cast<std::uint8_t>(op_->resp);
+		else
+			return {};
+	}
+
+private:
+	Loop			&loop_;
+	UUT_HANDLE		handle_;
+	OpType			type_;
+	std::uint32_t		addr_;
+	std::byte		*dst_;
+	const std::byte		*src_;
+	std::size_t		size_;
+	AsyncOp			*op_ = nullptr;
+	UINT32			id_ = 0;
+};
+
+} /* namespace detail */
+
+/*---------------------------------------------------------------------------
+ * AsyncSession
+ *---------------------------------------------------------------------------
+ */
+
+/*
+ * A session whose operations are awaited from tasks of a loop:
+ *
+ *	co_await board.write(addr, image);
+ *	auto resp = co_await board.call(addr);
+ *
+ * Each operation queues on the session as UUT_Submit does and resumes the
+ * task with its Result once done. The buffers must stay valid until then,
+ * which awaiting in place ensures. The loop must outlive the session.
+ */
+class AsyncSession {
+public:
+	AsyncSession(Loop &loop, Session &&session)
+		: loop_(&loop), session_(std::move(session))
+	{
+		if (session_)
+			loop_->attach(session_.native_handle());
+	}
+
+	AsyncSession(AsyncSession &&other) noexcept
+		: loop_(other.loop_), session_(std::move(other.session_)) {}
+
+	AsyncSession &operator=(AsyncSession &&) = delete;
+
+	/* The operations still queued end with EC_CANCEL_ERR */
+	~AsyncSession()
+	{
+		if (session_)
+			loop_->detach(session_.native_handle());
+	}
+
+	/* For the blocking calls, refused while operations are queued */
+	Session &session() noexcept { return session_; }
+
+	detail::OpAwaiter<Result<void>>
+	read(std::uint32_t addr, std::span<std::byte> buf)
+	{
+		return {*loop_, session_.native_handle(), detail::OpType::Read,
+			addr, buf.data(), nullptr, buf.size()};
+	}
+
+	detail::OpAwaiter<Result<void>>
+	write(std::uint32_t addr, std::span<const std::byte> buf)
+	{
+		return {*loop_, session_.native_handle(), detail::OpType::Write,
+			addr, nullptr, buf.data(), buf.size()};
+	}
+
+	/* Execute returnable code, the result is its response code */
+	detail::OpAwaiter<Result<std::uint8_t>> call(std::uint32_t addr)
+	{
+		return {*loop_, session_.native_handle(), detail::OpType::Call,
+			addr, nullptr, nullptr, 0};
+	}
+
+private:
+	Loop		*loop_;
+	Session		session_;
+};
+
+} /* namespace uut */
+
+#endif /* _UUT_CORO_HPP_ */
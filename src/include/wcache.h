@@ -0,0 +1,120 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   wcache.h
+ *	This file defines the write-combining cache of a session: small
+ *	library writes are kept on the host, and sent later as full WRITE
+ *	packets.
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#ifndef _WCACHE_H_
+#define _WCACHE_H_
+
+#include "uut_types.h"
+
+/* Defined in session.h */
+struct UUT_SESSION;
+
+/*---------------------------------------------------------------------------
+ * Constant definitions
+ *---------------------------------------------------------------------------
+ */
+#define WCACHE_LINE_SIZE	256	/* Data bytes of a WRITE packet */
+#define WCACHE_MAX_SIZE		(1024 * 1024)
+
+/*---------------------------------------------------------------------------
+ * Global types
+ *---------------------------------------------------------------------------
+ */
+
+/* An aligned line of device memory, and which of its bytes were written */
+struct WCACHE_LINE {
+	UINT32	addr;
+	UINT32	numDirty;
+	UINT8	dirty[WCACHE_LINE_SIZE / 8];
+	UINT8	data[WCACHE_LINE_SIZE];
+};
+
+struct WCACHE {
+	struct WCACHE_LINE	*lines;
+	UINT32			numLines;
+	UINT32			numUsed;
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------------------------------------------------------
+ * Functions prototypes
+ *---------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------------
+ * Function:	WCACHE_Enable
+ *
+ * Parameters:	session - session to cache the writes of.
+ *		size    - cache size in bytes, rounded up to whole lines, 0 to
+ *			  write through.
+ * Returns:	EC_OK, or the EXIT_CODE of the flush or of the allocation.
+ * Side effects: Flushes the cache in use first.
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+UINT32	WCACHE_Enable(struct UUT_SESSION *session, UINT32 size);
+
+/*---------------------------------------------------------------------------
+ * Function:	WCACHE_Write
+ *
+ * Parameters:	session - session to use.
+ *		addr    - Memory address to write to.
+ *		buff    - data buffer to write.
+ *		size    - Data size to write.
+ * Returns:	EC_OK, or the EXIT_CODE of the writes sent.
+ * Side effects: Flushes the cache when no line is left for the data.
+ * Description:
+ *	Write a buffer to memory through the session cache. Writes of a
+ *	packet or more, and all writes with no cache, go out at once, after
+ *	the data already cached.
+ *---------------------------------------------------------------------------
+ */
+UINT32	WCACHE_Write(struct UUT_SESSION *session, UINT32 addr,
+		     const UINT8 *buff, UINT32 size);
+
+/*---------------------------------------------------------------------------
+ * Function:	WCACHE_Flush
+ *
+ * Parameters:	session - session whose cached writes are sent.
+ * Returns:	EC_OK, or the EXIT_CODE of the failed transfer.
+ * Side effects:
+ * Description:
+ *	Send the cached data in one vectored write: each run of written
+ *	bytes is a range, and ranges touching each other fill full packets.
+ *	The cache is kept when the transfer fails, for a later flush.
+ *---------------------------------------------------------------------------
+ */
+UINT32	WCACHE_Flush(struct UUT_SESSION *session);
+
+/*---------------------------------------------------------------------------
+ * Function:	WCACHE_Free
+ *
+ * Parameters:	session - session whose cache is dropped.
+ * Returns:	none
+ * Side effects: Cached data not flushed is lost.
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+void	WCACHE_Free(struct UUT_SESSION *session);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _WCACHE_H_ */
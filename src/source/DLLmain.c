@@ -20,17 +20,22 @@
 #include "program.h"
 #include "ComPort.h"
 #include "opr.h"
+#include "session.h"
 #include "lib_uut.h"
+#include "wcache.h"
+#include "rcache.h"
 
 /*---------------------------------------------------------------------------
  * External variables
  *---------------------------------------------------------------------------
  */
-extern UINT32					BaudRate;
-extern char						PortName[MAX_PARAM_SIZE];
-extern struct COMPORT_FIELDS	PortCfg;
 extern BOOLEAN					Verbose;
-extern BOOLEAN					Console;
+
+/*---------------------------------------------------------------------------
+ * Local variables
+ *---------------------------------------------------------------------------
+ */
+static struct UUT_SESSION		DllSession;
 
 /*---------------------------------------------------------------------------
  * Functions implementation
@@ -71,7 +76,11 @@ BOOL WINAPI DllMain(
 			// Perform any necessary cleanup.
 			
 			printf("Close port...\n");
-			if (OPR_ClosePort() != TRUE)
+			if (WCACHE_Flush(&DllSession) != EC_OK)
+				displayColorMsg(FAIL, "ERROR: Write cache flush failed.\n");
+			WCACHE_Free(&DllSession);
+			RCACHE_Free(&DllSession);
+			if (OPR_ClosePort(&DllSession) != TRUE)
 				displayColorMsg(FAIL, "ERROR: Port close failed.\n");
 
 			break;
@@ -87,29 +96,21 @@ int Init (UINT32 baudRate)
     enum EXIT_CODE ec = EC_OK;
 
 	/* Setup defaults */
-	Console     = FALSE;
 	Verbose     = TRUE;
 
 	/*
-	* Initialize parameters
+	* Initialize the session and its COM Port parameters
 	*/
-	BaudRate	= baudRate;
+	WCACHE_Free(&DllSession);
+	RCACHE_Free(&DllSession);
+	SESSION_Init(&DllSession, baudRate);
 
 	/*
-	* Configure COM Port parameters
+	* Try the last port found, scan all the ports only if it does not answer
 	*/
-	PortCfg.BaudRate	= MAX(BaudRate, BR_LOW_LIMIT);
-	PortCfg.ByteSize	= 8;
-	PortCfg.FlowControl	= 0;
-	PortCfg.Parity		= 0;
-	PortCfg.StopBits	= 0;
-
-	/*
-	* A scan is required, check each port, and then save the port num to the invironment
-	*/
-	if (OPR_ScanPort(PortCfg, PortName)) {
+	if (OPR_FindPort(&DllSession, DllSession.portName)) {
 		displayColorMsg(SUCCESS,
-			"\nScan ports pass, detected %s\n", PortName);
+			"\nScan ports pass, detected %s\n", DllSession.portName);
 	}
 	else {
 		displayColorMsg(FAIL,
@@ -120,3 +121,214 @@ int Init (UINT32 baudRate)
     return ec;
 }
 
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_WriteMem_DLL
+ *
+ * Parameters:	addr	- Memory address to write to.
+ *		buff	- data buffer to write.
+ *		size	- Data size to write.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects: Closes the port when called with a zero size.
+ * Description:
+ *	Write a buffer to memory of the device found by Init(). With the
+ *	write cache on, a write smaller than a packet is only cached.
+ *---------------------------------------------------------------------------
+ */
+int OPR_WriteMem_DLL(UINT32 addr, const UINT8* buff, UINT32 size)
+{
+	/* Ensure non-zero size */
+	if (size == 0)
+	{
+		WCACHE_Flush(&DllSession);
+		OPR_ClosePort(&DllSession);
+		return EC_SIZE_ERR;
+	}
+
+	RCACHE_Invalidate(&DllSession, addr, size);
+
+	return WCACHE_Write(&DllSession, addr, buff, size);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_ReadMem_DLL
+ *
+ * Parameters:	addr   - Memory address to read from.
+ *		buff   - data buffer that was read.
+ *		size   - Data size to read.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects:
+ * Description:
+ *	Read memory of the device found by Init() into a buffer.
+ *---------------------------------------------------------------------------
+ */
+int OPR_ReadMem_DLL(UINT32 addr, UINT8* buff, UINT32 size)
+{
+	UINT32 ec = WCACHE_Flush(&DllSession);
+
+	if (ec != EC_OK)
+		return ec;
+
+	return RCACHE_Read(&DllSession, addr, buff, size);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_ExecuteReturn_DLL
+ *
+ * Parameters:	addr - Start address to execute from.
+ *		resp - Responce code of the executed command.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects:
+ * Description:
+ *	Execute returnable code on the device found by Init().
+ *---------------------------------------------------------------------------
+ */
+int OPR_ExecuteReturn_DLL(UINT32 addr, UINT8* resp)
+{
+	UINT32 ec = WCACHE_Flush(&DllSession);
+
+	if (ec != EC_OK)
+		return ec;
+
+	/* The code run may change any memory */
+	RCACHE_Invalidate(&DllSession, 0, 0);
+
+	return OPR_ExecuteCall(&DllSession, addr, resp);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_WriteMemV_DLL
+ *
+ * Parameters:	vec   - memory ranges to write, must not overlap.
+ *		count - number of ranges.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects:
+ * Description:
+ *	Write several buffers to memory of the device found by Init(), in
+ *	one transfer.
+ *---------------------------------------------------------------------------
+ */
+int OPR_WriteMemV_DLL(const struct UUT_IOVEC* vec, UINT32 count)
+{
+	UINT32 ec = WCACHE_Flush(&DllSession);
+	UINT32 i;
+
+	if (ec != EC_OK)
+		return ec;
+
+	for (i = 0; i < count; i++)
+		RCACHE_Invalidate(&DllSession, vec[i].addr, vec[i].len);
+
+	return OPR_WriteVec(&DllSession, vec, count);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_ReadMemV_DLL
+ *
+ * Parameters:	vec   - memory ranges to read, each into its buffer.
+ *		count - number of ranges.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects:
+ * Description:
+ *	Read several memory ranges of the device found by Init(), in one
+ *	transfer.
+ *---------------------------------------------------------------------------
+ */
+int OPR_ReadMemV_DLL(const struct UUT_IOVEC* vec, UINT32 count)
+{
+	UINT32 ec = WCACHE_Flush(&DllSession);
+
+	if (ec != EC_OK)
+		return ec;
+
+	return OPR_ReadVec(&DllSession, vec, count);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_SetPipeline_DLL
+ *
+ * Parameters:	depth - packets sent before reading their responses, 1 to
+ *			MAX_PIPE_DEPTH.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects:
+ * Description:
+ *	Pipeline the packets of the vectored calls, for devices known to
+ *	buffer several commands. The default of 1, restored by Init(),
+ *	waits for each response.
+ *---------------------------------------------------------------------------
+ */
+int OPR_SetPipeline_DLL(UINT32 depth)
+{
+	if ((depth == 0) || (depth > MAX_PIPE_DEPTH))
+		return EC_SIZE_ERR;
+
+	DllSession.pipeDepth = depth;
+
+	return EC_OK;
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_SetWriteCache_DLL
+ *
+ * Parameters:	size - cache size in bytes, 0 to write through.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects: Flushes the cache in use first.
+ * Description:
+ *	Keep the writes smaller than a packet on the host, to be sent
+ *	combined into full packets, see OPR_Flush_DLL().
+ *---------------------------------------------------------------------------
+ */
+int OPR_SetWriteCache_DLL(UINT32 size)
+{
+	return WCACHE_Enable(&DllSession, size);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_Flush_DLL
+ *
+ * Parameters:	none
+ * Returns:	EXIT_CODE of the cached writes.
+ * Side effects:
+ * Description:
+ *	Send the cached writes. Reads, calls and vectored writes flush the
+ *	cache first, and so does the cache being full.
+ *---------------------------------------------------------------------------
+ */
+int OPR_Flush_DLL(void)
+{
+	return WCACHE_Flush(&DllSession);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_SetReadCache_DLL
+ *
+ * Parameters:	size     - cache size in bytes, 0 to read through.
+ *		maxAgeMs - longest time a page is served without reading it
+ *			   again, 0 for no limit.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects: Drops the cache in use.
+ * Description:
+ *	Keep the memory read by OPR_ReadMem_DLL() on the host, in 256-byte
+ *	pages, until written, a call, OPR_Invalidate_DLL() or maxAgeMs.
+ *---------------------------------------------------------------------------
+ */
+int OPR_SetReadCache_DLL(UINT32 size, UINT32 maxAgeMs)
+{
+	return RCACHE_Enable(&DllSession, size, maxAgeMs);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_Invalidate_DLL
+ *
+ * Parameters:	addr - first address of the range.
+ *		size - range size, 0 for all the memory.
+ * Returns:	none
+ * Side effects:
+ * Description:
+ *	Drop the cached pages of a range the device may have changed.
+ *---------------------------------------------------------------------------
+ */
+void OPR_Invalidate_DLL(UINT32 addr, UINT32 size)
+{
+	RCACHE_Invalidate(&DllSession, addr, size);
+}
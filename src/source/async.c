@@ -0,0 +1,496 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   async.c
+ *	This file implements the asynchronous operations of a session.
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "uut_types.h"
+#include "ComPort.h"
+#include "program.h"
+#include "opr.h"
+#include "cmd.h"
+#include "session.h"
+#include "lib_uut.h"
+#include "async.h"
+
+/*----------------------------------------------------------------------------
+ * Constant definitions
+ *---------------------------------------------------------------------------
+ */
+#define ASYNC_MAX_DATA		256	/* Data bytes per READ/WRITE packet */
+#define ASYNC_CALL_RESP_SIZE	3	/* FCALL, FCALL_RSLT, result */
+
+/*---------------------------------------------------------------------------
+ * Functions prototypes
+ *---------------------------------------------------------------------------
+ */
+static void	ASYNC_Finish(struct UUT_SESSION *session,
+			     struct ASYNC_OP *op, UINT32 result);
+static void	ASYNC_Reap(struct UUT_SESSION *session);
+static void	ASYNC_Start(struct UUT_SESSION *session);
+static void	ASYNC_Retry(struct UUT_SESSION *session);
+static void	ASYNC_Complete(struct UUT_SESSION *session);
+
+/*---------------------------------------------------------------------------
+ * Functions implementation
+ *---------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------------
+ * Function:	ASYNC_Submit
+ *
+ * Parameters:	session - session to run the operation on.
+ *		type    - operation.
+ *		addr    - device memory address.
+ *		dst     - read data or call response buffer.
+ *		src     - write data.
+ *		size    - data size, ignored for a call.
+ *		cb      - callbacks, NULL for none.
+ *		opId    - returned operation id.
+ * Returns:	EC_OK if queued, otherwise the EXIT_CODE of the failure.
+ * Side effects: Allocates the session queue on first use.
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+UINT32 ASYNC_Submit(struct UUT_SESSION *session, enum ASYNC_OP_TYPE type,
+		    UINT32 addr, UINT8 *dst, const UINT8 *src, UINT32 size,
+		    const struct UUT_ASYNC_CB *cb, UINT32 *opId)
+{
+	struct ASYNC_QUEUE	*q = session->async;
+	struct ASYNC_OP		*op;
+
+	if (type == ASYNC_OP_CALL)
+		size = 1;
+	if (size == 0)
+		return EC_SIZE_ERR;
+
+	if (q == NULL) {
+		q = (struct ASYNC_QUEUE *)calloc(1, sizeof(*q));
+		if (q == NULL)
+			return EC_SIZE_ERR;
+		session->async = q;
+	}
+
+	op = (struct ASYNC_OP *)calloc(1, sizeof(*op));
+	if (op == NULL)
+		return EC_SIZE_ERR;
+
+	/* Ids are never 0, so 0 may stand for none */
+	if (++q->nextId == 0)
+		q->nextId = 1;
+
+	op->id   = q->nextId;
+	op->type = type;
+	op->addr = addr;
+	op->dst  = dst;
+	op->src  = src;
+	op->size = size;
+	if (cb != NULL)
+		op->cb = *cb;
+
+	if (q->tail != NULL)
+		q->tail->next = op;
+	else
+		q->head = op;
+	q->tail = op;
+	q->numOps++;
+
+	*opId = op->id;
+
+	return EC_OK;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	ASYNC_Poll
+ *
+ * Parameters:	session   - session whose operations are run.
+ *		timeoutMs - longest wait for the device, 0 not to wait.
+ * Returns:	The number of operations not done yet.
+ * Side effects: Calls the operation callbacks.
+ * Description:
+ *	Only one packet is on the way at a time; the device answers the
+ *	packets of a session in order anyway.
+ *---------------------------------------------------------------------------
+ */
+UINT32 ASYNC_Poll(struct UUT_SESSION *session, UINT32 timeoutMs)
+{
+	struct ASYNC_QUEUE	*q = session->async;
+	unsigned long long	end;
+	unsigned long long	now;
+	unsigned long long	until;
+	UINT8			junk[ASYNC_MAX_DATA];
+	UINT32			avail;
+	UINT32			nRead;
+
+	if (q == NULL)
+		return 0;
+
+	end = getTimeUs() + (timeoutMs * 1000ULL);
+
+	for (;;) {
+		ASYNC_Reap(session);
+
+		if (q->head == NULL) {
+			q->draining = FALSE;
+			break;
+		}
+
+		if (!q->busy && !q->draining) {
+			ASYNC_Start(session);
+			continue;
+		}
+
+		now = getTimeUs();
+		if (now >= q->deadlineUs) {
+			if (q->draining)
+				q->draining = FALSE;
+			else
+				ASYNC_Retry(session);
+			continue;
+		}
+
+		until = MIN(end, q->deadlineUs);
+		avail = ComPortWaitForReadTimeout(session->portHandle,
+				(now < until) ?
+				(UINT32)((until - now + 999) / 1000) : 0);
+
+		if (avail == 0) {
+			if (getTimeUs() >= end)
+				break;
+			continue;
+		}
+
+		/* Each late byte puts the end of the drain further */
+		if (q->draining) {
+			ComPortReadBin(session->portHandle, junk,
+				       MIN(avail, sizeof(junk)));
+			q->deadlineUs = getTimeUs() +
+					(SYNC_DRAIN_QUIET * 1000ULL);
+			continue;
+		}
+
+		nRead = ComPortReadBin(session->portHandle,
+				       session->respBuf + q->rxLen,
+				       MIN(avail, q->respSize - q->rxLen));
+		q->rxLen         += nRead;
+		session->rxBytes += nRead;
+
+		if (q->rxLen == q->respSize)
+			ASYNC_Complete(session);
+	}
+
+	return q->numOps;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	ASYNC_Cancel
+ *
+ * Parameters:	session - session the operation was submitted to.
+ *		opId    - operation id.
+ * Returns:	EC_OK, or EC_OPR_MUM_ERR for an unknown operation.
+ * Side effects:
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+UINT32 ASYNC_Cancel(struct UUT_SESSION *session, UINT32 opId)
+{
+	struct ASYNC_OP *op;
+
+	if (session->async == NULL)
+		return EC_OPR_MUM_ERR;
+
+	for (op = session->async->head; op != NULL; op = op->next) {
+		if (op->id == opId) {
+			op->cancel = TRUE;
+			return EC_OK;
+		}
+	}
+
+	return EC_OPR_MUM_ERR;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	ASYNC_Pending
+ *
+ * Parameters:	session - session to check.
+ * Returns:	The number of operations not done yet.
+ * Side effects:
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+UINT32 ASYNC_Pending(const struct UUT_SESSION *session)
+{
+	return (session->async != NULL) ? session->async->numOps : 0;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	ASYNC_NextDeadline
+ *
+ * Parameters:	session - session to check.
+ * Returns:	Milliseconds until ASYNC_Poll has work without any input, 0
+ *		now, -1 never.
+ * Side effects:
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+INT32 ASYNC_NextDeadline(const struct UUT_SESSION *session)
+{
+	const struct ASYNC_QUEUE	*q = session->async;
+	const struct ASYNC_OP		*op;
+	unsigned long long		now;
+
+	if ((q == NULL) || (q->head == NULL))
+		return -1;
+
+	/* A packet to send is sent at once */
+	if (!q->busy && !q->draining)
+		return 0;
+
+	/* So is a cancelled operation ended, see ASYNC_Reap */
+	for (op = q->busy ? q->head->next : q->head; op != NULL;
+	     op = op->next) {
+		if (op->cancel)
+			return 0;
+	}
+
+	now = getTimeUs();
+	if (now >= q->deadlineUs)
+		return 0;
+
+	return (INT32)MIN((q->deadlineUs - now + 999) / 1000, 0x7FFFFFFF);
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	ASYNC_Free
+ *
+ * Parameters:	session - session whose operations are dropped.
+ * Returns:	none
+ * Side effects: Ends every operation with EC_CANCEL_ERR, frees the queue.
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+void ASYNC_Free(struct UUT_SESSION *session)
+{
+	struct ASYNC_QUEUE *q = session->async;
+
+	if (q == NULL)
+		return;
+
+	q->busy     = FALSE;
+	q->draining = FALSE;
+	while (q->head != NULL)
+		ASYNC_Finish(session, q->head, EC_CANCEL_ERR);
+
+	free(q);
+	session->async = NULL;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	ASYNC_Finish
+ *
+ * Parameters:	session - session of the operation.
+ *		op      - operation, not on the way.
+ *		result  - EXIT_CODE of the operation.
+ * Returns:	none
+ * Side effects: Calls the done callback, frees the operation.
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+static void ASYNC_Finish(struct UUT_SESSION *session, struct ASYNC_OP *op,
+			 UINT32 result)
+{
+	struct ASYNC_QUEUE	*q = session->async;
+	struct ASYNC_OP		**link;
+	struct ASYNC_OP		*prev = NULL;
+
+	for (link = &q->head; *link != op; link = &(*link)->next)
+		prev = *link;
+
+	*link = op->next;
+	if (q->tail == op)
+		q->tail = prev;
+	q->numOps--;
+
+	if (op->cb.done != NULL)
+		op->cb.done(op->id, (int)result, op->cb.arg);
+
+	free(op);
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	ASYNC_Reap
+ *
+ * Parameters:	session - session whose cancelled operations are ended.
+ * Returns:	none
+ * Side effects: Calls the done callbacks.
+ * Description:
+ *	End the cancelled operations, but the one whose packet is on the
+ *	way: its response is handled first.
+ *---------------------------------------------------------------------------
+ */
+static void ASYNC_Reap(struct UUT_SESSION *session)
+{
+	struct ASYNC_QUEUE	*q = session->async;
+	struct ASYNC_OP		*op;
+	struct ASYNC_OP		*next;
+
+	for (op = q->head; op != NULL; op = next) {
+		next = op->next;
+
+		if (op->cancel && !(q->busy && (op == q->head)))
+			ASYNC_Finish(session, op, EC_CANCEL_ERR);
+	}
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	ASYNC_Start
+ *
+ * Parameters:	session - session whose head operation goes on.
+ * Returns:	none
+ * Side effects:
+ * Description:
+ *	Send the next packet of the head operation.
+ *---------------------------------------------------------------------------
+ */
+static void ASYNC_Start(struct UUT_SESSION *session)
+{
+	struct ASYNC_QUEUE	*q    = session->async;
+	struct ASYNC_OP		*op   = q->head;
+	struct ComandNode	*node = &session->cmdBuf[0];
+
+	q->pktLen = MIN(op->size - op->offset, ASYNC_MAX_DATA);
+
+	switch (op->type) {
+	case ASYNC_OP_READ:
+		CMD_CreateRead(session, op->addr + op->offset,
+			       (UINT8)(q->pktLen - 1), node->cmd,
+			       &node->cmdSize);
+		q->respSize = q->pktLen + 3;
+		break;
+
+	case ASYNC_OP_WRITE:
+		CMD_CreateWrite(session, op->addr + op->offset, q->pktLen,
+				op->src + op->offset, node->cmd,
+				&node->cmdSize);
+		q->respSize = 1;
+		break;
+
+	default:
+		CMD_CreateExec(session, op->addr, node->cmd, &node->cmdSize);
+		q->respSize = ASYNC_CALL_RESP_SIZE;
+		break;
+	}
+
+	if (ComPortWriteBin(session->portHandle, node->cmd,
+			    node->cmdSize) != TRUE) {
+		ASYNC_Finish(session, op, EC_SEND_CMD_ERR);
+		return;
+	}
+	session->txBytes += node->cmdSize;
+
+	q->busy       = TRUE;
+	q->rxLen      = 0;
+	q->deadlineUs = getTimeUs() + (session->cmdTimeout * 1000ULL);
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	ASYNC_Retry
+ *
+ * Parameters:	session - session whose head packet was not answered.
+ * Returns:	none
+ * Side effects: Counts the resends in session->retries.
+ * Description:
+ *	Drop the partial answer, and let the packet be sent again, up to
+ *	session->maxRetries times; otherwise the operation fails. The
+ *	resend waits for the line to be quiet for SYNC_DRAIN_QUIET, so late
+ *	answers are not taken for its answer; ASYNC_Poll drops them in the
+ *	meantime, without blocking.
+ *---------------------------------------------------------------------------
+ */
+static void ASYNC_Retry(struct UUT_SESSION *session)
+{
+	struct ASYNC_QUEUE	*q  = session->async;
+	struct ASYNC_OP		*op = q->head;
+
+	q->busy = FALSE;
+
+	if (op->cancel || (q->trial >= session->maxRetries)) {
+		q->trial = 0;
+		ASYNC_Finish(session, op,
+			     op->cancel ? EC_CANCEL_ERR : EC_SEND_CMD_ERR);
+		return;
+	}
+
+	q->draining   = TRUE;
+	q->deadlineUs = getTimeUs() + (SYNC_DRAIN_QUIET * 1000ULL);
+
+	q->trial++;
+	session->retries++;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	ASYNC_Complete
+ *
+ * Parameters:	session - session whose head packet was answered.
+ * Returns:	none
+ * Side effects: Calls the operation callbacks.
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+static void ASYNC_Complete(struct UUT_SESSION *session)
+{
+	struct ASYNC_QUEUE	*q  = session->async;
+	struct ASYNC_OP		*op = q->head;
+	UINT8			respCmd;
+
+	switch (op->type) {
+	case ASYNC_OP_READ:
+		respCmd = (UINT8)UFPP_READ_CMD;
+		break;
+	case ASYNC_OP_WRITE:
+		respCmd = (UINT8)UFPP_WRITE_CMD;
+		break;
+	default:
+		respCmd = (UINT8)UFPP_FCALL_CMD;
+		break;
+	}
+
+	if (session->respBuf[0] != respCmd) {
+		ASYNC_Retry(session);
+		return;
+	}
+
+	q->busy  = FALSE;
+	q->trial = 0;
+
+	/* The caller may have released the buffers once it cancelled */
+	if (op->cancel) {
+		ASYNC_Finish(session, op, EC_CANCEL_ERR);
+		return;
+	}
+
+	if (op->type == ASYNC_OP_READ)
+		memcpy(op->dst + op->offset, session->respBuf + 1, q->pktLen);
+	else if (op->type == ASYNC_OP_CALL)
+		op->dst[0] = session->respBuf[2];
+
+	op->offset += q->pktLen;
+
+	if (op->cb.progress != NULL)
+		op->cb.progress(op->id, op->offset, op->size, op->cb.arg);
+
+	if (op->offset == op->size)
+		ASYNC_Finish(session, op, EC_OK);
+}
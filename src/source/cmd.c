@@ -17,7 +17,9 @@
 
 #include "uut_types.h"
 #include "program.h"
+#include "ComPort.h"
 #include "cmd.h"
+#include "session.h"
 #include "lib_crc.h"
 
 /*----------------------------------------------------------------------------
@@ -44,8 +46,6 @@ union cmd_addr {
 	UINT32 h_adr;
 };
 
-extern UINT32          crc_type;  // 16/32
-
 /*----------------------------------------------------------------------------
  * Functions implementation
  *---------------------------------------------------------------------------
@@ -99,7 +99,8 @@ void CMD_CreateSync(UINT8  *cmdInfo, UINT32 *cmdLen)
 /*---------------------------------------------------------------------------
  * Function:        CMD_CreateWrite
  *
- * Parameters:	addr    - Memory address to write to.
+ * Parameters:	session - Session, selecting the CRC type.
+ *		addr    - Memory address to write to.
  *		size    - Size of daya (in bytes) to write to memory.
  *		dataBuf - Pointer to data buffer containing raw data to write.
  *		cmdInfo - Pointer to a command buffer.
@@ -113,9 +114,10 @@ void CMD_CreateSync(UINT8  *cmdInfo, UINT32 *cmdLen)
  *	The total command length is written to 'cmdLen'.
  *---------------------------------------------------------------------------
  */
-void CMD_CreateWrite(UINT32  addr,
+void CMD_CreateWrite(const struct UUT_SESSION *session,
+		     UINT32  addr,
 		     UINT32  size,
-		     UINT8  *dataBuf,
+		     const UINT8 *dataBuf,
 		     UINT8  *cmdInfo,
 		     UINT32 *cmdLen)
 {
@@ -142,7 +144,7 @@ void CMD_CreateWrite(UINT32  addr,
 	/* Calculate CRC */
 
 	for (i = 0; i < len; i++) {
-		if (crc_type == 32)
+		if (session->crcType == 32)
 			crc = update_crc32(crc, (char)cmdInfo[i]);
 		else
 			crc = update_crc16((UINT16)crc, (char)cmdInfo[i]);
@@ -159,7 +161,8 @@ void CMD_CreateWrite(UINT32  addr,
 /*----------------------------------------------------------------------------
  * Function:	CMD_CreateRead
  *
- * Parameters:	addr    - Memory address to read from.
+ * Parameters:	session - Session, selecting the CRC type.
+ *		addr    - Memory address to read from.
  *		size    - Size of daya (in bytes) to read from memory.
  *		cmdInfo - Pointer to a command buffer.
  *		cmdLen  - Pointer to command length.
@@ -172,7 +175,8 @@ void CMD_CreateWrite(UINT32  addr,
  *		The total command length is written to 'cmdLen'.
  *---------------------------------------------------------------------------
  */
-void CMD_CreateRead(UINT32  addr, UINT8   size, UINT8  *cmdInfo, UINT32 *cmdLen)
+void CMD_CreateRead(const struct UUT_SESSION *session,
+		    UINT32  addr, UINT8   size, UINT8  *cmdInfo, UINT32 *cmdLen)
 {
 	UINT32		i;
 	union cmd_addr	adr_tr;
@@ -192,7 +196,7 @@ void CMD_CreateRead(UINT32  addr, UINT8   size, UINT8  *cmdInfo, UINT32 *cmdLen)
 
 	/* Calculate CRC */
 	for (i = 0; i < len; i++) {
-		if (crc_type == 32)
+		if (session->crcType == 32)
 			crc = update_crc32(crc, (char)cmdInfo[i]);
 		else
 			crc = update_crc16((UINT16)crc, (char)cmdInfo[i]);
@@ -209,7 +213,8 @@ void CMD_CreateRead(UINT32  addr, UINT8   size, UINT8  *cmdInfo, UINT32 *cmdLen)
 /*----------------------------------------------------------------------------
  * Function:	CMD_CreateExec
  *
- * Parameters:	addr    - Memory address to execute from.
+ * Parameters:	session - Session, selecting the CRC type.
+ *		addr    - Memory address to execute from.
  *		cmdInfo - Pointer to a command buffer.
  *		cmdLen  - Pointer to command length.
  * Returns:     none.
@@ -221,7 +226,8 @@ void CMD_CreateRead(UINT32  addr, UINT8   size, UINT8  *cmdInfo, UINT32 *cmdLen)
  *		The total command length is written to 'cmdLen'.
  *---------------------------------------------------------------------------
  */
-void CMD_CreateExec(UINT32  addr, UINT8  *cmdInfo, UINT32 *cmdLen)
+void CMD_CreateExec(const struct UUT_SESSION *session,
+		    UINT32  addr, UINT8  *cmdInfo, UINT32 *cmdLen)
 {
 	UINT32		i;
 	union cmd_addr	adr_tr;
@@ -241,7 +247,7 @@ void CMD_CreateExec(UINT32  addr, UINT8  *cmdInfo, UINT32 *cmdLen)
 
 	/* Calculate CRC */
 	for (i = 0; i < len; i++) {
-		if (crc_type == 32)
+		if (session->crcType == 32)
 			crc = update_crc32(crc, (char)cmdInfo[i]);
 		else
 			crc = update_crc16((UINT16)crc, (char)cmdInfo[i]);
@@ -258,7 +264,7 @@ void CMD_CreateExec(UINT32  addr, UINT8  *cmdInfo, UINT32 *cmdLen)
 /*---------------------------------------------------------------------------
 * Function:        CMD_BuildSetDevPortToHigh
 *
-* Parameters:	cmdBuf - Pointer to a command buffer.
+* Parameters:	session - Session, holding the command buffer.
 *		cmdLen - Pointer to command length.
 * Returns:	none.
 * Description:
@@ -266,9 +272,10 @@ void CMD_CreateExec(UINT32  addr, UINT8  *cmdInfo, UINT32 *cmdLen)
 *		The total command number is written to 'cmdNum'.
 *---------------------------------------------------------------------------
 */
-void CMD_BuildSetDevPortToHigh(struct ComandNode *cmdBuf, UINT32 *cmdNum)
+void CMD_BuildSetDevPortToHigh(struct UUT_SESSION *session, UINT32 *cmdNum)
 {
-	UINT32 nCmd = 0;
+	struct ComandNode	*cmdBuf = session->cmdBuf;
+	UINT32			nCmd = 0;
 
 	CMD_CreateSetDevPortToHigh(cmdBuf[nCmd].cmd, &cmdBuf[nCmd].cmdSize);
 	cmdBuf[nCmd].respSize = 0;
@@ -280,7 +287,7 @@ void CMD_BuildSetDevPortToHigh(struct ComandNode *cmdBuf, UINT32 *cmdNum)
 /*---------------------------------------------------------------------------
  * Function:        CMD_BuildSync
  *
- * Parameters:	cmdBuf - Pointer to a command buffer.
+ * Parameters:	session - Session, holding the command buffer.
  *		cmdLen - Pointer to command length.
  * Returns:	none.
  * Description:
@@ -288,9 +295,10 @@ void CMD_BuildSetDevPortToHigh(struct ComandNode *cmdBuf, UINT32 *cmdNum)
  *		The total command number is written to 'cmdNum'.
  *---------------------------------------------------------------------------
  */
-void CMD_BuildSync(struct ComandNode *cmdBuf, UINT32       *cmdNum)
+void CMD_BuildSync(struct UUT_SESSION *session, UINT32 *cmdNum)
 {
-	UINT32 nCmd = 0;
+	struct ComandNode	*cmdBuf = session->cmdBuf;
+	UINT32			nCmd = 0;
 
 	CMD_CreateSync(cmdBuf[nCmd].cmd, &cmdBuf[nCmd].cmdSize);
 	cmdBuf[nCmd].respSize = 1;
@@ -302,8 +310,8 @@ void CMD_BuildSync(struct ComandNode *cmdBuf, UINT32       *cmdNum)
 /*----------------------------------------------------------------------------
  * Function:	CMD_BuildExecExit
  *
- * Parameters:	addr   - Memory address to execute from.
- *		cmdBuf - Pointer to a command buffer.
+ * Parameters:	session - Session, holding the command buffer.
+ *		addr    - Memory address to execute from.
  *		cmdLen - Pointer to command length.
  * Returns:	none.
  * Side effects:
@@ -316,11 +324,13 @@ void CMD_BuildSync(struct ComandNode *cmdBuf, UINT32       *cmdNum)
  *		The total command number is written to 'cmdNum'.
  *---------------------------------------------------------------------------
  */
-void CMD_BuildExecExit(UINT32  addr, struct ComandNode *cmdBuf, UINT32 *cmdNum)
+void CMD_BuildExecExit(struct UUT_SESSION *session, UINT32 addr,
+		       UINT32 *cmdNum)
 {
-	UINT32 nCmd = 0;
+	struct ComandNode	*cmdBuf = session->cmdBuf;
+	UINT32			nCmd = 0;
 
-	CMD_CreateExec(addr, cmdBuf[nCmd].cmd, &cmdBuf[nCmd].cmdSize);
+	CMD_CreateExec(session, addr, cmdBuf[nCmd].cmd, &cmdBuf[nCmd].cmdSize);
 	cmdBuf[nCmd].respSize = 1;
 	nCmd++;
 
@@ -330,8 +340,8 @@ void CMD_BuildExecExit(UINT32  addr, struct ComandNode *cmdBuf, UINT32 *cmdNum)
 /*----------------------------------------------------------------------------
  * Function:	CMD_BuildExecRet
  *
- * Parameters:	addr   - Memory address to execute from.
- *		cmdBuf - Pointer to a command buffer.
+ * Parameters:	session - Session, holding the command buffer.
+ *		addr    - Memory address to execute from.
  *		cmdLen - Pointer to command length.
  * Returns:	none.
  * Side effects:
@@ -344,11 +354,13 @@ void CMD_BuildExecExit(UINT32  addr, struct ComandNode *cmdBuf, UINT32 *cmdNum)
  *		The total command number is written to 'cmdNum'.
  *---------------------------------------------------------------------------
  */
-void CMD_BuildExecRet(UINT32  addr, struct ComandNode *cmdBuf, UINT32  *cmdNum)
+void CMD_BuildExecRet(struct UUT_SESSION *session, UINT32 addr,
+		      UINT32 *cmdNum)
 {
-	UINT32 nCmd = 0;
+	struct ComandNode	*cmdBuf = session->cmdBuf;
+	UINT32			nCmd = 0;
 
-	CMD_CreateExec(addr, cmdBuf[nCmd].cmd, &cmdBuf[nCmd].cmdSize);
+	CMD_CreateExec(session, addr, cmdBuf[nCmd].cmd, &cmdBuf[nCmd].cmdSize);
 	cmdBuf[nCmd].respSize = 3;
 	nCmd++;
 
@@ -379,22 +391,26 @@ BOOLEAN CMD_DispSync(UINT8 *respBuf)
 /*----------------------------------------------------------------------------
  * Function:	CMD_DispWrite
  *
- * Parameters:	respBuf - Pointer to a response buffer.
+ * Parameters:	session - Session, holding the response buffer.
  *		respSize - Response size.
  *		respNum - Response packet number.
  * Returns:	TRUE if successful, FALSE in the case of an error.
  * Side effects:
  * Description:
- *		Display WRITE command response information.
+ *		Display WRITE command response information. The progress
+ *		is displayed in verbose mode only.
  *---------------------------------------------------------------------------
  */
-BOOLEAN CMD_DispWrite(UINT8 *respBuf,
+BOOLEAN CMD_DispWrite(const struct UUT_SESSION *session,
 		      UINT32 respSize,
 		      UINT32 respNum,
 		      UINT32 totalSize)
 {
+	const UINT8 *respBuf = session->respBuf;
+
 	if (respBuf[0] == (UINT8)(UFPP_WRITE_CMD)) {
-		displayColorMsg(SUCCESS,
+		if (session->verbose)
+			displayColorMsg(SUCCESS,
 	"\rTransmitted packet of size %lu bytes, packet [%lu]out of [%lu]",
 			respSize, respNum, totalSize);
 		return TRUE;
@@ -407,22 +423,26 @@ BOOLEAN CMD_DispWrite(UINT8 *respBuf,
 /*-----------------------------------------------------------------------------
  * Function:	CMD_DispRead
  *
- * Parameters:	respBuf  - Pointer to a response buffer.
+ * Parameters:	session  - Session, holding the response buffer.
  *		respSize - Response size.
  *		respNum  - Response packet number.
  * Returns:	TRUE if successful, FALSE in the case of an error.
  * Side effects:
  * Description:
- *		Display READ command response information.
+ *		Display READ command response information. The progress
+ *		is displayed in verbose mode only.
  *---------------------------------------------------------------------------
  */
-BOOLEAN CMD_DispRead(UINT8 *respBuf,
+BOOLEAN CMD_DispRead(const struct UUT_SESSION *session,
 		     UINT32 respSize,
 		     UINT32 respNum,
 		     UINT32 totalSize)
 {
+	const UINT8 *respBuf = session->respBuf;
+
 	if (respBuf[0] == (UINT8)(UFPP_READ_CMD)) {
-		displayColorMsg(SUCCESS,
+		if (session->verbose)
+			displayColorMsg(SUCCESS,
 	"\rReceived packet of size %lu bytes, packet [%lu] out of [%lu]",
 	respSize, respNum, totalSize);
 		return TRUE;
@@ -0,0 +1,483 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   daemon.c
+ *	This file implements the daemon mode and its client.
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+#include "uut_types.h"
+#include "ComPort.h"
+#include "program.h"
+#include "opr.h"
+#include "session.h"
+#include "script.h"
+#include "daemon.h"
+
+/*----------------------------------------------------------------------------
+ * Internal types
+ *---------------------------------------------------------------------------
+ */
+struct DAEMON_CONN {
+	int	fd;
+	char	rx[MAX_SCRIPT_LINE_SIZE];
+	UINT32	rxLen;
+};
+
+/*---------------------------------------------------------------------------
+ * Local variables
+ *---------------------------------------------------------------------------
+ */
+static volatile sig_atomic_t DaemonStop;
+
+/*---------------------------------------------------------------------------
+ * Functions prototypes
+ *---------------------------------------------------------------------------
+ */
+static void	DAEMON_Signal(int sig);
+static BOOLEAN	DAEMON_SockAddr(const char *sockPath, struct sockaddr_un *addr);
+static BOOLEAN	DAEMON_SendLine(int fd, const char *fmt, ...);
+static BOOLEAN	DAEMON_ReadLine(struct DAEMON_CONN *conn, char *line,
+				UINT32 size);
+static BOOLEAN	DAEMON_InUse(const char *sockPath,
+			     const struct sockaddr_un *addr);
+static UINT32	DAEMON_ExecJob(struct UUT_SESSION *session, char *line,
+			       BOOLEAN *quit);
+static UINT32	DAEMON_SubmitJob(struct DAEMON_CONN *conn, const char *job);
+
+/*---------------------------------------------------------------------------
+ * Functions implementation
+ *---------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------------
+ * Function:	DAEMON_Signal
+ *
+ * Parameters:	sig - received signal.
+ * Returns:	none
+ * Side effects: Makes DAEMON_Run stop after the current client.
+ *---------------------------------------------------------------------------
+ */
+static void DAEMON_Signal(int sig)
+{
+	(void)sig;
+	DaemonStop = 1;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	DAEMON_SockAddr
+ *
+ * Parameters:	sockPath - Unix domain socket path.
+ *		addr     - the socket address.
+ * Returns:	FALSE if the path does not fit a socket address.
+ *---------------------------------------------------------------------------
+ */
+static BOOLEAN DAEMON_SockAddr(const char *sockPath, struct sockaddr_un *addr)
+{
+	memset(addr, 0, sizeof(*addr));
+	addr->sun_family = AF_UNIX;
+
+	if (strlen(sockPath) >= sizeof(addr->sun_path)) {
+		displayColorMsg(FAIL, "ERROR: socket path [%s] is too long\n",
+				sockPath);
+		return FALSE;
+	}
+
+	strcpy(addr->sun_path, sockPath);
+
+	return TRUE;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	DAEMON_SendLine
+ *
+ * Parameters:	fd  - connected socket.
+ *		fmt - line to send (format and arguments), without '\n'.
+ * Returns:	FALSE if the peer is gone.
+ *---------------------------------------------------------------------------
+ */
+static BOOLEAN DAEMON_SendLine(int fd, const char *fmt, ...)
+{
+	char	line[MAX_SCRIPT_LINE_SIZE + 1];
+	va_list	argptr;
+	int	len;
+	int	sent = 0;
+	int	ret;
+
+	va_start(argptr, fmt);
+	len = vsnprintf(line, sizeof(line) - 1, fmt, argptr);
+	va_end(argptr);
+
+	if ((len < 0) || (len >= (int)sizeof(line) - 1))
+		return FALSE;
+
+	line[len++] = '\n';
+
+	while (sent < len) {
+		ret = send(fd, line + sent, len - sent, MSG_NOSIGNAL);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return FALSE;
+		}
+		sent += ret;
+	}
+
+	return TRUE;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	DAEMON_ReadLine
+ *
+ * Parameters:	conn - connection, holding the bytes received so far.
+ *		line - the received line, without the '\n'.
+ *		size - size of line.
+ * Returns:	FALSE if the peer is gone or sent a too long line.
+ *---------------------------------------------------------------------------
+ */
+static BOOLEAN DAEMON_ReadLine(struct DAEMON_CONN *conn, char *line,
+			       UINT32 size)
+{
+	char	*end;
+	UINT32	len;
+	int	ret;
+
+	while (TRUE) {
+		end = memchr(conn->rx, '\n', conn->rxLen);
+		if (end != NULL) {
+			len = (UINT32)(end - conn->rx);
+			if (len >= size)
+				return FALSE;
+
+			memcpy(line, conn->rx, len);
+			line[len] = '\0';
+
+			conn->rxLen -= len + 1;
+			memmove(conn->rx, end + 1, conn->rxLen);
+
+			return TRUE;
+		}
+
+		if (conn->rxLen == sizeof(conn->rx))
+			return FALSE;
+
+		ret = recv(conn->fd, conn->rx + conn->rxLen,
+			   sizeof(conn->rx) - conn->rxLen, 0);
+		if (ret < 0 && errno == EINTR && !DaemonStop)
+			continue;
+		if (ret <= 0)
+			return FALSE;
+
+		conn->rxLen += ret;
+	}
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	DAEMON_InUse
+ *
+ * Parameters:	sockPath - Unix domain socket path to listen on.
+ *		addr     - the socket address.
+ * Returns:	TRUE if the path cannot be used.
+ * Side effects: Removes a stale socket of that path.
+ * Description:
+ *	Only a socket nobody listens on any more is removed. Any other file,
+ *	or the socket of a running daemon, is left alone.
+ *---------------------------------------------------------------------------
+ */
+static BOOLEAN DAEMON_InUse(const char *sockPath,
+			    const struct sockaddr_un *addr)
+{
+	struct stat	st;
+	int		fd;
+	BOOLEAN		answered;
+
+	if (lstat(sockPath, &st) != 0)
+		return FALSE;
+
+	if (!S_ISSOCK(st.st_mode)) {
+		displayColorMsg(FAIL, "ERROR: [%s] exists and is not a socket\n",
+				sockPath);
+		return TRUE;
+	}
+
+	fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+		return TRUE;
+	answered = (connect(fd, (const struct sockaddr *)addr,
+			    sizeof(*addr)) == 0);
+	close(fd);
+
+	if (answered) {
+		displayColorMsg(FAIL, "ERROR: a daemon already listens on [%s]\n",
+				sockPath);
+		return TRUE;
+	}
+
+	unlink(sockPath);
+
+	return FALSE;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	DAEMON_ExecJob
+ *
+ * Parameters:	session - session to use.
+ *		line - job line, altered by the execution.
+ *		quit - set when the job asks the daemon to stop.
+ * Returns:	EC_OK on success, otherwise the EXIT_CODE of the failure.
+ * Side effects:
+ * Description:
+ *	Run a daemon-only job (cd, sync, reset, quit) or a script operation.
+ * *---------------------------------------------------------------------------
+ */
+static UINT32 DAEMON_ExecJob(struct UUT_SESSION *session, char *line,
+			     BOOLEAN *quit)
+{
+	char	job[MAX_PARAM_SIZE];
+	char	dir[MAX_SCRIPT_LINE_SIZE];
+
+	if (sscanf(line, "%127s", job) != 1)
+		return EC_OK;
+
+	if (strcmp(job, DAEMON_JOB_CD) == 0) {
+		if ((sscanf(line, "%*s %1023[^\r\n]", dir) != 1) ||
+		    (chdir(dir) != 0)) {
+			displayColorMsg(FAIL,
+				"ERROR: could not change directory [%s]\n",
+				line);
+			return EC_FILE_ERR;
+		}
+		return EC_OK;
+	}
+
+	if ((strcmp(job, DAEMON_JOB_RESET) == 0) &&
+	    !OPR_ResetDevice(session))
+		return EC_PORT_ERR;
+
+	if ((strcmp(job, DAEMON_JOB_SYNC) == 0) ||
+	    (strcmp(job, DAEMON_JOB_RESET) == 0))
+		return (OPR_CheckSync(session, session->portCfg.BaudRate) ==
+			SR_OK) ?
+			EC_OK : EC_SYNC_ERR;
+
+	if (strcmp(job, DAEMON_JOB_QUIT) == 0) {
+		*quit = TRUE;
+		return EC_OK;
+	}
+
+	return SCRIPT_ExecLine(session, line);
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	DAEMON_Run
+ *
+ * Parameters:	session  - session to serve.
+ *		sockPath - Unix domain socket path to listen on.
+ * Returns:	EC_OK when stopped by a quit job or a signal, otherwise the
+ *		EXIT_CODE of the failure.
+ * Side effects: Removes a stale socket of the same path.
+ * Description:
+ *	Serve clients one at a time, running their jobs in order over the
+ *	opened port. The socket is accessible by its owner only.
+ *---------------------------------------------------------------------------
+ */
+UINT32 DAEMON_Run(struct UUT_SESSION *session, const char *sockPath)
+{
+	struct sockaddr_un	addr;
+	struct sigaction	sa;
+	struct DAEMON_CONN	conn;
+	char			line[MAX_SCRIPT_LINE_SIZE];
+	int			listenFd;
+	UINT32			ret_val;
+	UINT32			exitCode = EC_OK;
+	BOOLEAN			quit = FALSE;
+
+	if (!DAEMON_SockAddr(sockPath, &addr))
+		return EC_FILE_ERR;
+
+	listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listenFd < 0) {
+		displayColorMsg(FAIL, "ERROR: could not create a socket\n");
+		return EC_PORT_ERR;
+	}
+
+	if (DAEMON_InUse(sockPath, &addr)) {
+		close(listenFd);
+		return EC_FILE_ERR;
+	}
+
+	/* Nobody can connect before listen(), so restrict the mode first */
+	if ((bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) != 0) ||
+	    (chmod(sockPath, S_IRUSR | S_IWUSR) != 0) ||
+	    (listen(listenFd, DAEMON_BACKLOG) != 0)) {
+		displayColorMsg(FAIL, "ERROR: could not listen on [%s]\n",
+				sockPath);
+		close(listenFd);
+		unlink(sockPath);
+		return EC_FILE_ERR;
+	}
+
+	/* No SA_RESTART, so that a signal interrupts accept() and recv() */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = DAEMON_Signal;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	displayColorMsg(SUCCESS, "Daemon listening on %s\n", sockPath);
+
+	while (!quit && !DaemonStop) {
+		conn.fd = accept(listenFd, NULL, NULL);
+		if ((conn.fd < 0) && (errno == EINTR))
+			continue;
+		if (conn.fd < 0) {
+			displayColorMsg(FAIL,
+				"ERROR: could not accept a client on [%s]\n",
+				sockPath);
+			exitCode = EC_PORT_ERR;
+			break;
+		}
+
+		conn.rxLen = 0;
+		while (!quit && DAEMON_ReadLine(&conn, line, sizeof(line))) {
+			SESSION_MSG(session, ("Job: %s\n", line));
+
+			ret_val = DAEMON_ExecJob(session, line, &quit);
+			if (!DAEMON_SendLine(conn.fd, "%s %u",
+					     (ret_val == EC_OK) ?
+					     DAEMON_REPLY_OK : DAEMON_REPLY_ERR,
+					     ret_val))
+				break;
+		}
+
+		close(conn.fd);
+	}
+
+	close(listenFd);
+	unlink(sockPath);
+
+	SESSION_MSG(session, ("Daemon stopped\n"));
+
+	return exitCode;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	DAEMON_SubmitJob
+ *
+ * Parameters:	conn - connection to the daemon.
+ *		job  - job line, without '\n'.
+ * Returns:	The EXIT_CODE replied by the daemon.
+ *---------------------------------------------------------------------------
+ */
+static UINT32 DAEMON_SubmitJob(struct DAEMON_CONN *conn, const char *job)
+{
+	char	reply[MAX_SCRIPT_LINE_SIZE];
+	UINT32	code;
+
+	if (!DAEMON_SendLine(conn->fd, "%s", job) ||
+	    !DAEMON_ReadLine(conn, reply, sizeof(reply))) {
+		displayColorMsg(FAIL, "ERROR: daemon connection lost\n");
+		return EC_PORT_ERR;
+	}
+
+	if (sscanf(reply, "%*s %u", &code) != 1)
+		return EC_UNSUPPORTED_CMD_ERR;
+
+	return code;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	DAEMON_Client
+ *
+ * Parameters:	sockPath   - Unix domain socket path of the daemon.
+ *		job        - a single job line, NULL to send scriptName.
+ *		scriptName - script file whose lines are sent as jobs.
+ * Returns:	EC_OK if all the jobs succeeded, otherwise the EXIT_CODE of
+ *		the first failing job.
+ * Side effects:
+ * Description:
+ *	Submit jobs to a running daemon, after moving the daemon to the
+ *	client's current directory.
+ *---------------------------------------------------------------------------
+ */
+UINT32 DAEMON_Client(const char *sockPath, const char *job,
+		     const char *scriptName)
+{
+	struct sockaddr_un	addr;
+	struct DAEMON_CONN	conn;
+	char			cwd[MAX_SCRIPT_LINE_SIZE - sizeof(DAEMON_JOB_CD)];
+	char			line[MAX_SCRIPT_LINE_SIZE];
+	FILE			*scriptID = NULL;
+	UINT32			ret_val;
+
+	if (!DAEMON_SockAddr(sockPath, &addr))
+		return EC_FILE_ERR;
+
+	if (job == NULL) {
+		scriptID = fopen(scriptName, "r");
+		if (scriptID == NULL) {
+			displayColorMsg(FAIL,
+				"ERROR: could not open script file [%s]\n",
+				scriptName);
+			return EC_FILE_ERR;
+		}
+	}
+
+	conn.fd    = socket(AF_UNIX, SOCK_STREAM, 0);
+	conn.rxLen = 0;
+	if ((conn.fd < 0) ||
+	    (connect(conn.fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)) {
+		displayColorMsg(FAIL, "ERROR: no daemon listening on [%s]\n",
+				sockPath);
+		if (conn.fd >= 0)
+			close(conn.fd);
+		if (scriptID != NULL)
+			fclose(scriptID);
+		return EC_PORT_ERR;
+	}
+
+	ret_val = EC_FILE_ERR;
+	if (getcwd(cwd, sizeof(cwd)) != NULL) {
+		snprintf(line, sizeof(line), "%s %s", DAEMON_JOB_CD, cwd);
+		ret_val = DAEMON_SubmitJob(&conn, line);
+	}
+
+	if ((ret_val == EC_OK) && (job != NULL)) {
+		ret_val = DAEMON_SubmitJob(&conn, job);
+	} else if (ret_val == EC_OK) {
+		while (fgets(line, sizeof(line), scriptID) != NULL) {
+			line[strcspn(line, "\r\n")] = '\0';
+
+			ret_val = DAEMON_SubmitJob(&conn, line);
+			if (ret_val != EC_OK)
+				break;
+		}
+	}
+
+	if (ret_val != EC_OK)
+		displayColorMsg(FAIL, "ERROR: job failed, error = %u\n",
+				ret_val);
+
+	close(conn.fd);
+	if (scriptID != NULL)
+		fclose(scriptID);
+
+	return ret_val;
+}
@@ -0,0 +1,769 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   farm.c
+ *	This file implements the farm mode.
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <fnmatch.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+
+#include "uut_types.h"
+#include "ComPort.h"
+#include "program.h"
+#include "opr.h"
+#include "session.h"
+#include "script.h"
+#include "multi.h"
+#include "farm.h"
+
+/*----------------------------------------------------------------------------
+ * Constant definitions
+ *---------------------------------------------------------------------------
+ */
+#define FARM_DEV_PREFIX		"/dev/"
+#define FARM_UEVENT_GROUP	1		/* Kernel events */
+#define FARM_UEVENT_RCVBUF	(1024 * 1024)
+#define FARM_SUBSYSTEM		"tty"
+
+/*----------------------------------------------------------------------------
+ * Internal types
+ *---------------------------------------------------------------------------
+ */
+enum FARM_STATE {
+	FS_FREE = 0,
+	FS_QUEUED,	/* Waiting for a worker */
+	FS_RUNNING,
+	FS_DONE		/* Served, waiting to be unplugged */
+};
+
+enum FARM_RESULT {
+	FR_PASS = 0,
+	FR_FAIL,
+	FR_CANCELLED,
+	FR_SKIPPED,	/* Serial number already programmed */
+	FR_NUM
+};
+
+struct FARM_BOARD {
+	enum FARM_STATE		state;
+	BOOLEAN			removed;
+	struct COMPORT_INFO	info;
+	struct UUT_SESSION	session;
+	UINT32			result;		/* EXIT_CODE of the last job */
+	unsigned long long	elapsedUs;	/* Last job time */
+};
+
+struct FARM {
+	const struct UUT_SESSION *proto;
+	const char		*ports;
+	const char		*scriptName;
+	const char		*metricsFile;
+
+	/* Guarded by lock */
+	struct FARM_BOARD	boards[FARM_MAX_BOARDS];
+	UINT32			queue[FARM_MAX_BOARDS];	/* Board indexes */
+	UINT32			queueHead;
+	UINT32			queueLen;
+	char			done[FARM_MAX_DONE][MAX_COMPORT_SERIAL_SIZE];
+	UINT32			numDone;
+	UINT32			active;
+	UINT32			jobs[FR_NUM];
+	BOOLEAN			stop;
+	UINT32			metricsSeq;	/* Snapshots taken */
+	pthread_mutex_t		lock;
+	pthread_cond_t		wake;
+
+	/* Guarded by metricsLock */
+	UINT32			metricsWritten;	/* Last snapshot written */
+	pthread_mutex_t		metricsLock;
+};
+
+/*---------------------------------------------------------------------------
+ * Local variables
+ *---------------------------------------------------------------------------
+ */
+static struct FARM		Farm = {
+	.lock = PTHREAD_MUTEX_INITIALIZER,
+	.wake = PTHREAD_COND_INITIALIZER,
+	.metricsLock = PTHREAD_MUTEX_INITIALIZER
+};
+static volatile sig_atomic_t	FarmStop;
+static const char * const	FarmResultName[FR_NUM] = {
+	"pass", "fail", "cancelled", "skipped"
+};
+
+/*---------------------------------------------------------------------------
+ * Functions prototypes
+ *---------------------------------------------------------------------------
+ */
+static void	FARM_Signal(int sig);
+static BOOLEAN	FARM_IsServed(const char *name);
+static INT32	FARM_FindBoard(const char *name);
+static BOOLEAN	FARM_IsDone(const struct COMPORT_INFO *info);
+static void	FARM_Identify(const char *name, struct COMPORT_INFO *info);
+static void	FARM_Add(const struct COMPORT_INFO *info);
+static void	FARM_Remove(const char *name);
+static void	FARM_Rescan(void);
+static void	FARM_Unlock(void);
+static void	*FARM_Worker(void *arg);
+static void	FARM_ReadUevent(int fd);
+
+/*---------------------------------------------------------------------------
+ * Functions implementation
+ *---------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------------
+ * Function:	FARM_Signal
+ *
+ * Parameters:	sig - received signal.
+ * Returns:	none
+ * Side effects: Makes FARM_Run stop.
+ *---------------------------------------------------------------------------
+ */
+static void FARM_Signal(int sig)
+{
+	(void)sig;
+	FarmStop = 1;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	FARM_IsServed
+ *
+ * Parameters:	name - port name, relative to /dev.
+ * Returns:	TRUE when the name matches one of the farm port patterns.
+ *---------------------------------------------------------------------------
+ */
+static BOOLEAN FARM_IsServed(const char *name)
+{
+	char	patterns[MULTI_MAX_BOARDS * MAX_PARAM_SIZE];
+	char	*pattern;
+	char	*save;
+
+	snprintf(patterns, sizeof(patterns), "%s", Farm.ports);
+
+	for (pattern = strtok_r(patterns, MULTI_PORT_SEPS, &save);
+	     pattern != NULL;
+	     pattern = strtok_r(NULL, MULTI_PORT_SEPS, &save)) {
+		if (strncmp(pattern, FARM_DEV_PREFIX,
+			    strlen(FARM_DEV_PREFIX)) == 0)
+			pattern += strlen(FARM_DEV_PREFIX);
+
+		if (fnmatch(pattern, name, 0) == 0)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	FARM_FindBoard
+ *
+ * Parameters:	name - port name.
+ * Returns:	Index of the board on that port, -1 if none.
+ *---------------------------------------------------------------------------
+ */
+static INT32 FARM_FindBoard(const char *name)
+{
+	UINT32 i;
+
+	for (i = 0; i < FARM_MAX_BOARDS; i++) {
+		if ((Farm.boards[i].state != FS_FREE) &&
+		    !Farm.boards[i].removed &&
+		    (strcmp(Farm.boards[i].info.Name, name) == 0))
+			return (INT32)i;
+	}
+
+	return -1;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	FARM_IsDone
+ *
+ * Parameters:	info - board port identity.
+ * Returns:	TRUE when a board of the same USB serial number passed.
+ *---------------------------------------------------------------------------
+ */
+static BOOLEAN FARM_IsDone(const struct COMPORT_INFO *info)
+{
+	UINT32 i;
+
+	if (!info->IsUsb || (info->Serial[0] == '\0'))
+		return FALSE;
+
+	for (i = 0; i < MIN(Farm.numDone, FARM_MAX_DONE); i++) {
+		if (strcmp(Farm.done[i], info->Serial) == 0)
+			return TRUE;
+	}
+
+	return FALSE;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	FARM_Identify
+ *
+ * Parameters:	name - port name.
+ *		info - the port identity.
+ * Returns:	none
+ * Side effects:
+ * Description:
+ *	Get the port driver and USB identity. A port not enumerated, e.g. a
+ *	link to a pseudo terminal, is known by its name only. Enumerating
+ *	the ports is slow, so this is called without the farm lock.
+ *---------------------------------------------------------------------------
+ */
+static void FARM_Identify(const char *name, struct COMPORT_INFO *info)
+{
+	struct COMPORT_INFO		*found;
+	UINT32				numPorts;
+	UINT32				i;
+
+	memset(info, 0, sizeof(*info));
+	snprintf(info->Name, sizeof(info->Name), "%s", name);
+
+	found = (struct COMPORT_INFO *)malloc(MAX_COMPORT_ENUM *
+					      sizeof(*found));
+	if (found == NULL)
+		return;
+
+	numPorts = ComPortEnumerate(found, MAX_COMPORT_ENUM);
+	for (i = 0; i < numPorts; i++) {
+		if (strcmp(found[i].Name, name) == 0) {
+			*info = found[i];
+			break;
+		}
+	}
+
+	free(found);
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	FARM_Add
+ *
+ * Parameters:	info - identity of the port which appeared, called with
+ *		       the farm lock held.
+ * Returns:	none
+ * Side effects:
+ * Description:
+ *	Queue a job for a new board, unless its serial number passed.
+ *---------------------------------------------------------------------------
+ */
+static void FARM_Add(const struct COMPORT_INFO *info)
+{
+	const char		*name = info->Name;
+	struct FARM_BOARD	*board = NULL;
+	UINT32			i;
+
+	if (!FARM_IsServed(name) || (FARM_FindBoard(name) >= 0))
+		return;
+
+	for (i = 0; (i < FARM_MAX_BOARDS) && (board == NULL); i++) {
+		if (Farm.boards[i].state == FS_FREE)
+			board = &Farm.boards[i];
+	}
+
+	if (board == NULL) {
+		displayColorMsg(FAIL, "ERROR: %s ignored, %u boards present\n",
+				name, FARM_MAX_BOARDS);
+		return;
+	}
+
+	memset(board, 0, sizeof(*board));
+	board->info = *info;
+
+	if (board->info.IsUsb)
+		displayColorMsg(SUCCESS, "Board %s plugged (USB %04x:%04x serial %s)\n",
+				name, board->info.VendorId,
+				board->info.ProductId,
+				board->info.Serial[0] ? board->info.Serial : "-");
+	else
+		displayColorMsg(SUCCESS, "Board %s plugged\n", name);
+
+	if (FARM_IsDone(&board->info)) {
+		displayColorMsg(SUCCESS, "Board %s: serial %s already programmed\n",
+				name, board->info.Serial);
+		Farm.jobs[FR_SKIPPED]++;
+		board->state = FS_DONE;
+		return;
+	}
+
+	board->state = FS_QUEUED;
+	Farm.queue[(Farm.queueHead + Farm.queueLen) % FARM_MAX_BOARDS] =
+		(UINT32)(board - Farm.boards);
+	Farm.queueLen++;
+
+	pthread_cond_signal(&Farm.wake);
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	FARM_Remove
+ *
+ * Parameters:	name - port which disappeared, called with the farm lock held.
+ * Returns:	none
+ * Side effects: Cancels the board job.
+ *---------------------------------------------------------------------------
+ */
+static void FARM_Remove(const char *name)
+{
+	struct FARM_BOARD	*board;
+	INT32			index = FARM_FindBoard(name);
+	UINT32			i;
+
+	if (index < 0)
+		return;
+
+	board = &Farm.boards[index];
+	board->removed = TRUE;
+
+	switch (board->state) {
+	case FS_QUEUED:
+		for (i = 0; i < Farm.queueLen; i++) {
+			if (Farm.queue[(Farm.queueHead + i) % FARM_MAX_BOARDS] ==
+			    (UINT32)index)
+				break;
+		}
+		for (; i + 1 < Farm.queueLen; i++)
+			Farm.queue[(Farm.queueHead + i) % FARM_MAX_BOARDS] =
+			Farm.queue[(Farm.queueHead + i + 1) % FARM_MAX_BOARDS];
+		Farm.queueLen--;
+
+		displayColorMsg(FAIL, "Board %s: CANCELLED, unplugged before start\n",
+				name);
+		Farm.jobs[FR_CANCELLED]++;
+		board->state = FS_FREE;
+		break;
+	case FS_RUNNING:
+		/* The worker reports it and frees the board */
+		board->session.cancel = TRUE;
+		break;
+	default:
+		displayColorMsg(SUCCESS, "Board %s unplugged\n", name);
+		board->state = FS_FREE;
+		break;
+	}
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	FARM_Rescan
+ *
+ * Parameters:	none, called without the farm lock.
+ * Returns:	none
+ * Side effects: Replaces the metrics file.
+ * Description:
+ *	Bring the boards up to date with the ports present, at start and
+ *	when device events were lost. The ports are enumerated once, before
+ *	taking the lock.
+ *---------------------------------------------------------------------------
+ */
+static void FARM_Rescan(void)
+{
+	struct COMPORT_INFO		*found;
+	char				path[sizeof(FARM_DEV_PREFIX) +
+					     MAX_COMPORT_NAME_SIZE];
+	UINT32				numPorts = 0;
+	UINT32				i;
+
+	found = (struct COMPORT_INFO *)malloc(MAX_COMPORT_ENUM *
+					      sizeof(*found));
+	if (found != NULL)
+		numPorts = ComPortEnumerate(found, MAX_COMPORT_ENUM);
+
+	pthread_mutex_lock(&Farm.lock);
+
+	for (i = 0; i < FARM_MAX_BOARDS; i++) {
+		if ((Farm.boards[i].state == FS_FREE) ||
+		    Farm.boards[i].removed)
+			continue;
+
+		snprintf(path, sizeof(path), "%s%s", FARM_DEV_PREFIX,
+			 Farm.boards[i].info.Name);
+		if (access(path, F_OK) != 0)
+			FARM_Remove(Farm.boards[i].info.Name);
+	}
+
+	for (i = 0; i < numPorts; i++)
+		FARM_Add(&found[i]);
+
+	FARM_Unlock();
+
+	free(found);
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	FARM_Unlock
+ *
+ * Parameters:	none, called with the farm lock held.
+ * Returns:	none
+ * Side effects: Releases the farm lock, replaces the metrics file.
+ * Description:
+ *	Format the farm metrics in Prometheus text format, then release the
+ *	lock before writing them, so the file I/O holds up neither the
+ *	workers nor the device events. The file is written aside and
+ *	renamed, so readers never see a partial file, and an older snapshot
+ *	never replaces a newer one.
+ *---------------------------------------------------------------------------
+ */
+static void FARM_Unlock(void)
+{
+	char			tmpName[MAX_PARAM_SIZE * 4];
+	const struct FARM_BOARD	*board;
+	char			*text = NULL;
+	size_t			len = 0;
+	FILE			*file;
+	UINT32			seq;
+	UINT32			i;
+
+	if ((Farm.metricsFile == NULL) ||
+	    ((file = open_memstream(&text, &len)) == NULL)) {
+		pthread_mutex_unlock(&Farm.lock);
+		return;
+	}
+
+	fprintf(file,
+		"# HELP uut_farm_queue_depth Boards waiting for a worker.\n"
+		"# TYPE uut_farm_queue_depth gauge\n"
+		"uut_farm_queue_depth %u\n", Farm.queueLen);
+	fprintf(file,
+		"# HELP uut_farm_active_jobs Boards being programmed.\n"
+		"# TYPE uut_farm_active_jobs gauge\n"
+		"uut_farm_active_jobs %u\n", Farm.active);
+	fprintf(file,
+		"# HELP uut_farm_jobs_total Finished jobs by result.\n"
+		"# TYPE uut_farm_jobs_total counter\n");
+	for (i = 0; i < FR_NUM; i++)
+		fprintf(file, "uut_farm_jobs_total{result=\"%s\"} %u\n",
+			FarmResultName[i], Farm.jobs[i]);
+
+	fprintf(file,
+		"# HELP uut_farm_board_bytes_per_second Last job throughput.\n"
+		"# TYPE uut_farm_board_bytes_per_second gauge\n");
+	for (i = 0; i < FARM_MAX_BOARDS; i++) {
+		board = &Farm.boards[i];
+		if ((board->state != FS_DONE) || (board->elapsedUs == 0))
+			continue;
+
+		fprintf(file,
+			"uut_farm_board_bytes_per_second{port=\"%s\",serial=\"%s\"} %.0f\n",
+			board->info.Name, board->info.Serial,
+			((board->session.txBytes + board->session.rxBytes) *
+			 1000000.0) / board->elapsedUs);
+	}
+
+	fprintf(file,
+		"# HELP uut_farm_board_job_seconds Last job time.\n"
+		"# TYPE uut_farm_board_job_seconds gauge\n");
+	for (i = 0; i < FARM_MAX_BOARDS; i++) {
+		board = &Farm.boards[i];
+		if ((board->state != FS_DONE) || (board->elapsedUs == 0))
+			continue;
+
+		fprintf(file,
+			"uut_farm_board_job_seconds{port=\"%s\",serial=\"%s\"} %.3f\n",
+			board->info.Name, board->info.Serial,
+			board->elapsedUs / 1000000.0);
+	}
+
+	fprintf(file,
+		"# HELP uut_farm_board_retries Last job resent packets.\n"
+		"# TYPE uut_farm_board_retries gauge\n");
+	for (i = 0; i < FARM_MAX_BOARDS; i++) {
+		board = &Farm.boards[i];
+		if ((board->state != FS_DONE) || (board->elapsedUs == 0))
+			continue;
+
+		fprintf(file,
+			"uut_farm_board_retries{port=\"%s\",serial=\"%s\"} %u\n",
+			board->info.Name, board->info.Serial,
+			board->session.retries);
+	}
+
+	fclose(file);
+	seq = ++Farm.metricsSeq;
+
+	pthread_mutex_unlock(&Farm.lock);
+
+	pthread_mutex_lock(&Farm.metricsLock);
+
+	if ((text != NULL) && ((INT32)(seq - Farm.metricsWritten) > 0)) {
+		snprintf(tmpName, sizeof(tmpName), "%s.tmp", Farm.metricsFile);
+		file = fopen(tmpName, "w");
+		if (file != NULL) {
+			fwrite(text, 1, len, file);
+			fclose(file);
+			rename(tmpName, Farm.metricsFile);
+			Farm.metricsWritten = seq;
+		}
+	}
+
+	pthread_mutex_unlock(&Farm.metricsLock);
+
+	free(text);
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	FARM_Worker
+ *
+ * Parameters:	arg - unused.
+ * Returns:	NULL
+ * Side effects: Opens, synchronizes and closes the board ports.
+ * Description:
+ *	Run the queued jobs, one board at a time, until the farm stops.
+ *---------------------------------------------------------------------------
+ */
+static void *FARM_Worker(void *arg)
+{
+	struct FARM_BOARD	*board;
+	struct UUT_SESSION	*session;
+	enum FARM_RESULT	result;
+	unsigned long long	start;
+
+	(void)arg;
+
+	while (TRUE) {
+		pthread_mutex_lock(&Farm.lock);
+
+		while (!Farm.stop && (Farm.queueLen == 0))
+			pthread_cond_wait(&Farm.wake, &Farm.lock);
+		if (Farm.stop)
+			break;
+
+		board = &Farm.boards[Farm.queue[Farm.queueHead]];
+		Farm.queueHead = (Farm.queueHead + 1) % FARM_MAX_BOARDS;
+		Farm.queueLen--;
+		Farm.active++;
+
+		session = &board->session;
+		MULTI_InitSession(session, Farm.proto, board->info.Name);
+		board->state = FS_RUNNING;
+		FARM_Unlock();
+
+		/* Let the device node and the board settle */
+		usleep(FARM_SETTLE_TIME * 1000);
+
+		start = getTimeUs();
+		if (session->cancel)
+			board->result = EC_PORT_ERR;
+		else if (OPR_OpenPort(session, session->portName) != TRUE)
+			board->result = EC_PORT_ERR;
+		else if (OPR_CheckSync(session,
+				       session->portCfg.BaudRate) != SR_OK)
+			board->result = EC_SYNC_ERR;
+		else
+			board->result = SCRIPT_RunFile(session,
+						       Farm.scriptName);
+		OPR_ClosePort(session);
+
+		pthread_mutex_lock(&Farm.lock);
+
+		board->elapsedUs = getTimeUs() - start;
+		Farm.active--;
+
+		result = (board->result == EC_OK) ? FR_PASS :
+			 (session->cancel) ? FR_CANCELLED : FR_FAIL;
+		Farm.jobs[result]++;
+
+		if ((result == FR_PASS) && board->info.IsUsb &&
+		    (board->info.Serial[0] != '\0'))
+			snprintf(Farm.done[Farm.numDone++ % FARM_MAX_DONE],
+				 MAX_COMPORT_SERIAL_SIZE, "%s",
+				 board->info.Serial);
+
+		displayColorMsg(result == FR_PASS,
+			"Board %s: %s%s, %llu ms, %.1f KB/s, %u retries\n",
+			board->info.Name,
+			(result == FR_PASS) ? "PASS" :
+			(result == FR_FAIL) ? "FAIL" : "CANCELLED",
+			((result == FR_CANCELLED) && board->removed) ?
+				" (unplugged)" : "",
+			board->elapsedUs / 1000,
+			(board->elapsedUs != 0) ?
+				((session->txBytes + session->rxBytes) *
+				 1000000.0) / (board->elapsedUs * 1024.0) : 0.0,
+			session->retries);
+
+		board->state = board->removed ? FS_FREE : FS_DONE;
+		FARM_Unlock();
+	}
+
+	pthread_mutex_unlock(&Farm.lock);
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	FARM_ReadUevent
+ *
+ * Parameters:	fd - kernel device events socket.
+ * Returns:	none
+ * Side effects:
+ * Description:
+ *	Read one device event, and add or remove the board of a serial port.
+ *	The event is "ACTION@DEVPATH" followed by "KEY=value" strings.
+ *---------------------------------------------------------------------------
+ */
+static void FARM_ReadUevent(int fd)
+{
+	char		buf[FARM_UEVENT_SIZE];
+	const char	*action = NULL;
+	const char	*subsystem = NULL;
+	const char	*devName = NULL;
+	const char	*field;
+	struct COMPORT_INFO	info;
+	ssize_t		len;
+
+	len = recv(fd, buf, sizeof(buf) - 1, MSG_DONTWAIT);
+	if (len < 0) {
+		/* Events were lost, look at the ports instead */
+		if (errno == ENOBUFS)
+			FARM_Rescan();
+		return;
+	}
+	buf[len] = '\0';
+
+	for (field = buf; field < buf + len; field += strlen(field) + 1) {
+		if (strncmp(field, "ACTION=", 7) == 0)
+			action = field + 7;
+		else if (strncmp(field, "SUBSYSTEM=", 10) == 0)
+			subsystem = field + 10;
+		else if (strncmp(field, "DEVNAME=", 8) == 0)
+			devName = field + 8;
+	}
+
+	if ((action == NULL) || (devName == NULL) || (subsystem == NULL) ||
+	    (strcmp(subsystem, FARM_SUBSYSTEM) != 0))
+		return;
+
+	if (strncmp(devName, FARM_DEV_PREFIX, strlen(FARM_DEV_PREFIX)) == 0)
+		devName += strlen(FARM_DEV_PREFIX);
+
+	if (!FARM_IsServed(devName))
+		return;
+
+	if (strcmp(action, "add") == 0) {
+		FARM_Identify(devName, &info);
+		pthread_mutex_lock(&Farm.lock);
+		FARM_Add(&info);
+	} else if (strcmp(action, "remove") == 0) {
+		pthread_mutex_lock(&Farm.lock);
+		FARM_Remove(devName);
+	} else {
+		return;
+	}
+
+	FARM_Unlock();
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	FARM_Run
+ *
+ * Parameters:	proto       - session whose settings are copied to each board.
+ *		ports       - port name patterns, NULL for FARM_DEFAULT_PORTS.
+ *		scriptName  - script run on each board.
+ *		metricsFile - Prometheus metrics file, NULL for none.
+ * Returns:	EC_OK when stopped by a signal, otherwise the EXIT_CODE of the
+ *		failure.
+ * Side effects: Opens, synchronizes and closes the board ports.
+ * Description:
+ *	Serve the boards as they are plugged in, until SIGINT or SIGTERM.
+ *---------------------------------------------------------------------------
+ */
+UINT32 FARM_Run(const struct UUT_SESSION *proto, const char *ports,
+		const char *scriptName, const char *metricsFile)
+{
+	pthread_t		workers[FARM_WORKERS];
+	struct sockaddr_nl	addr;
+	struct sigaction	sa;
+	struct pollfd		fds;
+	int			rcvBuf = FARM_UEVENT_RCVBUF;
+	UINT32			numWorkers;
+	UINT32			i;
+
+	Farm.proto       = proto;
+	Farm.ports       = (ports != NULL) ? ports : FARM_DEFAULT_PORTS;
+	Farm.scriptName  = scriptName;
+	Farm.metricsFile = metricsFile;
+
+	/* Listen before looking at the ports present, so none is missed */
+	fds.fd     = socket(AF_NETLINK, SOCK_DGRAM, NETLINK_KOBJECT_UEVENT);
+	fds.events = POLLIN;
+	if (fds.fd < 0) {
+		displayColorMsg(FAIL, "ERROR: could not watch device events\n");
+		return EC_PORT_ERR;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.nl_family = AF_NETLINK;
+	addr.nl_groups = FARM_UEVENT_GROUP;
+	setsockopt(fds.fd, SOL_SOCKET, SO_RCVBUF, &rcvBuf, sizeof(rcvBuf));
+	if (bind(fds.fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+		displayColorMsg(FAIL, "ERROR: could not watch device events\n");
+		close(fds.fd);
+		return EC_PORT_ERR;
+	}
+
+	/* No SA_RESTART, so that a signal interrupts poll() */
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = FARM_Signal;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, NULL);
+	sigaction(SIGTERM, &sa, NULL);
+
+	for (numWorkers = 0; numWorkers < FARM_WORKERS; numWorkers++) {
+		if (pthread_create(&workers[numWorkers], NULL, FARM_Worker,
+				   NULL) != 0)
+			break;
+	}
+
+	if (numWorkers == 0) {
+		close(fds.fd);
+		return EC_PORT_ERR;
+	}
+
+	displayColorMsg(SUCCESS, "Farm serving %s with %s, %u workers\n",
+			Farm.ports, scriptName, numWorkers);
+
+	FARM_Rescan();
+
+	while (!FarmStop) {
+		if (poll(&fds, 1, -1) > 0)
+			FARM_ReadUevent(fds.fd);
+	}
+
+	/* Running jobs end at their next packet */
+	pthread_mutex_lock(&Farm.lock);
+	Farm.stop = TRUE;
+	for (i = 0; i < FARM_MAX_BOARDS; i++) {
+		if (Farm.boards[i].state == FS_RUNNING)
+			Farm.boards[i].session.cancel = TRUE;
+	}
+	pthread_cond_broadcast(&Farm.wake);
+	pthread_mutex_unlock(&Farm.lock);
+
+	for (i = 0; i < numWorkers; i++)
+		pthread_join(workers[i], NULL);
+
+	close(fds.fd);
+
+	displayColorMsg(SUCCESS, "Farm stopped: %u passed, %u failed, %u cancelled\n",
+			Farm.jobs[FR_PASS], Farm.jobs[FR_FAIL],
+			Farm.jobs[FR_CANCELLED]);
+
+	return EC_OK;
+}
@@ -0,0 +1,385 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   imgcache.c
+ *	This file implements the shared image cache.
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "uut_types.h"
+#include "ComPort.h"
+#include "program.h"
+#include "session.h"
+#include "pktstream.h"
+#include "imgcache.h"
+
+/*---------------------------------------------------------------------------
+ * Local variables
+ *---------------------------------------------------------------------------
+ */
+static struct IMG_ENTRY	*ImgCache[IMG_CACHE_MAX_ENTRIES];
+static UINT32		ImgCacheTick;
+static pthread_mutex_t	ImgCacheLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*---------------------------------------------------------------------------
+ * Functions prototypes
+ *---------------------------------------------------------------------------
+ */
+static struct IMG_ENTRY	*IMG_Load(const char *path, const struct stat *st,
+				  int fd);
+static void		IMG_Free(struct IMG_ENTRY *entry);
+static void		IMG_Evict(UINT32 slot);
+static BOOLEAN		IMG_IsSame(const struct IMG_ENTRY *entry,
+				   const struct stat *st);
+static struct IMG_ENTRY	*IMG_Lookup(const struct stat *st);
+static void		IMG_Insert(struct IMG_ENTRY *entry);
+
+/*---------------------------------------------------------------------------
+ * Functions implementation
+ *---------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------------
+ * Function:	IMG_IsSame
+ *
+ * Parameters:	entry - cached image.
+ *		st    - current file status.
+ * Returns:	TRUE when entry holds the file as it is now.
+ *---------------------------------------------------------------------------
+ */
+static BOOLEAN IMG_IsSame(const struct IMG_ENTRY *entry,
+			  const struct stat *st)
+{
+	return (entry->size == (UINT32)st->st_size) &&
+	       (entry->mtimeSec == (long long)st->st_mtim.tv_sec) &&
+	       (entry->mtimeNsec == st->st_mtim.tv_nsec);
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	IMG_Load
+ *
+ * Parameters:	path - image file name.
+ *		st   - file status.
+ *		fd   - opened file.
+ * Returns:	The new entry, NULL on failure.
+ * Side effects:
+ * Description:
+ *	Read the file into memory. A mapping would follow the file: the
+ *	usual 'cp new.bin image.bin' truncates it in place, and the sessions
+ *	still sending the old image would then fault.
+ *---------------------------------------------------------------------------
+ */
+static struct IMG_ENTRY *IMG_Load(const char *path, const struct stat *st,
+				  int fd)
+{
+	struct IMG_ENTRY	*entry;
+	UINT8			*data;
+	size_t			done = 0;
+	ssize_t			nRead;
+
+	data = (UINT8 *)malloc(st->st_size);
+	if (data == NULL)
+		return NULL;
+
+	/* A file cut short meanwhile is not taken for the image */
+	while (done < (size_t)st->st_size) {
+		nRead = read(fd, data + done, st->st_size - done);
+		if (nRead <= 0) {
+			free(data);
+			return NULL;
+		}
+		done += nRead;
+	}
+
+	entry = (struct IMG_ENTRY *)calloc(1, sizeof(*entry));
+	if (entry == NULL) {
+		free(data);
+		return NULL;
+	}
+
+	snprintf(entry->path, sizeof(entry->path), "%s", path);
+	entry->dev       = st->st_dev;
+	entry->ino       = st->st_ino;
+	entry->mtimeSec  = st->st_mtim.tv_sec;
+	entry->mtimeNsec = st->st_mtim.tv_nsec;
+	entry->data      = data;
+	entry->size      = (UINT32)st->st_size;
+	entry->cached    = TRUE;
+
+	return entry;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	IMG_Free
+ *
+ * Parameters:	entry - image to free.
+ * Returns:	none
+ * Side effects:
+ *---------------------------------------------------------------------------
+ */
+static void IMG_Free(struct IMG_ENTRY *entry)
+{
+	UINT32 i;
+
+	for (i = 0; i < IMG_MAX_STREAMS; i++) {
+		if (entry->streams[i] != NULL)
+			PKT_StreamPut(entry->streams[i]);
+	}
+
+	free((void *)entry->data);
+	free(entry);
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	IMG_Evict
+ *
+ * Parameters:	slot - cache slot, called with the cache lock held.
+ * Returns:	none
+ * Side effects:
+ * Description:
+ *	Drop an image from the cache. An image still in use is freed by its
+ *	last IMG_CachePut.
+ *---------------------------------------------------------------------------
+ */
+static void IMG_Evict(UINT32 slot)
+{
+	struct IMG_ENTRY *entry = ImgCache[slot];
+
+	ImgCache[slot] = NULL;
+	entry->cached  = FALSE;
+
+	if (entry->refCount == 0)
+		IMG_Free(entry);
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	IMG_Lookup
+ *
+ * Parameters:	st - current file status, called with the cache lock held.
+ * Returns:	The cached image of the file as it is now, NULL if none.
+ * Side effects: Drops the images of the file as it was before.
+ * Description:
+ *	Look the image up by device and inode, and check its size and
+ *	modification time.
+ *---------------------------------------------------------------------------
+ */
+static struct IMG_ENTRY *IMG_Lookup(const struct stat *st)
+{
+	UINT32 i;
+
+	for (i = 0; i < IMG_CACHE_MAX_ENTRIES; i++) {
+		if (ImgCache[i] == NULL)
+			continue;
+
+		/* The same file, whatever the path it is reached by */
+		if ((ImgCache[i]->dev != (unsigned long long)st->st_dev) ||
+		    (ImgCache[i]->ino != (unsigned long long)st->st_ino))
+			continue;
+
+		if (IMG_IsSame(ImgCache[i], st))
+			return ImgCache[i];
+
+		/* The file changed since it was cached */
+		IMG_Evict(i);
+	}
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	IMG_Insert
+ *
+ * Parameters:	entry - image read, called with the cache lock held.
+ * Returns:	none
+ * Side effects:
+ * Description:
+ *	When the cache is full the least recently used idle image is
+ *	dropped; with all of them busy the image is not cached.
+ *---------------------------------------------------------------------------
+ */
+static void IMG_Insert(struct IMG_ENTRY *entry)
+{
+	UINT32	free_slot = IMG_CACHE_MAX_ENTRIES;
+	UINT32	i;
+
+	for (i = 0; i < IMG_CACHE_MAX_ENTRIES; i++) {
+		if (ImgCache[i] == NULL) {
+			free_slot = i;
+			break;
+		}
+		if ((ImgCache[i]->refCount == 0) &&
+		    ((free_slot == IMG_CACHE_MAX_ENTRIES) ||
+		     (ImgCache[i]->lastUse < ImgCache[free_slot]->lastUse)))
+			free_slot = i;
+	}
+
+	if (free_slot == IMG_CACHE_MAX_ENTRIES) {
+		entry->cached = FALSE;
+		return;
+	}
+
+	if (ImgCache[free_slot] != NULL)
+		IMG_Evict(free_slot);
+	ImgCache[free_slot] = entry;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	IMG_CacheGet
+ *
+ * Parameters:	path - image file name.
+ * Returns:	The image with a reference taken, NULL on failure.
+ * Side effects: Reads the file, unless already cached.
+ * Description:
+ *	The file is read with the cache unlocked, so the other sessions go
+ *	on meanwhile; when two of them read the same new image, the first
+ *	one cached is kept.
+ *---------------------------------------------------------------------------
+ */
+struct IMG_ENTRY *IMG_CacheGet(const char *path)
+{
+	struct IMG_ENTRY	*entry;
+	struct IMG_ENTRY	*loaded;
+	struct stat		st;
+	int			fd;
+
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		displayColorMsg(FAIL, "ERROR: could not open input file [%s]\n",
+				path);
+		return NULL;
+	}
+
+	if ((fstat(fd, &st) != 0) || (st.st_size <= 0) ||
+	    (st.st_size > (off_t)0xFFFFFFFF)) {
+		displayColorMsg(FAIL, "ERROR: could not read input file [%s]\n",
+				path);
+		close(fd);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&ImgCacheLock);
+	entry = IMG_Lookup(&st);
+	if (entry != NULL) {
+		entry->refCount++;
+		entry->lastUse = ++ImgCacheTick;
+	}
+	pthread_mutex_unlock(&ImgCacheLock);
+
+	if (entry != NULL) {
+		close(fd);
+		return entry;
+	}
+
+	loaded = IMG_Load(path, &st, fd);
+	close(fd);
+	if (loaded == NULL) {
+		displayColorMsg(FAIL, "ERROR: could not read input file [%s]\n",
+				path);
+		return NULL;
+	}
+
+	pthread_mutex_lock(&ImgCacheLock);
+
+	entry = IMG_Lookup(&st);
+	if (entry == NULL) {
+		entry = loaded;
+		IMG_Insert(entry);
+	} else {
+		IMG_Free(loaded);
+	}
+
+	entry->refCount++;
+	entry->lastUse = ++ImgCacheTick;
+
+	pthread_mutex_unlock(&ImgCacheLock);
+
+	return entry;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	IMG_CacheStream
+ *
+ * Parameters:	entry   - cached image.
+ *		session - session whose CRC type is used.
+ *		addr    - image start address.
+ * Returns:	The WRITE packets of the image with a reference taken, to be
+ *		dropped by PKT_StreamPut; NULL when out of memory.
+ * Side effects: Encodes the image, unless already encoded for addr.
+ * Description:
+ *	Get the packet stream writing the image to addr. The last
+ *	IMG_MAX_STREAMS encodings are kept with the image.
+ *---------------------------------------------------------------------------
+ */
+struct PKT_STREAM *IMG_CacheStream(struct IMG_ENTRY *entry,
+				   const struct UUT_SESSION *session,
+				   UINT32 addr)
+{
+	struct PKT_STREAM	*stream = NULL;
+	UINT32			i;
+
+	pthread_mutex_lock(&ImgCacheLock);
+
+	for (i = 0; i < IMG_MAX_STREAMS; i++) {
+		if ((entry->streams[i] != NULL) &&
+		    (entry->streams[i]->addr == addr) &&
+		    (entry->streams[i]->crcType == session->crcType)) {
+			stream = entry->streams[i];
+			break;
+		}
+	}
+
+	if (stream == NULL) {
+		stream = PKT_StreamCreate(session, addr, entry->data,
+					  entry->size);
+		if (stream != NULL) {
+			/* Oldest encoding out, newest in front */
+			if (entry->streams[IMG_MAX_STREAMS - 1] != NULL)
+				PKT_StreamPut(entry->streams[IMG_MAX_STREAMS - 1]);
+			memmove(&entry->streams[1], &entry->streams[0],
+				(IMG_MAX_STREAMS - 1) *
+				sizeof(entry->streams[0]));
+			entry->streams[0] = stream;
+		}
+	}
+
+	if (stream != NULL)
+		PKT_StreamGet(stream);
+
+	pthread_mutex_unlock(&ImgCacheLock);
+
+	return stream;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	IMG_CachePut
+ *
+ * Parameters:	entry - cached image.
+ * Returns:	none
+ * Side effects: Frees a replaced image with its last reference.
+ * Description:
+ *	Drop a reference taken by IMG_CacheGet. The image stays cached.
+ *---------------------------------------------------------------------------
+ */
+void IMG_CachePut(struct IMG_ENTRY *entry)
+{
+	pthread_mutex_lock(&ImgCacheLock);
+
+	if ((--entry->refCount == 0) && !entry->cached)
+		IMG_Free(entry);
+
+	pthread_mutex_unlock(&ImgCacheLock);
+}
@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<-----------------------------------------------------------------------
+ * File Contents:
+ *   l_com_baud.c
+ *            This file sets non-standard baud rates on Linux tty devices.
+ *            It is kept apart from l_com_port.c since the kernel termios2
+ *            definitions clash with the libc <termios.h> ones.
+ *  Project:
+ *            UartUpdateTool
+ *--------------------------------------------------------------------------
+ */
+
+#include <sys/ioctl.h>
+#include <asm/termbits.h>
+
+#include "uut_types.h"
+#include "ComPort.h"
+
+/******************************************************************************
+ * Function: ComPortSetCustomBaudRate()
+ *
+ * Purpose:  Set an arbitrary baud rate, using the termios2 BOTHER interface.
+ *
+ * Params:   nDeviceID - the opened handle returned by ComPortOpen()
+ *           BaudRate - requested baud rate
+ *
+ * Returns:  1 if successful
+ *           0 in the case of an error.
+ *
+ *****************************************************************************
+ */
+BOOLEAN ComPortSetCustomBaudRate(HANDLE nDeviceID, UINT32 BaudRate)
+{
+	struct termios2 tty;
+
+	if (ioctl((int)nDeviceID, TCGETS2, &tty) != 0)
+		return FALSE;
+
+	tty.c_cflag &= ~(CBAUD | (CBAUD << IBSHIFT));
+	tty.c_cflag |= BOTHER | (BOTHER << IBSHIFT);
+	tty.c_ispeed = BaudRate;
+	tty.c_ospeed = BaudRate;
+
+	return (ioctl((int)nDeviceID, TCSETS2, &tty) == 0);
+}
@@ -12,6 +12,7 @@
  *--------------------------------------------------------------------------
  */
 
+#define _GNU_SOURCE	/* strverscmp() */
 
 #include <termios.h>
 #include <stdio.h>
@@ -20,11 +21,18 @@
 #include <errno.h>
 #include <unistd.h>
 #include <poll.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <dirent.h>
+#include <pthread.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <linux/serial.h>
 
 #include "uut_types.h"
 #include "program.h"
 #include "ComPort.h"
+#include "TcpPort.h"
 
 /*---------------------------------------------------------------------------
  * Constant definitions
@@ -42,13 +50,34 @@
 
 #define COMMAND_TIMEOUT		10000 /* 10 seconds */
 
+#define SYSFS_TTY_CLASS		"/sys/class/tty"
+#define FTDI_DRIVER_NAME	"ftdi_sio"
+#define FTDI_LOW_LATENCY	1     /* ms */
+#define SYSFS_VALUE_SIZE	16
+#define SYSFS_DEVICES_ROOT	"/sys/devices"
+#define SERIAL8250_DRIVER_NAME	"serial8250"
+#define SERIAL_PORT_UNKNOWN	0     /* PORT_UNKNOWN in the "type" attribute */
+
+/*---------------------------------------------------------------------------
+ * Internal types
+ *---------------------------------------------------------------------------
+ */
+struct TTY_PORT {
+	BOOLEAN		inUse;
+	HANDLE		handle;
+	struct termios	savetty;
+	char		latencyPath[PATH_MAX];
+	INT32		savedLatency;		/* -1 if not modified */
+	BOOLEAN		lowLatencySet;		/* ASYNC_LOW_LATENCY was set */
+};
 
 /*---------------------------------------------------------------------------
  * Global variables
  *---------------------------------------------------------------------------
  */
 HANDLE DeviceDescriptor[MAX_COMPORT_DEVICES];
-static struct termios  savetty;
+static struct TTY_PORT TtyPorts[MAX_COMPORT_DEVICES];
+static pthread_mutex_t TtyPortsLock = PTHREAD_MUTEX_INITIALIZER;
 
 /*---------------------------------------------------------------------------
  * Functions prototypes
@@ -75,6 +104,14 @@ static struct termios  savetty;
 static speed_t convert_baudrate_to_baudrate_mask(UINT32 baudrate)
 {
 	switch (baudrate) {
+	case 600:
+		return B600;
+	case 1200:
+		return B1200;
+	case 2400:
+		return B2400;
+	case 4800:
+		return B4800;
 	case 9600:
 		return B9600;
 	case 19200:
@@ -85,6 +122,12 @@ static speed_t convert_baudrate_to_baudrate_mask(UINT32 baudrate)
 		return B57600;
 	case 115200:
 		return B115200;
+	case 230400:
+		return B230400;
+	case 460800:
+		return B460800;
+	case 921600:
+		return B921600;
 	default:
 		return B0;
 	}
@@ -152,6 +195,282 @@ static tcflag_t convert_byte_size_to_byte_size_mask(UINT32 byte_size)
 }
 
 
+/*--------------------------------------------------------------------------
+ * Function:	tty_find_port
+ *
+ * Parameters:
+ *		hDevice_Driver	- The opened handle returned by ComPortOpen()
+ *
+ * Returns:	The tty descriptor, NULL if the handle is unknown.
+ *--------------------------------------------------------------------------
+ */
+static struct TTY_PORT *tty_find_port(HANDLE hDevice_Driver)
+{
+	UINT32 i;
+
+	for (i = 0; i < MAX_COMPORT_DEVICES; i++) {
+		if (TtyPorts[i].inUse && (TtyPorts[i].handle == hDevice_Driver))
+			return &TtyPorts[i];
+	}
+
+	return NULL;
+}
+
+/*--------------------------------------------------------------------------
+ * Function:	sysfs_read_int
+ *
+ * Parameters:
+ *		path	- sysfs attribute path.
+ *		value	- the attribute value.
+ *
+ * Returns:	TRUE if the attribute was read.
+ *--------------------------------------------------------------------------
+ */
+static BOOLEAN sysfs_read_int(const char *path, INT32 *value)
+{
+	char	buf[SYSFS_VALUE_SIZE];
+	FILE	*file = fopen(path, "r");
+
+	if (file == NULL)
+		return FALSE;
+
+	if (fgets(buf, sizeof(buf), file) == NULL) {
+		fclose(file);
+		return FALSE;
+	}
+
+	fclose(file);
+	*value = (INT32)strtol(buf, NULL, 10);
+
+	return TRUE;
+}
+
+/*--------------------------------------------------------------------------
+ * Function:	sysfs_write_int
+ *
+ * Parameters:
+ *		path	- sysfs attribute path.
+ *		value	- the value to write.
+ *
+ * Returns:	TRUE if the attribute was written.
+ *--------------------------------------------------------------------------
+ */
+static BOOLEAN sysfs_write_int(const char *path, INT32 value)
+{
+	FILE	*file = fopen(path, "w");
+	BOOLEAN	ret_val;
+
+	if (file == NULL)
+		return FALSE;
+
+	ret_val = (fprintf(file, "%d", value) > 0);
+
+	if (fclose(file) != 0)
+		ret_val = FALSE;
+
+	return ret_val;
+}
+
+/*--------------------------------------------------------------------------
+ * Function:	tty_low_latency_setup
+ *
+ * Parameters:
+ *		port		- tty descriptor of the opened port.
+ *		deviceName	- device path (e.g. /dev/ttyUSB0).
+ *		verbose		- display the changed values.
+ *
+ * Returns:	none
+ * Side effects:
+ * Description:
+ *		USB-serial adapters batch received bytes for up to their
+ *		latency timer (16 ms on FTDI) before passing them to the host,
+ *		which stalls every request/response round trip. Lower the FTDI
+ *		latency timer and set ASYNC_LOW_LATENCY where the driver
+ *		supports it. Original values are restored by ComPortClose().
+ *--------------------------------------------------------------------------
+ */
+static void tty_low_latency_setup(struct TTY_PORT *port,
+				  const char *deviceName, BOOLEAN verbose)
+{
+	const char		*name;
+	char			path[PATH_MAX];
+	char			driver[PATH_MAX];
+	const char		*driverName = "unknown";
+	ssize_t			len;
+	INT32			latency;
+	struct serial_struct	serial;
+
+	port->savedLatency  = -1;
+	port->lowLatencySet = FALSE;
+
+	name = strrchr(deviceName, '/');
+	name = (name == NULL) ? deviceName : name + 1;
+
+	if ((strncmp(name, "ttyUSB", strlen("ttyUSB")) != 0) &&
+	    (strncmp(name, "ttyACM", strlen("ttyACM")) != 0))
+		return;
+
+	snprintf(path, sizeof(path), SYSFS_TTY_CLASS "/%s/device/driver",
+		 name);
+	len = readlink(path, driver, sizeof(driver) - 1);
+	if (len > 0) {
+		driver[len] = '\0';
+		driverName = strrchr(driver, '/');
+		driverName = (driverName == NULL) ? driver : driverName + 1;
+	}
+
+	if (strcmp(driverName, FTDI_DRIVER_NAME) == 0) {
+		snprintf(port->latencyPath, sizeof(port->latencyPath),
+			 SYSFS_TTY_CLASS "/%s/device/latency_timer", name);
+
+		if (sysfs_read_int(port->latencyPath, &latency) &&
+		    (latency > FTDI_LOW_LATENCY)) {
+			if (sysfs_write_int(port->latencyPath,
+					    FTDI_LOW_LATENCY)) {
+				port->savedLatency = latency;
+				if (verbose)
+					printf("%s: latency_timer %d -> %d ms\n",
+					       name, latency, FTDI_LOW_LATENCY);
+			} else if (verbose) {
+				printf(
+				"%s: cannot lower latency_timer (%d ms): %s\n",
+				       name, latency, strerror(errno));
+			}
+		}
+	}
+
+	if (ioctl(port->handle, TIOCGSERIAL, &serial) == 0) {
+		if ((serial.flags & ASYNC_LOW_LATENCY) == 0) {
+			serial.flags |= ASYNC_LOW_LATENCY;
+			if (ioctl(port->handle, TIOCSSERIAL, &serial) == 0) {
+				port->lowLatencySet = TRUE;
+				if (verbose)
+					printf("%s: %s driver, ASYNC_LOW_LATENCY set\n",
+					       name, driverName);
+			}
+		}
+	}
+}
+
+/*--------------------------------------------------------------------------
+ * Function:	tty_low_latency_restore
+ *
+ * Parameters:
+ *		port	- tty descriptor of the opened port.
+ *
+ * Returns:	none
+ * Description:
+ *		Restore the values changed by tty_low_latency_setup().
+ *--------------------------------------------------------------------------
+ */
+static void tty_low_latency_restore(struct TTY_PORT *port)
+{
+	struct serial_struct serial;
+
+	if (port->lowLatencySet &&
+	    (ioctl(port->handle, TIOCGSERIAL, &serial) == 0)) {
+		serial.flags &= ~ASYNC_LOW_LATENCY;
+		ioctl(port->handle, TIOCSSERIAL, &serial);
+	}
+
+	if (port->savedLatency >= 0)
+		sysfs_write_int(port->latencyPath, port->savedLatency);
+
+	port->savedLatency  = -1;
+	port->lowLatencySet = FALSE;
+}
+
+/*--------------------------------------------------------------------------
+ * Function:	sysfs_read_str
+ *
+ * Parameters:
+ *		path	- sysfs attribute path.
+ *		buf	- the attribute value, without the trailing new line.
+ *		size	- buf size.
+ *
+ * Returns:	TRUE if the attribute was read.
+ *--------------------------------------------------------------------------
+ */
+static BOOLEAN sysfs_read_str(const char *path, char *buf, UINT32 size)
+{
+	FILE	*file = fopen(path, "r");
+
+	if (file == NULL)
+		return FALSE;
+
+	if (fgets(buf, size, file) == NULL) {
+		fclose(file);
+		return FALSE;
+	}
+
+	fclose(file);
+	buf[strcspn(buf, "\r\n")] = '\0';
+
+	return TRUE;
+}
+
+/*--------------------------------------------------------------------------
+ * Function:	sysfs_get_usb_info
+ *
+ * Parameters:
+ *		name	- tty name.
+ *		info	- port information to fill.
+ *
+ * Returns:	none
+ * Description:
+ *		Walk up from the tty device node to the USB device that owns
+ *		it and read its vendor/product/serial attributes.
+ *--------------------------------------------------------------------------
+ */
+static void sysfs_get_usb_info(const char *name, struct COMPORT_INFO *info)
+{
+	char	path[PATH_MAX + SYSFS_VALUE_SIZE];
+	char	devPath[PATH_MAX];
+	char	value[SYSFS_VALUE_SIZE];
+	char	*sep;
+
+	snprintf(path, sizeof(path), SYSFS_TTY_CLASS "/%s/device", name);
+	if (realpath(path, devPath) == NULL)
+		return;
+
+	while (strncmp(devPath, SYSFS_DEVICES_ROOT "/",
+		       strlen(SYSFS_DEVICES_ROOT "/")) == 0) {
+		snprintf(path, sizeof(path), "%s/idVendor", devPath);
+		if (sysfs_read_str(path, value, sizeof(value))) {
+			info->IsUsb    = TRUE;
+			info->VendorId = (UINT16)strtoul(value, NULL, 16);
+
+			snprintf(path, sizeof(path), "%s/idProduct", devPath);
+			if (sysfs_read_str(path, value, sizeof(value)))
+				info->ProductId =
+					(UINT16)strtoul(value, NULL, 16);
+
+			snprintf(path, sizeof(path), "%s/serial", devPath);
+			sysfs_read_str(path, info->Serial,
+				       sizeof(info->Serial));
+			return;
+		}
+
+		sep = strrchr(devPath, '/');
+		if (sep == NULL)
+			return;
+		*sep = '\0';
+	}
+}
+
+/*--------------------------------------------------------------------------
+ * Function:	compare_port_info
+ *
+ * Description:
+ *		qsort() callback, orders ports by name (ttyS2 before ttyS10).
+ *--------------------------------------------------------------------------
+ */
+static int compare_port_info(const void *a, const void *b)
+{
+	return strverscmp(((const struct COMPORT_INFO *)a)->Name,
+			  ((const struct COMPORT_INFO *)b)->Name);
+}
+
 /*-------------------------------------------------------------------------
  * Function:	set_read_blocking
  *
@@ -216,6 +535,9 @@ BOOLEAN ConfigureUart(HANDLE  hDevice_Driver,
 	struct termios tty;
 	speed_t        baudrate;
 
+	if (TcpPortIsHandle(hDevice_Driver))
+		return TcpPortConfigure(hDevice_Driver, ComPortFields);
+
 	memset(&tty, 0, sizeof(tty));
 
 	if (tcgetattr(hDevice_Driver, &tty) != 0) {
@@ -225,11 +547,18 @@ BOOLEAN ConfigureUart(HANDLE  hDevice_Driver,
 		return FALSE;
 	}
 
+	/*
+	 * Rates without a Bxxx constant keep the current speed here and are
+	 * set through termios2 once the other attributes are applied, since
+	 * B0 would hang up the line.
+	 */
 	baudrate = convert_baudrate_to_baudrate_mask(ComPortFields.BaudRate);
-	cfsetospeed(&tty, baudrate);
-	cfsetispeed(&tty, baudrate);
+	if (baudrate != B0) {
+		cfsetospeed(&tty, baudrate);
+		cfsetispeed(&tty, baudrate);
 
-	tty.c_cflag |= baudrate;
+		tty.c_cflag |= baudrate;
+	}
 
 	tty.c_cflag |=
 		convert_byte_size_to_byte_size_mask(ComPortFields.ByteSize);
@@ -269,6 +598,48 @@ BOOLEAN ConfigureUart(HANDLE  hDevice_Driver,
 		return FALSE;
 	}
 
+	if ((baudrate == B0) &&
+	    !ComPortSetCustomBaudRate(hDevice_Driver, ComPortFields.BaudRate)) {
+		displayColorMsg(FAIL,
+	"ConfigureUart Error: %d setting baud rate %u on port handle %d: %s.\n",
+		errno, ComPortFields.BaudRate, hDevice_Driver, strerror(errno));
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/******************************************************************************
+ * Function: BOOLEAN ComPortSetModemLines()
+ *
+ * Purpose:  Assert or release modem control lines.
+ *
+ * Params:   nDeviceID - the opened handle returned by ComPortOpen()
+ *           Lines - COMPORT_LINE_* mask of the lines to change
+ *           Assert - TRUE to assert the lines, FALSE to release them
+ *
+ * Returns:  1 if successful
+ *           0 in the case of an error.
+ *
+ *****************************************************************************
+ */
+BOOLEAN ComPortSetModemLines(HANDLE nDeviceID, UINT32 Lines, BOOLEAN Assert)
+{
+	int bits = 0;
+
+	if (TcpPortIsHandle(nDeviceID))
+		return TcpPortSetModemLines(nDeviceID, Lines, Assert);
+
+	bits |= (Lines & COMPORT_LINE_DTR) ? TIOCM_DTR : 0;
+	bits |= (Lines & COMPORT_LINE_RTS) ? TIOCM_RTS : 0;
+
+	if (ioctl(nDeviceID, Assert ? TIOCMBIS : TIOCMBIC, &bits) != 0) {
+		displayColorMsg(FAIL,
+	"ComPortSetModemLines() Error: %d setting port handle %d: %s.\n",
+		errno, nDeviceID, strerror(errno));
+		return FALSE;
+	}
+
 	return TRUE;
 }
 
@@ -279,6 +650,7 @@ BOOLEAN ConfigureUart(HANDLE  hDevice_Driver,
  *
  * Params:   ComPortDeviceName - The name of the device to open
  *           ComPortFields - a struct filled with Comport settings
+ *           Verbose - display the port tuning messages
  *
  * Returns:  INVALID_HANDLE_VALUE (-1) - invalid handle.
  *           Other value - Handle to be used in other Comport APIs
@@ -289,11 +661,29 @@ BOOLEAN ConfigureUart(HANDLE  hDevice_Driver,
  *****************************************************************************
  */
 HANDLE ComPortOpen(const char *ComPortDeviceName,
-		   struct COMPORT_FIELDS ComPortFields)
+		   struct COMPORT_FIELDS ComPortFields, BOOLEAN Verbose)
 {
-	INT32  port_handler;
+	INT32		port_handler;
+	struct TTY_PORT	*port = NULL;
+	UINT32		i;
+
+	if (strncmp(ComPortDeviceName, COMP_PORT_PREFIX_TCP,
+		    strlen(COMP_PORT_PREFIX_TCP)) == 0)
+		return TcpPortOpen(ComPortDeviceName +
+				   strlen(COMP_PORT_PREFIX_TCP),
+				   ComPortFields, FALSE);
+
+	if (strncmp(ComPortDeviceName, COMP_PORT_PREFIX_RFC2217,
+		    strlen(COMP_PORT_PREFIX_RFC2217)) == 0)
+		return TcpPortOpen(ComPortDeviceName +
+				   strlen(COMP_PORT_PREFIX_RFC2217),
+				   ComPortFields, TRUE);
 
-	port_handler = open(ComPortDeviceName, O_RDWR | O_NOCTTY);
+	/*
+	 * Open without waiting for carrier detect, CLOCAL is set by
+	 * ConfigureUart() and blocking mode is restored afterwards.
+	 */
+	port_handler = open(ComPortDeviceName, O_RDWR | O_NOCTTY | O_NONBLOCK);
 
 	if (port_handler < 0) {
 		//displayColorMsg(FAIL,
@@ -302,15 +692,38 @@ HANDLE ComPortOpen(const char *ComPortDeviceName,
 		return INVALID_HANDLE_VALUE;
 	}
 
-	tcgetattr(port_handler, &savetty);
+	pthread_mutex_lock(&TtyPortsLock);
+	for (i = 0; i < MAX_COMPORT_DEVICES; i++) {
+		if (!TtyPorts[i].inUse) {
+			port = &TtyPorts[i];
+			port->inUse  = TRUE;
+			port->handle = (HANDLE) port_handler;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&TtyPortsLock);
+
+	if (port == NULL) {
+		close(port_handler);
+		return INVALID_HANDLE_VALUE;
+	}
+
+	tcgetattr(port_handler, &port->savetty);
 
 	if (!ConfigureUart(port_handler, ComPortFields)) {
 		displayColorMsg(FAIL,
 		"ComPortOpen() Error %d, Failed on ConfigureUart() %s, %s\n",
 				errno, ComPortDeviceName,  strerror(errno));
+		port->inUse = FALSE;
+		close(port_handler);
 		return INVALID_HANDLE_VALUE;
 	}
 
+	fcntl(port_handler, F_SETFL,
+	      fcntl(port_handler, F_GETFL) & ~O_NONBLOCK);
+
+	tty_low_latency_setup(port, ComPortDeviceName, Verbose);
+
 	return (HANDLE) port_handler;
 }
 
@@ -328,8 +741,17 @@ HANDLE ComPortOpen(const char *ComPortDeviceName,
  */
 BOOLEAN ComPortClose(HANDLE nDeviceID)
 {
+	struct TTY_PORT *port;
+
+	if (TcpPortIsHandle(nDeviceID))
+		return TcpPortClose(nDeviceID);
 
-	tcsetattr(nDeviceID, TCSANOW, &savetty);
+	port = tty_find_port(nDeviceID);
+	if (port != NULL) {
+		tty_low_latency_restore(port);
+		tcsetattr(nDeviceID, TCSANOW, &port->savetty);
+		port->inUse = FALSE;
+	}
 
 	if (close(nDeviceID) == INVALID_HANDLE_VALUE) {
 		displayColorMsg(FAIL,
@@ -363,6 +785,9 @@ BOOLEAN ComPortWriteBin(HANDLE		nDeviceID,
 {
 	UINT32  bytes_written;
 
+	if (TcpPortIsHandle(nDeviceID))
+		return TcpPortWriteBin(nDeviceID, Buffer, BufSize);
+
 	bytes_written = write(nDeviceID, Buffer, BufSize);
 	if (bytes_written != BufSize) {
 		displayColorMsg(FAIL,
@@ -396,6 +821,9 @@ UINT32 ComPortReadBin(HANDLE	nDeviceID,
 {
 	INT32   read_bytes;
 
+	if (TcpPortIsHandle(nDeviceID))
+		return TcpPortReadBin(nDeviceID, Buffer, BufSize);
+
 	/* Reset read blocking mode */
 	set_read_blocking(nDeviceID, FALSE);
 
@@ -410,6 +838,66 @@ UINT32 ComPortReadBin(HANDLE	nDeviceID,
 	return read_bytes;
 }
 
+/******************************************************************************
+ * Function: UINT32 ComPortReadScatter()
+ *
+ * Purpose:  Read a binary data from Comport into several buffers
+ *
+ * Params:   nDeviceID - the opened handle returned by ComPortOpen()
+ *           Iov - buffers, filled one after the other
+ *           IovCnt - number of buffers, up to COMP_MAX_IOV
+ *
+ * Returns:  The number of bytes read.
+ *
+ * Comments: A serial port is read with a single readv().
+ *
+ *****************************************************************************
+ */
+UINT32 ComPortReadScatter(HANDLE			nDeviceID,
+			  const struct COMP_IOV	*Iov,
+			  UINT32			IovCnt)
+{
+	struct iovec	vec[COMP_MAX_IOV];
+	ssize_t		read_bytes;
+	UINT32		total = 0;
+	UINT32		n;
+	UINT32		i;
+
+	/* Remote data is copied out of the decoded stream anyway */
+	if (TcpPortIsHandle(nDeviceID)) {
+		for (i = 0; i < IovCnt; i++) {
+			n = TcpPortReadBin(nDeviceID, Iov[i].Buffer,
+					   Iov[i].BufSize);
+			total += n;
+			if (n < Iov[i].BufSize)
+				break;
+		}
+		return total;
+	}
+
+	if (IovCnt > COMP_MAX_IOV)
+		IovCnt = COMP_MAX_IOV;
+
+	for (i = 0; i < IovCnt; i++) {
+		vec[i].iov_base = Iov[i].Buffer;
+		vec[i].iov_len  = Iov[i].BufSize;
+	}
+
+	/* Reset read blocking mode */
+	set_read_blocking(nDeviceID, FALSE);
+
+	read_bytes = readv(nDeviceID, vec, IovCnt);
+
+	if (read_bytes == -1) {
+		displayColorMsg(FAIL,
+	"ComPortReadScatter() Error: %d Device number %lu was not opened, %s.\n",
+				errno, (UINT32)nDeviceID,  strerror(errno));
+		return 0;
+	}
+
+	return (UINT32)read_bytes;
+}
+
 /******************************************************************************
  * Function: UINT32 ComPortWaitForRead()
  *
@@ -422,21 +910,41 @@ UINT32 ComPortReadBin(HANDLE	nDeviceID,
  *****************************************************************************
  */
 UINT32 ComPortWaitForRead(HANDLE nDeviceID)
+{
+	/* Wait up to 10 sec untile byte is received for read. */
+	return ComPortWaitForReadTimeout(nDeviceID, COMMAND_TIMEOUT);
+}
+
+/******************************************************************************
+ * Function: UINT32 ComPortWaitForReadTimeout()
+ *
+ * Purpose:  Wait until a byte is received for read, or Timeout expires
+ *
+ * Params:   nDeviceID - the opened handle returned by ComPortOpen()
+ *           Timeout - maximum time to wait, in milliseconds
+ *
+ * Returns:  The number of bytes that are waiting in RX queue.
+ *
+ *****************************************************************************
+ */
+UINT32 ComPortWaitForReadTimeout(HANDLE nDeviceID, UINT32 Timeout)
 {
 	INT32           bytes;
 	INT32           ret_val;
 	struct pollfd   fds;
 
+	if (TcpPortIsHandle(nDeviceID))
+		return TcpPortWaitForRead(nDeviceID, Timeout);
+
 	/* Set read blocking mode */
 	set_read_blocking(nDeviceID, TRUE);
 
-	/* Wait up to 10 sec untile byte is received for read. */
 	fds.fd      = nDeviceID;
 	fds.events  = POLLIN;
-	ret_val = poll(&fds, 1, COMMAND_TIMEOUT);
+	ret_val = poll(&fds, 1, (int)Timeout);
 	if (ret_val < 0) {
 		displayColorMsg(FAIL,
-		"ComPortWaitForRead() Error: %d Device number %lu %s\n",
+		"ComPortWaitForReadTimeout() Error: %d Device number %lu %s\n",
 				errno, (UINT32)nDeviceID,  strerror(errno));
 		return 0;
 	}
@@ -448,7 +956,7 @@ UINT32 ComPortWaitForRead(HANDLE nDeviceID)
 		/* Get number of bytes that are ready to be read. */
 		if (ioctl(nDeviceID, FIONREAD, &bytes) < 0) {
 			displayColorMsg(FAIL,
-		"ComPortWaitForRead() Error: %d Device number %lu %s\n",
+		"ComPortWaitForReadTimeout() Error: %d Device number %lu %s\n",
 					errno, (UINT32)nDeviceID,
 					strerror(errno));
 			return 0;
@@ -458,4 +966,74 @@ UINT32 ComPortWaitForRead(HANDLE nDeviceID)
 	return bytes;
 }
 
+/******************************************************************************
+ * Function: UINT32 ComPortEnumerate()
+ *
+ * Purpose:  List the serial ports present in the system, using sysfs.
+ *
+ * Params:   Ports - array filled with the found ports
+ *           MaxPorts - number of entries in Ports
+ *
+ * Returns:  The number of ports found.
+ *
+ *****************************************************************************
+ */
+UINT32 ComPortEnumerate(struct COMPORT_INFO *Ports, UINT32 MaxPorts)
+{
+	DIR			*dir;
+	struct dirent		*entry;
+	struct COMPORT_INFO	*info;
+	char			path[PATH_MAX];
+	char			driver[PATH_MAX];
+	const char		*driverName;
+	ssize_t			len;
+	INT32			type;
+	UINT32			numPorts = 0;
+
+	dir = opendir(SYSFS_TTY_CLASS);
+	if (dir == NULL) {
+		displayColorMsg(FAIL,
+			"ComPortEnumerate() Error: %d cannot open %s, %s\n",
+			errno, SYSFS_TTY_CLASS, strerror(errno));
+		return 0;
+	}
+
+	while (((entry = readdir(dir)) != NULL) && (numPorts < MaxPorts)) {
+		if (entry->d_name[0] == '.')
+			continue;
+
+		if (strlen(entry->d_name) >= MAX_COMPORT_NAME_SIZE)
+			continue;
+
+		/* Virtual consoles and pseudo terminals have no driver */
+		snprintf(path, sizeof(path),
+			 SYSFS_TTY_CLASS "/%s/device/driver", entry->d_name);
+		len = readlink(path, driver, sizeof(driver) - 1);
+		if (len <= 0)
+			continue;
+		driver[len] = '\0';
+		driverName = strrchr(driver, '/');
+		driverName = (driverName == NULL) ? driver : driverName + 1;
+
+		/* Legacy 8250 driver registers all slots, even empty ones */
+		if (strcmp(driverName, SERIAL8250_DRIVER_NAME) == 0) {
+			snprintf(path, sizeof(path),
+				 SYSFS_TTY_CLASS "/%s/type", entry->d_name);
+			if (!sysfs_read_int(path, &type) ||
+			    (type == SERIAL_PORT_UNKNOWN))
+				continue;
+		}
+
+		info = &Ports[numPorts++];
+		memset(info, 0, sizeof(*info));
+		strcpy(info->Name, entry->d_name);
+		strncpy(info->Driver, driverName, sizeof(info->Driver) - 1);
+		sysfs_get_usb_info(entry->d_name, info);
+	}
 
+	closedir(dir);
+
+	qsort(Ports, numPorts, sizeof(Ports[0]), compare_port_info);
+
+	return numPorts;
+}
@@ -0,0 +1,724 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<-----------------------------------------------------------------------
+ * File Contents:
+ *   l_tcp_port.c
+ *            This file implements a remote serial port reached over TCP,
+ *            either as a raw byte stream or using RFC 2217 (telnet
+ *            COM-PORT-OPTION) for remote baud rate and line control.
+ *  Project:
+ *            UartUpdateTool
+ *--------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "uut_types.h"
+#include "program.h"
+#include "ComPort.h"
+#include "TcpPort.h"
+
+/*---------------------------------------------------------------------------
+ * Constant definitions
+ *---------------------------------------------------------------------------
+ */
+#define TCP_RX_BUF_SIZE		4096
+#define TCP_TX_CHUNK_SIZE	1024
+#define TCP_READ_TIMEOUT	500	/* Same as VTIME of the tty backend */
+#define TCP_HOST_NAME_SIZE	256
+
+/* Telnet protocol (RFC 854) */
+#define TELNET_IAC		255
+#define TELNET_DONT		254
+#define TELNET_DO		253
+#define TELNET_WONT		252
+#define TELNET_WILL		251
+#define TELNET_SB		250
+#define TELNET_SE		240
+
+#define TELNET_OPT_BINARY	0
+#define TELNET_OPT_SGA		3
+#define TELNET_OPT_COM_PORT	44
+
+/* RFC 2217 client to server COM-PORT-OPTION commands */
+#define CPO_SET_BAUDRATE	1
+#define CPO_SET_DATASIZE	2
+#define CPO_SET_PARITY		3
+#define CPO_SET_STOPSIZE	4
+#define CPO_SET_CONTROL		5
+#define CPO_PURGE_DATA		12
+
+#define CPO_PURGE_RX		1
+
+/* RFC 2217 SET-CONTROL values */
+#define CPO_CONTROL_DTR_ON	8
+#define CPO_CONTROL_DTR_OFF	9
+#define CPO_CONTROL_RTS_ON	11
+#define CPO_CONTROL_RTS_OFF	12
+
+/*---------------------------------------------------------------------------
+ * Internal types
+ *---------------------------------------------------------------------------
+ */
+enum TELNET_STATE {
+	TS_DATA,
+	TS_IAC,
+	TS_OPT,
+	TS_SB,
+	TS_SB_IAC
+};
+
+struct TCP_PORT {
+	BOOLEAN			inUse;
+	HANDLE			handle;
+	BOOLEAN			rfc2217;
+	enum TELNET_STATE	state;
+	UINT8			cmd;
+	UINT8			rxBuf[TCP_RX_BUF_SIZE];
+	UINT32			rxHead;
+	UINT32			rxTail;
+};
+
+/*---------------------------------------------------------------------------
+ * Global variables
+ *---------------------------------------------------------------------------
+ */
+static struct TCP_PORT TcpPorts[MAX_TCP_PORTS];
+static pthread_mutex_t TcpPortsLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*--------------------------------------------------------------------------
+ * Local Function implementation
+ *--------------------------------------------------------------------------
+ */
+
+/*--------------------------------------------------------------------------
+ * Function:	tcp_find_port
+ *
+ * Parameters:	nDeviceID - handle returned by TcpPortOpen()
+ * Returns:	The port descriptor, NULL if the handle is not a TCP port.
+ *--------------------------------------------------------------------------
+ */
+static struct TCP_PORT *tcp_find_port(HANDLE nDeviceID)
+{
+	UINT32 i;
+
+	for (i = 0; i < MAX_TCP_PORTS; i++) {
+		if (TcpPorts[i].inUse && (TcpPorts[i].handle == nDeviceID))
+			return &TcpPorts[i];
+	}
+
+	return NULL;
+}
+
+/*--------------------------------------------------------------------------
+ * Function:	tcp_send_all
+ *
+ * Parameters:	port   - TCP port descriptor.
+ *		buf    - data to send (already telnet escaped, if needed).
+ *		size   - data size.
+ * Returns:	TRUE if all data was sent.
+ *--------------------------------------------------------------------------
+ */
+static BOOLEAN tcp_send_all(struct TCP_PORT *port, const UINT8 *buf,
+			    UINT32 size)
+{
+	ssize_t sent;
+
+	while (size > 0) {
+		sent = send((int)port->handle, buf, size, MSG_NOSIGNAL);
+		if (sent < 0) {
+			if (errno == EINTR)
+				continue;
+			displayColorMsg(FAIL,
+		"TcpPortWriteBin() Error: %d Failed to send data to socket %d, %s.\n",
+				errno, (int)port->handle, strerror(errno));
+			return FALSE;
+		}
+		buf  += sent;
+		size -= (UINT32)sent;
+	}
+
+	return TRUE;
+}
+
+/*--------------------------------------------------------------------------
+ * Function:	tcp_telnet_option
+ *
+ * Parameters:	port - TCP port descriptor.
+ *		cmd  - WILL/WONT/DO/DONT received from the server.
+ *		opt  - telnet option.
+ * Returns:	none
+ * Description:
+ *		Refuse any option we did not offer; acknowledgements of the
+ *		options we requested need no reply.
+ *--------------------------------------------------------------------------
+ */
+static void tcp_telnet_option(struct TCP_PORT *port, UINT8 cmd, UINT8 opt)
+{
+	UINT8 reply[3];
+
+	if ((opt == TELNET_OPT_BINARY) || (opt == TELNET_OPT_SGA) ||
+	    (opt == TELNET_OPT_COM_PORT))
+		return;
+
+	reply[0] = TELNET_IAC;
+	reply[2] = opt;
+
+	if (cmd == TELNET_DO)
+		reply[1] = TELNET_WONT;
+	else if (cmd == TELNET_WILL)
+		reply[1] = TELNET_DONT;
+	else
+		return;
+
+	tcp_send_all(port, reply, sizeof(reply));
+}
+
+/*--------------------------------------------------------------------------
+ * Function:	tcp_decode
+ *
+ * Parameters:	port - TCP port descriptor.
+ *		buf  - bytes received from the socket.
+ *		size - number of received bytes.
+ * Returns:	none
+ * Description:
+ *		Append received bytes to the RX buffer. In RFC 2217 mode,
+ *		telnet commands and COM-PORT-OPTION notifications are stripped
+ *		and escaped IAC bytes are restored.
+ *--------------------------------------------------------------------------
+ */
+static void tcp_decode(struct TCP_PORT *port, const UINT8 *buf, UINT32 size)
+{
+	UINT32 i;
+	UINT8  c;
+
+	if (!port->rfc2217) {
+		memcpy(&port->rxBuf[port->rxTail], buf, size);
+		port->rxTail += size;
+		return;
+	}
+
+	for (i = 0; i < size; i++) {
+		c = buf[i];
+
+		switch (port->state) {
+		case TS_DATA:
+			if (c == TELNET_IAC)
+				port->state = TS_IAC;
+			else
+				port->rxBuf[port->rxTail++] = c;
+			break;
+
+		case TS_IAC:
+			if (c == TELNET_IAC) {
+				port->rxBuf[port->rxTail++] = c;
+				port->state = TS_DATA;
+			} else if (c == TELNET_SB) {
+				port->state = TS_SB;
+			} else if ((c == TELNET_WILL) || (c == TELNET_WONT) ||
+				   (c == TELNET_DO) || (c == TELNET_DONT)) {
+				port->cmd   = c;
+				port->state = TS_OPT;
+			} else {
+				port->state = TS_DATA;
+			}
+			break;
+
+		case TS_OPT:
+			tcp_telnet_option(port, port->cmd, c);
+			port->state = TS_DATA;
+			break;
+
+		case TS_SB:
+			/* Server notifications are not needed, skip them */
+			if (c == TELNET_IAC)
+				port->state = TS_SB_IAC;
+			break;
+
+		case TS_SB_IAC:
+			port->state = (c == TELNET_SE) ? TS_DATA : TS_SB;
+			break;
+		}
+	}
+}
+
+/*--------------------------------------------------------------------------
+ * Function:	tcp_fill
+ *
+ * Parameters:	port       - TCP port descriptor.
+ *		timeout_ms - time to wait for the socket to become readable.
+ * Returns:	FALSE if the connection failed, TRUE otherwise.
+ * Description:
+ *		Move whatever the socket holds into the RX buffer.
+ *--------------------------------------------------------------------------
+ */
+static BOOLEAN tcp_fill(struct TCP_PORT *port, UINT32 timeout_ms)
+{
+	UINT8		buf[TCP_RX_BUF_SIZE];
+	struct pollfd	fds;
+	ssize_t		got;
+	UINT32		room;
+	int		ret_val;
+
+	/* Compact the RX buffer */
+	if (port->rxHead == port->rxTail) {
+		port->rxHead = 0;
+		port->rxTail = 0;
+	} else if (port->rxHead > 0) {
+		memmove(port->rxBuf, &port->rxBuf[port->rxHead],
+			port->rxTail - port->rxHead);
+		port->rxTail -= port->rxHead;
+		port->rxHead  = 0;
+	}
+
+	room = TCP_RX_BUF_SIZE - port->rxTail;
+	if (room == 0)
+		return TRUE;
+
+	fds.fd     = (int)port->handle;
+	fds.events = POLLIN;
+	ret_val = poll(&fds, 1, (int)timeout_ms);
+	if (ret_val < 0) {
+		if (errno == EINTR)
+			return TRUE;
+		displayColorMsg(FAIL,
+			"TcpPortWaitForRead() Error: %d socket %d %s\n",
+			errno, (int)port->handle, strerror(errno));
+		return FALSE;
+	}
+
+	if (ret_val == 0)
+		return TRUE;
+
+	got = recv((int)port->handle, buf, room, MSG_DONTWAIT);
+	if (got == 0) {
+		displayColorMsg(FAIL,
+			"TcpPortWaitForRead() Error: connection closed by peer\n");
+		return FALSE;
+	}
+	if (got < 0)
+		return ((errno == EAGAIN) || (errno == EINTR));
+
+	tcp_decode(port, buf, (UINT32)got);
+
+	return TRUE;
+}
+
+/*--------------------------------------------------------------------------
+ * Function:	tcp_connect
+ *
+ * Parameters:	hostPort - "host:port" or "[addr]:port".
+ * Returns:	Connected socket, -1 in case of an error.
+ *--------------------------------------------------------------------------
+ */
+static int tcp_connect(const char *hostPort)
+{
+	char		host[TCP_HOST_NAME_SIZE];
+	const char	*service;
+	const char	*sep;
+	size_t		hostLen;
+	struct addrinfo	hints;
+	struct addrinfo	*res;
+	struct addrinfo	*ai;
+	int		sock = -1;
+	int		one  = 1;
+	int		err;
+
+	if (hostPort[0] == '[') {
+		sep = strchr(hostPort, ']');
+		if ((sep == NULL) || (sep[1] != ':'))
+			return -1;
+		hostLen = sep - hostPort - 1;
+		hostPort++;
+		service = sep + 2;
+	} else {
+		sep = strrchr(hostPort, ':');
+		if (sep == NULL)
+			return -1;
+		hostLen = sep - hostPort;
+		service = sep + 1;
+	}
+
+	if (hostLen >= sizeof(host))
+		return -1;
+	memcpy(host, hostPort, hostLen);
+	host[hostLen] = '\0';
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family   = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+
+	err = getaddrinfo(host, service, &hints, &res);
+	if (err != 0) {
+		displayColorMsg(FAIL, "TcpPortOpen() Error: %s: %s\n",
+				host, gai_strerror(err));
+		return -1;
+	}
+
+	for (ai = res; ai != NULL; ai = ai->ai_next) {
+		sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if (sock < 0)
+			continue;
+		if (connect(sock, ai->ai_addr, ai->ai_addrlen) == 0)
+			break;
+		close(sock);
+		sock = -1;
+	}
+
+	freeaddrinfo(res);
+
+	if (sock < 0)
+		return -1;
+
+	/* Packets are small and latency bound, never let Nagle hold them */
+	setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	return sock;
+}
+
+/*--------------------------------------------------------------------------
+ * Global Function implementation
+ *--------------------------------------------------------------------------
+ */
+
+/******************************************************************************
+ * Function: HANDLE TcpPortOpen()
+ *
+ * Purpose:  Connect to a remote serial port and return its handle.
+ *
+ * Params:   hostPort - "host:port" string
+ *           ComPortFields - a struct filled with Comport settings
+ *           rfc2217 - negotiate RFC 2217 line control
+ *
+ * Returns:  INVALID_HANDLE_VALUE (-1) - invalid handle.
+ *           Other value - Handle to be used in other Comport APIs
+ *
+ *****************************************************************************
+ */
+HANDLE TcpPortOpen(const char *hostPort,
+		   struct COMPORT_FIELDS ComPortFields,
+		   BOOLEAN rfc2217)
+{
+	static const UINT8 negotiation[] = {
+		TELNET_IAC, TELNET_WILL, TELNET_OPT_BINARY,
+		TELNET_IAC, TELNET_DO,   TELNET_OPT_BINARY,
+		TELNET_IAC, TELNET_WILL, TELNET_OPT_SGA,
+		TELNET_IAC, TELNET_DO,   TELNET_OPT_SGA,
+		TELNET_IAC, TELNET_WILL, TELNET_OPT_COM_PORT
+	};
+	struct TCP_PORT *port = NULL;
+	UINT32		i;
+	int		sock;
+
+	sock = tcp_connect(hostPort);
+	if (sock < 0)
+		return INVALID_HANDLE_VALUE;
+
+	pthread_mutex_lock(&TcpPortsLock);
+	for (i = 0; i < MAX_TCP_PORTS; i++) {
+		if (!TcpPorts[i].inUse) {
+			port = &TcpPorts[i];
+			memset(port, 0, sizeof(*port));
+			port->inUse  = TRUE;
+			port->handle = (HANDLE)sock;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&TcpPortsLock);
+
+	if (port == NULL) {
+		close(sock);
+		return INVALID_HANDLE_VALUE;
+	}
+
+	port->rfc2217 = rfc2217;
+	port->state   = TS_DATA;
+
+	if (rfc2217 &&
+	    !tcp_send_all(port, negotiation, sizeof(negotiation))) {
+		TcpPortClose(port->handle);
+		return INVALID_HANDLE_VALUE;
+	}
+
+	if (!TcpPortConfigure(port->handle, ComPortFields)) {
+		TcpPortClose(port->handle);
+		return INVALID_HANDLE_VALUE;
+	}
+
+	return port->handle;
+}
+
+/******************************************************************************
+ * Function: TcpPortIsHandle()
+ *
+ * Purpose:  Check whether a handle belongs to the TCP transport.
+ *
+ *****************************************************************************
+ */
+BOOLEAN TcpPortIsHandle(HANDLE nDeviceID)
+{
+	return (tcp_find_port(nDeviceID) != NULL);
+}
+
+/******************************************************************************
+ * Function: TcpPortConfigure()
+ *
+ * Purpose:  Apply serial settings. In RFC 2217 mode the settings are sent to
+ *           the console server; in raw mode they are owned by the server
+ *           configuration. In both modes pending input is discarded, like
+ *           tcflush() does for a local tty.
+ *
+ *****************************************************************************
+ */
+BOOLEAN TcpPortConfigure(HANDLE nDeviceID,
+			 struct COMPORT_FIELDS ComPortFields)
+{
+	static const UINT8 parity_map[]   = { 1, 2, 3, 4, 5 };
+	static const UINT8 stopbits_map[] = { 1, 3, 2 };
+	static const UINT8 flow_map[]     = { 1, 2, 3 };
+	struct TCP_PORT *port = tcp_find_port(nDeviceID);
+	UINT8		cmd[64];
+	UINT8		value[4];
+	UINT32		len = 0;
+	UINT32		i;
+
+	if (port == NULL)
+		return FALSE;
+
+	if (port->rfc2217) {
+		value[0] = (UINT8)(ComPortFields.BaudRate >> 24);
+		value[1] = (UINT8)(ComPortFields.BaudRate >> 16);
+		value[2] = (UINT8)(ComPortFields.BaudRate >> 8);
+		value[3] = (UINT8)(ComPortFields.BaudRate);
+
+		cmd[len++] = TELNET_IAC;
+		cmd[len++] = TELNET_SB;
+		cmd[len++] = TELNET_OPT_COM_PORT;
+		cmd[len++] = CPO_SET_BAUDRATE;
+		for (i = 0; i < sizeof(value); i++) {
+			cmd[len++] = value[i];
+			if (value[i] == TELNET_IAC)
+				cmd[len++] = TELNET_IAC;
+		}
+		cmd[len++] = TELNET_IAC;
+		cmd[len++] = TELNET_SE;
+
+#define CPO_APPEND(code, val)				\
+		do {					\
+			cmd[len++] = TELNET_IAC;	\
+			cmd[len++] = TELNET_SB;		\
+			cmd[len++] = TELNET_OPT_COM_PORT; \
+			cmd[len++] = (code);		\
+			cmd[len++] = (val);		\
+			cmd[len++] = TELNET_IAC;	\
+			cmd[len++] = TELNET_SE;		\
+		} while (0)
+
+		CPO_APPEND(CPO_SET_DATASIZE, ComPortFields.ByteSize);
+		CPO_APPEND(CPO_SET_PARITY,
+			   parity_map[MIN(ComPortFields.Parity, 4)]);
+		CPO_APPEND(CPO_SET_STOPSIZE,
+			   stopbits_map[MIN(ComPortFields.StopBits, 2)]);
+		CPO_APPEND(CPO_SET_CONTROL,
+			   flow_map[MIN(ComPortFields.FlowControl, 2)]);
+		CPO_APPEND(CPO_PURGE_DATA, CPO_PURGE_RX);
+
+#undef CPO_APPEND
+
+		if (!tcp_send_all(port, cmd, len))
+			return FALSE;
+	}
+
+	/* Drop anything already received */
+	if (!tcp_fill(port, 0))
+		return FALSE;
+	port->rxHead = 0;
+	port->rxTail = 0;
+
+	return TRUE;
+}
+
+/******************************************************************************
+ * Function: TcpPortSetModemLines()
+ *
+ * Purpose:  Assert or release the console server modem lines, through RFC
+ *           2217 SET-CONTROL commands. A raw port has no modem lines.
+ *
+ *****************************************************************************
+ */
+BOOLEAN TcpPortSetModemLines(HANDLE nDeviceID, UINT32 Lines, BOOLEAN Assert)
+{
+	struct TCP_PORT *port = tcp_find_port(nDeviceID);
+	UINT8		cmd[14];
+	UINT32		len = 0;
+
+	if (port == NULL)
+		return FALSE;
+
+	if (!port->rfc2217) {
+		displayColorMsg(FAIL,
+			"TcpPortSetModemLines() Error: no modem lines on a raw TCP port, use rfc2217:\n");
+		return FALSE;
+	}
+
+#define CPO_CONTROL(val)				\
+	do {						\
+		cmd[len++] = TELNET_IAC;		\
+		cmd[len++] = TELNET_SB;			\
+		cmd[len++] = TELNET_OPT_COM_PORT;	\
+		cmd[len++] = CPO_SET_CONTROL;		\
+		cmd[len++] = (val);			\
+		cmd[len++] = TELNET_IAC;		\
+		cmd[len++] = TELNET_SE;			\
+	} while (0)
+
+	if (Lines & COMPORT_LINE_DTR)
+		CPO_CONTROL(Assert ? CPO_CONTROL_DTR_ON : CPO_CONTROL_DTR_OFF);
+	if (Lines & COMPORT_LINE_RTS)
+		CPO_CONTROL(Assert ? CPO_CONTROL_RTS_ON : CPO_CONTROL_RTS_OFF);
+
+#undef CPO_CONTROL
+
+	return tcp_send_all(port, cmd, len);
+}
+
+/******************************************************************************
+ * Function: TcpPortClose()
+ *
+ * Purpose:  Close the connection specified by Handle
+ *
+ *****************************************************************************
+ */
+BOOLEAN TcpPortClose(HANDLE nDeviceID)
+{
+	struct TCP_PORT *port = tcp_find_port(nDeviceID);
+
+	if (port == NULL)
+		return FALSE;
+
+	port->inUse = FALSE;
+
+	if (close((int)nDeviceID) != 0) {
+		displayColorMsg(FAIL,
+			"TcpPortClose() Error: %d socket %d, %s.\n",
+			errno, (int)nDeviceID, strerror(errno));
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/******************************************************************************
+ * Function: TcpPortWriteBin()
+ *
+ * Purpose:  Send binary data. The whole buffer is escaped into as few
+ *           send() calls as possible, so each protocol packet leaves the
+ *           host as a single TCP segment.
+ *
+ *****************************************************************************
+ */
+BOOLEAN TcpPortWriteBin(HANDLE nDeviceID, const UINT8 *Buffer, UINT32 BufSize)
+{
+	struct TCP_PORT *port = tcp_find_port(nDeviceID);
+	UINT8		escBuf[TCP_TX_CHUNK_SIZE * 2];
+	UINT32		len;
+	UINT32		i;
+
+	if (port == NULL)
+		return FALSE;
+
+	if (!port->rfc2217)
+		return tcp_send_all(port, Buffer, BufSize);
+
+	while (BufSize > 0) {
+		len = 0;
+		for (i = 0; (i < BufSize) && (i < TCP_TX_CHUNK_SIZE); i++) {
+			escBuf[len++] = Buffer[i];
+			if (Buffer[i] == TELNET_IAC)
+				escBuf[len++] = TELNET_IAC;
+		}
+
+		if (!tcp_send_all(port, escBuf, len))
+			return FALSE;
+
+		Buffer  += i;
+		BufSize -= i;
+	}
+
+	return TRUE;
+}
+
+/******************************************************************************
+ * Function: TcpPortReadBin()
+ *
+ * Purpose:  Read received data, waiting up to TCP_READ_TIMEOUT for the first
+ *           byte (same semantics as the tty backend VTIME setting).
+ *
+ *****************************************************************************
+ */
+UINT32 TcpPortReadBin(HANDLE nDeviceID, UINT8 *Buffer, UINT32 BufSize)
+{
+	struct TCP_PORT *port = tcp_find_port(nDeviceID);
+	UINT32		avail;
+
+	if (port == NULL)
+		return 0;
+
+	if (port->rxHead == port->rxTail)
+		TcpPortWaitForRead(nDeviceID, TCP_READ_TIMEOUT);
+
+	avail = MIN(port->rxTail - port->rxHead, BufSize);
+	memcpy(Buffer, &port->rxBuf[port->rxHead], avail);
+	port->rxHead += avail;
+
+	return avail;
+}
+
+/******************************************************************************
+ * Function: TcpPortWaitForRead()
+ *
+ * Purpose:  Wait until data is received for read.
+ *
+ * Returns:  The number of (decoded) bytes that are waiting in RX buffer.
+ *
+ *****************************************************************************
+ */
+UINT32 TcpPortWaitForRead(HANDLE nDeviceID, UINT32 timeout_ms)
+{
+	struct TCP_PORT		*port = tcp_find_port(nDeviceID);
+	unsigned long long	deadline;
+	unsigned long long	now;
+
+	if (port == NULL)
+		return 0;
+
+	/* Pick up whatever already arrived */
+	if (!tcp_fill(port, 0))
+		return 0;
+
+	deadline = (getTimeUs() / 1000) + timeout_ms;
+
+	while (port->rxHead == port->rxTail) {
+		now = getTimeUs() / 1000;
+		if (now >= deadline)
+			break;
+		if (!tcp_fill(port, (UINT32)(deadline - now)))
+			return 0;
+	}
+
+	return port->rxTail - port->rxHead;
+}
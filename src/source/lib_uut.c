@@ -0,0 +1,536 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   lib_uut.c
+ *	This file implements the Linux shared library API: the DLL
+ *	operations, each on the session given by the caller.
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "uut_types.h"
+#include "program.h"
+#include "ComPort.h"
+#include "opr.h"
+#include "session.h"
+#include "lib_uut.h"
+#include "async.h"
+#include "wcache.h"
+#include "rcache.h"
+
+/*---------------------------------------------------------------------------
+ * Functions prototypes
+ *---------------------------------------------------------------------------
+ */
+static int UUT_Idle(UUT_HANDLE handle);
+
+/*---------------------------------------------------------------------------
+ * Functions implementation
+ *---------------------------------------------------------------------------
+ */
+
+/*----------------------------------------------------------------------------
+ * Function:	UUT_Open
+ *
+ * Parameters:	portName - port to open, NULL or "" to find the device.
+ *		baudRate - host baud rate.
+ *		handle   - returned session handle.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects: Opens the port, and keeps it open until UUT_Close.
+ * Description:
+ *	Open the port and synchronize with the device.
+ *---------------------------------------------------------------------------
+ */
+int UUT_Open(const char *portName, UINT32 baudRate, UUT_HANDLE *handle)
+{
+	struct UUT_SESSION	*session;
+	enum EXIT_CODE		ec = EC_OK;
+
+	*handle = NULL;
+
+	session = (struct UUT_SESSION *)malloc(sizeof(*session));
+	if (session == NULL)
+		return EC_SIZE_ERR;
+
+	SESSION_Init(session, baudRate);
+	session->verbose = FALSE;
+
+	if ((portName == NULL) || (portName[0] == '\0')) {
+		/* The port found is left open and synchronized */
+		if (!OPR_FindPort(session, session->portName))
+			ec = EC_SCAN_ERR;
+	} else if (OPR_OpenPort(session, portName) != TRUE) {
+		ec = EC_PORT_ERR;
+	} else if (OPR_CheckSync(session, session->portCfg.BaudRate) !=
+		   SR_OK) {
+		ec = EC_SYNC_ERR;
+	}
+
+	if (ec != EC_OK) {
+		UUT_Close(session);
+		return ec;
+	}
+
+	*handle = session;
+
+	return EC_OK;
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	UUT_Close
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ * Returns:	none
+ * Side effects: Cancels the queued operations, flushes the write cache,
+ *		 closes the port and frees the session.
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+void UUT_Close(UUT_HANDLE handle)
+{
+	if (handle == NULL)
+		return;
+
+	ASYNC_Free(handle);
+
+	if ((INT32)handle->portHandle > 0)
+		WCACHE_Flush(handle);
+	WCACHE_Free(handle);
+	RCACHE_Free(handle);
+
+	if ((INT32)handle->portHandle > 0)
+		OPR_ClosePort(handle);
+
+	free(handle);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	UUT_WriteMem
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ *		addr   - Memory address to write to.
+ *		buff   - data buffer to write.
+ *		size   - Data size to write.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects:
+ * Description:
+ *	Write a buffer to the device memory.
+ *---------------------------------------------------------------------------
+ */
+int UUT_WriteMem(UUT_HANDLE handle, UINT32 addr, const UINT8 *buff,
+		 UINT32 size)
+{
+	/* Ensure non-zero size */
+	if (size == 0)
+		return EC_SIZE_ERR;
+
+	if (ASYNC_Pending(handle) != 0)
+		return EC_UNSUPPORTED_CMD_ERR;
+
+	RCACHE_Invalidate(handle, addr, size);
+
+	return WCACHE_Write(handle, addr, buff, size);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	UUT_ReadMem
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ *		addr   - Memory address to read from.
+ *		buff   - data buffer that was read.
+ *		size   - Data size to read.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects:
+ * Description:
+ *	Read the device memory into a buffer.
+ *---------------------------------------------------------------------------
+ */
+int UUT_ReadMem(UUT_HANDLE handle, UINT32 addr, UINT8 *buff, UINT32 size)
+{
+	int	ec = UUT_Idle(handle);
+
+	if (ec != EC_OK)
+		return ec;
+
+	return RCACHE_Read(handle, addr, buff, size);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	UUT_ExecuteReturn
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ *		addr   - Start address to execute from.
+ *		resp   - Responce code of the executed command.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects:
+ * Description:
+ *	Execute returnable code on the device.
+ *---------------------------------------------------------------------------
+ */
+int UUT_ExecuteReturn(UUT_HANDLE handle, UINT32 addr, UINT8 *resp)
+{
+	int	ec = UUT_Idle(handle);
+
+	if (ec != EC_OK)
+		return ec;
+
+	/* The code run may change any memory */
+	RCACHE_Invalidate(handle, 0, 0);
+
+	return OPR_ExecuteCall(handle, addr, resp);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	UUT_WriteMemV
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ *		vec    - memory ranges to write, must not overlap.
+ *		count  - number of ranges.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects:
+ * Description:
+ *	Write several buffers to the device memory in one transfer.
+ *---------------------------------------------------------------------------
+ */
+int UUT_WriteMemV(UUT_HANDLE handle, const struct UUT_IOVEC *vec,
+		  UINT32 count)
+{
+	int	ec = UUT_Idle(handle);
+	UINT32	i;
+
+	if (ec != EC_OK)
+		return ec;
+
+	for (i = 0; i < count; i++)
+		RCACHE_Invalidate(handle, vec[i].addr, vec[i].len);
+
+	return OPR_WriteVec(handle, vec, count);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	UUT_ReadMemV
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ *		vec    - memory ranges to read, each into its buffer.
+ *		count  - number of ranges.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects:
+ * Description:
+ *	Read several device memory ranges in one transfer.
+ *---------------------------------------------------------------------------
+ */
+int UUT_ReadMemV(UUT_HANDLE handle, const struct UUT_IOVEC *vec, UINT32 count)
+{
+	int	ec = UUT_Idle(handle);
+
+	if (ec != EC_OK)
+		return ec;
+
+	return OPR_ReadVec(handle, vec, count);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	UUT_SetPipeline
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ *		depth  - packets sent before reading their responses.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects:
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+int UUT_SetPipeline(UUT_HANDLE handle, UINT32 depth)
+{
+	if ((depth == 0) || (depth > MAX_PIPE_DEPTH))
+		return EC_SIZE_ERR;
+
+	handle->pipeDepth = depth;
+
+	return EC_OK;
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	UUT_SetTimeout
+ *
+ * Parameters:	handle    - session handle from UUT_Open.
+ *		timeoutMs - longest wait for a response.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects:
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+int UUT_SetTimeout(UUT_HANDLE handle, UINT32 timeoutMs)
+{
+	if (timeoutMs == 0)
+		return EC_SIZE_ERR;
+
+	handle->cmdTimeout = timeoutMs;
+
+	return EC_OK;
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	UUT_SetRetries
+ *
+ * Parameters:	handle  - session handle from UUT_Open.
+ *		retries - resends of a failed packet.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects:
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+int UUT_SetRetries(UUT_HANDLE handle, UINT32 retries)
+{
+	handle->maxRetries = retries;
+
+	return EC_OK;
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	UUT_SubmitRead
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ *		addr   - Memory address to read from.
+ *		buff   - data buffer, filled as the operation goes on.
+ *		size   - Data size to read.
+ *		cb     - callbacks, NULL for none.
+ *		opId   - returned operation id.
+ * Returns:	EXIT_CODE of the submission.
+ * Side effects:
+ * Description:
+ *	Queue a read, to be run by UUT_Poll().
+ *---------------------------------------------------------------------------
+ */
+int UUT_SubmitRead(UUT_HANDLE handle, UINT32 addr, UINT8 *buff, UINT32 size,
+		   const struct UUT_ASYNC_CB *cb, UINT32 *opId)
+{
+	int	ec = (ASYNC_Pending(handle) == 0) ? WCACHE_Flush(handle) : EC_OK;
+
+	if (ec != EC_OK)
+		return ec;
+
+	return ASYNC_Submit(handle, ASYNC_OP_READ, addr, buff, NULL, size, cb,
+			    opId);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	UUT_SubmitWrite
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ *		addr   - Memory address to write to.
+ *		buff   - data buffer to write.
+ *		size   - Data size to write.
+ *		cb     - callbacks, NULL for none.
+ *		opId   - returned operation id.
+ * Returns:	EXIT_CODE of the submission.
+ * Side effects:
+ * Description:
+ *	Queue a write, to be run by UUT_Poll().
+ *---------------------------------------------------------------------------
+ */
+int UUT_SubmitWrite(UUT_HANDLE handle, UINT32 addr, const UINT8 *buff,
+		    UINT32 size, const struct UUT_ASYNC_CB *cb, UINT32 *opId)
+{
+	int	ec = (ASYNC_Pending(handle) == 0) ? WCACHE_Flush(handle) : EC_OK;
+
+	if (ec != EC_OK)
+		return ec;
+
+	RCACHE_Invalidate(handle, addr, size);
+
+	return ASYNC_Submit(handle, ASYNC_OP_WRITE, addr, NULL, buff, size, cb,
+			    opId);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	UUT_SubmitCall
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ *		addr   - Start address to execute from.
+ *		resp   - Responce code of the executed command.
+ *		cb     - callbacks, NULL for none.
+ *		opId   - returned operation id.
+ * Returns:	EXIT_CODE of the submission.
+ * Side effects:
+ * Description:
+ *	Queue the execution of returnable code, to be run by UUT_Poll().
+ *---------------------------------------------------------------------------
+ */
+int UUT_SubmitCall(UUT_HANDLE handle, UINT32 addr, UINT8 *resp,
+		   const struct UUT_ASYNC_CB *cb, UINT32 *opId)
+{
+	int	ec = (ASYNC_Pending(handle) == 0) ? WCACHE_Flush(handle) : EC_OK;
+
+	if (ec != EC_OK)
+		return ec;
+
+	RCACHE_Invalidate(handle, 0, 0);
+
+	return ASYNC_Submit(handle, ASYNC_OP_CALL, addr, resp, NULL, 0, cb,
+			    opId);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	UUT_Poll
+ *
+ * Parameters:	handle    - session handle from UUT_Open.
+ *		timeoutMs - longest wait for the device, 0 not to wait.
+ * Returns:	The number of operations not done yet.
+ * Side effects: Calls the operation callbacks.
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+int UUT_Poll(UUT_HANDLE handle, UINT32 timeoutMs)
+{
+	return (int)ASYNC_Poll(handle, timeoutMs);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	UUT_Cancel
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ *		opId   - operation id from a UUT_Submit call.
+ * Returns:	EC_OK, or EC_OPR_MUM_ERR when the operation is already done.
+ * Side effects:
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+int UUT_Cancel(UUT_HANDLE handle, UINT32 opId)
+{
+	return ASYNC_Cancel(handle, opId);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	UUT_GetFd
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ * Returns:	The file descriptor of the session port.
+ * Side effects:
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+int UUT_GetFd(UUT_HANDLE handle)
+{
+	/* Both the serial and the TCP port handles are descriptors */
+	return (int)handle->portHandle;
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	UUT_Process
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ * Returns:	The number of operations not done yet.
+ * Side effects: Calls the operation callbacks.
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+int UUT_Process(UUT_HANDLE handle)
+{
+	return (int)ASYNC_Poll(handle, 0);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	UUT_NextDeadline
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ * Returns:	Milliseconds until UUT_Process is due, 0 now, -1 never.
+ * Side effects:
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+int UUT_NextDeadline(UUT_HANDLE handle)
+{
+	return (int)ASYNC_NextDeadline(handle);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	UUT_SetWriteCache
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ *		size   - cache size in bytes, 0 to write through.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects: Flushes the cache in use first.
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+int UUT_SetWriteCache(UUT_HANDLE handle, UINT32 size)
+{
+	if (ASYNC_Pending(handle) != 0)
+		return EC_UNSUPPORTED_CMD_ERR;
+
+	return WCACHE_Enable(handle, size);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	UUT_Flush
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ * Returns:	EXIT_CODE of the cached writes.
+ * Side effects:
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+int UUT_Flush(UUT_HANDLE handle)
+{
+	return UUT_Idle(handle);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	UUT_SetReadCache
+ *
+ * Parameters:	handle   - session handle from UUT_Open.
+ *		size     - cache size in bytes, 0 to read through.
+ *		maxAgeMs - longest time a page is served, 0 for no limit.
+ * Returns:	EXIT_CODE of the operation.
+ * Side effects: Drops the cache in use.
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+int UUT_SetReadCache(UUT_HANDLE handle, UINT32 size, UINT32 maxAgeMs)
+{
+	return RCACHE_Enable(handle, size, maxAgeMs);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	UUT_Invalidate
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ *		addr   - first address of the range.
+ *		size   - range size, 0 for all the memory.
+ * Returns:	none
+ * Side effects:
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+void UUT_Invalidate(UUT_HANDLE handle, UINT32 addr, UINT32 size)
+{
+	RCACHE_Invalidate(handle, addr, size);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	UUT_Idle
+ *
+ * Parameters:	handle - session handle from UUT_Open.
+ * Returns:	EC_OK when a blocking call may go on, otherwise its EXIT_CODE.
+ * Side effects: Flushes the write cache.
+ * Description:
+ *	Refuse the blocking calls while asynchronous operations are queued,
+ *	and send the cached writes ahead of the call.
+ *---------------------------------------------------------------------------
+ */
+static int UUT_Idle(UUT_HANDLE handle)
+{
+	if (ASYNC_Pending(handle) != 0)
+		return EC_UNSUPPORTED_CMD_ERR;
+
+	return WCACHE_Flush(handle);
+}
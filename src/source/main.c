@@ -21,6 +21,13 @@
 #include "program.h"
 #include "ComPort.h"
 #include "opr.h"
+#include "session.h"
+#include "script.h"
+#ifndef WIN32
+#include "daemon.h"
+#include "multi.h"
+#include "farm.h"
+#endif
 
 /*---------------------------------------------------------------------------
  * External variables
@@ -28,11 +35,8 @@
  */
 extern UINT32                   BaudRate;
 extern char                     PortName[MAX_PARAM_SIZE];
-extern struct COMPORT_FIELDS    PortCfg;
 extern BOOLEAN                  Verbose;
-extern BOOLEAN                  Console;
 extern UINT32                   DevPortNum;
-extern UINT32                   crc_type;
 
 /*----------------------------------------------------------------------------
  * Constant definitions
@@ -41,9 +45,6 @@ extern UINT32                   crc_type;
 #define MAX_FILE_NAME_SIZE	512
 #define MAX_MSG_SIZE		128
 
-#define GET_BASE(str)		(((str[0] == 'x') || (str[1] == 'x')) ? \
-								BASE_HEXADECIMAL : BASE_DECIMAL)
-
 /*---------------------------------------------------------------------------
  * Global variables
  *---------------------------------------------------------------------------
@@ -54,12 +55,23 @@ char	SizeStr[MAX_PARAM_SIZE];
 char	OprName[MAX_PARAM_SIZE];
 char	RateStr[MAX_PARAM_SIZE];
 char	DevPortNumStr[MAX_PARAM_SIZE];
+char	ScriptName[MAX_FILE_NAME_SIZE];
+char	DaemonSock[MAX_FILE_NAME_SIZE];
+char	ClientSock[MAX_FILE_NAME_SIZE];
+#ifndef WIN32
+char	PortsList[MULTI_MAX_BOARDS * MAX_PARAM_SIZE];
+char	FarmScript[MAX_FILE_NAME_SIZE];
+char	MetricsFile[MAX_FILE_NAME_SIZE];
+char	EngineName[MAX_PARAM_SIZE];
+#endif
 
 
 /*---------------------------------------------------------------------------
  * Local variables
  *---------------------------------------------------------------------------
  */
+static struct UUT_SESSION Session;
+
 #ifdef WIN32
 static const char TOOL_NAME[]	  = { "WINDOWS UART Update Tool" };
 #if defined(_WIN32)
@@ -84,6 +96,10 @@ static UINT32	PARAM_GetStrSize(char *string);
 static void	    MAIN_PrintVersion(void);
 static void	    ToolUsage(void);
 static void     ExitUartApp(UINT32 exitStatus);
+#ifndef WIN32
+static UINT32	PARAM_SubmitJobs(const char *sockPath);
+static enum MULTI_ENGINE PARAM_GetEngine(const char *name);
+#endif
 static int	    str_cmp_no_case(const char *s1, const char *s2);
 
 /*---------------------------------------------------------------------------
@@ -146,28 +162,54 @@ int main(int   argc, char *argv[])
 	strncpy(PortName, DEFAULT_PORT_NAME, sizeof(PortName));
 	BaudRate     = DEFAULT_BAUD_RATE;
 	OprName[0]  = '\0';
+	ScriptName[0] = '\0';
+	DaemonSock[0] = '\0';
+	ClientSock[0] = '\0';
+#ifndef WIN32
+	PortsList[0]  = '\0';
+	FarmScript[0] = '\0';
+	MetricsFile[0] = '\0';
+	EngineName[0] = '\0';
+#endif
+	RateStr[0]    = '\0';
 	Verbose  = TRUE;
-	Console  = FALSE;
-	crc_type = 16;
+	SESSION_Init(&Session, BaudRate);
 
 	PARAM_ParseCmdLine(argc, argv);
 
+#ifndef WIN32
+	/* Jobs are run by the daemon holding the port */
+	if (ClientSock[0] != '\0')
+		exit(PARAM_SubmitJobs(ClientSock));
+#endif
+
 	PARAM_CheckPortNum(PortName);
 
 	/*
 	* Configure COM Port parameters
 	*/
-	PortCfg.BaudRate	= MAX(BaudRate, BR_LOW_LIMIT);
-	PortCfg.ByteSize	= 8;
-	PortCfg.FlowControl	= 0;
-	PortCfg.Parity		= 0;
-	PortCfg.StopBits	= 0;
+	Session.portCfg.BaudRate = MAX(BaudRate, BR_LOW_LIMIT);
+	Session.verbose		 = Verbose;
+
+#ifndef WIN32
+	/* Program the boards as they are plugged in, until stopped */
+	if (FarmScript[0] != '\0')
+		exit(FARM_Run(&Session, (PortsList[0] != '\0') ? PortsList : NULL,
+			      FarmScript,
+			      (MetricsFile[0] != '\0') ? MetricsFile : NULL));
+
+	/* Same image to several boards, each with its own session */
+	if (PortsList[0] != '\0')
+		exit(MULTI_Run(&Session, PortsList, OprName, FileName,
+			       strtoul(AddrStr, &stopStr, GET_BASE(AddrStr)),
+			       PARAM_GetEngine(EngineName)));
+#endif
 
 	/*
 	* A scan is required, check each port, and then save the port num to the invironment
 	*/
 	if (strcmp(OprName, OPR_SCAN) == 0) {
-		if (OPR_ScanPort(PortCfg, PortName)) {
+		if (OPR_ScanPort(&Session, PortName)) {
 			displayColorMsg(SUCCESS,
 				"\nScan ports pass, detected %s\n", PortName);
 			ExitUartApp(EC_OK);
@@ -181,23 +223,32 @@ int main(int   argc, char *argv[])
 	/*
 	 * Open a ComPort device. If user haven't specified such, use ComPort 1
 	 */
-	if (OPR_OpenPort(PortName, PortCfg) != TRUE)
+	if (OPR_OpenPort(&Session, PortName) != TRUE)
 		exit(EC_PORT_ERR);
 
 	if (BaudRate == 0) { /* Scan baud rate range */
-		OPR_ScanBaudRate();
-		exit(EC_OK);
+		ExitUartApp(OPR_ScanBaudRate(&Session) ? EC_OK : EC_BAUDRATE_ERR);
 	}
 
 	/* Verify Host and Device are synchronized */
 	DISPLAY_MSG(("Performing a Host/Device synchronization check...\n"));
-	sr = OPR_CheckSync(BaudRate);
+	sr = OPR_CheckSync(&Session, BaudRate);
 	if (sr != SR_OK) {
 		displayColorMsg(FAIL,
 		     "Host/Device synchronization failed, error = %lu.\n", sr);
 		ExitUartApp(EC_SYNC_ERR);
 	}
 
+	/* Run all the script operations over this session */
+	if (ScriptName[0] != '\0')
+		ExitUartApp(SCRIPT_RunFile(&Session, ScriptName));
+
+#ifndef WIN32
+	/* Keep the session and serve jobs until asked to quit */
+	if (DaemonSock[0] != '\0')
+		ExitUartApp(DAEMON_Run(&Session, DaemonSock));
+#endif
+
 	PARAM_CheckOprNum(OprName);
 
 	/* Write buffer data to chosen address */
@@ -212,7 +263,7 @@ int main(int   argc, char *argv[])
 		memcpy(auxBuf, FileName, sizeof(FileName));
 
 		/* Retrieve input size */
-		if (Console)
+		if (Session.console)
 			size = PARAM_GetStrSize(auxBuf);
 		else
 			size = PARAM_GetFileSize(FileName);
@@ -221,31 +272,31 @@ int main(int   argc, char *argv[])
 		if (size == 0)
 			ExitUartApp(EC_FILE_ERR);
 
-		OPR_WriteMem(FileName, addr, size);
+		OPR_WriteMem(&Session, FileName, addr, size);
 	} else if (strcmp(OprName, OPR_READ_MEM) == 0) {
 		/* Read data to chosen address */
 
 		addr = strtoul(AddrStr, &stopStr, GET_BASE(AddrStr));
 		size = strtoul(SizeStr, &stopStr, GET_BASE(SizeStr));
 
-		OPR_ReadMem(FileName, addr, size);
+		OPR_ReadMem(&Session, FileName, addr, size);
 	} else if (strcmp(OprName, OPR_EXECUTE_EXIT) == 0) {
 		/* Execute From Address a non-return code */
 
 		addr = strtoul(AddrStr, &stopStr, GET_BASE(AddrStr));
 
-		OPR_ExecuteExit(addr);
+		OPR_ExecuteExit(&Session, addr);
 		ExitUartApp(EC_OK);
 	} else if (strcmp(OprName, OPR_EXECUTE_CONT) == 0) {
 		/* Execute From Address a returnable code */
 
 		addr = strtoul(AddrStr, &stopStr, GET_BASE(AddrStr));
 
-		OPR_ExecuteReturn(addr);
+		OPR_ExecuteReturn(&Session, addr);
 	} else if (strcmp(OprName, OPR_SET_HRATE) == 0) {
 		/* Execute From Address a non-return code */
 
-		OPR_SetDevicePortHighRate();
+		OPR_SetDevicePortHighRate(&Session);
 		ExitUartApp(EC_OK);
 	} else
 		ExitUartApp(EC_UNSUPPORTED_CMD_ERR);
@@ -311,7 +362,7 @@ static void PARAM_ParseCmdLine(int   argc, char *argv[])
 		 *-----------------------------------------------------------
 		 */
 		else if (str_cmp_no_case(*(argv+i), "-console") == 0) {
-			Console = TRUE;
+			Session.console = TRUE;
 			continue;
 		}
 		/*-----------------------------------------------------------
@@ -321,6 +372,7 @@ static void PARAM_ParseCmdLine(int   argc, char *argv[])
 		else if (str_cmp_no_case(*(argv+i), "-baudrate") == 0) {
 			if (sscanf(*(argv+1+i), "%du", &BaudRate) == 0)
 				exit(EC_BAUDRATE_ERR);
+			sscanf(*(argv+1+i), "%127s", RateStr);
 		}
 		/*-----------------------------------------------------------
 		 * Operation Number
@@ -343,9 +395,30 @@ static void PARAM_ParseCmdLine(int   argc, char *argv[])
 		*-----------------------------------------------------------
 		*/
 		else if (str_cmp_no_case(*(argv + i), "-crc") == 0) {
-			if (sscanf(*(argv + 1 + i), "%du", &crc_type) == 0)
+			if (sscanf(*(argv + 1 + i), "%du", &Session.crcType) == 0)
 				exit(EC_CRC_ERR);
 		}
+		/*-----------------------------------------------------------
+		 * Response Timeout and Packet Resends
+		 *-----------------------------------------------------------
+		 */
+		else if (str_cmp_no_case(*(argv + i), "-timeout") == 0) {
+			if ((sscanf(*(argv + 1 + i), "%u", &Session.cmdTimeout) == 0) ||
+			    (Session.cmdTimeout == 0))
+				exit(EC_PORT_ERR);
+		}
+		else if (str_cmp_no_case(*(argv + i), "-retries") == 0) {
+			if (sscanf(*(argv + 1 + i), "%u", &Session.maxRetries) == 0)
+				exit(EC_PORT_ERR);
+		}
+		/*-----------------------------------------------------------
+		 * Modem Lines Reset Sequence
+		 *-----------------------------------------------------------
+		 */
+		else if (str_cmp_no_case(*(argv + i), "-reset") == 0) {
+			if (sscanf(*(argv + 1 + i), "%127s", Session.resetSeq) == 0)
+				exit(EC_PORT_ERR);
+		}
 		/*-----------------------------------------------------------
 		 * File Name
 		 *-----------------------------------------------------------
@@ -354,6 +427,56 @@ static void PARAM_ParseCmdLine(int   argc, char *argv[])
 			if (sscanf(*(argv+1+i), "%s", FileName) == 0)
 				exit(EC_FILE_ERR);
 		}
+		/*-----------------------------------------------------------
+		 * Script File Name
+		 *-----------------------------------------------------------
+		 */
+		else if (str_cmp_no_case(*(argv+i), "-script") == 0) {
+			if (sscanf(*(argv+1+i), "%s", ScriptName) == 0)
+				exit(EC_FILE_ERR);
+		}
+#ifndef WIN32
+		/*-----------------------------------------------------------
+		 * Daemon / Client Socket Path
+		 *-----------------------------------------------------------
+		 */
+		else if (str_cmp_no_case(*(argv+i), "-daemon") == 0) {
+			if (sscanf(*(argv+1+i), "%s", DaemonSock) == 0)
+				exit(EC_FILE_ERR);
+		}
+		else if (str_cmp_no_case(*(argv+i), "-client") == 0) {
+			if (sscanf(*(argv+1+i), "%s", ClientSock) == 0)
+				exit(EC_FILE_ERR);
+		}
+		/*-----------------------------------------------------------
+		 * Multi-Board Port List
+		 *-----------------------------------------------------------
+		 */
+		else if (str_cmp_no_case(*(argv+i), "-ports") == 0) {
+			if (sscanf(*(argv+1+i), "%s", PortsList) == 0)
+				exit(EC_PORT_ERR);
+		}
+		/*-----------------------------------------------------------
+		 * Board Farm Script / Metrics File
+		 *-----------------------------------------------------------
+		 */
+		else if (str_cmp_no_case(*(argv+i), "-farm") == 0) {
+			if (sscanf(*(argv+1+i), "%s", FarmScript) == 0)
+				exit(EC_FILE_ERR);
+		}
+		else if (str_cmp_no_case(*(argv+i), "-metrics") == 0) {
+			if (sscanf(*(argv+1+i), "%s", MetricsFile) == 0)
+				exit(EC_FILE_ERR);
+		}
+		/*-----------------------------------------------------------
+		 * Multi-Board Engine
+		 *-----------------------------------------------------------
+		 */
+		else if (str_cmp_no_case(*(argv+i), "-engine") == 0) {
+			if (sscanf(*(argv+1+i), "%127s", EngineName) == 0)
+				exit(EC_UNSUPPORTED_CMD_ERR);
+		}
+#endif
 		/*-----------------------------------------------------------
 		 * Start memory address
 		 *-----------------------------------------------------------
@@ -396,6 +519,68 @@ static void PARAM_ParseCmdLine(int   argc, char *argv[])
 	}
 }
 
+#ifndef WIN32
+/*---------------------------------------------------------------------------
+ * Function:	PARAM_SubmitJobs
+ *
+ * Parameters:	sockPath - Unix domain socket path of the daemon.
+ * Returns:	EC_OK if the jobs succeeded, otherwise the EXIT_CODE of the
+ *		first failing job.
+ * Side effects:
+ * Description:
+ *		Send the -script lines, or the -opr operation with its
+ *		switches, to a daemon instead of opening the port.
+ *---------------------------------------------------------------------------
+ */
+static UINT32 PARAM_SubmitJobs(const char *sockPath)
+{
+	char	job[MAX_SCRIPT_LINE_SIZE];
+	int	len;
+
+	if (ScriptName[0] != '\0')
+		return DAEMON_Client(sockPath, NULL, ScriptName);
+
+	if (OprName[0] == '\0') {
+		displayColorMsg(FAIL, "ERROR: -client requires -opr or -script\n");
+		return EC_OPR_MUM_ERR;
+	}
+
+	len = snprintf(job, sizeof(job), "%s", OprName);
+	if (FileName[0] != '\0')
+		len += snprintf(job + len, sizeof(job) - len, " -file %s", FileName);
+	if (AddrStr[0] != '\0')
+		len += snprintf(job + len, sizeof(job) - len, " -addr %s", AddrStr);
+	if (SizeStr[0] != '\0')
+		len += snprintf(job + len, sizeof(job) - len, " -size %s", SizeStr);
+	if (RateStr[0] != '\0')
+		len += snprintf(job + len, sizeof(job) - len, " -baudrate %s",
+				RateStr);
+
+	return DAEMON_Client(sockPath, job, NULL);
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	PARAM_GetEngine
+ *
+ * Parameters:	name - -engine switch value, "" for the default.
+ * Returns:	The multi-board engine.
+ * Side effects: Exits on an unknown engine.
+ *---------------------------------------------------------------------------
+ */
+static enum MULTI_ENGINE PARAM_GetEngine(const char *name)
+{
+	if ((name[0] == '\0') || (str_cmp_no_case(name, "thread") == 0))
+		return MULTI_ENGINE_THREAD;
+
+	if (str_cmp_no_case(name, "uring") == 0)
+		return MULTI_ENGINE_URING;
+
+	displayColorMsg(FAIL, "ERROR: unknown engine [%s], use thread or uring\n",
+			name);
+	exit(EC_UNSUPPORTED_CMD_ERR);
+}
+#endif
+
 /*---------------------------------------------------------------------------
  * Function:        PARAM_CheckPortNum
  *
@@ -408,6 +593,9 @@ static void PARAM_ParseCmdLine(int   argc, char *argv[])
  */
 static void PARAM_CheckPortNum(char *port_name)
 {
+	if (COMP_PORT_IS_REMOTE(port_name))
+		return;
+
 	if ((strncmp(port_name,
 		     COMP_PORT_PREFIX_1,
 		     strlen(COMP_PORT_PREFIX_1)) != 0) &&
@@ -559,9 +747,28 @@ static void ToolUsage(void)
 "       -port <name>     - Serial port name (default is %s)\n",
 DEFAULT_PORT_NAME);
 	printf(
-"       -baudrate <num>  - COM Port baud-rate (default is %d)\n",
+"                          tcp:<host>:<port>     - raw TCP console server\n");
+	printf(
+"                          rfc2217:<host>:<port> - RFC 2217 console server\n");
+	printf(
+"       -baudrate <num>  - COM Port baud-rate (default is %d,\n",
 DEFAULT_BAUD_RATE);
+	printf(
+"                          0 to detect the device baud-rate)\n");
 	printf("       -crc <num>       - CRC type [16, 32]. Default 16.\n");
+	printf(
+"       -timeout <ms>    - Wait for a response (default %ld, as a flash\n",
+DEFAULT_CMD_TIMEOUT);
+	printf(
+"                          erase may be that long)\n");
+	printf(
+"       -retries <num>   - Resends of a packet not answered in time\n");
+	printf(
+"                          (default %d)\n", DEFAULT_MAX_RETRIES);
+	printf(
+"       -reset <steps>   - Drive the DTR/RTS lines once the port is opened,\n");
+	printf(
+"                          e.g. dtr=1,rts-pulse:50ms,wait:100ms,dtr=0\n");
 	printf("\n");
 
 	printf("Operation specific switches:\n");
@@ -569,6 +776,34 @@ DEFAULT_BAUD_RATE);
 	printf("       -file  <name>    - Input/output file name\n");
 	printf("       -addr  <num>     - Start memory address\n");
 	printf("       -size  <num>     - Size of data to read\n");
+	printf(
+"       -script <name>   - Run the operations listed in a file, one per line,\n");
+	printf(
+"                          over a single port open and synchronization\n");
+#ifndef WIN32
+	printf(
+"       -daemon <path>   - Keep the port open and synchronized, and run the\n");
+	printf(
+"                          jobs (script lines) received on a Unix socket\n");
+	printf(
+"       -client <path>   - Send the -opr operation or the -script lines to\n");
+	printf(
+"                          a daemon instead of opening the port\n");
+	printf(
+"       -ports <list>    - Write (wr) or verify the -file image on several\n");
+	printf(
+"                          boards at once, e.g. ttyUSB0,ttyUSB1 or 'ttyUSB*'\n");
+	printf(
+"       -engine <name>   - -ports engine: thread (one thread per board, the\n");
+	printf(
+"                          default) or uring (all the boards on one thread)\n");
+	printf(
+"       -farm <name>     - Run a script on every board plugged in, on the\n");
+	printf(
+"                          -ports patterns (default 'ttyUSB*,ttyACM*')\n");
+	printf(
+"       -metrics <name>  - Keep the -farm metrics in a Prometheus text file\n");
+#endif
 	printf("\n");
 }
 
@@ -599,7 +834,7 @@ static void MAIN_PrintVersion(void)
  */
 static void ExitUartApp(UINT32 exitStatus)
 {
-	if (OPR_ClosePort() != TRUE)
+	if (OPR_ClosePort(&Session) != TRUE)
 		displayColorMsg(FAIL, "ERROR: Port close failed.\n");
 
 	exit(exitStatus);
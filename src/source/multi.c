@@ -0,0 +1,322 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   multi.c
+ *	This file implements the multi-board mode.
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <glob.h>
+#include <pthread.h>
+
+#include "uut_types.h"
+#include "ComPort.h"
+#include "program.h"
+#include "opr.h"
+#include "session.h"
+#include "pktstream.h"
+#include "imgcache.h"
+#include "multi.h"
+#include "uring.h"
+
+/*----------------------------------------------------------------------------
+ * Constant definitions
+ *---------------------------------------------------------------------------
+ */
+#define MULTI_DEV_PREFIX	"/dev/"
+
+/*---------------------------------------------------------------------------
+ * Functions prototypes
+ *---------------------------------------------------------------------------
+ */
+static UINT32	MULTI_ExpandPorts(const char *ports,
+				  char names[][MAX_PARAM_SIZE], UINT32 maxNames);
+static void	*MULTI_BoardThread(void *arg);
+
+/*---------------------------------------------------------------------------
+ * Functions implementation
+ *---------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------------
+ * Function:	MULTI_ExpandPorts
+ *
+ * Parameters:	ports    - comma separated port names or /dev patterns.
+ *		names    - the port names found.
+ *		maxNames - size of names.
+ * Returns:	Number of port names found.
+ * Side effects:
+ * Description:
+ *	Split the port list and expand the glob patterns under /dev. Remote
+ *	ports are kept as is.
+ *---------------------------------------------------------------------------
+ */
+static UINT32 MULTI_ExpandPorts(const char *ports,
+				char names[][MAX_PARAM_SIZE], UINT32 maxNames)
+{
+	char	list[MULTI_MAX_BOARDS * MAX_PARAM_SIZE];
+	char	pattern[sizeof(MULTI_DEV_PREFIX) + MAX_PARAM_SIZE];
+	char	*token;
+	char	*save;
+	glob_t	found;
+	UINT32	num = 0;
+	size_t	i;
+
+	strncpy(list, ports, sizeof(list) - 1);
+	list[sizeof(list) - 1] = '\0';
+
+	for (token = strtok_r(list, MULTI_PORT_SEPS, &save);
+	     (token != NULL) && (num < maxNames);
+	     token = strtok_r(NULL, MULTI_PORT_SEPS, &save)) {
+		/* Port names are relative to /dev, as for -port */
+		if (strncmp(token, MULTI_DEV_PREFIX,
+			    strlen(MULTI_DEV_PREFIX)) == 0)
+			token += strlen(MULTI_DEV_PREFIX);
+
+		if (COMP_PORT_IS_REMOTE(token) ||
+		    (strpbrk(token, MULTI_GLOB_CHARS) == NULL)) {
+			snprintf(names[num++], MAX_PARAM_SIZE, "%s", token);
+			continue;
+		}
+
+		snprintf(pattern, sizeof(pattern), "%s%s", MULTI_DEV_PREFIX,
+			 token);
+		if (glob(pattern, 0, NULL, &found) != 0) {
+			displayColorMsg(FAIL, "ERROR: no port matches %s\n",
+					pattern);
+			continue;
+		}
+
+		for (i = 0; (i < found.gl_pathc) && (num < maxNames); i++)
+			snprintf(names[num++], MAX_PARAM_SIZE, "%s",
+				 found.gl_pathv[i] + strlen(MULTI_DEV_PREFIX));
+
+		globfree(&found);
+	}
+
+	return num;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	MULTI_BoardThread
+ *
+ * Parameters:	arg - Pointer to the MULTI_BOARD to program.
+ * Returns:	NULL
+ * Side effects: Opens, synchronizes and closes the board port, drops the
+ *		 board reference to the packet stream.
+ * Description:
+ *	Run the job on one board, using only its own session.
+ *---------------------------------------------------------------------------
+ */
+static void *MULTI_BoardThread(void *arg)
+{
+	struct MULTI_BOARD	*board   = (struct MULTI_BOARD *)arg;
+	struct UUT_SESSION	*session = &board->session;
+	const struct MULTI_JOB	*job     = board->job;
+	unsigned long long	start    = getTimeUs();
+	UINT8			*readBuf;
+
+	if (OPR_OpenPort(session, session->portName) != TRUE) {
+		board->result = EC_PORT_ERR;
+	} else if (OPR_CheckSync(session, session->portCfg.BaudRate) != SR_OK) {
+		board->result = EC_SYNC_ERR;
+	} else if (board->stream != NULL) {
+		board->result = OPR_WriteStream(session, board->stream);
+	} else {
+		readBuf = (UINT8 *)malloc(job->size);
+		if (readBuf == NULL)
+			board->result = EC_SIZE_ERR;
+		else if ((board->result = OPR_ReadBuf(session, job->addr,
+						      readBuf, job->size)) ==
+			 EC_OK)
+			board->result = (memcmp(readBuf, job->image,
+						job->size) == 0) ?
+					EC_OK : EC_VERIFY_ERR;
+		free(readBuf);
+	}
+
+	OPR_ClosePort(session);
+
+	if (board->stream != NULL)
+		PKT_StreamPut(board->stream);
+
+	board->elapsedUs = getTimeUs() - start;
+
+	return NULL;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	MULTI_InitSession
+ *
+ * Parameters:	session  - board session to set up.
+ *		proto    - session whose settings are copied.
+ *		portName - board port name.
+ * Returns:	none
+ * Side effects:
+ * Description:
+ *	Set up a board session: quiet, with the timeout and retries of
+ *	proto. Each board waits on its own, so a silent board does not hold
+ *	the others.
+ *---------------------------------------------------------------------------
+ */
+void MULTI_InitSession(struct UUT_SESSION *session,
+		       const struct UUT_SESSION *proto, const char *portName)
+{
+	*session = *proto;
+	session->portHandle = INVALID_HANDLE_VALUE;
+	session->verbose    = FALSE;
+	session->retries    = 0;
+	session->txBytes    = 0;
+	session->rxBytes    = 0;
+	session->cancel     = FALSE;
+	snprintf(session->portName, sizeof(session->portName), "%s",
+		 portName);
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	MULTI_Run
+ *
+ * Parameters:	proto    - session whose settings are copied to each board.
+ *		ports    - comma separated port names or /dev patterns.
+ *		oprName  - OPR_WRITE_MEM or OPR_VERIFY_MEM.
+ *		fileName - image file.
+ *		addr     - start memory address.
+ *		engine   - engine driving the boards.
+ * Returns:	EC_OK when all the boards passed, otherwise the EXIT_CODE of
+ *		the first board which failed.
+ * Side effects: Opens, synchronizes and closes every port.
+ * Description:
+ *	Get the image from the image cache and run the operation on all the
+ *	boards at once. For a write the image packet stream, encoded once,
+ *	is sent as is to all the boards. The thread engine is used when the
+ *	io_uring one cannot run.
+ *---------------------------------------------------------------------------
+ */
+UINT32 MULTI_Run(const struct UUT_SESSION *proto, const char *ports,
+		 const char *oprName, const char *fileName, UINT32 addr,
+		 enum MULTI_ENGINE engine)
+{
+	char			names[MULTI_MAX_BOARDS][MAX_PARAM_SIZE];
+	struct MULTI_BOARD	*boards;
+	struct MULTI_BOARD	*board;
+	struct MULTI_JOB	job;
+	struct IMG_ENTRY	*image;
+	struct PKT_STREAM	*stream = NULL;
+	UINT32			numBoards;
+	UINT32			passed = 0;
+	UINT32			ret_val = EC_OK;
+	UINT32			i;
+
+	if ((strcmp(oprName, OPR_WRITE_MEM) != 0) &&
+	    (strcmp(oprName, OPR_VERIFY_MEM) != 0)) {
+		displayColorMsg(FAIL, "ERROR: -ports supports -opr %s and %s\n",
+				OPR_WRITE_MEM, OPR_VERIFY_MEM);
+		return EC_OPR_MUM_ERR;
+	}
+
+	numBoards = MULTI_ExpandPorts(ports, names, MULTI_MAX_BOARDS);
+	if (numBoards == 0) {
+		displayColorMsg(FAIL, "ERROR: no port in [%s]\n", ports);
+		return EC_PORT_ERR;
+	}
+
+	image = IMG_CacheGet(fileName);
+	if (image == NULL)
+		return EC_FILE_ERR;
+
+	job.opr   = oprName;
+	job.addr  = addr;
+	job.image = image->data;
+	job.size  = image->size;
+
+	/* The boards would have nothing to write or read back */
+	if (job.size == 0) {
+		displayColorMsg(FAIL, "ERROR: [%s] is empty\n", fileName);
+		IMG_CachePut(image);
+		return EC_SIZE_ERR;
+	}
+
+	if (strcmp(oprName, OPR_WRITE_MEM) == 0) {
+		stream = IMG_CacheStream(image, proto, addr);
+		if (stream == NULL) {
+			IMG_CachePut(image);
+			return EC_SIZE_ERR;
+		}
+	}
+
+	boards = (struct MULTI_BOARD *)calloc(numBoards, sizeof(*boards));
+	if (boards == NULL) {
+		if (stream != NULL)
+			PKT_StreamPut(stream);
+		IMG_CachePut(image);
+		return EC_SIZE_ERR;
+	}
+
+	SESSION_MSG(proto, ("%s [%u] bytes at 0x%08X on %u boards\n",
+		    oprName, job.size, addr, numBoards));
+
+	/* Each board gets its own session */
+	for (i = 0; i < numBoards; i++) {
+		board = &boards[i];
+		MULTI_InitSession(&board->session, proto, names[i]);
+		board->job    = &job;
+		board->stream = (stream != NULL) ? PKT_StreamGet(stream) : NULL;
+	}
+
+	if (stream != NULL)
+		PKT_StreamPut(stream);
+
+	/* Otherwise each board gets its own thread too */
+	if ((engine != MULTI_ENGINE_URING) || !URING_Run(boards, numBoards)) {
+		for (i = 0; i < numBoards; i++) {
+			board = &boards[i];
+			board->started = (pthread_create(&board->thread, NULL,
+							 MULTI_BoardThread,
+							 board) == 0);
+			if (!board->started)
+				MULTI_BoardThread(board);
+		}
+
+		for (i = 0; i < numBoards; i++) {
+			if (boards[i].started)
+				pthread_join(boards[i].thread, NULL);
+		}
+	}
+
+	printf("\nBoard Port                     Result  Time [ms]     KB/s  Retries\n");
+	for (i = 0; i < numBoards; i++) {
+		board = &boards[i];
+
+		displayColorMsg(board->result == EC_OK,
+			"%5u %-24s %-6s %10llu %8.1f %8u\n",
+			i + 1, board->session.portName,
+			(board->result == EC_OK) ? "PASS" : "FAIL",
+			board->elapsedUs / 1000,
+			(board->elapsedUs != 0) ?
+				(job.size * 1000000.0) /
+				(board->elapsedUs * 1024.0) : 0.0,
+			board->session.retries);
+
+		if (board->result == EC_OK)
+			passed++;
+		else if (ret_val == EC_OK)
+			ret_val = board->result;
+	}
+
+	displayColorMsg(passed == numBoards, "%u of %u boards passed\n",
+			passed, numBoards);
+
+	free(boards);
+	IMG_CachePut(image);
+
+	return ret_val;
+}
@@ -18,6 +18,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <pthread.h>
 #endif
 #include <time.h>
 
@@ -26,15 +27,12 @@
 #include "program.h"
 #include "opr.h"
 #include "cmd.h"
-#ifdef WIN32
-#include "lib_uut.h"
+#include "session.h"
+#include "pktstream.h"
+#ifndef WIN32
+#include "imgcache.h"
 #endif
-
-/*---------------------------------------------------------------------------
- * External variables
- *---------------------------------------------------------------------------
- */
-extern BOOLEAN	Console;
+#include "lib_uut.h"
 
 /*----------------------------------------------------------------------------
  * Constant definitions
@@ -42,13 +40,18 @@ extern BOOLEAN	Console;
  */
 /* Maximum Read/Write data size per packet */
 #define MAX_RW_DATA_SIZE    256
-#define MAX_PORT_NAME_SIZE  32
+#define MAX_PORT_NAME_SIZE  MAX_PARAM_SIZE
 #define OPR_TIMEOUT         10L     /* 10  seconds */
-#define FLASH_ERASE_TIMEOUT 400L    /*  seconds */
 #define STS_MSG_MIN_SIZE    8
 #define STS_MSG_APP_END     0x09
 #define DUMMY_SIZE          2
-#define MAX_SYNC_TRIALS     3
+#define SCAN_SYNC_TRIALS    2
+#define SCAN_SYNC_TIMEOUT   150L    /* ms, per SYNC trial while scanning */
+#define SCAN_LIST_FILE      "SerialPortList.txt"
+#define SCAN_PORT_FILE      "SerialPortNumber.txt"
+#define SCAN_CACHE_FILE     "SerialPortCache.txt"
+#define RESET_STEP_SEPS     ","
+#define RESET_MAX_TIME      10000L  /* ms, longest reset pulse or wait */
 
 /*----------------------------------------------------------------------------
  * Internal types
@@ -60,19 +63,94 @@ struct STATUS_MSG {
 	UINT8	data[DUMMY_SIZE];
 };
 
-/*----------------------------------------------------------------------------
- * Global variables
+#ifndef WIN32
+/* A port probed for a SYNC answer by its own scan thread */
+struct SCAN_PROBE {
+	struct COMPORT_INFO	info;
+	struct COMPORT_FIELDS	cfg;
+	BOOLEAN			verbose;
+	enum SYNC_RESULT	sr;
+	UINT8			resp;
+	UINT32			rttUs;
+	pthread_t		thread;
+	BOOLEAN			started;
+};
+#endif
+
+/* A range of a vectored transfer, in address order */
+struct VEC_SEG {
+	UINT32	addr;
+	UINT32	len;
+	UINT32	idx;		/* Of the caller's UUT_IOVEC */
+};
+
+/* A packet of a vectored transfer, covering segments first to last */
+struct VEC_PKT {
+	UINT32	addr;
+	UINT32	len;
+	UINT32	first;
+	UINT32	last;
+};
+
+/* Reset sequence step, see OPR_ResetDevice */
+struct RESET_STEP {
+	const char	*name;
+	UINT32		lines;		/* COMPORT_LINE_*, 0 for a wait */
+	BOOLEAN		pulse;		/* Assert, wait, release */
+};
+
+/*---------------------------------------------------------------------------
+ * Local variables
  *---------------------------------------------------------------------------
  */
-struct ComandNode   CmdBuf[MAX_CMD_BUF_SIZE];
-UINT8               RespBuf[MAX_RESP_BUF_SIZE];
-HANDLE              PortHandle = INVALID_HANDLE_VALUE;
+static const struct RESET_STEP ResetSteps[] = {
+	{ "dtr",	COMPORT_LINE_DTR,	FALSE },
+	{ "rts",	COMPORT_LINE_RTS,	FALSE },
+	{ "dtr-pulse",	COMPORT_LINE_DTR,	TRUE },
+	{ "rts-pulse",	COMPORT_LINE_RTS,	TRUE },
+	{ "wait",	0,			FALSE }
+};
 
 /*---------------------------------------------------------------------------
  * Functions prototypes
  *---------------------------------------------------------------------------
  */
-static BOOLEAN OPR_SendCmds(struct ComandNode *cmdBuf, UINT32 cmdNum);
+static BOOLEAN OPR_SendCmds(struct UUT_SESSION *session,
+			    struct ComandNode *cmdBuf, UINT32 cmdNum);
+static BOOLEAN OPR_SendPacket(struct UUT_SESSION *session, const UINT8 *cmd,
+			      UINT32 cmdSize, UINT32 respSize);
+static BOOLEAN OPR_SendWrite(struct UUT_SESSION *session, const UINT8 *cmd,
+			     UINT32 cmdSize);
+static BOOLEAN OPR_WaitResp(struct UUT_SESSION *session, UINT32 respSize);
+static BOOLEAN OPR_ReadResp(struct UUT_SESSION *session, UINT32 respSize);
+static BOOLEAN OPR_ReadRespData(struct UUT_SESSION *session, UINT8 *data,
+				UINT32 dataSize);
+static int OPR_VecSegCmp(const void *a, const void *b);
+static UINT32 OPR_VecPlan(const struct UUT_IOVEC *vec, UINT32 count,
+			  BOOLEAN write, struct VEC_SEG **segs,
+			  struct VEC_PKT **pkts, UINT32 *numPkts);
+static void OPR_VecCopy(const struct UUT_IOVEC *vec,
+			const struct VEC_SEG *segs, const struct VEC_PKT *pkt,
+			UINT8 *data, BOOLEAN write);
+static UINT32 OPR_VecTransfer(struct UUT_SESSION *session,
+			      const struct UUT_IOVEC *vec, UINT32 count,
+			      BOOLEAN write);
+static void OPR_SleepMs(UINT32 ms);
+static BOOLEAN OPR_ResetStep(struct UUT_SESSION *session, const char *step,
+			     UINT32 stepLen);
+static void OPR_DrainInput(HANDLE handle, UINT32 quietMs);
+static enum SYNC_RESULT OPR_SyncHandle(HANDLE handle, UINT8 *resp,
+				       UINT32 timeoutMs, UINT32 *rttUs);
+static void OPR_SavePort(const char *name, const struct COMPORT_INFO *info);
+static BOOLEAN OPR_CachedPort(char *name);
+static BOOLEAN OPR_ProbePort(struct UUT_SESSION *session, const char *name,
+			     char *port);
+#ifndef WIN32
+static void *OPR_ScanThread(void *arg);
+static BOOLEAN OPR_FindFingerprint(const char *line, char *name);
+static BOOLEAN OPR_WriteImage(struct UUT_SESSION *session, const char *input,
+			      UINT32 addr);
+#endif
 
 /*----------------------------------------------------------------------------
  * Functions implementation
@@ -97,85 +175,200 @@ void OPR_Usage(void)
 	printf("       %s\t\t- Execute a non-return code\n", OPR_EXECUTE_EXIT);
 	printf("       %s\t\t- Execute a returnable code\n", OPR_EXECUTE_CONT);
 	printf("       %s\t\t- Scan all ports. Output is saved to  SerialPortNumber.txt\n", OPR_SCAN);
+	printf("       \t\t  (all answering ports are listed in %s)\n", SCAN_LIST_FILE);
 	printf("       %s\t\t- Set device port to hight baudrate.\n", OPR_SET_HRATE);
+	printf("       %s\t\t- Compare Memory/Flash with a file (-script only)\n", OPR_VERIFY_MEM);
 }
 
 /*----------------------------------------------------------------------------
  * Function:	OPR_ClosePort
  *
- * Parameters:	none
+ * Parameters:	session - the session whose port is closed.
  * Returns:
  * Side effects:
  * Description:
  *		This routine closes the opened COM port by the application
  *---------------------------------------------------------------------------
  */
-BOOLEAN OPR_ClosePort(void)
+BOOLEAN OPR_ClosePort(struct UUT_SESSION *session)
 {
-	return ComPortClose(PortHandle);
+	BOOLEAN ret_val = ComPortClose(session->portHandle);
+
+	session->portHandle = INVALID_HANDLE_VALUE;
+
+	return ret_val;
 }
 
 
 /*----------------------------------------------------------------------------
  * Function:        OPR_OpenPort
  *
- * Parameters:	port_name - COM Port name.
- *		portCfg - COM Port configuration structure.
+ * Parameters:	session   - session, holding the port configuration.
+ *		port_name - COM Port name.
  * Returns:	1 if successful, 0 in the case of an error.
  * Side effects:
  * Description:
  *		Open a specified ComPort device.
  *---------------------------------------------------------------------------
  */
-BOOLEAN OPR_OpenPort(const char  *port_name, struct COMPORT_FIELDS portCfg)
+BOOLEAN OPR_OpenPort(struct UUT_SESSION *session, const char  *port_name)
 {
 	char full_port_name[MAX_PORT_NAME_SIZE];
 
 #ifdef WIN32
 	strcpy(full_port_name, "\\\\.\\");
 #else
-	strcpy(full_port_name, "/dev/");
+	/* Remote ports are passed to the ComPort layer as is */
+	if (COMP_PORT_IS_REMOTE(port_name))
+		full_port_name[0] = '\0';
+	else
+		strcpy(full_port_name, "/dev/");
 #endif
 
 	strcat(full_port_name, port_name);
 
-	if ((INT32)PortHandle > 0)
-		ComPortClose(PortHandle);
+	if ((INT32)session->portHandle > 0)
+		ComPortClose(session->portHandle);
 
-	PortHandle = ComPortOpen((const char *) full_port_name, portCfg);
+	session->portHandle = ComPortOpen((const char *) full_port_name,
+					  session->portCfg, session->verbose);
 
-	if ((INT32)PortHandle <= 0) {
+	if ((INT32)session->portHandle <= 0) {
 		displayColorMsg(FAIL, "\nERROR: COM Port failed to open.\n");
-		DISPLAY_MSG(
+		SESSION_MSG(session,
 	   ("Please select the right serial port or check if other serial\n"));
-		DISPLAY_MSG(("communication applications are opened.\n"));
+		SESSION_MSG(session, ("communication applications are opened.\n"));
 		return FALSE;
 	}
 
 	displayColorMsg(SUCCESS, "Port %s Opened\n", full_port_name);
 
+	strncpy(session->portName, port_name, sizeof(session->portName) - 1);
+
+	/* Reboot the device into its UART mode, before it is synchronized */
+	if ((session->resetSeq[0] != '\0') && !OPR_ResetDevice(session)) {
+		OPR_ClosePort(session);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_ResetDevice
+ *
+ * Parameters:	session - session, with its port opened.
+ * Returns:	TRUE if successful, FALSE on a bad step or a line error.
+ * Side effects: Drives the port modem lines.
+ * Description:
+ *	Run session->resetSeq, a comma separated list of steps:
+ *		dtr=<0|1>, rts=<0|1>	- release or assert the line
+ *		dtr-pulse:<n>ms		- assert the line for n ms
+ *		rts-pulse:<n>ms
+ *		wait:<n>ms		- let the device boot
+ *	e.g. "dtr=1,rts-pulse:50ms,wait:100ms,dtr=0" holds the boot strap
+ *	(DTR) while the reset line (RTS) is pulsed. Input received meanwhile,
+ *	e.g. a boot banner, is discarded.
+ *---------------------------------------------------------------------------
+ */
+BOOLEAN OPR_ResetDevice(struct UUT_SESSION *session)
+{
+	const char	*step = session->resetSeq;
+	UINT32		stepLen;
+
+	while (*step != '\0') {
+		stepLen = (UINT32)strcspn(step, RESET_STEP_SEPS);
+		if (!OPR_ResetStep(session, step, stepLen))
+			return FALSE;
+
+		step += stepLen;
+		if (*step != '\0')
+			step++;
+	}
+
+	OPR_DrainInput(session->portHandle, SYNC_DRAIN_QUIET);
+
 	return TRUE;
 }
 
+/*----------------------------------------------------------------------------
+ * Function:	OPR_ResetStep
+ *
+ * Parameters:	session - session, with its port opened.
+ *		step    - reset sequence step, e.g. "rts-pulse:50ms".
+ *		stepLen - step length.
+ * Returns:	TRUE if successful, FALSE on a bad step or a line error.
+ * Side effects: Drives the port modem lines.
+ *---------------------------------------------------------------------------
+ */
+static BOOLEAN OPR_ResetStep(struct UUT_SESSION *session, const char *step,
+			     UINT32 stepLen)
+{
+	const struct RESET_STEP	*found = NULL;
+	char			*end = NULL;
+	UINT32			nameLen;
+	UINT32			value = 0;
+	UINT32			i;
+
+	nameLen = (UINT32)strcspn(step, "=:" RESET_STEP_SEPS);
+
+	for (i = 0; i < sizeof(ResetSteps) / sizeof(ResetSteps[0]); i++) {
+		if ((strlen(ResetSteps[i].name) == nameLen) &&
+		    (strncmp(ResetSteps[i].name, step, nameLen) == 0))
+			found = &ResetSteps[i];
+	}
+
+	if (nameLen < stepLen) {
+		value = (UINT32)strtoul(step + nameLen + 1, &end, 10);
+		if (end == step + nameLen + 1)
+			end = NULL;
+		else if (strncmp(end, "ms", 2) == 0)
+			end += 2;
+	}
+
+	if ((found == NULL) || (end != step + stepLen) ||
+	    (value > RESET_MAX_TIME) ||
+	    ((found->lines != 0) && !found->pulse && (value > 1))) {
+		displayColorMsg(FAIL, "ERROR: bad reset step [%.*s]\n",
+				(int)stepLen, step);
+		return FALSE;
+	}
+
+	if (found->lines == 0) {
+		OPR_SleepMs(value);
+		return TRUE;
+	}
+
+	if (!found->pulse)
+		return ComPortSetModemLines(session->portHandle, found->lines,
+					    (BOOLEAN)value);
+
+	if (!ComPortSetModemLines(session->portHandle, found->lines, TRUE))
+		return FALSE;
+	OPR_SleepMs(value);
+
+	return ComPortSetModemLines(session->portHandle, found->lines, FALSE);
+}
+
 /*----------------------------------------------------------------------------
 * Function:        OPR_SetDevicePortHighRate
 *
-* Parameters:	None
+* Parameters:	session - session to use.
 * Returns:	1 if successful, 0 in the case of an error.
 * Side effects:
 * Description:
 *		Open a specified ComPort device.
 *---------------------------------------------------------------------------
 */
-BOOLEAN OPR_SetDevicePortHighRate(void)
+BOOLEAN OPR_SetDevicePortHighRate(struct UUT_SESSION *session)
 {
 	UINT32 cmdNum;
 
-	DISPLAY_MSG(("Set device port to high baudrate \n"));
+	SESSION_MSG(session, ("Set device port to high baudrate \n"));
 
-	CMD_BuildSetDevPortToHigh(CmdBuf, &cmdNum);
+	CMD_BuildSetDevPortToHigh(session, &cmdNum);
 
-	if (OPR_SendCmds(CmdBuf, cmdNum) != TRUE)
+	if (OPR_SendCmds(session, session->cmdBuf, cmdNum) != TRUE)
 	{
 		return EC_SEND_CMD_ERR;
 	}
@@ -186,117 +379,435 @@ BOOLEAN OPR_SetDevicePortHighRate(void)
 /*----------------------------------------------------------------------------
 * Function:        OPR_ScanPort
 *
-* Parameters:	portCfg - COM Port configuration structure.
+* Parameters:	session - session, holding the port configuration. The
+*			  found port is left open in it.
+*		port    - the found port full name.
 * Returns:	1 if successful, 0 in the case of an error.
 * Side effects:
 * Description:
-*		Open a specified ComPort device.
+*		Look for the serial port a device is connected to.
+*		On Linux only the ports listed by ComPortEnumerate() are tried.
 *---------------------------------------------------------------------------
 */
-BOOLEAN OPR_ScanPort(struct COMPORT_FIELDS portCfg, char * port)
+BOOLEAN OPR_ScanPort(struct UUT_SESSION *session, char * port)
 {
 	char full_port_name[MAX_PORT_NAME_SIZE] = { 0 };
-	char env[6 + MAX_PORT_NAME_SIZE] = { 0 };  // PORT=...
+	const struct COMPORT_INFO *selected = NULL;
+	BOOLEAN ret_val = FALSE;
+#ifdef WIN32
+	enum SYNC_RESULT sr;
 	char num[4];
 	int i;
-	enum SYNC_RESULT sr;
-	BOOLEAN ret_val = FALSE;
-	FILE *file_pointer;
+#else
+	struct SCAN_PROBE *ports;
+	struct COMPORT_INFO *found;
+	FILE *list_pointer;
+	UINT32 numPorts;
+	UINT32 i;
+#endif
 
-	DISPLAY_MSG(("\nscan ports...\n"));
+	SESSION_MSG(session, ("\nscan ports...\n"));
 
+#ifdef WIN32
 	for (i = 0; i < 256; i++) {
 		sprintf(num, "%d", i);
-#ifdef WIN32
 		strcpy(full_port_name, "\\\\.\\COM");
-#else
-		strcpy(full_port_name, "/dev/tty");
-#endif
 		strcat(full_port_name, num);
 
-		if (PortHandle != INVALID_HANDLE_VALUE)
-			ComPortClose(PortHandle);
+		if (session->portHandle != INVALID_HANDLE_VALUE)
+			ComPortClose(session->portHandle);
 
-		DISPLAY_MSG(("\rTry to open port  %s", full_port_name));
+		SESSION_MSG(session, ("\rTry to open port  %s", full_port_name));
 
-		PortHandle = ComPortOpen((const char *)full_port_name, portCfg);
+		session->portHandle = ComPortOpen(
+				(const char *)full_port_name, session->portCfg,
+				session->verbose);
 
-		if ((INT32)PortHandle > 0) {
-			sr = OPR_CheckSync(portCfg.BaudRate);
+		if ((INT32)session->portHandle > 0) {
+			sr = OPR_CheckSync(session, session->portCfg.BaudRate);
 			if (sr == SR_OK) {
 				displayColorMsg(SUCCESS, "\nFound port  %s\n", full_port_name);
-				strncpy(port, full_port_name, sizeof(full_port_name));
-#ifdef WIN32
+				strncpy(port, full_port_name, MAX_PORT_NAME_SIZE);
 				strcpy(full_port_name, "COM");
 				strcat(full_port_name, num);
-#else
-				strcpy(full_port_name, "tty");
-				strcat(full_port_name, num);
-#endif
-
 
 				ret_val = TRUE;
 				break;
 			}
 		}
 	}
-	// for Linux only: can be both tty0 or ttyUSBS0.
-#ifndef WIN32
-	if ((INT32)PortHandle < 0) {
-		DISPLAY_MSG(("\n\nscan usb to serial ports...\n"));
+#else
+	ports = (struct SCAN_PROBE *)malloc(MAX_COMPORT_ENUM * sizeof(*ports));
+	found = (struct COMPORT_INFO *)malloc(MAX_COMPORT_ENUM *
+					      sizeof(*found));
+	if ((ports == NULL) || (found == NULL)) {
+		free(ports);
+		free(found);
+		return FALSE;
+	}
 
-        for (i = 0; i < 256; i++) {
-			strcpy(full_port_name, "/dev/ttyUSB");
+	numPorts = ComPortEnumerate(found, MAX_COMPORT_ENUM);
+	SESSION_MSG(session, ("Probing %u serial ports\n", numPorts));
+
+	/* Probe all candidates at once, each on its own handle */
+	for (i = 0; i < numPorts; i++) {
+		ports[i].info    = found[i];
+		ports[i].cfg     = session->portCfg;
+		ports[i].verbose = session->verbose;
+		ports[i].sr      = SR_ERROR;
+		ports[i].started = (pthread_create(&ports[i].thread, NULL,
+						   OPR_ScanThread,
+						   &ports[i]) == 0);
+		if (!ports[i].started)
+			OPR_ScanThread(&ports[i]);
+	}
 
-			sprintf(num, "%d", i);
-			strcat(full_port_name, num);
+	for (i = 0; i < numPorts; i++) {
+		if (ports[i].started)
+			pthread_join(ports[i].thread, NULL);
+	}
 
-            DISPLAY_MSG(("\rTry to open port  %s", full_port_name));
+	list_pointer = fopen(SCAN_LIST_FILE, "w+");
+
+	for (i = 0; i < numPorts; i++) {
+		struct COMPORT_INFO *info = &ports[i].info;
+
+		if (ports[i].sr != SR_OK)
+			continue;
+
+		displayColorMsg(SUCCESS, "Found port  /dev/%s (%s", info->Name,
+				info->Driver);
+		if (info->IsUsb)
+			displayColorMsg(SUCCESS, ", USB %04x:%04x serial %s",
+					info->VendorId, info->ProductId,
+					info->Serial[0] ? info->Serial : "-");
+		displayColorMsg(SUCCESS, ", sync %u us)\n", ports[i].rttUs);
+
+		if (list_pointer) {
+			fprintf(list_pointer, "%s driver=%s", info->Name,
+				info->Driver);
+			if (info->IsUsb)
+				fprintf(list_pointer,
+					" usb=%04x:%04x serial=%s",
+					info->VendorId, info->ProductId,
+					info->Serial[0] ? info->Serial : "-");
+			fprintf(list_pointer, " baudrate=%u sync_us=%u\n",
+				session->portCfg.BaudRate, ports[i].rttUs);
+		}
 
-			if (PortHandle != INVALID_HANDLE_VALUE)
-				ComPortClose(PortHandle);
+		/* The first answering port is the one used */
+		if (!ret_val) {
+			snprintf(full_port_name, sizeof(full_port_name),
+				 "/dev/%s", info->Name);
+			strncpy(port, full_port_name, MAX_PORT_NAME_SIZE);
+			strcpy(full_port_name, info->Name);
+			selected = info;
+			ret_val = TRUE;
+		}
+	}
 
-			PortHandle = ComPortOpen((const char *)full_port_name, portCfg);
+	if (list_pointer)
+		fclose(list_pointer);
 
-			if ((INT32)PortHandle > 0) {
-				displayColorMsg(SUCCESS, "\nFound port  %s\n", full_port_name);
-				strncpy(port, full_port_name, sizeof(full_port_name));
-				ComPortClose(PortHandle);
-				strcpy(full_port_name, "ttyUSB");
-				strcat(full_port_name, num);
-				ret_val = TRUE;
-				break;
-			}
-		}
+	/* Leave the selected port open, as the sequential scan did */
+	if (ret_val) {
+		if ((INT32)session->portHandle > 0)
+			ComPortClose(session->portHandle);
+		session->portHandle = ComPortOpen(port, session->portCfg,
+						  session->verbose);
 	}
 #endif
 
-	// save the port number to environment:
-	strcpy(env, "PORT=");
-	strcat(env, full_port_name);
-	putenv(env);
+	/* selected points into ports, so save it before freeing them */
+	if (ret_val)
+		OPR_SavePort(full_port_name, selected);
+
+#ifndef WIN32
+	free(ports);
+	free(found);
+#endif
+
+	return ret_val;
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_FindPort
+ *
+ * Parameters:	session - session, holding the port configuration. The
+ *			  found port is left open in it.
+ *		port    - the found port full name.
+ * Returns:	1 if successful, 0 in the case of an error.
+ * Side effects:
+ * Description:
+ *		Look for the serial port a device is connected to, trying
+ *		the last port found first. A full scan is done only when
+ *		that port is gone or no device answers on it.
+ *---------------------------------------------------------------------------
+ */
+BOOLEAN OPR_FindPort(struct UUT_SESSION *session, char *port)
+{
+	char name[MAX_PORT_NAME_SIZE];
+
+	if (OPR_CachedPort(name) && OPR_ProbePort(session, name, port))
+		return TRUE;
+
+	return OPR_ScanPort(session, port);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_SavePort
+ *
+ * Parameters:	name - found port name, e.g. ttyUSB0 or COM3.
+ *		info - the port description, NULL if unknown.
+ * Returns:	none.
+ * Side effects: Sets PORT in the environment, writes SCAN_PORT_FILE and
+ *		 SCAN_CACHE_FILE.
+ * Description:
+ *		Remember the port a device was found on, with the USB
+ *		fingerprint of its adapter when it has one.
+ *---------------------------------------------------------------------------
+ */
+static void OPR_SavePort(const char *name, const struct COMPORT_INFO *info)
+{
+	FILE *file_pointer;
+
+	// save the port number to environment, setenv() keeps its own copy:
+	setenv("PORT", name, 1);
 
 	//save the port to "SerialPortNumber.txt" for writing
-	file_pointer = fopen("SerialPortNumber.txt", "w+");
+	file_pointer = fopen(SCAN_PORT_FILE, "w+");
 
 	if (file_pointer) {
 		// Write to the file
-		fprintf(file_pointer, "%s", full_port_name);
+		fprintf(file_pointer, "%s", name);
 
 		// Close the file
 		fclose(file_pointer);
 	}
 
-	return ret_val;
+	file_pointer = fopen(SCAN_CACHE_FILE, "w+");
+	if (file_pointer == NULL)
+		return;
+
+	fprintf(file_pointer, "%s", name);
+	if ((info != NULL) && info->IsUsb)
+		fprintf(file_pointer, " usb=%04x:%04x serial=%s",
+			info->VendorId, info->ProductId,
+			info->Serial[0] ? info->Serial : "-");
+	fprintf(file_pointer, "\n");
+
+	fclose(file_pointer);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_CachedPort
+ *
+ * Parameters:	name - the cached port name.
+ * Returns:	TRUE if a port is worth trying.
+ * Side effects:
+ * Description:
+ *		Get the last port found from SCAN_CACHE_FILE, or from
+ *		SCAN_PORT_FILE when there is no cache. On Linux a cached USB
+ *		adapter is looked up by its fingerprint, so it is found under
+ *		its new name after it re-enumerated, and is not tried when
+ *		another adapter took its name.
+ *---------------------------------------------------------------------------
+ */
+static BOOLEAN OPR_CachedPort(char *name)
+{
+	char	line[2 * MAX_PORT_NAME_SIZE + MAX_COMPORT_SERIAL_SIZE];
+	FILE	*file_pointer;
+
+	file_pointer = fopen(SCAN_CACHE_FILE, "r");
+	if (file_pointer == NULL)
+		file_pointer = fopen(SCAN_PORT_FILE, "r");
+	if (file_pointer == NULL)
+		return FALSE;
+
+	if (fgets(line, sizeof(line), file_pointer) == NULL)
+		line[0] = '\0';
+	fclose(file_pointer);
+
+	if (sscanf(line, "%127s", name) != 1)
+		return FALSE;
+
+#ifdef WIN32
+	return TRUE;
+#else
+	return OPR_FindFingerprint(line, name);
+#endif
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_ProbePort
+ *
+ * Parameters:	session - session, holding the port configuration. The
+ *			  port is left open in it when a device answers.
+ *		name    - port name, e.g. ttyUSB0 or COM3.
+ *		port    - the port full name, set when a device answers.
+ * Returns:	TRUE if a device answers SYNC on the port.
+ * Side effects:
+ * Description:
+ *		Try a single port, as fast as a scan tries each port.
+ *---------------------------------------------------------------------------
+ */
+static BOOLEAN OPR_ProbePort(struct UUT_SESSION *session, const char *name,
+			     char *port)
+{
+	char			full_port_name[MAX_PORT_NAME_SIZE];
+	enum SYNC_RESULT	sr = SR_TIMEOUT;
+	HANDLE			handle;
+	UINT32			trial;
+	UINT32			rttUs = 0;
+	UINT8			resp;
+
+#ifdef WIN32
+	snprintf(full_port_name, sizeof(full_port_name), "\\\\.\\%s", name);
+#else
+	snprintf(full_port_name, sizeof(full_port_name), "/dev/%s", name);
+#endif
+
+	handle = ComPortOpen((const char *)full_port_name, session->portCfg,
+			     session->verbose);
+	if ((INT32)handle <= 0)
+		return FALSE;
+
+	for (trial = 0; trial < SCAN_SYNC_TRIALS; trial++) {
+		sr = OPR_SyncHandle(handle, &resp, SCAN_SYNC_TIMEOUT, &rttUs);
+		if (sr != SR_TIMEOUT)
+			break;
+	}
+
+	if (sr != SR_OK) {
+		ComPortClose(handle);
+		return FALSE;
+	}
+
+	if ((INT32)session->portHandle > 0)
+		ComPortClose(session->portHandle);
+	session->portHandle = handle;
+	session->syncRttUs  = rttUs;
+
+	strncpy(port, full_port_name, MAX_PORT_NAME_SIZE);
+
+	SESSION_MSG(session, ("Found cached port %s, sync %u us\n",
+			      full_port_name, rttUs));
+
+	return TRUE;
+}
+
+#ifndef WIN32
+/*----------------------------------------------------------------------------
+ * Function:	OPR_ScanThread
+ *
+ * Parameters:	arg - Pointer to the SCAN_PROBE of the port to probe.
+ * Returns:	NULL
+ * Side effects:
+ * Description:
+ *		Open one candidate port on a private handle and check whether
+ *		a device answers SYNC on it. Globals are not touched, so all
+ *		candidates may be probed concurrently.
+ *---------------------------------------------------------------------------
+ */
+static void *OPR_ScanThread(void *arg)
+{
+	struct SCAN_PROBE	*probe = (struct SCAN_PROBE *)arg;
+	char			name[MAX_PORT_NAME_SIZE];
+	HANDLE			handle;
+	UINT32			trial;
+
+	snprintf(name, sizeof(name), "/dev/%s", probe->info.Name);
+
+	handle = ComPortOpen(name, probe->cfg, probe->verbose);
+	if ((INT32)handle <= 0) {
+		probe->sr = SR_ERROR;
+		return NULL;
+	}
+
+	for (trial = 0; trial < SCAN_SYNC_TRIALS; trial++) {
+		probe->sr = OPR_SyncHandle(handle, &probe->resp,
+					   SCAN_SYNC_TIMEOUT, &probe->rttUs);
+		if (probe->sr != SR_TIMEOUT)
+			break;
+	}
+
+	ComPortClose(handle);
+
+	return NULL;
 }
 
+/*----------------------------------------------------------------------------
+ * Function:	OPR_FindFingerprint
+ *
+ * Parameters:	line - SCAN_CACHE_FILE line: the port name, followed by
+ *		       "usb=<vid>:<pid> serial=<serial>" for a USB adapter.
+ *		name - the cached port name, set to the adapter current name.
+ * Returns:	TRUE if the port is worth trying.
+ * Side effects:
+ * Description:
+ *		Look the cached USB adapter up by vendor, product and serial
+ *		number. An adapter without a serial number must still be on
+ *		the cached port.
+ *---------------------------------------------------------------------------
+ */
+static BOOLEAN OPR_FindFingerprint(const char *line, char *name)
+{
+	struct COMPORT_INFO		*found;
+	char				serial[MAX_COMPORT_SERIAL_SIZE];
+	const char			*usb;
+	unsigned int			vid;
+	unsigned int			pid;
+	UINT32				numPorts;
+	UINT32				i;
+
+	usb = strstr(line, " usb=");
+	if (usb == NULL)
+		return TRUE;
+
+	if (sscanf(usb, " usb=%x:%x serial=%63s", &vid, &pid, serial) != 3)
+		return TRUE;
+	if (strcmp(serial, "-") == 0)
+		serial[0] = '\0';
+
+	/* Without the port list, try the cached name as is */
+	found = (struct COMPORT_INFO *)malloc(MAX_COMPORT_ENUM *
+					      sizeof(*found));
+	if (found == NULL)
+		return TRUE;
+
+	numPorts = ComPortEnumerate(found, MAX_COMPORT_ENUM);
+
+	for (i = 0; i < numPorts; i++) {
+		if (!found[i].IsUsb || (found[i].VendorId != vid) ||
+		    (found[i].ProductId != pid) ||
+		    (strcmp(found[i].Serial, serial) != 0))
+			continue;
+
+		if (serial[0] != '\0') {
+			if (strcmp(found[i].Name, name) != 0)
+				OPR_SavePort(found[i].Name, &found[i]);
+			strcpy(name, found[i].Name);
+			break;
+		}
+
+		if (strcmp(found[i].Name, name) == 0)
+			break;
+	}
+
+	free(found);
+
+	return (i < numPorts);
+}
+#endif
+
 /*----------------------------------------------------------------------------
  * Function:	OPR_WriteMem
  *
- * Parameters:	input	- Input (file-name/console), containing data to write.
+ * Parameters:	session	- session to use.
+ *		input	- Input (file-name/console), containing data to write.
  *		addr	- Memory address to write to.
  *		size	- Data size to write.
- * Returns:	none.
+ * Returns:	TRUE if all the data was written.
  * Side effects:
  * Description:
  *	Write data to memory, starting from a given address.
@@ -307,7 +818,8 @@ BOOLEAN OPR_ScanPort(struct COMPORT_FIELDS portCfg, char * port)
  *	(console mode).
  *---------------------------------------------------------------------------
  */
-void OPR_WriteMem(char  *input, UINT32 addr, UINT32 size)
+BOOLEAN OPR_WriteMem(struct UUT_SESSION *session, char  *input, UINT32 addr,
+		     UINT32 size)
 {
 	FILE	      *inputFileID = NULL;
 	UINT32	      curAddr = addr;
@@ -316,34 +828,42 @@ void OPR_WriteMem(char  *input, UINT32 addr, UINT32 size)
 	UINT32	      cmdIdx	= 1;
 	char	      seps[]	= " ";
 	char	      *token	= NULL;
+	char	      *save	= NULL;
 	char	      *stopStr;
-	UINT32	      blockSize = (Console) ? sizeof(UINT32) : MAX_RW_DATA_SIZE;
+	UINT32	      blockSize = (session->console) ? sizeof(UINT32) : MAX_RW_DATA_SIZE;
+	BOOLEAN	      ret_val	= TRUE;
 	struct ComandNode wCmdBuf;
 
-	if (!Console) {
+#ifndef WIN32
+	/* Image files are sent from the shared image cache */
+	if (!session->console)
+		return OPR_WriteImage(session, input, addr);
+#endif
+
+	if (!session->console) {
 		inputFileID = fopen(input, "rb");
 
 		if (inputFileID == NULL) {
 			displayColorMsg(FAIL,
 				"ERROR: could not open input file [%s]\n",
 					input);
-			return;
+			return FALSE;
 		}
 	}
 
 	/* Initialize response size */
 	wCmdBuf.respSize = 1;
 
-	DISPLAY_MSG(("Writing to 0x%08X [%d] bytes in [%d] packets\n",
+	SESSION_MSG(session, ("Writing to 0x%08X [%d] bytes in [%d] packets\n",
 		     addr, size, ((size + (blockSize - 1)) / blockSize)));
 
 	/* Read first token from string */
-	if (Console)
-		token = strtok(input, seps);
+	if (session->console)
+		token = strtok_r(input, seps, &save);
 
 	/* Main write loop */
 	while (TRUE) {
-		if (Console) {
+		if (session->console) {
 			/* Check if last token in string is reached */
 			if (token == NULL)
 				break;
@@ -359,7 +879,7 @@ void OPR_WriteMem(char  *input, UINT32 addr, UINT32 size)
 			writeSize = sizeof(UINT32);
 
 			/* Prepare the next iteration */
-			token = strtok(NULL, seps);
+			token = strtok_r(NULL, seps, &save);
 		} else {
 			/* Check if end of file is reached */
 			if (feof(inputFileID))
@@ -381,77 +901,64 @@ void OPR_WriteMem(char  *input, UINT32 addr, UINT32 size)
 				break;
 		}
 
-		CMD_CreateWrite(curAddr, writeSize, dataBuf,
+		CMD_CreateWrite(session, curAddr, writeSize, dataBuf,
 				wCmdBuf.cmd, &wCmdBuf.cmdSize);
-		if (OPR_SendCmds(&wCmdBuf, 1) != TRUE)
+		if (OPR_SendWrite(session, wCmdBuf.cmd,
+				  wCmdBuf.cmdSize) != TRUE) {
+			ret_val = FALSE;
 			break;
+		}
 
-		CMD_DispWrite(RespBuf, writeSize, cmdIdx,
+		CMD_DispWrite(session, writeSize, cmdIdx,
 			      ((size + (blockSize - 1)) / blockSize));
 
 		curAddr += blockSize;
 		cmdIdx++;
 	}
 
-	DISPLAY_MSG(("\n"));
+	SESSION_MSG(session, ("\n"));
 
-	if (!Console)
+	if (!session->console)
 		fclose(inputFileID);
+
+	return ret_val;
 }
 
 /*----------------------------------------------------------------------------
- * Function:	OPR_WriteMem_DLL
+ * Function:	OPR_WriteBuf
  *
- * Parameters:	buff	- data buffer to write.
+ * Parameters:	session - session to use.
  *		addr	- Memory address to write to.
+ *		buff	- data buffer to write.
  *		size	- Data size to write.
- * Returns:	none.
+ * Returns:	EC_OK if successful, otherwise the EXIT_CODE of the failure.
  * Side effects:
  * Description:
- *	Write data to memory, starting from a given address.
+ *	Write a data buffer to memory, starting from a given address.
  *	Memory may be Flash (SPI), DRAM (DDR) or SRAM.
- *	The data is retrieved either from an input file or from a console.
- *	Data size is not limited.
- *	Data is sent in 256 bytes chunks (file mode) or 4 ytes chunks
- *	(console mode).
+ *	Data is sent in 256 bytes chunks.
  *---------------------------------------------------------------------------
  */
-int OPR_WriteMem_DLL(UINT32 addr, const UINT8* buff, UINT32 size)
+UINT32 OPR_WriteBuf(struct UUT_SESSION *session, UINT32 addr,
+		    const UINT8 *buff, UINT32 size)
 {
-	UINT8	sendBuff[MAX_RW_DATA_SIZE];
 	struct  ComandNode wCmdBuf;
 	UINT32	curAddr = addr;
 	UINT32	writeSize;
 	UINT32	offset = 0;
-	UINT32  i;
-
-	/* Initialize response size */
-	wCmdBuf.respSize = 1;
 
-	/* Ensure non-zero size */
 	if (size == 0)
-	{
-		OPR_ClosePort();
 		return EC_SIZE_ERR;
-	}
 
-	while (size > 0)
-	{
-		/* copy buff into data buffer */
+	while (size > 0) {
 		writeSize = MIN(MAX_RW_DATA_SIZE, size);
 
-		for (i = 0; i < writeSize; i++)
-		{
-			sendBuff[i] = buff[offset + i];
-		}
-
-		CMD_CreateWrite(curAddr, writeSize, sendBuff,
-			wCmdBuf.cmd, &wCmdBuf.cmdSize);
+		CMD_CreateWrite(session, curAddr, writeSize, buff + offset,
+				wCmdBuf.cmd, &wCmdBuf.cmdSize);
 
-		if (OPR_SendCmds(&wCmdBuf, 1) != TRUE)
-		{
+		if (OPR_SendWrite(session, wCmdBuf.cmd,
+				  wCmdBuf.cmdSize) != TRUE)
 			return EC_SEND_CMD_ERR;
-		}
 
 		curAddr	+= writeSize;
 		offset	+= writeSize;
@@ -462,43 +969,123 @@ int OPR_WriteMem_DLL(UINT32 addr, const UINT8* buff, UINT32 size)
 }
 
 /*----------------------------------------------------------------------------
- * Function:	OPR_ReadMem
+ * Function:	OPR_WriteStream
  *
- * Parameters:	output - Output file name, containing data that was read.
- *		addr   - Memory address to read from.
- *		size   - Data size to read.
- * Returns:	none.
+ * Parameters:	session - session to use.
+ *		stream  - WRITE commands, encoded by PKT_StreamCreate.
+ * Returns:	EC_OK if successful, otherwise the EXIT_CODE of the failure.
  * Side effects:
  * Description:
- *		Read data from memory, starting from a given address.
- *		Memory may be Flash (SPI), DRAM (DDR) or SRAM.
- *		The data is written into an output file, data size is limited
- *		as specified.
- *		Data is received in 256 bytes chunks.
+ *	Send already encoded WRITE commands, as is. The stream is only read,
+ *	so any number of sessions may send it at once.
  *---------------------------------------------------------------------------
  */
-void OPR_ReadMem(char  *output, UINT32 addr, UINT32 size)
+UINT32 OPR_WriteStream(struct UUT_SESSION *session,
+		       const struct PKT_STREAM *stream)
 {
-	FILE		*outputFileID = NULL;
-	UINT32		curAddr;
-	UINT32		bytesLeft;
-	UINT32		readSize;
-	UINT32		cmdIdx = 1;
-	struct ComandNode	rCmdBuf;
+	UINT32 cmdSize;
+	UINT32 i;
 
-	if (!Console) {
-		outputFileID = fopen(output, "w+b");
+	if (stream->crcType != session->crcType)
+		return EC_CRC_ERR;
 
-		if (outputFileID == NULL) {
-			displayColorMsg(FAIL,
-				"ERROR: could not open outout file [%s]\n",
-					output);
-			return;
-		}
-	}
+	for (i = 0; i < stream->numPackets; i++) {
+		cmdSize = stream->offsets[i + 1] - stream->offsets[i];
 
-	DISPLAY_MSG(("Reading from 0x%08x [%d] bytes in [%d] packets\n", addr, size,
-		    ((size + (MAX_RW_DATA_SIZE - 1)) / MAX_RW_DATA_SIZE)));
+		if (OPR_SendWrite(session, stream->data + stream->offsets[i],
+				  cmdSize) != TRUE)
+			return EC_SEND_CMD_ERR;
+
+		CMD_DispWrite(session, cmdSize - PKT_WRITE_OVERHEAD, i + 1,
+			      stream->numPackets);
+	}
+
+	return EC_OK;
+}
+
+#ifndef WIN32
+/*----------------------------------------------------------------------------
+ * Function:	OPR_WriteImage
+ *
+ * Parameters:	session - session to use.
+ *		input   - image file name.
+ *		addr    - Memory address to write to.
+ * Returns:	TRUE if all the image was written.
+ * Side effects:
+ * Description:
+ *	Write an image file through the image cache: a file written before,
+ *	e.g. by an earlier daemon job, is neither read nor encoded again.
+ *---------------------------------------------------------------------------
+ */
+static BOOLEAN OPR_WriteImage(struct UUT_SESSION *session, const char *input,
+			      UINT32 addr)
+{
+	struct IMG_ENTRY	*image;
+	struct PKT_STREAM	*stream;
+	UINT32			ret_val = EC_SIZE_ERR;
+
+	image = IMG_CacheGet(input);
+	if (image == NULL)
+		return FALSE;
+
+	SESSION_MSG(session, ("Writing to 0x%08X [%d] bytes\n",
+		     addr, image->size));
+
+	stream = IMG_CacheStream(image, session, addr);
+	if (stream != NULL) {
+		ret_val = OPR_WriteStream(session, stream);
+		PKT_StreamPut(stream);
+	}
+
+	SESSION_MSG(session, ("\n"));
+
+	IMG_CachePut(image);
+
+	return (ret_val == EC_OK);
+}
+#endif
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_ReadMem
+ *
+ * Parameters:	session - session to use.
+ *		output - Output file name, containing data that was read.
+ *		addr   - Memory address to read from.
+ *		size   - Data size to read.
+ * Returns:	TRUE if all the data was read.
+ * Side effects:
+ * Description:
+ *		Read data from memory, starting from a given address.
+ *		Memory may be Flash (SPI), DRAM (DDR) or SRAM.
+ *		The data is written into an output file, data size is limited
+ *		as specified.
+ *		Data is received in 256 bytes chunks.
+ *---------------------------------------------------------------------------
+ */
+BOOLEAN OPR_ReadMem(struct UUT_SESSION *session, char  *output, UINT32 addr,
+		    UINT32 size)
+{
+	FILE		*outputFileID = NULL;
+	UINT32		curAddr;
+	UINT32		bytesLeft;
+	UINT32		readSize;
+	UINT32		cmdIdx = 1;
+	BOOLEAN		ret_val = TRUE;
+	struct ComandNode	rCmdBuf;
+
+	if (!session->console) {
+		outputFileID = fopen(output, "w+b");
+
+		if (outputFileID == NULL) {
+			displayColorMsg(FAIL,
+				"ERROR: could not open outout file [%s]\n",
+					output);
+			return FALSE;
+		}
+	}
+
+	SESSION_MSG(session, ("Reading from 0x%08x [%d] bytes in [%d] packets\n", addr, size,
+		    ((size + (MAX_RW_DATA_SIZE - 1)) / MAX_RW_DATA_SIZE)));
 
 	for (curAddr = addr;
 	     curAddr < (addr + size);
@@ -506,73 +1093,173 @@ void OPR_ReadMem(char  *output, UINT32 addr, UINT32 size)
 		bytesLeft = (UINT32)(addr + size - curAddr);
 		readSize = MIN(bytesLeft, MAX_RW_DATA_SIZE);
 
-		CMD_CreateRead(curAddr, ((UINT8)readSize - 1),
+		CMD_CreateRead(session, curAddr, ((UINT8)readSize - 1),
 			       rCmdBuf.cmd, &rCmdBuf.cmdSize);
 		rCmdBuf.respSize = readSize + 3;
 
-		if (OPR_SendCmds(&rCmdBuf, 1) != TRUE)
+		if (OPR_SendCmds(session, &rCmdBuf, 1) != TRUE) {
+			ret_val = FALSE;
 			break;
+		}
 
-		CMD_DispRead(RespBuf, readSize, cmdIdx,
+		CMD_DispRead(session, readSize, cmdIdx,
 		     ((size + (MAX_RW_DATA_SIZE - 1)) / MAX_RW_DATA_SIZE));
 
-		if (Console)
-			CMD_DispData((RespBuf+1), readSize);
+		if (session->console)
+			CMD_DispData((session->respBuf+1), readSize);
 		else
-			fwrite((RespBuf+1), 1, readSize, outputFileID);
+			fwrite((session->respBuf+1), 1, readSize, outputFileID);
 
 		cmdIdx++;
 	}
 
-	DISPLAY_MSG(("\n"));
-	if (!Console)
+	SESSION_MSG(session, ("\n"));
+	if (!session->console)
 		fclose(outputFileID);
+
+	return ret_val;
 }
 
 /*----------------------------------------------------------------------------
- * Function:	OPR_ReadMem_DLL
+ * Function:	OPR_VerifyMem
  *
- * Parameters:	buff - data buffer that was read.
- *		addr   - Memory address to read from.
- *		size   - Data size to read.
- * Returns:	none.
+ * Parameters:	session - session to use.
+ *		input - Input file name, containing the expected data.
+ *		addr  - Memory address to compare from.
+ *		size  - Data size to compare.
+ * Returns:	TRUE if the memory content matches the file.
  * Side effects:
  * Description:
- *		Read data from memory, starting from a given address.
- *		Memory may be Flash (SPI), DRAM (DDR) or SRAM.
- *		The data is written into an output file, data size is limited
- *		as specified.
+ *		Read back memory, starting from a given address, and compare
+ *		it with the first 'size' bytes of an input file.
  *		Data is received in 256 bytes chunks.
  *---------------------------------------------------------------------------
  */
-int OPR_ReadMem_DLL(UINT32 addr, UINT8* buff, UINT32 size)
+BOOLEAN OPR_VerifyMem(struct UUT_SESSION *session, char *input, UINT32 addr,
+		      UINT32 size)
 {
+#ifdef WIN32
+	FILE		*inputFileID;
+	UINT8		dataBuf[MAX_RW_DATA_SIZE];
+#else
+	struct IMG_ENTRY	*image;
+#endif
+	const UINT8	*expected;
 	UINT32		curAddr;
-	UINT32		bytesLeft = size;
 	UINT32		readSize;
-	UINT32		offset = 0;
 	UINT32		i;
+	BOOLEAN		ret_val = TRUE;
 	struct ComandNode	rCmdBuf;
 
-	for (curAddr = addr;
-		curAddr < (addr + size);
-		curAddr += MAX_RW_DATA_SIZE)
-	{
-		readSize = MIN(bytesLeft, MAX_RW_DATA_SIZE);
+#ifdef WIN32
+	inputFileID = fopen(input, "rb");
+	if (inputFileID == NULL) {
+		displayColorMsg(FAIL,
+				"ERROR: could not open input file [%s]\n",
+				input);
+		return FALSE;
+	}
+#else
+	/* The expected data is the cached image, not read again */
+	image = IMG_CacheGet(input);
+	if (image == NULL)
+		return FALSE;
+#endif
+
+	SESSION_MSG(session, ("Verifying 0x%08x [%d] bytes against [%s]\n",
+		     addr, size, input));
+
+	for (curAddr = addr; curAddr < (addr + size) && ret_val;
+	     curAddr += readSize) {
+		readSize = MIN((UINT32)(addr + size - curAddr),
+			       MAX_RW_DATA_SIZE);
+
+#ifdef WIN32
+		if (fread(dataBuf, 1, readSize, inputFileID) != readSize) {
+#else
+		if ((curAddr - addr) + readSize > image->size) {
+#endif
+			displayColorMsg(FAIL,
+				"ERROR: file [%s] is shorter than %d bytes\n",
+				input, size);
+			ret_val = FALSE;
+			break;
+		}
+#ifdef WIN32
+		expected = dataBuf;
+#else
+		expected = image->data + (curAddr - addr);
+#endif
 
-		CMD_CreateRead(curAddr, ((UINT8)readSize - 1),
-			rCmdBuf.cmd, &rCmdBuf.cmdSize);
+		CMD_CreateRead(session, curAddr, ((UINT8)readSize - 1),
+			       rCmdBuf.cmd, &rCmdBuf.cmdSize);
 		rCmdBuf.respSize = readSize + 3;
 
-		if (OPR_SendCmds(&rCmdBuf, 1) != TRUE)
-		{
-			return EC_SEND_CMD_ERR;
+		if (OPR_SendCmds(session, &rCmdBuf, 1) != TRUE) {
+			ret_val = FALSE;
+			break;
 		}
 
-		for (i = 0; i < readSize; i++)
-		{
-			buff[offset + i] = RespBuf[1 + i];
+		for (i = 0; i < readSize; i++) {
+			if (session->respBuf[1 + i] != expected[i]) {
+				displayColorMsg(FAIL,
+		"ERROR: verify failed at 0x%08x: read 0x%02x, expected 0x%02x\n",
+					curAddr + i, session->respBuf[1 + i],
+					expected[i]);
+				ret_val = FALSE;
+				break;
+			}
 		}
+	}
+
+#ifdef WIN32
+	fclose(inputFileID);
+#else
+	IMG_CachePut(image);
+#endif
+
+	if (ret_val)
+		displayColorMsg(SUCCESS, "Verify passed\n");
+
+	return ret_val;
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_ReadBuf
+ *
+ * Parameters:	session - session to use.
+ *		addr	- Memory address to read from.
+ *		buff	- data buffer that was read.
+ *		size	- Data size to read.
+ * Returns:	EC_OK if successful, otherwise the EXIT_CODE of the failure.
+ * Side effects:
+ * Description:
+ *		Read data from memory into a buffer, starting from a given
+ *		address.
+ *		Memory may be Flash (SPI), DRAM (DDR) or SRAM.
+ *		Data is received in 256 bytes chunks.
+ *---------------------------------------------------------------------------
+ */
+UINT32 OPR_ReadBuf(struct UUT_SESSION *session, UINT32 addr, UINT8 *buff,
+		   UINT32 size)
+{
+	UINT32		curAddr;
+	UINT32		bytesLeft = size;
+	UINT32		readSize;
+	UINT32		offset = 0;
+	struct ComandNode	rCmdBuf;
+
+	for (curAddr = addr; bytesLeft > 0; curAddr += readSize) {
+		readSize = MIN(bytesLeft, MAX_RW_DATA_SIZE);
+
+		CMD_CreateRead(session, curAddr, ((UINT8)readSize - 1),
+			       rCmdBuf.cmd, &rCmdBuf.cmdSize);
+
+		/* The data goes straight to the caller buffer */
+		if ((OPR_SendPacket(session, rCmdBuf.cmd, rCmdBuf.cmdSize, 0) !=
+		     TRUE) ||
+		    (OPR_ReadRespData(session, buff + offset, readSize) != TRUE))
+			return EC_SEND_CMD_ERR;
 
 		bytesLeft	-= readSize;
 		offset		+= readSize;
@@ -581,10 +1268,308 @@ int OPR_ReadMem_DLL(UINT32 addr, UINT8* buff, UINT32 size)
 	return EC_OK;
 }
 
+/*----------------------------------------------------------------------------
+ * Function:	OPR_WriteVec
+ *
+ * Parameters:	session - session to use.
+ *		vec	- memory ranges to write, must not overlap.
+ *		count	- number of ranges.
+ * Returns:	EC_OK if successful, otherwise the EXIT_CODE of the failure.
+ * Side effects:
+ * Description:
+ *	Write several buffers to memory in one transfer, see
+ *	OPR_VecTransfer.
+ *---------------------------------------------------------------------------
+ */
+UINT32 OPR_WriteVec(struct UUT_SESSION *session, const struct UUT_IOVEC *vec,
+		    UINT32 count)
+{
+	return OPR_VecTransfer(session, vec, count, TRUE);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_ReadVec
+ *
+ * Parameters:	session - session to use.
+ *		vec	- memory ranges to read, each into its buffer.
+ *		count	- number of ranges.
+ * Returns:	EC_OK if successful, otherwise the EXIT_CODE of the failure.
+ * Side effects:
+ * Description:
+ *	Read several memory ranges in one transfer, see
+ *	OPR_VecTransfer.
+ *---------------------------------------------------------------------------
+ */
+UINT32 OPR_ReadVec(struct UUT_SESSION *session, const struct UUT_IOVEC *vec,
+		   UINT32 count)
+{
+	return OPR_VecTransfer(session, vec, count, FALSE);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_VecSegCmp
+ *
+ * Parameters:	a, b - segments to compare.
+ * Returns:	qsort() order: by address, then by the caller's order.
+ * Side effects:
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+static int OPR_VecSegCmp(const void *a, const void *b)
+{
+	const struct VEC_SEG *segA = (const struct VEC_SEG *)a;
+	const struct VEC_SEG *segB = (const struct VEC_SEG *)b;
+
+	if (segA->addr != segB->addr)
+		return (segA->addr < segB->addr) ? -1 : 1;
+
+	return (segA->idx < segB->idx) ? -1 : (segA->idx > segB->idx);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_VecPlan
+ *
+ * Parameters:	vec	- memory ranges.
+ *		count	- number of ranges.
+ *		write	- TRUE for a write, whose ranges must not overlap.
+ *		segs	- returned ranges, in address order.
+ *		pkts	- returned packets, in address order.
+ *		numPkts	- returned number of packets.
+ * Returns:	EC_OK if successful, otherwise the EXIT_CODE of the failure.
+ * Side effects: Allocates segs and pkts, to be freed by the caller.
+ * Description:
+ *	Sort the ranges and cut them into packets. Ranges which touch or
+ *	overlap are merged, so their packets are full; ranges apart are
+ *	never merged, the gap may hold registers which must not be
+ *	accessed.
+ *---------------------------------------------------------------------------
+ */
+static UINT32 OPR_VecPlan(const struct UUT_IOVEC *vec, UINT32 count,
+			  BOOLEAN write, struct VEC_SEG **segs,
+			  struct VEC_PKT **pkts, UINT32 *numPkts)
+{
+	struct VEC_SEG		*seg;
+	struct VEC_PKT		*pkt;
+	unsigned long long	runStart;
+	unsigned long long	runEnd;
+	unsigned long long	addr;
+	UINT32			numSegs = 0;
+	UINT32			maxPkts = 0;
+	UINT32			first;
+	UINT32			i;
+
+	*segs    = (struct VEC_SEG *)malloc((count + 1) * sizeof(**segs));
+	*pkts    = NULL;
+	*numPkts = 0;
+	if (*segs == NULL)
+		return EC_SIZE_ERR;
+
+	for (i = 0; i < count; i++) {
+		if (vec[i].len == 0)
+			continue;
+
+		if ((unsigned long long)vec[i].addr + vec[i].len >
+		    0x100000000ULL)
+			return EC_SIZE_ERR;
+
+		seg       = &(*segs)[numSegs++];
+		seg->addr = vec[i].addr;
+		seg->len  = vec[i].len;
+		seg->idx  = i;
+		maxPkts  += (vec[i].len / MAX_RW_DATA_SIZE) + 1;
+	}
+
+	qsort(*segs, numSegs, sizeof(**segs), OPR_VecSegCmp);
+
+	*pkts = (struct VEC_PKT *)malloc((maxPkts + 1) * sizeof(**pkts));
+	if (*pkts == NULL)
+		return EC_SIZE_ERR;
+
+	for (i = 0; i < numSegs; ) {
+		first    = i;
+		runStart = (*segs)[i].addr;
+		runEnd   = runStart + (*segs)[i].len;
+
+		for (i++; (i < numSegs) && ((*segs)[i].addr <= runEnd); i++) {
+			if (write && ((*segs)[i].addr < runEnd))
+				return EC_SIZE_ERR;
+
+			runEnd = MAX(runEnd,
+				     (unsigned long long)(*segs)[i].addr +
+				     (*segs)[i].len);
+		}
+
+		for (addr = runStart; addr < runEnd; addr += pkt->len) {
+			pkt        = &(*pkts)[(*numPkts)++];
+			pkt->addr  = (UINT32)addr;
+			pkt->len   = (UINT32)MIN(runEnd - addr, MAX_RW_DATA_SIZE);
+			pkt->first = first;
+			pkt->last  = i - 1;
+		}
+	}
+
+	return EC_OK;
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_VecCopy
+ *
+ * Parameters:	vec   - memory ranges.
+ *		segs  - ranges, in address order.
+ *		pkt   - packet.
+ *		data  - packet data.
+ *		write - TRUE to gather the packet data from the ranges, FALSE
+ *			to scatter it to them.
+ * Returns:	none.
+ * Side effects:
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+static void OPR_VecCopy(const struct UUT_IOVEC *vec,
+			const struct VEC_SEG *segs, const struct VEC_PKT *pkt,
+			UINT8 *data, BOOLEAN write)
+{
+	const struct VEC_SEG	*seg;
+	unsigned long long	start;
+	unsigned long long	end;
+	UINT32			i;
+
+	for (i = pkt->first; i <= pkt->last; i++) {
+		seg   = &segs[i];
+		start = MAX(seg->addr, pkt->addr);
+		end   = MIN((unsigned long long)seg->addr + seg->len,
+			    (unsigned long long)pkt->addr + pkt->len);
+		if (start >= end)
+			continue;
+
+		if (write)
+			memcpy(data + (start - pkt->addr),
+			       vec[seg->idx].buf + (start - seg->addr),
+			       (size_t)(end - start));
+		else
+			memcpy(vec[seg->idx].buf + (start - seg->addr),
+			       data + (start - pkt->addr),
+			       (size_t)(end - start));
+	}
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_VecTransfer
+ *
+ * Parameters:	session - session to use.
+ *		vec	- memory ranges.
+ *		count	- number of ranges.
+ *		write	- TRUE to write the ranges, FALSE to read them.
+ * Returns:	EC_OK if successful, otherwise the EXIT_CODE of the failure.
+ * Side effects: Counts the resent packets in session->retries.
+ * Description:
+ *	Send the packets in batches of session->pipeDepth, back to back,
+ *	and then collect the batch responses in order. The default depth of
+ *	1 is the stop-and-wait of the ROM; a deeper pipeline pays the round
+ *	trip once per batch, for devices which buffer the commands. When a
+ *	response is missing or garbled, the input is drained and the
+ *	packets are resent from the first one not answered, up to
+ *	session->maxRetries times, so a packet acknowledged is never sent
+ *	again. Responses carry no packet number: with a pipeline, a command
+ *	lost on the line shifts the responses after it, hence pipelining is
+ *	only for links which do not lose bytes.
+ *---------------------------------------------------------------------------
+ */
+static UINT32 OPR_VecTransfer(struct UUT_SESSION *session,
+			      const struct UUT_IOVEC *vec, UINT32 count,
+			      BOOLEAN write)
+{
+	struct VEC_SEG		*segs;
+	struct VEC_PKT		*pkts;
+	struct VEC_PKT		*pkt;
+	struct ComandNode	*node;
+	UINT8			data[MAX_RW_DATA_SIZE];
+	UINT8			respCmd;
+	UINT32			numPkts;
+	UINT32			done = 0;
+	UINT32			batch;
+	UINT32			trial = 0;
+	UINT32			i;
+	UINT32			ret_val;
+
+	respCmd = write ? (UINT8)UFPP_WRITE_CMD : (UINT8)UFPP_READ_CMD;
+
+	ret_val = OPR_VecPlan(vec, count, write, &segs, &pkts, &numPkts);
+
+	while ((ret_val == EC_OK) && (done < numPkts)) {
+		batch = MIN(numPkts - done, session->pipeDepth);
+
+		for (i = 0; i < batch; i++) {
+			pkt  = &pkts[done + i];
+			node = &session->cmdBuf[i];
+
+			if (write) {
+				OPR_VecCopy(vec, segs, pkt, data, TRUE);
+				CMD_CreateWrite(session, pkt->addr, pkt->len,
+						data, node->cmd,
+						&node->cmdSize);
+				node->respSize = 1;
+			} else {
+				CMD_CreateRead(session, pkt->addr,
+					       (UINT8)(pkt->len - 1), node->cmd,
+					       &node->cmdSize);
+				node->respSize = pkt->len + 3;
+			}
+
+			if (session->cancel ||
+			    (ComPortWriteBin(session->portHandle, node->cmd,
+					     node->cmdSize) != TRUE)) {
+				ret_val = EC_SEND_CMD_ERR;
+				break;
+			}
+			session->txBytes += node->cmdSize;
+		}
+
+		if (ret_val != EC_OK)
+			break;
+
+		for (i = 0; i < batch; i++) {
+			session->respBuf[0] = 0;
+
+			if (!OPR_ReadResp(session, session->cmdBuf[i].respSize) ||
+			    (session->respBuf[0] != respCmd))
+				break;
+
+			if (!write)
+				OPR_VecCopy(vec, segs, &pkts[done + i],
+					    session->respBuf + 1, FALSE);
+		}
+
+		/* The packets answered are done, resend from the first other */
+		done += i;
+		if (i == batch) {
+			trial = 0;
+			continue;
+		}
+		if (i > 0)
+			trial = 0;
+
+		if ((trial >= session->maxRetries) || session->cancel) {
+			ret_val = EC_SEND_CMD_ERR;
+			break;
+		}
+
+		OPR_DrainInput(session->portHandle, SYNC_DRAIN_QUIET);
+		session->retries += batch - i;
+		trial++;
+	}
+
+	free(segs);
+	free(pkts);
+
+	return ret_val;
+}
+
 /*----------------------------------------------------------------------------
  * Function:	OPR_ReadStatusMsg
  *
  * Parameters:
+ *		session - session to use.
  *		outputFileName - name of the file to write the data to
  *
  * Returns:	none
@@ -593,7 +1578,7 @@ int OPR_ReadMem_DLL(UINT32 addr, UINT8* buff, UINT32 size)
  *  Reads status message from the core and outputs it to a file (binary format)
  *---------------------------------------------------------------------------
  */
-void OPR_ReadStatusMsg(char *outputFileName)
+void OPR_ReadStatusMsg(struct UUT_SESSION *session, char *outputFileName)
 {
 
 	FILE	*outputFileID = NULL;
@@ -610,49 +1595,49 @@ void OPR_ReadStatusMsg(char *outputFileName)
 		return;
 	}
 
-	DISPLAY_MSG(("Reading status message\n"));
+	SESSION_MSG(session, ("Reading status message\n"));
 
 	while (1) {
 		UINT32  dataSize;
 
 		bytesToRead = 0;
 		while (bytesToRead < STS_MSG_MIN_SIZE)
-			bytesToRead = ComPortWaitForRead(PortHandle);
+			bytesToRead = ComPortWaitForRead(session->portHandle);
 
-		bytesRead = ComPortReadBin(PortHandle,
-					   RespBuf,
+		bytesRead = ComPortReadBin(session->portHandle,
+					   session->respBuf,
 					   STS_MSG_MIN_SIZE);
 
-		DISPLAY_MSG(("bytesRead = %d\n", bytesRead));
+		SESSION_MSG(session, ("bytesRead = %d\n", bytesRead));
 
 		for (i = 0; i < bytesRead; i++)
-			DISPLAY_MSG(("0x%x ", RespBuf[i]));
+			SESSION_MSG(session, ("0x%x ", session->respBuf[i]));
 
-		DISPLAY_MSG(("\n"));
+		SESSION_MSG(session, ("\n"));
 
-		fwrite(RespBuf, 1, bytesRead, outputFileID);
+		fwrite(session->respBuf, 1, bytesRead, outputFileID);
 
-		if (*((UINT32 *)RespBuf) == (UINT32)STS_MSG_APP_END)
+		if (*((UINT32 *)session->respBuf) == (UINT32)STS_MSG_APP_END)
 			break;
 
 		/* Read additional data if exists */
-		dataSize = ((struct STATUS_MSG *)RespBuf)->dataSize;
+		dataSize = ((struct STATUS_MSG *)session->respBuf)->dataSize;
 		if (dataSize != 0) {
 			bytesToRead = 0;
 			while (bytesToRead < dataSize)
-				bytesToRead = ComPortWaitForRead(PortHandle);
+				bytesToRead = ComPortWaitForRead(session->portHandle);
 
-			bytesRead = ComPortReadBin(PortHandle,
-						   RespBuf,
+			bytesRead = ComPortReadBin(session->portHandle,
+						   session->respBuf,
 						   dataSize);
 
-			DISPLAY_MSG(("bytesRead = %d\n", bytesRead));
+			SESSION_MSG(session, ("bytesRead = %d\n", bytesRead));
 			for (i = 0; i < bytesRead; i++)
-				DISPLAY_MSG(("0x%x ", RespBuf[i]));
+				SESSION_MSG(session, ("0x%x ", session->respBuf[i]));
 
-			DISPLAY_MSG(("\n"));
+			SESSION_MSG(session, ("\n"));
 
-			fwrite(RespBuf, 1, bytesRead, outputFileID);
+			fwrite(session->respBuf, 1, bytesRead, outputFileID);
 		}
 	}
 
@@ -662,8 +1647,9 @@ void OPR_ReadStatusMsg(char *outputFileName)
 /*----------------------------------------------------------------------------
  * Function:	OPR_ExecuteExit
  *
- * Parameters:	addr - Start address to execute from.
- * Returns:	none.
+ * Parameters:	session - session to use.
+ *		addr - Start address to execute from.
+ * Returns:	TRUE if the command was sent.
  * Side effects:	ROM-Code is not in UART command mode anymore.
  * Description:
  *	Execute code starting from a given address.
@@ -671,22 +1657,25 @@ void OPR_ReadStatusMsg(char *outputFileName)
  *	No further communication with thr ROM-Code is expected at this point.
  *---------------------------------------------------------------------------
  */
-void OPR_ExecuteExit(UINT32 addr)
+BOOLEAN OPR_ExecuteExit(struct UUT_SESSION *session, UINT32 addr)
 {
 	UINT32 cmdNum;
 
-	CMD_BuildExecExit(addr, CmdBuf, &cmdNum);
-	if (OPR_SendCmds(CmdBuf, cmdNum) != TRUE)
-		return;
+	CMD_BuildExecExit(session, addr, &cmdNum);
+	if (OPR_SendCmds(session, session->cmdBuf, cmdNum) != TRUE)
+		return FALSE;
+
+	CMD_DispExecExit(session->respBuf);
 
-	CMD_DispExecExit(RespBuf);
+	return TRUE;
 }
 
 /*----------------------------------------------------------------------------
  * Function:	OPR_ExecuteReturn
  *
- * Parameters:	addr - Start address to execute from.
- * Returns:	none.
+ * Parameters:	session - session to use.
+ *		addr - Start address to execute from.
+ * Returns:	TRUE if the execution result was received.
  * Side effects:
  * Description:
  *	Execute code starting from a given address.
@@ -694,23 +1683,26 @@ void OPR_ExecuteExit(UINT32 addr)
  *	The executed code should return with the execution result.
  *---------------------------------------------------------------------------
  */
-void OPR_ExecuteReturn(UINT32 addr)
+BOOLEAN OPR_ExecuteReturn(struct UUT_SESSION *session, UINT32 addr)
 {
 	UINT32 cmdNum;
 
-	CMD_BuildExecRet(addr, CmdBuf, &cmdNum);
-	if (OPR_SendCmds(CmdBuf, cmdNum) != TRUE)
-		return;
+	CMD_BuildExecRet(session, addr, &cmdNum);
+	if (OPR_SendCmds(session, session->cmdBuf, cmdNum) != TRUE)
+		return FALSE;
+
+	CMD_DispExecRet(session->respBuf);
 
-	CMD_DispExecRet(RespBuf);
+	return TRUE;
 }
 
 /*----------------------------------------------------------------------------
- * Function:	OPR_ExecuteReturn
+ * Function:	OPR_ExecuteCall
  *
- * Parameters:	addr - Start address to execute from.
- *				resp   - Responce code of the executed command.
- * Returns:	none.
+ * Parameters:	session - session to use.
+ *		addr	- Start address to execute from.
+ *		resp	- Responce code of the executed command.
+ * Returns:	EC_OK if successful, otherwise the EXIT_CODE of the failure.
  * Side effects:
  * Description:
  *	Execute code starting from a given address.
@@ -718,160 +1710,578 @@ void OPR_ExecuteReturn(UINT32 addr)
  *	The executed code should return with the execution result.
  *---------------------------------------------------------------------------
  */
-int OPR_ExecuteReturn_DLL(UINT32 addr, UINT8* resp)
+UINT32 OPR_ExecuteCall(struct UUT_SESSION *session, UINT32 addr, UINT8 *resp)
 {
 	UINT32 cmdNum;
 
-	CMD_BuildExecRet(addr, CmdBuf, &cmdNum);
-	if (OPR_SendCmds(CmdBuf, cmdNum) != TRUE)
-	{
+	CMD_BuildExecRet(session, addr, &cmdNum);
+	if (OPR_SendCmds(session, session->cmdBuf, cmdNum) != TRUE)
 		return EC_SEND_CMD_ERR;
-	}
 
-	resp[0] = RespBuf[2];
+	resp[0] = session->respBuf[2];
 
 	return EC_OK;
 }
 
+/*----------------------------------------------------------------------------
+ * Function:	OPR_SleepMs
+ *
+ * Parameters:	ms - time to sleep.
+ * Returns:	none
+ *---------------------------------------------------------------------------
+ */
+static void OPR_SleepMs(UINT32 ms)
+{
+#ifdef WIN32
+	Sleep(ms);
+#else
+	usleep(ms * 1000);
+#endif
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_DrainInput
+ *
+ * Parameters:
+ *		handle  - opened port handle.
+ *		quietMs - line silence which ends the drain.
+ * Returns:	none
+ * Side effects:
+ * Description:
+ *	Discard input until the line has been quiet for quietMs, e.g. late
+ *	answers to earlier SYNC commands. Gives up after SYNC_DEADLINE.
+ *---------------------------------------------------------------------------
+ */
+static void OPR_DrainInput(HANDLE handle, UINT32 quietMs)
+{
+	UINT8			buf[64];
+	unsigned long long	end = getTimeUs() + (SYNC_DEADLINE * 1000);
+
+	while ((getTimeUs() < end) &&
+	       (ComPortWaitForReadTimeout(handle, quietMs) > 0)) {
+		if (ComPortReadBin(handle, buf, sizeof(buf)) == 0)
+			break;
+	}
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_SendWrite
+ *
+ * Parameters:
+ *		session - session to use.
+ *		cmd     - an encoded WRITE command.
+ *		cmdSize - command size.
+ * Returns:	TRUE once the device acknowledged the packet.
+ * Side effects: Counts the resends in session->retries.
+ * Description:
+ *	Send a WRITE packet and check its acknowledge. An unanswered or
+ *	garbled packet is resent up to session->maxRetries times; rewriting
+ *	the same data to the same address is harmless. Late answers are
+ *	drained before a resend, so they are not taken as its acknowledge.
+ *---------------------------------------------------------------------------
+ */
+static BOOLEAN OPR_SendWrite(struct UUT_SESSION *session, const UINT8 *cmd,
+			     UINT32 cmdSize)
+{
+	UINT32 trial;
+
+	for (trial = 0; ; trial++) {
+		session->respBuf[0] = 0;
+
+		if ((OPR_SendPacket(session, cmd, cmdSize, 1) == TRUE) &&
+		    (session->respBuf[0] == (UINT8)UFPP_WRITE_CMD))
+			return TRUE;
+
+		if ((trial >= session->maxRetries) || session->cancel)
+			return FALSE;
+
+		OPR_DrainInput(session->portHandle, SYNC_DRAIN_QUIET);
+		session->retries++;
+	}
+}
+
 /*----------------------------------------------------------------------------
  * Function:	OPR_CheckSync
  *
  * Parameters:
+ *		session - session to use.
  *		bdRate - baud rate to check
  *
  * Returns:
  * Side effects:
  * Description:
  *	Checks whether the Host and the Core are synchoronized in the
- *	specified baud rate
+ *	specified baud rate.
+ *	SYNC is re-sent with a doubling answer wait (SYNC_BURST_TIMEOUT up to
+ *	SYNC_MAX_TIMEOUT) until the device answers or SYNC_DEADLINE expires.
+ *	Stale input is drained before the first SYNC and after the answer.
  *---------------------------------------------------------------------------
  */
-enum SYNC_RESULT OPR_CheckSync(UINT32 bdRate)
+enum SYNC_RESULT OPR_CheckSync(struct UUT_SESSION *session, UINT32 bdRate)
 {
+	enum SYNC_RESULT	sr = SR_TIMEOUT;
+	unsigned long long	end;
+	unsigned long long	now;
+	UINT32			timeout = SYNC_BURST_TIMEOUT;
+	UINT32			wrong = 0;
+	UINT32			rttUs = 0;
+	UINT32			trials = 0;
+	UINT8			resp;
+
+	session->portCfg.BaudRate = bdRate;
+	if (!ConfigureUart(session->portHandle, session->portCfg))
+		return SR_ERROR;
 
-	UINT32			cmdNum;
-	struct ComandNode	*curCmd = CmdBuf;
-#ifdef WIN32
-#if !defined(__WATCOMC__)
-	UINT32		errors;
-	COMSTAT		comstat;
-#endif
-#endif
-	UINT32		bytesRead = 0;
-	UINT32		i;
+	OPR_DrainInput(session->portHandle, 1);
 
-	PortCfg.BaudRate = bdRate;
-	if (!ConfigureUart(PortHandle, PortCfg))
-		return SR_ERROR;
+	end = getTimeUs() + (SYNC_DEADLINE * 1000);
+	for (now = getTimeUs(); now < end; now = getTimeUs()) {
+		timeout = MIN(timeout, (UINT32)((end - now + 999) / 1000));
+		trials++;
 
-	CMD_BuildSync(CmdBuf, &cmdNum);
+		sr = OPR_SyncHandle(session->portHandle, &resp, timeout, &rttUs);
+		if (sr == SR_OK || sr == SR_ERROR)
+			break;
 
-#ifdef WIN32
-#if !defined(__WATCOMC__)
-	ClearCommError(PortHandle, (LPDWORD)&errors, &comstat);
-#endif
-#endif
+		/* A garbled answer may be noise of a device reset */
+		if ((sr == SR_WRONG_DATA) && (++wrong >= SYNC_WRONG_LIMIT))
+			break;
 
-	if (!ComPortWriteBin(PortHandle, curCmd->cmd, curCmd->cmdSize))
-		return SR_ERROR;
+		timeout = MIN(timeout * 2, SYNC_MAX_TIMEOUT);
+	}
 
-	/* Allow several SYNC trials */
-	for (i = 0; i < MAX_SYNC_TRIALS; i++) {
-		bytesRead = ComPortReadBin(PortHandle, RespBuf, 1);
+	if ((sr == SR_TIMEOUT) && (wrong > 0))
+		sr = SR_WRONG_DATA;
 
-		/* Quit if succeeded to read a response */
-		if (bytesRead == 1)
-			break;
-		/* Otherwise give the ROM-Code time to answer */
-#if WIN32
-#if !defined(__WATCOMC__)
-		Sleep(300);
-#else
-		sleep(1);
-#endif
-#else
-		sleep(1);
-#endif
+	if (sr == SR_OK) {
+		/* Answers to earlier SYNC trials may still be on their way */
+		if (trials > 1)
+			OPR_DrainInput(session->portHandle,
+				       MAX(SYNC_DRAIN_QUIET, (2 * rttUs) / 1000));
+
+		session->syncRttUs = rttUs;
+		SESSION_MSG(session, ("Sync RTT %u us after %u trial(s)\n",
+			     rttUs, trials));
 	}
 
-	if (bytesRead == 0)
-		/*
-		 * Unable to read a response from ROM-Code in a reasonable
-		 * time
-		 */
+	return sr;
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_SyncHandle
+ *
+ * Parameters:
+ *		handle    - opened port handle.
+ *		resp      - the byte received from the device.
+ *		timeoutMs - time to wait for an answer.
+ *		rttUs     - SYNC round trip time, valid when a byte arrived.
+ * Returns:	SYNC result.
+ * Side effects:
+ * Description:
+ *	Send a single SYNC command and wait up to timeoutMs for its answer.
+ *	Uses only the given handle, so it may run on any thread.
+ *---------------------------------------------------------------------------
+ */
+static enum SYNC_RESULT OPR_SyncHandle(HANDLE handle, UINT8 *resp,
+				       UINT32 timeoutMs, UINT32 *rttUs)
+{
+	UINT8			cmd[MAX_CMD_BUF_SIZE];
+	UINT32			cmdLen;
+	unsigned long long	start;
+
+	CMD_CreateSync(cmd, &cmdLen);
+
+	start = getTimeUs();
+
+	if (!ComPortWriteBin(handle, cmd, cmdLen))
+		return SR_ERROR;
+
+	if (ComPortWaitForReadTimeout(handle, timeoutMs) == 0)
+		return SR_TIMEOUT;
+
+	if (ComPortReadBin(handle, resp, 1) != 1)
 		return SR_TIMEOUT;
 
-	if (RespBuf[0] != (UINT8)(UFPP_D2H_SYNC_CMD))
-		/* ROM-Code response is not as expected */
+	*rttUs = (UINT32)(getTimeUs() - start);
+
+	if (*resp != (UINT8)(UFPP_D2H_SYNC_CMD))
 		return SR_WRONG_DATA;
 
-	/* Good response */
 	return SR_OK;
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_SyncLevel
+ *
+ * Parameters:	t - time since the SYNC response start bit, in 1/1000 of a
+ *		    device bit.
+ * Returns:	Line level driven by the device at that time.
+ *---------------------------------------------------------------------------
+ */
+static UINT8 OPR_SyncLevel(UINT32 t)
+{
+	UINT32 bit = t / 1000;
 
+	if (bit == 0)
+		return 0;	/* Start bit */
+
+	if (bit <= 8)
+		return (UFPP_D2H_SYNC_CMD >> (bit - 1)) & 0x01;
+
+	return 1;		/* Stop bit and idle line */
 }
 
 /*----------------------------------------------------------------------------
- * Function:	OPR_ScanBaudRate
+ * Function:	OPR_GarbledSync
  *
- * Parameters:	none
- * Returns:
+ * Parameters:	ratio - device baud rate / host baud rate, in 1/1000.
+ *		byte  - the byte the host UART receives.
+ * Returns:	FALSE if the host UART does not see a start bit at all.
+ * Side effects:
+ * Description:
+ *	Model the host UART sampling the device SYNC response: each host bit
+ *	is sampled at its middle, a low stop bit is a framing error, which
+ *	the tty layer delivers as 0x00.
+ *---------------------------------------------------------------------------
+ */
+static BOOLEAN OPR_GarbledSync(UINT32 ratio, UINT8 *byte)
+{
+	UINT8	val = 0;
+	UINT32	i;
+
+	if (OPR_SyncLevel(ratio / 2) != 0)
+		return FALSE;
+
+	for (i = 0; i < 8; i++)
+		val |= OPR_SyncLevel(((2 * i + 3) * ratio) / 2) << i;
+
+	if (OPR_SyncLevel((19 * ratio) / 2) == 0)
+		val = 0;
+
+	*byte = val;
+
+	return TRUE;
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_EstimateBaudRates
+ *
+ * Parameters:	hostRates - host baud rates which received a garbled SYNC.
+ *		garbled   - the byte received at each of hostRates.
+ *		numObs    - number of garbled SYNC observations.
+ *		rates     - the estimated device baud rates.
+ *		maxRates  - size of rates.
+ * Returns:	Number of estimated baud rates.
+ * Side effects:
+ * Description:
+ *	Find the device baud rates which explain all the garbled SYNC
+ *	responses received so far, and return a rate from each range of
+ *	matching rates, adding more points for ranges wider than a UART can
+ *	tolerate.
+ *---------------------------------------------------------------------------
+ */
+static UINT32 OPR_EstimateBaudRates(const UINT32 *hostRates,
+				    const UINT8 *garbled, UINT32 numObs,
+				    UINT32 *rates, UINT32 maxRates)
+{
+	UINT32	numRates = 0;
+	UINT32	devRate;
+	UINT32	runStart = 0;
+	UINT32	rate;
+	BOOLEAN	inRun = FALSE;
+	BOOLEAN	match;
+	UINT8	byte;
+	UINT32	i;
+
+	if (numObs == 0)
+		return 0;
+
+	for (devRate = BR_LOW_LIMIT; devRate <= BR_HIGH_LIMIT + 1;
+	     devRate += (devRate * BR_RATIO_STEP) / 1000 + 1) {
+		match = (devRate <= BR_HIGH_LIMIT);
+		for (i = 0; (i < numObs) && match; i++) {
+			match = OPR_GarbledSync((UINT32)(((unsigned long long)
+					devRate * 1000) / hostRates[i]), &byte) &&
+				(byte == garbled[i]);
+		}
+
+		if (match && !inRun) {
+			runStart = devRate;
+			inRun    = TRUE;
+		} else if (!match && inRun) {
+			inRun = FALSE;
+
+			/* One probe every BR_FINE_STEP percent of the range */
+			rate = runStart + (runStart * BR_FINE_STEP) / 200;
+			if (rate >= devRate)
+				rate = (runStart + devRate) / 2;
+
+			for (; (rate < devRate) && (numRates < maxRates);
+			     rate += (rate * BR_FINE_STEP) / 100)
+				rates[numRates++] = rate;
+		}
+	}
+
+	return numRates;
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_ProbeBaudRate
+ *
+ * Parameters:	session - session to use.
+ *		bdRate - baud rate to check.
+ *		resp   - the byte received from the device.
+ * Returns:	SYNC result.
  * Side effects:
  * Description:
- *		Scans the baud rate range by sending sync request to the core
- *		and prints the response
+ *	Switch the port to bdRate and send a single SYNC, waiting only as
+ *	long as the answer takes to arrive at that rate.
  *---------------------------------------------------------------------------
  */
-BOOLEAN OPR_ScanBaudRate(void)
+static enum SYNC_RESULT OPR_ProbeBaudRate(struct UUT_SESSION *session,
+					  UINT32 bdRate, UINT8 *resp)
 {
-	UINT32          bdRate = 0;
-	UINT32          brStep;
-	enum SYNC_RESULT     sr;
-	BOOLEAN         synched = FALSE;
-	BOOLEAN         dataReceived = FALSE;
+	enum SYNC_RESULT	sr;
+	UINT32			rttUs = 0;
+	/* Time for two characters to arrive, plus the device latency */
+	UINT32			timeout = BR_SYNC_TIMEOUT_MIN + (20 * 1000) / bdRate;
+
+	session->portCfg.BaudRate = bdRate;
+	if (!ConfigureUart(session->portHandle, session->portCfg))
+		return SR_ERROR;
+
+	*resp = 0;
+	sr = OPR_SyncHandle(session->portHandle, resp, timeout, &rttUs);
+
+	if (sr == SR_OK)
+		SESSION_MSG(session, ("SR_OK: Baud rate - %d, respBuf - 0x%x\n",
+			     bdRate, *resp));
+	else if (sr == SR_WRONG_DATA)
+		SESSION_MSG(session, ("SR_WRONG_DATA: Baud rate - %d, respBuf - 0x%x\n",
+			     bdRate, *resp));
+	else if (sr == SR_TIMEOUT)
+		SESSION_MSG(session, ("SR_TIMEOUT: Baud rate - %d\n", bdRate));
+	else
+		SESSION_MSG(session, ("SR_ERROR: Baud rate - %d\n", bdRate));
+
+	return sr;
+}
 
-	/* Scan with HUGE STEPS */
-	brStep = (BR_LOW_LIMIT*BR_BIG_STEP) / 100; /* BR_BIG_STEP is percents */
-	for (bdRate = BR_LOW_LIMIT; bdRate < BR_HIGH_LIMIT; bdRate += brStep) {
-		sr = OPR_CheckSync(bdRate);
-		brStep = (bdRate * BR_BIG_STEP) / 100;
+/*----------------------------------------------------------------------------
+ * Function:	OPR_ScanBaudRate
+ *
+ * Parameters:	session - session to use.
+ * Returns:	TRUE if the device baud rate was found.
+ * Side effects:
+ * Description:
+ *	Look for the device baud rate:
+ *	1. Try the standard baud rates, most common first.
+ *	2. The garbled SYNC responses received on the way tell which device
+ *	   rates are possible: try the rates matching all of them.
+ *	3. As a last resort sweep the BR_LOW_LIMIT..BR_HIGH_LIMIT range in
+ *	   BR_FINE_STEP steps.
+ *	Each probe waits only a few character times for the answer.
+ *---------------------------------------------------------------------------
+ */
+BOOLEAN OPR_ScanBaudRate(struct UUT_SESSION *session)
+{
+	static const UINT32 stdRates[] = {
+		115200, 57600, 38400, 19200, 9600, 4800, 2400, 1200, 600
+	};
+	UINT32			obsRates[sizeof(stdRates) / sizeof(stdRates[0])];
+	UINT8			obsBytes[sizeof(stdRates) / sizeof(stdRates[0])];
+	UINT32			numObs = 0;
+	UINT32			rates[BR_MAX_ESTIMATES];
+	UINT32			numRates;
+	UINT32			bdRate = 0;
+	UINT32			i;
+	UINT8			resp;
+	enum SYNC_RESULT	sr;
+
+	for (i = 0; (i < sizeof(stdRates) / sizeof(stdRates[0])) &&
+	     (bdRate == 0); i++) {
+		if ((stdRates[i] < BR_LOW_LIMIT) || (stdRates[i] > BR_HIGH_LIMIT))
+			continue;
+
+		sr = OPR_ProbeBaudRate(session, stdRates[i], &resp);
 		if (sr == SR_OK) {
-			printf("SR_OK: Baud rate - %d, respBuf - 0x%x\n",
-			       bdRate,
-			       RespBuf[0]);
-			synched = TRUE;
-			brStep = (bdRate * BR_SMALL_STEP) / 100;
+			bdRate = stdRates[i];
 		} else if (sr == SR_WRONG_DATA) {
-			printf(
-			     "SR_WRONG_DATA: Baud rate - %d, respBuf - 0x%x\n",
-			     bdRate,
-			     RespBuf[0]);
-			dataReceived = TRUE;
-			brStep = (bdRate * BR_MEDIUM_STEP) / 100;
-		} else if (sr == SR_TIMEOUT) {
-			printf("SR_TIMEOUT: Baud rate - %d, respBuf - 0x%x\n",
-			       bdRate, RespBuf[0]);
-
-			if (synched || dataReceived)
-				break;
-		} else if (sr == SR_ERROR) {
-			printf("SR_ERROR: Baud rate - %d, respBuf - 0x%x\n",
-			       bdRate, RespBuf[0]);
-			if (synched || dataReceived)
-				break;
-		} else
-		printf("Unknown error code: Baud rate - %d, respBuf - 0x%x\n",
-			bdRate, RespBuf[0]);
+			obsRates[numObs]   = stdRates[i];
+			obsBytes[numObs++] = resp;
+		}
+	}
+
+	if (bdRate == 0) {
+		numRates = OPR_EstimateBaudRates(obsRates, obsBytes, numObs,
+						 rates, BR_MAX_ESTIMATES);
+		for (i = 0; (i < numRates) && (bdRate == 0); i++) {
+			if (OPR_ProbeBaudRate(session, rates[i], &resp) == SR_OK)
+				bdRate = rates[i];
+		}
+	}
+
+	for (i = BR_LOW_LIMIT; (i < BR_HIGH_LIMIT) && (bdRate == 0);
+	     i += (i * BR_FINE_STEP) / 100) {
+		if (OPR_ProbeBaudRate(session, i, &resp) == SR_OK)
+			bdRate = i;
+	}
+
+	if (bdRate == 0) {
+		displayColorMsg(FAIL, "Baud rate detection failed\n");
+		return FALSE;
 	}
 
+	displayColorMsg(SUCCESS, "Detected baud rate %u\n", bdRate);
+
 	return TRUE;
 }
 
 
+/*----------------------------------------------------------------------------
+ * Function:	OPR_SendPacket
+ *
+ * Parameters:	session  - session to use.
+ *		cmd      - encoded command.
+ *		cmdSize  - command size.
+ *		respSize - expected response size, 0 for none.
+ * Returns:	1 if successful, 0 in the case of an error.
+ * Side effects:
+ * Description:
+ *	Send a single command and wait for its complete response, which is
+ *	read into the session response buffer. Fails when the response is
+ *	not complete within the session command timeout, or when the session
+ *	was cancelled.
+ *---------------------------------------------------------------------------
+ */
+static BOOLEAN OPR_SendPacket(struct UUT_SESSION *session, const UINT8 *cmd,
+			      UINT32 cmdSize, UINT32 respSize)
+{
+	if (session->cancel)
+		return FALSE;
+
+	if (ComPortWriteBin(session->portHandle, cmd, cmdSize) != TRUE) {
+		displayColorMsg(FAIL, "ERROR: Failed to send Command\n");
+		return FALSE;
+	}
+	session->txBytes += cmdSize;
+
+	/* No answer expected, e.g. set device high rate */
+	if (respSize == 0)
+		return TRUE;
+
+	return OPR_ReadResp(session, respSize);
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_WaitResp
+ *
+ * Parameters:	session  - session to use.
+ *		respSize - expected response size.
+ * Returns:	1 if successful, 0 in the case of an error.
+ * Side effects:
+ * Description:
+ *	Wait for a complete response to be received. Fails when the response
+ *	is not complete within the session command timeout.
+ *---------------------------------------------------------------------------
+ */
+static BOOLEAN OPR_WaitResp(struct UUT_SESSION *session, UINT32 respSize)
+{
+	UINT32			nRead;
+	unsigned long long	end;
+	unsigned long long	now;
+
+	end = getTimeUs() + (session->cmdTimeout * 1000ULL);
+
+	do {
+		now = getTimeUs();
+		nRead = (now < end) ?
+			ComPortWaitForReadTimeout(session->portHandle,
+					(UINT32)((end - now) / 1000) + 1) : 0;
+	} while ((nRead < respSize) && (getTimeUs() < end));
+
+	/* A partial answer is left for the caller to drain */
+	if (nRead < respSize) {
+		displayColorMsg(FAIL,
+	"ERROR: [%d] bytes received for read, [%d] bytes are expected\n",
+				nRead, respSize);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_ReadResp
+ *
+ * Parameters:	session  - session to use.
+ *		respSize - expected response size.
+ * Returns:	1 if successful, 0 in the case of an error.
+ * Side effects:
+ * Description:
+ *	Wait for a complete response, which is read into the session
+ *	response buffer, see OPR_WaitResp.
+ *---------------------------------------------------------------------------
+ */
+static BOOLEAN OPR_ReadResp(struct UUT_SESSION *session, UINT32 respSize)
+{
+	if (!OPR_WaitResp(session, respSize))
+		return FALSE;
+
+	ComPortReadBin(session->portHandle, session->respBuf, respSize);
+	session->rxBytes += respSize;
+
+	return TRUE;
+}
+
+/*----------------------------------------------------------------------------
+ * Function:	OPR_ReadRespData
+ *
+ * Parameters:	session  - session to use.
+ *		data     - buffer receiving the response data.
+ *		dataSize - expected data size.
+ * Returns:	1 if successful, 0 in the case of an error.
+ * Side effects:
+ * Description:
+ *	Wait for a complete READ response, and read its data straight into
+ *	the given buffer. The opcode and CRC around it go to the session
+ *	response buffer, at respBuf[0] and respBuf[1..2].
+ *---------------------------------------------------------------------------
+ */
+static BOOLEAN OPR_ReadRespData(struct UUT_SESSION *session, UINT8 *data,
+				UINT32 dataSize)
+{
+	struct COMP_IOV	iov[3];
+	UINT32		nRead;
+
+	if (!OPR_WaitResp(session, dataSize + 3))
+		return FALSE;
+
+	iov[0].Buffer  = session->respBuf;
+	iov[0].BufSize = 1;
+	iov[1].Buffer  = data;
+	iov[1].BufSize = dataSize;
+	iov[2].Buffer  = session->respBuf + 1;
+	iov[2].BufSize = 2;
+
+	nRead = ComPortReadScatter(session->portHandle, iov, 3);
+	session->rxBytes += nRead;
+
+	if ((nRead != dataSize + 3) ||
+	    (session->respBuf[0] != (UINT8)UFPP_READ_CMD)) {
+		displayColorMsg(FAIL, "ERROR: Invalid read response\n");
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 #ifdef __WATCOMC__
 /*----------------------------------------------------------------------------
  * Function:	OPR_SendCmds    (DOS version)
  *
- * Parameters:	cmdBuf - Pointer to a Command Buffer.
+ * Parameters:	session - session to use.
+ *		cmdBuf - Pointer to a Command Buffer.
  *		cmdNum - Number of commands to send.
  * Returns:	1 if successful, 0 in the case of an error.
  * Side effects:
@@ -881,8 +2291,8 @@ BOOLEAN OPR_ScanBaudRate(void)
  *	was recieved.
  *---------------------------------------------------------------------------
  */
-static BOOLEAN OPR_SendCmds(struct ComandNode *cmdBuf, UINT32        cmdNum
-)
+static BOOLEAN OPR_SendCmds(struct UUT_SESSION *session,
+			    struct ComandNode *cmdBuf, UINT32 cmdNum)
 {
 	struct ComandNode	*curCmd = cmdBuf;
 	UINT32		nCmd;
@@ -893,14 +2303,14 @@ static BOOLEAN OPR_SendCmds(struct ComandNode *cmdBuf, UINT32        cmdNum
 
 	for (nCmd = 0; nCmd < cmdNum; nCmd++, curCmd++) {
 		bytesRead = 0;
-		if (ComPortWriteBin(portHandle, curCmd->cmd, curCmd->cmdSize)
+		if (ComPortWriteBin(session->portHandle, curCmd->cmd, curCmd->cmdSize)
 								== TRUE) {
 			time(&start);
 
 			/* Yarkon Z1 BYPASS */
 			if (chipNum == Yarkon) {
 				do {
-					nRead = ComPortWaitForRead(portHandle);
+					nRead = ComPortWaitForRead(session->portHandle);
 					elapsed_time = difftime(time(NULL),
 								start);
 					/*
@@ -909,20 +2319,20 @@ static BOOLEAN OPR_SendCmds(struct ComandNode *cmdBuf, UINT32        cmdNum
 					 * planned, therefore we read whatever
 					 * is available:
 					 */
-					bytesRead += ComPortReadBin(portHandle,
-							    respBuf+bytesRead,
+					bytesRead += ComPortReadBin(session->portHandle,
+							    session->respBuf+bytesRead,
 							    MAX_RESP_BUF_SIZE);
 				} while ((bytesRead < curCmd->respSize) &&
 					 (elapsed_time <= OPR_TIMEOUT));
 			} else {
 				do {
-					nRead = ComPortWaitForRead(portHandle);
+					nRead = ComPortWaitForRead(session->portHandle);
 					elapsed_time = difftime(time(NULL),
 								start);
 				} while ((nRead == 0) &&
 					 (elapsed_time <= OPR_TIMEOUT));
-				ComPortReadBin(portHandle,
-					       respBuf,
+				ComPortReadBin(session->portHandle,
+					       session->respBuf,
 					       curCmd->respSize);
 			}
 
@@ -947,46 +2357,28 @@ static BOOLEAN OPR_SendCmds(struct ComandNode *cmdBuf, UINT32        cmdNum
 /*----------------------------------------------------------------------------
  * Function:	OPR_SendCmds  (Windows version)
  *
- * Parameters:	cmdBuf - Pointer to a Command Buffer.
+ * Parameters:	session - session to use.
+ *		cmdBuf - Pointer to a Command Buffer.
  *		cmdNum - Number of commands to send.
  * Returns:	1 if successful, 0 in the case of an error.
  * Side effects:
  * Description:
  *	Send a group of commands through COM port.
  *	A command is sent only after a valid response for the previous command
- *	was recieved.
+ *	was recieved. Fails when a response is not complete within the session
+ *	command timeout.
  *---------------------------------------------------------------------------
  */
-static BOOLEAN OPR_SendCmds(struct ComandNode *cmdBuf, UINT32  cmdNum)
+static BOOLEAN OPR_SendCmds(struct UUT_SESSION *session,
+			    struct ComandNode *cmdBuf, UINT32 cmdNum)
 {
 	struct ComandNode	*curCmd = cmdBuf;
 	UINT32		nCmd;
-	UINT32		nRead;
-	time_t		start;
-	FP64		elapsed_time;
 
 	for (nCmd = 0; nCmd < cmdNum; nCmd++, curCmd++) {
-		if (ComPortWriteBin(PortHandle, curCmd->cmd,
-						curCmd->cmdSize) == TRUE) {
-			time(&start);
-
-			do {
-				nRead = ComPortWaitForRead(PortHandle);
-				elapsed_time = difftime(time(NULL), start);
-			} while ((nRead < curCmd->respSize) &&
-				 (elapsed_time <= FLASH_ERASE_TIMEOUT));
-			ComPortReadBin(PortHandle, RespBuf, curCmd->respSize);
-
-			if (elapsed_time > FLASH_ERASE_TIMEOUT)
-				displayColorMsg(FAIL,
-	"ERROR: [%d] bytes received for read, [%d] bytes are expected\n",
-						nRead, curCmd->respSize);
-		} else {
-			displayColorMsg(FAIL,
-				"ERROR: Failed to send Command number %d\n",
-					nCmd);
+		if (OPR_SendPacket(session, curCmd->cmd, curCmd->cmdSize,
+				   curCmd->respSize) != TRUE)
 			return FALSE;
-		}
 	}
 
 	return TRUE;
@@ -0,0 +1,142 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   pktstream.c
+ *	This file implements the shared packet stream.
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "uut_types.h"
+#include "ComPort.h"
+#include "session.h"
+#include "cmd.h"
+#include "pktstream.h"
+
+/*---------------------------------------------------------------------------
+ * Local variables
+ *---------------------------------------------------------------------------
+ */
+static pthread_mutex_t PktStreamLock = PTHREAD_MUTEX_INITIALIZER;
+
+/*---------------------------------------------------------------------------
+ * Functions implementation
+ *---------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------------
+ * Function:	PKT_StreamCreate
+ *
+ * Parameters:	session - session whose CRC type is used.
+ *		addr    - image start address.
+ *		image   - image data, not referenced after the call.
+ *		size    - image size.
+ * Returns:	The stream holding one reference, NULL when out of memory.
+ * Side effects:
+ * Description:
+ *	Encode the image into PKT_MAX_PAYLOAD bytes WRITE commands, stored
+ *	back to back in a single buffer.
+ *---------------------------------------------------------------------------
+ */
+struct PKT_STREAM *PKT_StreamCreate(const struct UUT_SESSION *session,
+				    UINT32 addr, const UINT8 *image,
+				    UINT32 size)
+{
+	struct PKT_STREAM	*stream;
+	UINT32			numPackets;
+	UINT32			offset = 0;
+	UINT32			cmdSize;
+	UINT32			writeSize;
+	UINT32			i;
+
+	numPackets = (size + PKT_MAX_PAYLOAD - 1) / PKT_MAX_PAYLOAD;
+
+	stream = (struct PKT_STREAM *)calloc(1, sizeof(*stream));
+	if (stream == NULL)
+		return NULL;
+
+	stream->data    = (UINT8 *)malloc(size +
+				(numPackets * PKT_WRITE_OVERHEAD));
+	stream->offsets = (UINT32 *)malloc((numPackets + 1) *
+					   sizeof(*stream->offsets));
+	if ((stream->data == NULL) || (stream->offsets == NULL)) {
+		free(stream->data);
+		free(stream->offsets);
+		free(stream);
+		return NULL;
+	}
+
+	for (i = 0; i < numPackets; i++) {
+		writeSize = MIN(PKT_MAX_PAYLOAD, size - (i * PKT_MAX_PAYLOAD));
+
+		stream->offsets[i] = offset;
+		CMD_CreateWrite(session, addr + (i * PKT_MAX_PAYLOAD),
+				writeSize, image + (i * PKT_MAX_PAYLOAD),
+				stream->data + offset, &cmdSize);
+		offset += cmdSize;
+	}
+	stream->offsets[numPackets] = offset;
+
+	stream->numPackets = numPackets;
+	stream->addr       = addr;
+	stream->size       = size;
+	stream->crcType    = session->crcType;
+	stream->refCount   = 1;
+
+	return stream;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	PKT_StreamGet
+ *
+ * Parameters:	stream - packet stream.
+ * Returns:	stream, with one more reference.
+ * Side effects:
+ * Description:
+ *	Take a reference, e.g. for each thread sending the stream.
+ *---------------------------------------------------------------------------
+ */
+struct PKT_STREAM *PKT_StreamGet(struct PKT_STREAM *stream)
+{
+	pthread_mutex_lock(&PktStreamLock);
+	stream->refCount++;
+	pthread_mutex_unlock(&PktStreamLock);
+
+	return stream;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	PKT_StreamPut
+ *
+ * Parameters:	stream - packet stream.
+ * Returns:	none
+ * Side effects: Frees the stream with its last reference.
+ * Description:
+ *	Drop a reference taken by PKT_StreamCreate or PKT_StreamGet.
+ *---------------------------------------------------------------------------
+ */
+void PKT_StreamPut(struct PKT_STREAM *stream)
+{
+	UINT32 refCount;
+
+	pthread_mutex_lock(&PktStreamLock);
+	refCount = --stream->refCount;
+	pthread_mutex_unlock(&PktStreamLock);
+
+	if (refCount != 0)
+		return;
+
+	free(stream->data);
+	free(stream->offsets);
+	free(stream);
+}
@@ -16,6 +16,7 @@
 #include <string.h>
 #ifndef WIN32
 #include <stdarg.h>
+#include <time.h>
 #endif
 
 #include "uut_types.h"
@@ -30,11 +31,8 @@
  */
 UINT32					BaudRate;
 char					PortName[MAX_PARAM_SIZE];
-struct COMPORT_FIELDS	PortCfg;
 BOOLEAN					Verbose;
-BOOLEAN					Console;
 UINT32					DevPortNum;
-UINT32					crc_type;
 
 /*----------------------------------------------------------------------------
  * Functions implementation
@@ -123,4 +121,31 @@ void displayMsg(char *fmt, ...)
 	}
 }
 
+/*---------------------------------------------------------------------------
+ * Function:	getTimeUs
+ *
+ * Parameters:	none
+ * Returns:	Monotonic time in micro-seconds.
+ * Side effects:
+ * Description:
+ *		The clock of all the timeouts, deadlines and durations.
+ *---------------------------------------------------------------------------
+ */
+unsigned long long getTimeUs(void)
+{
+#ifdef WIN32
+	LARGE_INTEGER freq;
+	LARGE_INTEGER count;
+
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (unsigned long long)((count.QuadPart * 1000000) / freq.QuadPart);
+#else
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((unsigned long long)ts.tv_sec * 1000000) + (ts.tv_nsec / 1000);
+#endif
+}
+
 
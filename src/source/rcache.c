@@ -0,0 +1,266 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   rcache.c
+ *	This file implements the read cache of a session.
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "uut_types.h"
+#include "ComPort.h"
+#include "program.h"
+#include "opr.h"
+#include "cmd.h"
+#include "session.h"
+#include "lib_uut.h"
+#include "rcache.h"
+
+/*---------------------------------------------------------------------------
+ * Functions prototypes
+ *---------------------------------------------------------------------------
+ */
+static struct RCACHE_PAGE *RCACHE_Slot(const struct RCACHE *cache,
+				       UINT32 base);
+static BOOLEAN	RCACHE_Hit(const struct RCACHE *cache,
+			   const struct RCACHE_PAGE *page, UINT32 base,
+			   unsigned long long now);
+
+/*---------------------------------------------------------------------------
+ * Functions implementation
+ *---------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------------
+ * Function:	RCACHE_Enable
+ *
+ * Parameters:	session  - session to cache the reads of.
+ *		size     - cache size in bytes, 0 to read through.
+ *		maxAgeMs - longest time a page is served, 0 for no limit.
+ * Returns:	EC_OK, or the EXIT_CODE of the allocation.
+ * Side effects: Drops the cache in use.
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+UINT32 RCACHE_Enable(struct UUT_SESSION *session, UINT32 size,
+		     UINT32 maxAgeMs)
+{
+	struct RCACHE	*cache;
+
+	if (size > RCACHE_MAX_SIZE)
+		return EC_SIZE_ERR;
+
+	RCACHE_Free(session);
+
+	if (size == 0)
+		return EC_OK;
+
+	cache = (struct RCACHE *)malloc(sizeof(*cache));
+	if (cache == NULL)
+		return EC_SIZE_ERR;
+
+	cache->numPages = (size + RCACHE_PAGE_SIZE - 1) / RCACHE_PAGE_SIZE;
+	cache->maxAgeMs = maxAgeMs;
+	cache->pages    = (struct RCACHE_PAGE *)
+			  calloc(cache->numPages, sizeof(*cache->pages));
+	if (cache->pages == NULL) {
+		free(cache);
+		return EC_SIZE_ERR;
+	}
+
+	session->rcache = cache;
+
+	return EC_OK;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	RCACHE_Read
+ *
+ * Parameters:	session - session to use.
+ *		addr    - Memory address to read from.
+ *		buff    - data buffer that was read.
+ *		size    - Data size to read.
+ * Returns:	EC_OK, or the EXIT_CODE of the device read.
+ * Side effects: Replaces the pages mapped to the same slots.
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+UINT32 RCACHE_Read(struct UUT_SESSION *session, UINT32 addr, UINT8 *buff,
+		   UINT32 size)
+{
+	struct RCACHE		*cache = session->rcache;
+	struct RCACHE_PAGE	*page;
+	struct UUT_IOVEC	*vec;
+	unsigned long long	now;
+	UINT32			first = addr - (addr % RCACHE_PAGE_SIZE);
+	UINT32			numSpan;
+	UINT32			count = 0;
+	UINT32			base;
+	UINT32			offset;
+	UINT32			n;
+	UINT32			i;
+	UINT32			ec;
+
+	if ((cache == NULL) || (size == 0) ||
+	    (size > cache->numPages * RCACHE_PAGE_SIZE) ||
+	    (addr + size < addr))
+		return OPR_ReadBuf(session, addr, buff, size);
+
+	/* The pages spanned map to distinct slots when they all fit */
+	numSpan = ((addr % RCACHE_PAGE_SIZE) + size + RCACHE_PAGE_SIZE - 1) /
+		  RCACHE_PAGE_SIZE;
+	if (numSpan > cache->numPages)
+		return OPR_ReadBuf(session, addr, buff, size);
+
+	vec = (struct UUT_IOVEC *)malloc(numSpan * sizeof(*vec));
+	if (vec == NULL)
+		return EC_SIZE_ERR;
+
+	/* Read the missing pages whole, in one transfer */
+	now = getTimeUs();
+	for (i = 0, base = first; i < numSpan; i++, base += RCACHE_PAGE_SIZE) {
+		page = RCACHE_Slot(cache, base);
+		if (RCACHE_Hit(cache, page, base, now))
+			continue;
+
+		page->addr  = base;
+		page->valid = FALSE;
+
+		vec[count].addr = base;
+		vec[count].buf  = page->data;
+		vec[count].len  = RCACHE_PAGE_SIZE;
+		count++;
+	}
+
+	if (count > 0) {
+		ec = OPR_ReadVec(session, vec, count);
+		if (ec != EC_OK) {
+			free(vec);
+			return ec;
+		}
+
+		for (i = 0; i < count; i++) {
+			page = RCACHE_Slot(cache, vec[i].addr);
+			page->valid   = TRUE;
+			page->fetchUs = now;
+		}
+	}
+
+	free(vec);
+
+	for (i = 0, base = first; i < numSpan; i++, base += RCACHE_PAGE_SIZE) {
+		page   = RCACHE_Slot(cache, base);
+		offset = (base < addr) ? (addr - base) : 0;
+		n      = MIN(RCACHE_PAGE_SIZE - offset, size);
+
+		memcpy(buff, page->data + offset, n);
+		buff += n;
+		size -= n;
+	}
+
+	return EC_OK;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	RCACHE_Invalidate
+ *
+ * Parameters:	session - session to use.
+ *		addr    - first address of the range.
+ *		size    - range size, 0 for all the memory.
+ * Returns:	none
+ * Side effects:
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+void RCACHE_Invalidate(struct UUT_SESSION *session, UINT32 addr, UINT32 size)
+{
+	struct RCACHE		*cache = session->rcache;
+	struct RCACHE_PAGE	*page;
+	unsigned long long	end = (unsigned long long)addr + size;
+	unsigned long long	base;
+	UINT32			i;
+
+	if (cache == NULL)
+		return;
+
+	/* A large range hits every slot, drop them all */
+	if ((size == 0) ||
+	    (size / RCACHE_PAGE_SIZE >= cache->numPages)) {
+		for (i = 0; i < cache->numPages; i++)
+			cache->pages[i].valid = FALSE;
+		return;
+	}
+
+	for (base = addr - (addr % RCACHE_PAGE_SIZE); base < end;
+	     base += RCACHE_PAGE_SIZE) {
+		page = RCACHE_Slot(cache, (UINT32)base);
+		if (page->addr == (UINT32)base)
+			page->valid = FALSE;
+	}
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	RCACHE_Free
+ *
+ * Parameters:	session - session whose cache is dropped.
+ * Returns:	none
+ * Side effects:
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+void RCACHE_Free(struct UUT_SESSION *session)
+{
+	if (session->rcache == NULL)
+		return;
+
+	free(session->rcache->pages);
+	free(session->rcache);
+	session->rcache = NULL;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	RCACHE_Slot
+ *
+ * Parameters:	cache - session read cache.
+ *		base  - page aligned memory address.
+ * Returns:	The only slot which may hold the page.
+ *---------------------------------------------------------------------------
+ */
+static struct RCACHE_PAGE *RCACHE_Slot(const struct RCACHE *cache,
+				       UINT32 base)
+{
+	return &cache->pages[(base / RCACHE_PAGE_SIZE) % cache->numPages];
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	RCACHE_Hit
+ *
+ * Parameters:	cache - session read cache.
+ *		page  - slot of the page.
+ *		base  - page aligned memory address.
+ *		now   - current time.
+ * Returns:	TRUE if the slot holds the page, read recently enough.
+ *---------------------------------------------------------------------------
+ */
+static BOOLEAN RCACHE_Hit(const struct RCACHE *cache,
+			  const struct RCACHE_PAGE *page, UINT32 base,
+			  unsigned long long now)
+{
+	if (!page->valid || (page->addr != base))
+		return FALSE;
+
+	if ((cache->maxAgeMs != 0) &&
+	    (now - page->fetchUs > cache->maxAgeMs * 1000ULL))
+		return FALSE;
+
+	return TRUE;
+}
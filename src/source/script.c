@@ -0,0 +1,310 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   script.c
+ *	This file implements the batch script operations.
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "uut_types.h"
+#include "ComPort.h"
+#include "program.h"
+#include "opr.h"
+#include "session.h"
+#include "script.h"
+
+/*----------------------------------------------------------------------------
+ * Constant definitions
+ *---------------------------------------------------------------------------
+ */
+#define SCRIPT_SEPS		" \t\r\n"
+
+/*----------------------------------------------------------------------------
+ * Internal types
+ *---------------------------------------------------------------------------
+ */
+struct SCRIPT_PARAMS {
+	char	*opr;
+	char	*file;
+	char	*addr;
+	char	*size;
+	char	*baudrate;
+};
+
+/*---------------------------------------------------------------------------
+ * Functions prototypes
+ *---------------------------------------------------------------------------
+ */
+static BOOLEAN	SCRIPT_ParseLine(char *line, struct SCRIPT_PARAMS *params);
+static UINT32	SCRIPT_GetNum(const char *str);
+static UINT32	SCRIPT_GetFileSize(const char *fileName);
+static UINT32	SCRIPT_SetHighRate(struct UUT_SESSION *session,
+				   const char *baudrate);
+
+/*---------------------------------------------------------------------------
+ * Functions implementation
+ *---------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------------
+ * Function:	SCRIPT_ParseLine
+ *
+ * Parameters:	line   - script line, altered by the parsing.
+ *		params - the operation and its parameters, NULL when missing.
+ * Returns:	FALSE for an unknown or incomplete parameter.
+ * Side effects:
+ * Description:
+ *	Split a script line into the operation name and its parameters.
+ *---------------------------------------------------------------------------
+ */
+static BOOLEAN SCRIPT_ParseLine(char *line, struct SCRIPT_PARAMS *params)
+{
+	char	*comment;
+	char	*token;
+	char	*save = NULL;
+	char	**value;
+
+	memset(params, 0, sizeof(*params));
+
+	comment = strchr(line, SCRIPT_COMMENT_CHAR);
+	if (comment != NULL)
+		*comment = '\0';
+
+	/* Farm workers parse their scripts at once, strtok is not reentrant */
+	params->opr = strtok_r(line, SCRIPT_SEPS, &save);
+	if (params->opr == NULL)
+		return TRUE;
+
+	for (token = strtok_r(NULL, SCRIPT_SEPS, &save);
+	     token != NULL;
+	     token = strtok_r(NULL, SCRIPT_SEPS, &save)) {
+		if (strcmp(token, "-file") == 0)
+			value = &params->file;
+		else if (strcmp(token, "-addr") == 0)
+			value = &params->addr;
+		else if (strcmp(token, "-size") == 0)
+			value = &params->size;
+		else if (strcmp(token, "-baudrate") == 0)
+			value = &params->baudrate;
+		else {
+			displayColorMsg(FAIL,
+				"ERROR: Parameter '%s' is not supported\n",
+				token);
+			return FALSE;
+		}
+
+		*value = strtok_r(NULL, SCRIPT_SEPS, &save);
+		if (*value == NULL) {
+			displayColorMsg(FAIL,
+				"ERROR: Parameter '%s' has no value\n", token);
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	SCRIPT_GetNum
+ *
+ * Parameters:	str - decimal or hexadecimal ("0x"/"x" prefix) number.
+ * Returns:	The number value.
+ *---------------------------------------------------------------------------
+ */
+static UINT32 SCRIPT_GetNum(const char *str)
+{
+	char *stopStr;
+
+	return strtoul(str, &stopStr, GET_BASE(str));
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	SCRIPT_GetFileSize
+ *
+ * Parameters:	fileName - file name.
+ * Returns:	The file size, 0 if the file could not be opened.
+ *---------------------------------------------------------------------------
+ */
+static UINT32 SCRIPT_GetFileSize(const char *fileName)
+{
+	FILE	*fileID;
+	UINT32	size;
+
+	fileID = fopen(fileName, "rb");
+	if (fileID == NULL) {
+		displayColorMsg(FAIL,
+			"ERROR: could not open input file [%s]\n", fileName);
+		return 0;
+	}
+
+	fseek(fileID, 0, SEEK_END);
+	size = (UINT32)ftell(fileID);
+	fclose(fileID);
+
+	return size;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	SCRIPT_SetHighRate
+ *
+ * Parameters:	session  - session to use.
+ *		baudrate - the device high baud rate, NULL to keep the host
+ *			   baud rate.
+ * Returns:	EC_OK on success, otherwise the EXIT_CODE of the failure.
+ * Side effects: The host port follows the device to the new baud rate.
+ * Description:
+ *	Switch the device port to its high baud rate, then move the host
+ *	port to the same rate and synchronize again, so that the following
+ *	lines run at the high rate.
+ *---------------------------------------------------------------------------
+ */
+static UINT32 SCRIPT_SetHighRate(struct UUT_SESSION *session,
+				 const char *baudrate)
+{
+	enum SYNC_RESULT sr;
+
+	if (OPR_SetDevicePortHighRate(session) != EC_OK)
+		return EC_SEND_CMD_ERR;
+
+	if (baudrate == NULL)
+		return EC_OK;
+
+	sr = OPR_CheckSync(session, SCRIPT_GetNum(baudrate));
+	if (sr != SR_OK) {
+		displayColorMsg(FAIL,
+			"Host/Device synchronization failed at %s, error = %u.\n",
+			baudrate, sr);
+		return EC_SYNC_ERR;
+	}
+
+	SESSION_MSG(session, ("Host/Device synchronized at %s\n", baudrate));
+
+	return EC_OK;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	SCRIPT_ExecLine
+ *
+ * Parameters:	session - session to use.
+ *		line    - a single script line.
+ * Returns:	EC_OK on success, otherwise the EXIT_CODE of the failure.
+ * Side effects:
+ * Description:
+ *	Parse and run one script operation.
+ *---------------------------------------------------------------------------
+ */
+UINT32 SCRIPT_ExecLine(struct UUT_SESSION *session, char *line)
+{
+	struct SCRIPT_PARAMS	params;
+	UINT32			addr;
+	UINT32			size;
+
+	if (!SCRIPT_ParseLine(line, &params))
+		return EC_UNSUPPORTED_CMD_ERR;
+
+	if (params.opr == NULL)
+		return EC_OK;
+
+	if (strcmp(params.opr, OPR_SET_HRATE) == 0)
+		return SCRIPT_SetHighRate(session, params.baudrate);
+
+	if (params.addr == NULL) {
+		displayColorMsg(FAIL, "ERROR: %s requires -addr\n", params.opr);
+		return EC_UNSUPPORTED_CMD_ERR;
+	}
+	addr = SCRIPT_GetNum(params.addr);
+
+	if (strcmp(params.opr, OPR_EXECUTE_CONT) == 0)
+		return OPR_ExecuteReturn(session, addr) ? EC_OK : EC_SEND_CMD_ERR;
+
+	if (strcmp(params.opr, OPR_EXECUTE_EXIT) == 0)
+		return OPR_ExecuteExit(session, addr) ? EC_OK : EC_SEND_CMD_ERR;
+
+	if (params.file == NULL) {
+		displayColorMsg(FAIL, "ERROR: %s requires -file\n", params.opr);
+		return EC_FILE_ERR;
+	}
+
+	if (params.size != NULL)
+		size = SCRIPT_GetNum(params.size);
+	else if (strcmp(params.opr, OPR_READ_MEM) != 0)
+		size = SCRIPT_GetFileSize(params.file);
+	else
+		size = 0;
+
+	if (size == 0) {
+		displayColorMsg(FAIL, "ERROR: %s requires a non-zero size\n",
+				params.opr);
+		return EC_SIZE_ERR;
+	}
+
+	if (strcmp(params.opr, OPR_WRITE_MEM) == 0)
+		return OPR_WriteMem(session, params.file, addr, size) ?
+			EC_OK : EC_SEND_CMD_ERR;
+
+	if (strcmp(params.opr, OPR_READ_MEM) == 0)
+		return OPR_ReadMem(session, params.file, addr, size) ?
+			EC_OK : EC_SEND_CMD_ERR;
+
+	if (strcmp(params.opr, OPR_VERIFY_MEM) == 0)
+		return OPR_VerifyMem(session, params.file, addr, size) ?
+			EC_OK : EC_VERIFY_ERR;
+
+	displayColorMsg(FAIL, "ERROR: Operation %s not supported in scripts\n",
+			params.opr);
+
+	return EC_UNSUPPORTED_CMD_ERR;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	SCRIPT_RunFile
+ *
+ * Parameters:	session  - session to use.
+ *		fileName - script file, one operation per line.
+ * Returns:	EC_OK if all the lines succeeded, otherwise the EXIT_CODE of
+ *		the first failing line.
+ * Side effects:
+ * Description:
+ *	Run the script lines in order, stopping at the first failure.
+ *---------------------------------------------------------------------------
+ */
+UINT32 SCRIPT_RunFile(struct UUT_SESSION *session, const char *fileName)
+{
+	FILE	*scriptID;
+	char	line[MAX_SCRIPT_LINE_SIZE];
+	UINT32	lineNum = 0;
+	UINT32	ret_val = EC_OK;
+
+	scriptID = fopen(fileName, "r");
+	if (scriptID == NULL) {
+		displayColorMsg(FAIL,
+			"ERROR: could not open script file [%s]\n", fileName);
+		return EC_FILE_ERR;
+	}
+
+	while (fgets(line, sizeof(line), scriptID) != NULL) {
+		lineNum++;
+
+		ret_val = SCRIPT_ExecLine(session, line);
+		if (ret_val != EC_OK) {
+			displayColorMsg(FAIL,
+				"ERROR: %s line %u failed, error = %u\n",
+				fileName, lineNum, ret_val);
+			break;
+		}
+	}
+
+	fclose(scriptID);
+
+	return ret_val;
+}
@@ -0,0 +1,50 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   session.c
+ *	This file implements the session setup.
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "uut_types.h"
+#include "session.h"
+#include "opr.h"
+
+/*---------------------------------------------------------------------------
+ * Function:	SESSION_Init
+ *
+ * Parameters:	session  - session to initialize.
+ *		baudRate - host baud rate.
+ * Returns:	none
+ * Side effects:
+ * Description:
+ *	Set the session defaults: no port opened, 8N1 at baudRate, CRC16,
+ *	file mode, verbose messages, no packet retries and no pipelining.
+ *---------------------------------------------------------------------------
+ */
+void SESSION_Init(struct UUT_SESSION *session, UINT32 baudRate)
+{
+	memset(session, 0, sizeof(*session));
+
+	session->portHandle		= INVALID_HANDLE_VALUE;
+	session->portCfg.BaudRate	= MAX(baudRate, BR_LOW_LIMIT);
+	session->portCfg.ByteSize	= 8;
+	session->portCfg.FlowControl	= 0;
+	session->portCfg.Parity		= 0;
+	session->portCfg.StopBits	= 0;
+	session->crcType		= DEFAULT_CRC_TYPE;
+	session->console		= FALSE;
+	session->verbose		= TRUE;
+	session->cmdTimeout		= DEFAULT_CMD_TIMEOUT;
+	session->maxRetries		= DEFAULT_MAX_RETRIES;
+	session->pipeDepth		= DEFAULT_PIPE_DEPTH;
+}
@@ -0,0 +1,722 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   uring.c
+ *	This file implements the io_uring multi-board engine.
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+#include "uut_types.h"
+#include "ComPort.h"
+#include "program.h"
+#include "opr.h"
+#include "cmd.h"
+#include "session.h"
+#include "pktstream.h"
+#include "multi.h"
+#include "uring.h"
+
+/*----------------------------------------------------------------------------
+ * Constant definitions
+ *---------------------------------------------------------------------------
+ */
+/* Completion user data: board index and operation */
+#define URING_OP_WRITE		1
+#define URING_OP_READ		2
+#define URING_OP_TIMEOUT	3
+#define URING_DATA(index, op)	(((__u64)(index) << 8) | (op))
+#define URING_INDEX(data)	((UINT32)((data) >> 8))
+#define URING_OP(data)		((UINT32)((data) & 0xFF))
+
+/*----------------------------------------------------------------------------
+ * Internal types
+ *---------------------------------------------------------------------------
+ */
+enum URING_STATE {
+	US_SYNC = 0,	/* SYNC sent, waiting for its answer */
+	US_DRAIN,	/* Discarding input until the line is quiet */
+	US_WRITE,	/* WRITE packet sent, waiting for its acknowledge */
+	US_READ,	/* READ command sent, waiting for the data */
+	US_DONE
+};
+
+struct URING_BOARD {
+	struct MULTI_BOARD	*board;
+	enum URING_STATE	state;
+	UINT32			pending;	/* Completions still to come */
+	INT32			writeRes;
+	INT32			readRes;
+	const UINT8		*cmd;		/* Command in flight, if any */
+	UINT32			cmdSize;
+	UINT32			respSize;
+	UINT32			rxLen;		/* Response bytes received */
+	UINT8			drain[URING_DRAIN_SIZE];
+	struct __kernel_timespec deadline;	/* Of the read in flight */
+	unsigned long long	startUs;
+	unsigned long long	sentUs;
+	unsigned long long	endUs;		/* Sync or drain deadline */
+	UINT32			quietMs;	/* Drain: silence ending it */
+	UINT32			timeout;	/* ms, SYNC answer wait */
+	UINT32			trials;		/* SYNC commands sent */
+	UINT32			wrong;		/* Garbled SYNC answers */
+	UINT32			packet;		/* WRITE packet or READ chunk */
+	UINT32			trial;		/* Resends of the packet */
+};
+
+struct URING_RING {
+	int			fd;
+	void			*sqRing;
+	size_t			sqRingSize;
+	void			*cqRing;
+	size_t			cqRingSize;
+	struct io_uring_sqe	*sqes;
+	size_t			sqesSize;
+
+	/* Submission queue, this thread is the only producer */
+	unsigned		*sqTail;
+	unsigned		*sqArray;
+	unsigned		sqMask;
+	unsigned		sqLocalTail;
+	unsigned		toSubmit;
+
+	/* Completion queue, this thread is the only consumer */
+	unsigned		*cqHead;
+	unsigned		*cqTail;
+	unsigned		cqMask;
+	struct io_uring_cqe	*cqes;
+};
+
+/*---------------------------------------------------------------------------
+ * Functions prototypes
+ *---------------------------------------------------------------------------
+ */
+static BOOLEAN	URING_Setup(struct URING_RING *ring, UINT32 entries);
+static void	URING_Teardown(struct URING_RING *ring);
+static struct io_uring_sqe *URING_GetSqe(struct URING_RING *ring);
+static void	URING_SetDeadline(struct URING_BOARD *ub, unsigned long long us);
+static void	URING_QueueRead(struct URING_RING *ring, struct URING_BOARD *ub,
+				UINT32 index);
+static void	URING_Send(struct URING_RING *ring, struct URING_BOARD *ub,
+			   UINT32 index, const UINT8 *cmd, UINT32 cmdSize,
+			   UINT32 respSize, UINT32 timeoutMs);
+static void	URING_SendSync(struct URING_RING *ring, struct URING_BOARD *ub,
+			       UINT32 index);
+static void	URING_Drain(struct URING_RING *ring, struct URING_BOARD *ub,
+			    UINT32 index, UINT32 quietMs);
+static void	URING_Next(struct URING_RING *ring, struct URING_BOARD *ub,
+			   UINT32 index);
+static void	URING_Finish(struct URING_BOARD *ub, UINT32 result);
+static void	URING_Complete(struct URING_RING *ring, struct URING_BOARD *ub,
+			       UINT32 index);
+
+/*---------------------------------------------------------------------------
+ * Functions implementation
+ *---------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------------
+ * Function:	URING_Setup
+ *
+ * Parameters:	ring    - ring to set up.
+ *		entries - submission queue size.
+ * Returns:	TRUE if successful, FALSE when io_uring is not available.
+ * Side effects:
+ * Description:
+ *	Create the ring and map its queues, through the raw system calls so
+ *	no library is needed.
+ *---------------------------------------------------------------------------
+ */
+static BOOLEAN URING_Setup(struct URING_RING *ring, UINT32 entries)
+{
+	struct io_uring_params	params;
+
+	memset(ring, 0, sizeof(*ring));
+	memset(&params, 0, sizeof(params));
+
+	ring->fd = (int)syscall(__NR_io_uring_setup, entries, &params);
+	if (ring->fd < 0)
+		return FALSE;
+
+	ring->sqRingSize = params.sq_off.array +
+			   (params.sq_entries * sizeof(unsigned));
+	ring->cqRingSize = params.cq_off.cqes +
+			   (params.cq_entries * sizeof(struct io_uring_cqe));
+	ring->sqesSize   = params.sq_entries * sizeof(struct io_uring_sqe);
+
+	/* Both rings may share a single mapping */
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->sqRingSize = MAX(ring->sqRingSize, ring->cqRingSize);
+		ring->cqRingSize = 0;
+	}
+
+	ring->sqRing = mmap(NULL, ring->sqRingSize, PROT_READ | PROT_WRITE,
+			    MAP_SHARED | MAP_POPULATE, ring->fd,
+			    IORING_OFF_SQ_RING);
+	ring->cqRing = (ring->cqRingSize == 0) ? ring->sqRing :
+		       mmap(NULL, ring->cqRingSize, PROT_READ | PROT_WRITE,
+			    MAP_SHARED | MAP_POPULATE, ring->fd,
+			    IORING_OFF_CQ_RING);
+	ring->sqes   = (struct io_uring_sqe *)
+		       mmap(NULL, ring->sqesSize, PROT_READ | PROT_WRITE,
+			    MAP_SHARED | MAP_POPULATE, ring->fd,
+			    IORING_OFF_SQES);
+
+	if ((ring->sqRing == MAP_FAILED) || (ring->cqRing == MAP_FAILED) ||
+	    ((void *)ring->sqes == MAP_FAILED)) {
+		URING_Teardown(ring);
+		return FALSE;
+	}
+
+	ring->sqTail      = (unsigned *)((char *)ring->sqRing +
+					 params.sq_off.tail);
+	ring->sqArray     = (unsigned *)((char *)ring->sqRing +
+					 params.sq_off.array);
+	ring->sqMask      = *(unsigned *)((char *)ring->sqRing +
+					  params.sq_off.ring_mask);
+	ring->sqLocalTail = *ring->sqTail;
+
+	ring->cqHead = (unsigned *)((char *)ring->cqRing + params.cq_off.head);
+	ring->cqTail = (unsigned *)((char *)ring->cqRing + params.cq_off.tail);
+	ring->cqMask = *(unsigned *)((char *)ring->cqRing +
+				     params.cq_off.ring_mask);
+	ring->cqes   = (struct io_uring_cqe *)((char *)ring->cqRing +
+					       params.cq_off.cqes);
+
+	return TRUE;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	URING_Teardown
+ *
+ * Parameters:	ring - ring to release.
+ * Returns:	none
+ * Side effects: Unmaps the queues and closes the ring.
+ *---------------------------------------------------------------------------
+ */
+static void URING_Teardown(struct URING_RING *ring)
+{
+	if ((ring->sqes != NULL) && ((void *)ring->sqes != MAP_FAILED))
+		munmap(ring->sqes, ring->sqesSize);
+	if ((ring->cqRingSize != 0) && (ring->cqRing != NULL) &&
+	    (ring->cqRing != MAP_FAILED))
+		munmap(ring->cqRing, ring->cqRingSize);
+	if ((ring->sqRing != NULL) && (ring->sqRing != MAP_FAILED))
+		munmap(ring->sqRing, ring->sqRingSize);
+
+	close(ring->fd);
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	URING_GetSqe
+ *
+ * Parameters:	ring - ring to use.
+ * Returns:	A cleared submission queue entry, queued for the next submit.
+ * Side effects:
+ * Description:
+ *	The queue holds URING_OPS_PER_BOARD entries per board and a board
+ *	never has more in flight, so an entry is always free.
+ *---------------------------------------------------------------------------
+ */
+static struct io_uring_sqe *URING_GetSqe(struct URING_RING *ring)
+{
+	unsigned		slot = ring->sqLocalTail & ring->sqMask;
+	struct io_uring_sqe	*sqe = &ring->sqes[slot];
+
+	memset(sqe, 0, sizeof(*sqe));
+	ring->sqArray[slot] = slot;
+	ring->sqLocalTail++;
+	ring->toSubmit++;
+
+	return sqe;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	URING_QueueRead
+ *
+ * Parameters:	ring  - ring to use.
+ *		ub    - board.
+ *		index - board index.
+ * Returns:	none
+ * Side effects:
+ * Description:
+ *	Queue the board command, if any, then a read of the rest of its
+ *	response (or of any input while draining) bounded by ub->deadline.
+ *---------------------------------------------------------------------------
+ */
+static void URING_QueueRead(struct URING_RING *ring, struct URING_BOARD *ub,
+			    UINT32 index)
+{
+	struct UUT_SESSION	*session = &ub->board->session;
+	struct io_uring_sqe	*sqe;
+
+	ub->writeRes = 0;
+	ub->readRes  = 0;
+
+	if (ub->cmd != NULL) {
+		sqe = URING_GetSqe(ring);
+		sqe->opcode    = IORING_OP_WRITE;
+		sqe->flags     = IOSQE_IO_LINK;
+		sqe->fd        = (int)session->portHandle;
+		sqe->addr      = (unsigned long)ub->cmd;
+		sqe->len       = ub->cmdSize;
+		sqe->off       = (__u64)-1;	/* Current position */
+		sqe->user_data = URING_DATA(index, URING_OP_WRITE);
+		ub->pending++;
+	}
+
+	sqe = URING_GetSqe(ring);
+	sqe->opcode    = IORING_OP_READ;
+	sqe->flags     = IOSQE_IO_LINK;
+	sqe->fd        = (int)session->portHandle;
+	sqe->off       = (__u64)-1;
+	sqe->user_data = URING_DATA(index, URING_OP_READ);
+	if (ub->state == US_DRAIN) {
+		sqe->addr = (unsigned long)ub->drain;
+		sqe->len  = sizeof(ub->drain);
+	} else {
+		sqe->addr = (unsigned long)(session->respBuf + ub->rxLen);
+		sqe->len  = ub->respSize - ub->rxLen;
+	}
+	ub->pending++;
+
+	sqe = URING_GetSqe(ring);
+	sqe->opcode        = IORING_OP_LINK_TIMEOUT;
+	sqe->addr          = (unsigned long)&ub->deadline;
+	sqe->len           = 1;
+	sqe->timeout_flags = IORING_TIMEOUT_ABS;
+	sqe->user_data     = URING_DATA(index, URING_OP_TIMEOUT);
+	ub->pending++;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	URING_SetDeadline
+ *
+ * Parameters:	ub - board.
+ *		us - monotonic time the read in flight gives up at.
+ * Returns:	none
+ *---------------------------------------------------------------------------
+ */
+static void URING_SetDeadline(struct URING_BOARD *ub, unsigned long long us)
+{
+	ub->deadline.tv_sec  = (long long)(us / 1000000);
+	ub->deadline.tv_nsec = (long long)((us % 1000000) * 1000);
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	URING_Send
+ *
+ * Parameters:	ring      - ring to use.
+ *		ub        - board.
+ *		index     - board index.
+ *		cmd       - command, kept until its completion.
+ *		cmdSize   - command size.
+ *		respSize  - expected response size.
+ *		timeoutMs - time to wait for the whole response.
+ * Returns:	none
+ *---------------------------------------------------------------------------
+ */
+static void URING_Send(struct URING_RING *ring, struct URING_BOARD *ub,
+		       UINT32 index, const UINT8 *cmd, UINT32 cmdSize,
+		       UINT32 respSize, UINT32 timeoutMs)
+{
+	ub->cmd      = cmd;
+	ub->cmdSize  = cmdSize;
+	ub->respSize = respSize;
+	ub->rxLen    = 0;
+	ub->sentUs   = getTimeUs();
+	URING_SetDeadline(ub, ub->sentUs + (timeoutMs * 1000ULL));
+
+	URING_QueueRead(ring, ub, index);
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	URING_SendSync
+ *
+ * Parameters:	ring  - ring to use.
+ *		ub    - board.
+ *		index - board index.
+ * Returns:	none
+ * Side effects:
+ * Description:
+ *	Send a SYNC command, waiting for its answer as OPR_CheckSync does:
+ *	the wait doubles from SYNC_BURST_TIMEOUT up to SYNC_MAX_TIMEOUT,
+ *	within SYNC_DEADLINE.
+ *---------------------------------------------------------------------------
+ */
+static void URING_SendSync(struct URING_RING *ring, struct URING_BOARD *ub,
+			   UINT32 index)
+{
+	struct UUT_SESSION	*session = &ub->board->session;
+	unsigned long long	now = getTimeUs();
+	UINT32			cmdSize;
+
+	ub->state = US_SYNC;
+	ub->trials++;
+
+	CMD_CreateSync(session->cmdBuf[0].cmd, &cmdSize);
+	URING_Send(ring, ub, index, session->cmdBuf[0].cmd, cmdSize, 1,
+		   (ub->endUs > now) ?
+		   (UINT32)MIN(ub->timeout, (ub->endUs - now + 999) / 1000) : 1);
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	URING_Drain
+ *
+ * Parameters:	ring    - ring to use.
+ *		ub      - board.
+ *		index   - board index.
+ *		quietMs - line silence which ends the drain.
+ * Returns:	none
+ * Side effects:
+ * Description:
+ *	Discard input until the line has been quiet for quietMs, as
+ *	OPR_DrainInput does, then go on with the job.
+ *---------------------------------------------------------------------------
+ */
+static void URING_Drain(struct URING_RING *ring, struct URING_BOARD *ub,
+			UINT32 index, UINT32 quietMs)
+{
+	unsigned long long now = getTimeUs();
+
+	ub->state   = US_DRAIN;
+	ub->cmd     = NULL;
+	ub->quietMs = quietMs;
+	ub->endUs   = now + (SYNC_DEADLINE * 1000);
+	URING_SetDeadline(ub, now + (quietMs * 1000ULL));
+
+	URING_QueueRead(ring, ub, index);
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	URING_Next
+ *
+ * Parameters:	ring  - ring to use.
+ *		ub    - board.
+ *		index - board index.
+ * Returns:	none
+ * Side effects:
+ * Description:
+ *	Send the current WRITE packet or verify READ command, or end the
+ *	job once all of them are done.
+ *---------------------------------------------------------------------------
+ */
+static void URING_Next(struct URING_RING *ring, struct URING_BOARD *ub,
+		       UINT32 index)
+{
+	struct MULTI_BOARD	*board   = ub->board;
+	struct UUT_SESSION	*session = &board->session;
+	const struct PKT_STREAM	*stream  = board->stream;
+	UINT32			offset   = ub->packet * PKT_MAX_PAYLOAD;
+	UINT32			readSize;
+	UINT32			cmdSize;
+
+	if (stream != NULL) {
+		if (ub->packet == stream->numPackets) {
+			URING_Finish(ub, EC_OK);
+			return;
+		}
+
+		ub->state = US_WRITE;
+		URING_Send(ring, ub, index,
+			   stream->data + stream->offsets[ub->packet],
+			   stream->offsets[ub->packet + 1] -
+			   stream->offsets[ub->packet],
+			   1, session->cmdTimeout);
+		return;
+	}
+
+	if (offset >= board->job->size) {
+		URING_Finish(ub, EC_OK);
+		return;
+	}
+
+	readSize = MIN(PKT_MAX_PAYLOAD, board->job->size - offset);
+
+	ub->state = US_READ;
+	CMD_CreateRead(session, board->job->addr + offset,
+		       (UINT8)(readSize - 1), session->cmdBuf[0].cmd,
+		       &cmdSize);
+	URING_Send(ring, ub, index, session->cmdBuf[0].cmd, cmdSize,
+		   readSize + 3, session->cmdTimeout);
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	URING_Finish
+ *
+ * Parameters:	ub     - board, with nothing in flight.
+ *		result - EXIT_CODE of the job.
+ * Returns:	none
+ * Side effects: Closes the board port, drops its packet stream reference.
+ *---------------------------------------------------------------------------
+ */
+static void URING_Finish(struct URING_BOARD *ub, UINT32 result)
+{
+	struct MULTI_BOARD *board = ub->board;
+
+	ub->state     = US_DONE;
+	board->result = result;
+
+	if ((INT32)board->session.portHandle > 0)
+		OPR_ClosePort(&board->session);
+
+	if (board->stream != NULL)
+		PKT_StreamPut(board->stream);
+
+	board->elapsedUs = getTimeUs() - ub->startUs;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	URING_Complete
+ *
+ * Parameters:	ring  - ring to use.
+ *		ub    - board, whose operations all completed.
+ *		index - board index.
+ * Returns:	none
+ * Side effects:
+ * Description:
+ *	Move the board state machine on, from the result of its command
+ *	and read.
+ *---------------------------------------------------------------------------
+ */
+static void URING_Complete(struct URING_RING *ring, struct URING_BOARD *ub,
+			   UINT32 index)
+{
+	struct MULTI_BOARD	*board   = ub->board;
+	struct UUT_SESSION	*session = &board->session;
+	unsigned long long	now      = getTimeUs();
+	UINT32			offset;
+	BOOLEAN			timedOut = FALSE;
+
+	if (ub->cmd != NULL) {
+		if (ub->writeRes != (INT32)ub->cmdSize) {
+			URING_Finish(ub, EC_SEND_CMD_ERR);
+			return;
+		}
+		session->txBytes += ub->cmdSize;
+		ub->cmd = NULL;
+	}
+
+	if (ub->readRes > 0) {
+		if (ub->state == US_DRAIN) {
+			/* Not quiet yet */
+			if (now < ub->endUs) {
+				URING_SetDeadline(ub, MIN(now +
+					(ub->quietMs * 1000ULL), ub->endUs));
+				URING_QueueRead(ring, ub, index);
+				return;
+			}
+			timedOut = TRUE;
+		} else {
+			ub->rxLen        += ub->readRes;
+			session->rxBytes += ub->readRes;
+
+			/* The rest of the answer, within the same deadline */
+			if (ub->rxLen < ub->respSize) {
+				URING_QueueRead(ring, ub, index);
+				return;
+			}
+		}
+	} else if ((ub->readRes == -ECANCELED) || (ub->readRes == -EINTR) ||
+		   (ub->readRes == -ETIME)) {
+		timedOut = TRUE;
+	} else {
+		/* Hang up or port error */
+		URING_Finish(ub, EC_PORT_ERR);
+		return;
+	}
+
+	switch (ub->state) {
+	case US_SYNC:
+		if (!timedOut && (session->respBuf[0] == UFPP_D2H_SYNC_CMD)) {
+			session->syncRttUs = (UINT32)(now - ub->sentUs);
+			/* Answers to earlier SYNC trials may be on their way */
+			if (ub->trials > 1)
+				URING_Drain(ring, ub, index,
+					MAX(SYNC_DRAIN_QUIET,
+					    (2 * session->syncRttUs) / 1000));
+			else
+				URING_Next(ring, ub, index);
+		} else if ((now >= ub->endUs) ||
+			   (!timedOut && (++ub->wrong >= SYNC_WRONG_LIMIT))) {
+			URING_Finish(ub, EC_SYNC_ERR);
+		} else {
+			if (timedOut)
+				ub->timeout = MIN(ub->timeout * 2,
+						  SYNC_MAX_TIMEOUT);
+			URING_SendSync(ring, ub, index);
+		}
+		break;
+
+	case US_DRAIN:
+		URING_Next(ring, ub, index);
+		break;
+
+	case US_WRITE:
+		if (!timedOut && (session->respBuf[0] == UFPP_WRITE_CMD)) {
+			ub->packet++;
+			ub->trial = 0;
+			URING_Next(ring, ub, index);
+		} else if (ub->trial < session->maxRetries) {
+			/* Late answers are drained before the resend */
+			ub->trial++;
+			session->retries++;
+			URING_Drain(ring, ub, index, SYNC_DRAIN_QUIET);
+		} else {
+			URING_Finish(ub, EC_SEND_CMD_ERR);
+		}
+		break;
+
+	case US_READ:
+		offset = ub->packet * PKT_MAX_PAYLOAD;
+		if (timedOut) {
+			URING_Finish(ub, EC_SEND_CMD_ERR);
+		} else if ((session->respBuf[0] != UFPP_READ_CMD) ||
+			   (memcmp(session->respBuf + 1,
+				   board->job->image + offset,
+				   ub->respSize - 3) != 0)) {
+			URING_Finish(ub, EC_VERIFY_ERR);
+		} else {
+			ub->packet++;
+			URING_Next(ring, ub, index);
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	URING_Run
+ *
+ * Parameters:	boards    - boards to program.
+ *		numBoards - number of boards.
+ * Returns:	TRUE once all the boards are done, FALSE when the engine
+ *		cannot run.
+ * Side effects: Opens, synchronizes and closes every port.
+ * Description:
+ *	Open the ports, start synchronizing all the boards, then submit and
+ *	reap in a single loop until every board is done.
+ *---------------------------------------------------------------------------
+ */
+BOOLEAN URING_Run(struct MULTI_BOARD *boards, UINT32 numBoards)
+{
+	struct URING_RING	ring;
+	struct URING_BOARD	*ubs;
+	struct URING_BOARD	*ub;
+	struct io_uring_cqe	*cqe;
+	unsigned		head;
+	unsigned		tail;
+	UINT32			active = 0;
+	UINT32			i;
+	int			ret;
+
+	for (i = 0; i < numBoards; i++) {
+		if (COMP_PORT_IS_REMOTE(boards[i].session.portName)) {
+			displayColorMsg(FAIL,
+				"The io_uring engine drives local ports only, using threads\n");
+			return FALSE;
+		}
+	}
+
+	ubs = (struct URING_BOARD *)calloc(numBoards, sizeof(*ubs));
+	if (ubs == NULL)
+		return FALSE;
+
+	if (!URING_Setup(&ring, numBoards * URING_OPS_PER_BOARD)) {
+		displayColorMsg(FAIL,
+			"io_uring is not available (%s), using threads\n",
+			strerror(errno));
+		free(ubs);
+		return FALSE;
+	}
+
+	for (i = 0; i < numBoards; i++) {
+		ub          = &ubs[i];
+		ub->board   = &boards[i];
+		ub->startUs = getTimeUs();
+
+		if (OPR_OpenPort(&ub->board->session,
+				 ub->board->session.portName) != TRUE) {
+			URING_Finish(ub, EC_PORT_ERR);
+			continue;
+		}
+
+		/* Reads wait for data through io_uring, never in read() */
+		fcntl((int)ub->board->session.portHandle, F_SETFL,
+		      fcntl((int)ub->board->session.portHandle, F_GETFL) |
+		      O_NONBLOCK);
+
+		ub->timeout = SYNC_BURST_TIMEOUT;
+		ub->endUs   = getTimeUs() + (SYNC_DEADLINE * 1000);
+		URING_SendSync(&ring, ub, i);
+		active++;
+	}
+
+	while (active > 0) {
+		__atomic_store_n(ring.sqTail, ring.sqLocalTail,
+				 __ATOMIC_RELEASE);
+
+		ret = (int)syscall(__NR_io_uring_enter, ring.fd, ring.toSubmit,
+				   1, IORING_ENTER_GETEVENTS, NULL, 0);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+
+			displayColorMsg(FAIL, "ERROR: io_uring_enter: %s\n",
+					strerror(errno));
+			break;
+		}
+		ring.toSubmit -= (unsigned)ret;
+
+		head = *ring.cqHead;
+		tail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+
+		for (; head != tail; head++) {
+			cqe = &ring.cqes[head & ring.cqMask];
+			ub  = &ubs[URING_INDEX(cqe->user_data)];
+
+			if (URING_OP(cqe->user_data) == URING_OP_WRITE)
+				ub->writeRes = cqe->res;
+			else if (URING_OP(cqe->user_data) == URING_OP_READ)
+				ub->readRes = cqe->res;
+
+			if (--ub->pending == 0) {
+				URING_Complete(&ring, ub,
+					       URING_INDEX(cqe->user_data));
+				if (ub->state == US_DONE)
+					active--;
+			}
+		}
+
+		__atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+	}
+
+	/* Closing the ring drops anything still in flight */
+	URING_Teardown(&ring);
+
+	for (i = 0; i < numBoards; i++) {
+		if (ubs[i].state != US_DONE)
+			URING_Finish(&ubs[i], EC_PORT_ERR);
+	}
+
+	free(ubs);
+
+	return TRUE;
+}
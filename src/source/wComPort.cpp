@@ -247,6 +247,44 @@ BOOLEAN ConfigureUart(
     return TRUE;
 }
 
+/******************************************************************************
+* Function: BOOLEAN ComPortSetModemLines()
+*           
+* Purpose:  Assert or release modem control lines.
+*           
+* Params:   nDeviceID - the opened handle returned by ComPortOpen()
+*           Lines - COMPORT_LINE_* mask of the lines to change
+*           Assert - TRUE to assert the lines, FALSE to release them
+*           
+* Returns:  1 if successful
+*           0 in the case of an error.
+*           
+******************************************************************************/
+BOOLEAN ComPortSetModemLines (
+    HANDLE  nDeviceID,
+    UINT32  Lines,
+    BOOLEAN Assert
+)
+{
+	if ((Lines & COMPORT_LINE_DTR) &&
+	    !::EscapeCommFunction(nDeviceID, Assert ? SETDTR : CLRDTR))
+	{
+		displayColorMsg(FAIL, "ComPortSetModemLines() Error: EscapeCommFunction() returned %lu\n",
+			::GetLastError());
+		return FALSE;
+	}
+
+	if ((Lines & COMPORT_LINE_RTS) &&
+	    !::EscapeCommFunction(nDeviceID, Assert ? SETRTS : CLRRTS))
+	{
+		displayColorMsg(FAIL, "ComPortSetModemLines() Error: EscapeCommFunction() returned %lu\n",
+			::GetLastError());
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 /******************************************************************************
 * Function: HANDLE ComPortOpen()
 *           
@@ -254,6 +292,7 @@ BOOLEAN ConfigureUart(
 *           
 * Params:   ComPortDeviceName - The name of the device to open
 *           ComPortFields - a struct filled with Comport settings
+*           Verbose - unused, Windows ports are not tuned
 *           
 * Returns:  INVALID_HANDLE_VALUE (-1) - invalid handle.
 *           Other value - Handle to be used in other Comport APIs
@@ -264,7 +303,8 @@ BOOLEAN ConfigureUart(
 ******************************************************************************/
 HANDLE ComPortOpen (
 	const char    *ComPortDeviceName, 
-	COMPORT_FIELDS ComPortFields
+	COMPORT_FIELDS ComPortFields,
+	BOOLEAN        /* Verbose */
 )
 {
 	UINT32	PrimaryAddress = 1;
@@ -435,6 +475,43 @@ UINT32	ComPortReadBin (
 	return (UINT32)NumberOfBytesRead;
 }
 
+/******************************************************************************
+* Function: UINT32 ComPortReadScatter()
+*           
+* Purpose:  Read a binary data from Comport into several buffers
+*           
+* Params:   nDeviceID - the opened handle returned by ComPortOpen()
+*           Iov - buffers, filled one after the other
+*           IovCnt - number of buffers
+*           
+* Returns:  The number of bytes read.
+*           
+* Comments: Comm handles have no scatter read, each buffer is read in turn.
+*           
+******************************************************************************/
+UINT32	ComPortReadScatter (
+	HANDLE                 nDeviceID,
+	const struct COMP_IOV *Iov,
+	UINT32                 IovCnt
+)
+{
+	UINT32 total = 0;
+	UINT32 n;
+	UINT32 i;
+
+	for (i = 0; i < IovCnt; i++)
+	{
+		n = ComPortReadBin(nDeviceID, Iov[i].Buffer, Iov[i].BufSize);
+		total += n;
+		if (n < Iov[i].BufSize)
+		{
+			break;
+		}
+	}
+
+	return total;
+}
+
 /******************************************************************************
 * Function: UINT32 ComPortWaitForRead()
 *           
@@ -486,4 +563,42 @@ UINT32 ComPortWaitForRead (HANDLE nDeviceID)
 	}
 }
 
+/******************************************************************************
+* Function: UINT32 ComPortWaitForReadTimeout()
+*           
+* Purpose:  Wait until a byte is received for read, or Timeout expires
+*           
+* Params:   nDeviceID - the opened handle returned by ComPortOpen()
+*           Timeout - maximum time to wait, in milliseconds
+*           
+* Returns:  The number of bytes that are waiting in RX queue.
+*           
+******************************************************************************/
+UINT32 ComPortWaitForReadTimeout (HANDLE nDeviceID, UINT32 Timeout)
+{
+	UINT32   Errors;
+	COMSTAT  Comstat;
+	DWORD    start = GetTickCount();
+
+	do
+	{
+		ClearCommError(nDeviceID, (LPDWORD)&Errors, &Comstat);
+
+		if (Errors)
+		{
+			displayColorMsg(FAIL, "ComPortWaitForReadTimeout() Error: ClearCommError Error %lu was detected.\n", Errors);
+			return 0;
+		}
+
+		if (Comstat.cbInQue)
+		{
+			return (UINT32)Comstat.cbInQue;
+		}
+
+		Sleep(1);
+	} while ((GetTickCount() - start) < Timeout);
+
+	return 0;
+}
+
 #endif //_WIN32
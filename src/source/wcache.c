@@ -0,0 +1,285 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   wcache.c
+ *	This file implements the write-combining cache of a session.
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "uut_types.h"
+#include "ComPort.h"
+#include "program.h"
+#include "opr.h"
+#include "cmd.h"
+#include "session.h"
+#include "lib_uut.h"
+#include "wcache.h"
+
+/*---------------------------------------------------------------------------
+ * Constant definitions
+ *---------------------------------------------------------------------------
+ */
+#define WCACHE_IS_DIRTY(line, i)	((line)->dirty[(i) / 8] & (1 << ((i) % 8)))
+#define WCACHE_SET_DIRTY(line, i)	((line)->dirty[(i) / 8] |= (1 << ((i) % 8)))
+
+/*---------------------------------------------------------------------------
+ * Functions prototypes
+ *---------------------------------------------------------------------------
+ */
+static struct WCACHE_LINE *WCACHE_Line(struct UUT_SESSION *session,
+				       UINT32 base, UINT32 *ec);
+static UINT32	WCACHE_Runs(const struct WCACHE_LINE *line,
+			    struct UUT_IOVEC *vec);
+
+/*---------------------------------------------------------------------------
+ * Functions implementation
+ *---------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------------
+ * Function:	WCACHE_Enable
+ *
+ * Parameters:	session - session to cache the writes of.
+ *		size    - cache size in bytes, 0 to write through.
+ * Returns:	EC_OK, or the EXIT_CODE of the flush or of the allocation.
+ * Side effects: Flushes the cache in use first.
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+UINT32 WCACHE_Enable(struct UUT_SESSION *session, UINT32 size)
+{
+	struct WCACHE	*cache;
+	UINT32		ec;
+
+	if (size > WCACHE_MAX_SIZE)
+		return EC_SIZE_ERR;
+
+	ec = WCACHE_Flush(session);
+	if (ec != EC_OK)
+		return ec;
+
+	WCACHE_Free(session);
+
+	if (size == 0)
+		return EC_OK;
+
+	cache = (struct WCACHE *)malloc(sizeof(*cache));
+	if (cache == NULL)
+		return EC_SIZE_ERR;
+
+	cache->numLines = (size + WCACHE_LINE_SIZE - 1) / WCACHE_LINE_SIZE;
+	cache->numUsed  = 0;
+	cache->lines    = (struct WCACHE_LINE *)
+			  malloc(cache->numLines * sizeof(*cache->lines));
+	if (cache->lines == NULL) {
+		free(cache);
+		return EC_SIZE_ERR;
+	}
+
+	session->wcache = cache;
+
+	return EC_OK;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	WCACHE_Write
+ *
+ * Parameters:	session - session to use.
+ *		addr    - Memory address to write to.
+ *		buff    - data buffer to write.
+ *		size    - Data size to write.
+ * Returns:	EC_OK, or the EXIT_CODE of the writes sent.
+ * Side effects: Flushes the cache when no line is left for the data.
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+UINT32 WCACHE_Write(struct UUT_SESSION *session, UINT32 addr,
+		    const UINT8 *buff, UINT32 size)
+{
+	struct WCACHE_LINE	*line;
+	UINT32			offset;
+	UINT32			n;
+	UINT32			i;
+	UINT32			ec;
+
+	/* Nothing to combine, keep the order of the writes */
+	if ((session->wcache == NULL) || (size >= WCACHE_LINE_SIZE)) {
+		ec = WCACHE_Flush(session);
+		if (ec != EC_OK)
+			return ec;
+
+		return OPR_WriteBuf(session, addr, buff, size);
+	}
+
+	while (size > 0) {
+		offset = addr % WCACHE_LINE_SIZE;
+		n      = MIN(size, WCACHE_LINE_SIZE - offset);
+
+		line = WCACHE_Line(session, addr - offset, &ec);
+		if (line == NULL)
+			return ec;
+
+		memcpy(line->data + offset, buff, n);
+		for (i = offset; i < offset + n; i++) {
+			if (!WCACHE_IS_DIRTY(line, i)) {
+				WCACHE_SET_DIRTY(line, i);
+				line->numDirty++;
+			}
+		}
+
+		addr += n;
+		buff += n;
+		size -= n;
+	}
+
+	return EC_OK;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	WCACHE_Flush
+ *
+ * Parameters:	session - session whose cached writes are sent.
+ * Returns:	EC_OK, or the EXIT_CODE of the failed transfer.
+ * Side effects:
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+UINT32 WCACHE_Flush(struct UUT_SESSION *session)
+{
+	struct WCACHE		*cache = session->wcache;
+	struct UUT_IOVEC	*vec;
+	UINT32			count = 0;
+	UINT32			i;
+	UINT32			ec;
+
+	if ((cache == NULL) || (cache->numUsed == 0))
+		return EC_OK;
+
+	/* A line has at most a run every other byte */
+	vec = (struct UUT_IOVEC *)malloc(cache->numUsed *
+					 (WCACHE_LINE_SIZE / 2) * sizeof(*vec));
+	if (vec == NULL)
+		return EC_SIZE_ERR;
+
+	for (i = 0; i < cache->numUsed; i++)
+		count += WCACHE_Runs(&cache->lines[i], vec + count);
+
+	ec = OPR_WriteVec(session, vec, count);
+	if (ec == EC_OK)
+		cache->numUsed = 0;
+
+	free(vec);
+
+	return ec;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	WCACHE_Free
+ *
+ * Parameters:	session - session whose cache is dropped.
+ * Returns:	none
+ * Side effects: Cached data not flushed is lost.
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+void WCACHE_Free(struct UUT_SESSION *session)
+{
+	if (session->wcache == NULL)
+		return;
+
+	free(session->wcache->lines);
+	free(session->wcache);
+	session->wcache = NULL;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	WCACHE_Line
+ *
+ * Parameters:	session - session to use.
+ *		base    - line aligned memory address.
+ *		ec      - EXIT_CODE of the flush, when it failed.
+ * Returns:	The line caching base, NULL when the flush to free a line
+ *		failed.
+ * Side effects: Flushes the cache when all the lines are in use.
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+static struct WCACHE_LINE *WCACHE_Line(struct UUT_SESSION *session,
+				       UINT32 base, UINT32 *ec)
+{
+	struct WCACHE		*cache = session->wcache;
+	struct WCACHE_LINE	*line;
+	UINT32			i;
+
+	for (i = 0; i < cache->numUsed; i++) {
+		if (cache->lines[i].addr == base)
+			return &cache->lines[i];
+	}
+
+	if (cache->numUsed == cache->numLines) {
+		*ec = WCACHE_Flush(session);
+		if (*ec != EC_OK)
+			return NULL;
+	}
+
+	line = &cache->lines[cache->numUsed++];
+	line->addr     = base;
+	line->numDirty = 0;
+	memset(line->dirty, 0, sizeof(line->dirty));
+
+	return line;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	WCACHE_Runs
+ *
+ * Parameters:	line - cache line.
+ *		vec  - filled with the runs of written bytes.
+ * Returns:	The number of runs.
+ * Side effects:
+ * Description:
+ *---------------------------------------------------------------------------
+ */
+static UINT32 WCACHE_Runs(const struct WCACHE_LINE *line,
+			  struct UUT_IOVEC *vec)
+{
+	UINT32	count = 0;
+	UINT32	start;
+	UINT32	i = 0;
+
+	/* A fully written line is a single run */
+	if (line->numDirty == WCACHE_LINE_SIZE) {
+		vec[0].addr = line->addr;
+		vec[0].buf  = (UINT8 *)line->data;
+		vec[0].len  = WCACHE_LINE_SIZE;
+		return 1;
+	}
+
+	while (i < WCACHE_LINE_SIZE) {
+		if (!WCACHE_IS_DIRTY(line, i)) {
+			i++;
+			continue;
+		}
+
+		for (start = i; (i < WCACHE_LINE_SIZE) &&
+		     WCACHE_IS_DIRTY(line, i); i++)
+			;
+
+		vec[count].addr = line->addr + start;
+		vec[count].buf  = (UINT8 *)line->data + start;
+		vec[count].len  = i - start;
+		count++;
+	}
+
+	return count;
+}
@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0
+#
+# Nuvoton UART Update Tool
+#
+# bench_ports.py
+#	Compare the -ports engines on simulated boards: start uut_sim.py
+#	with <boards> ptys, then run -opr wr and -opr verify of a random
+#	image with each engine, and report the wall time, the CPU time and
+#	the involuntary context switches of the tool.
+#
+#	bench_ports.py [--boards 32] [--size-kb 100] [--runs 2]
+#
+#	Run from the repository top directory, after "make all", as root
+#	(the ptys are linked under /dev). The simulator runs in Python, so
+#	it, not the tool, bounds the wall time.
+
+import argparse
+import os
+import subprocess
+import sys
+import tempfile
+import time
+
+TOP = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+TOOL = os.path.join(TOP, "Release", "Uartupdatetool")
+SIM = os.path.join(TOP, "tools", "uut_sim.py")
+
+
+def run(cmd):
+	"""Run cmd, return its wall time and resource usage."""
+	start = time.monotonic()
+	proc = subprocess.Popen(cmd, stdout=subprocess.PIPE,
+				stderr=subprocess.STDOUT)
+	out = proc.stdout.read()
+	_, status, usage = os.wait4(proc.pid, 0)
+	wall = time.monotonic() - start
+	if os.waitstatus_to_exitcode(status) != 0:
+		sys.stdout.write(out.decode(errors="replace"))
+		sys.exit("FAILED: " + " ".join(cmd))
+	return wall, usage
+
+
+def main():
+	parser = argparse.ArgumentParser(description="-ports engine benchmark")
+	parser.add_argument("--boards", type=int, default=32)
+	parser.add_argument("--size-kb", type=int, default=100)
+	parser.add_argument("--runs", type=int, default=2)
+	parser.add_argument("--addr", default="0x10000")
+	args = parser.parse_args()
+
+	sim = subprocess.Popen([sys.executable, SIM, "pty",
+				"--count", str(args.boards)],
+			       stdout=subprocess.PIPE)
+	sim.stdout.readline()
+
+	image = tempfile.NamedTemporaryFile(suffix=".bin")
+	image.write(os.urandom(args.size_kb * 1024))
+	image.flush()
+
+	print("%d boards, %d KB image" % (args.boards, args.size_kb))
+	print("%-7s %-7s %8s %10s %7s %8s" %
+	      ("opr", "engine", "wall [s]", "cpu [s]", "ivcs", "rss [MB]"))
+	try:
+		for opr in ("wr", "verify"):
+			for engine in ("thread", "uring"):
+				for _ in range(args.runs):
+					wall, ru = run([TOOL, "-silent",
+						"-ports", "ttySIM*",
+						"-engine", engine,
+						"-opr", opr,
+						"-file", image.name,
+						"-addr", args.addr])
+					print("%-7s %-7s %8.2f %10.2f %7d %8.1f" %
+					      (opr, engine, wall,
+					       ru.ru_utime + ru.ru_stime,
+					       ru.ru_nivcsw, ru.ru_maxrss / 1024))
+	finally:
+		sim.terminate()
+		sim.wait()
+
+
+if __name__ == "__main__":
+	main()
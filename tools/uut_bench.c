@@ -0,0 +1,612 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Nuvoton UART Update Tool
+ *
+ * Copyright (C) 2019 Nuvoton Technologies, All Rights Reserved
+ *<<<------------------------------------------------------------------------
+ * File Contents:
+ *   uut_bench.c
+ *	This file implements the libuut.so benchmarks, run against a board
+ *	or against tools/uut_sim.py. Built by "make bench".
+ *  Project:
+ *	UartUpdateTool
+ *---------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+
+#include "uut_types.h"
+#include "program.h"
+#include "lib_uut.h"
+
+/*----------------------------------------------------------------------------
+ * Constant definitions
+ *---------------------------------------------------------------------------
+ */
+#define BENCH_BAUD_RATE		115200
+#define BENCH_ADDR		0x10000
+#define BENCH_ACCESS_SIZE	4
+#define BENCH_ACCESS_COUNT	1000
+#define BENCH_SHELL_COUNT	50
+#define BENCH_TOOL_NAME		"Uartupdatetool"
+#define BENCH_OPEN_COUNT	100
+#define BENCH_NO_PORT		"ttyNONE"
+#define BENCH_VEC_RANGES	300
+#define BENCH_VEC_MIN_LEN	4
+#define BENCH_VEC_MAX_LEN	64
+#define BENCH_VEC_MAX_GAP	64
+#define BENCH_RETRY_TIMEOUT	50	/* ms, response wait with retries */
+#define BENCH_ASYNC_SIZE_KB	100
+#define BENCH_POLL_MS		10
+#define BENCH_NUM_OPS		4
+
+/* Port files of the scan, see opr.c, relative to the current directory */
+#define BENCH_CACHE_FILE	"SerialPortCache.txt"
+#define BENCH_SCAN_FILES	{ BENCH_CACHE_FILE, "SerialPortNumber.txt", \
+				  "SerialPortList.txt" }
+
+/*----------------------------------------------------------------------------
+ * Internal types
+ *---------------------------------------------------------------------------
+ */
+struct BENCH_MODE {
+	const char	*name;
+	const char	*usage;
+	int		(*run)(int argc, char *argv[]);
+};
+
+/*---------------------------------------------------------------------------
+ * Functions prototypes
+ *---------------------------------------------------------------------------
+ */
+static double	BENCH_TimeMs(void);
+static int	BENCH_Access(int argc, char *argv[]);
+static BOOLEAN	BENCH_SetCache(const char *port);
+static int	BENCH_Open(int argc, char *argv[]);
+static int	BENCH_Session(int argc, char *argv[], int retriesArg,
+			      UUT_HANDLE *h);
+static int	BENCH_Vector(int argc, char *argv[]);
+static void	BENCH_Progress(UINT32 opId, UINT32 done, UINT32 total,
+			       void *arg);
+static void	BENCH_Done(UINT32 opId, int result, void *arg);
+static int	BENCH_Async(int argc, char *argv[]);
+
+/* State of the asynchronous operations of BENCH_Async */
+struct BENCH_OPS {
+	UINT32	id[BENCH_NUM_OPS];
+	int	result[BENCH_NUM_OPS];
+	UINT32	progress[BENCH_NUM_OPS];
+	UINT32	numDone;
+};
+
+/*---------------------------------------------------------------------------
+ * Local variables
+ *---------------------------------------------------------------------------
+ */
+static const struct BENCH_MODE BenchModes[] = {
+	{ "access", "<port> [count]", BENCH_Access },
+	{ "open",   "<port> [count]", BENCH_Open },
+	{ "vector", "<port> [depth] [retries]", BENCH_Vector },
+	{ "async",  "<port> [size KB] [retries]", BENCH_Async },
+};
+
+#define BENCH_NUM_MODES	(sizeof(BenchModes) / sizeof(BenchModes[0]))
+
+/*---------------------------------------------------------------------------
+ * Functions implementation
+ *---------------------------------------------------------------------------
+ */
+
+/*---------------------------------------------------------------------------
+ * Function:	BENCH_TimeMs
+ *
+ * Parameters:	none
+ * Returns:	Monotonic time in milli-seconds.
+ *---------------------------------------------------------------------------
+ */
+static double BENCH_TimeMs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (ts.tv_sec * 1000.0) + (ts.tv_nsec / 1000000.0);
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	BENCH_Access
+ *
+ * Parameters:	argc - number of arguments.
+ *		argv - port, and the number of accesses.
+ * Returns:	EXIT_CODE of the first failure.
+ * Side effects:
+ * Description:
+ *	Time a 4-byte write and read back, in-process on an open session
+ *	and by running the tool once per access.
+ *---------------------------------------------------------------------------
+ */
+static int BENCH_Access(int argc, char *argv[])
+{
+	UUT_HANDLE	h;
+	UINT8		wr[BENCH_ACCESS_SIZE];
+	UINT8		rd[BENCH_ACCESS_SIZE];
+	char		tool[PATH_MAX];
+	char		cmd[2 * PATH_MAX];
+	char		*dir;
+	ssize_t		len;
+	double		start;
+	int		count;
+	int		ret_val;
+	int		i;
+
+	count = (argc > 1) ? atoi(argv[1]) : BENCH_ACCESS_COUNT;
+	if (count <= 0)
+		return EC_SIZE_ERR;
+
+	ret_val = UUT_Open(argv[0], BENCH_BAUD_RATE, &h);
+	if (ret_val != EC_OK)
+		return ret_val;
+
+	start = BENCH_TimeMs();
+	for (i = 0; (i < count) && (ret_val == EC_OK); i++) {
+		memcpy(wr, &i, sizeof(wr));
+		ret_val = UUT_WriteMem(h, BENCH_ADDR, wr, sizeof(wr));
+		if (ret_val == EC_OK)
+			ret_val = UUT_ReadMem(h, BENCH_ADDR, rd, sizeof(rd));
+		if ((ret_val == EC_OK) && (memcmp(wr, rd, sizeof(wr)) != 0))
+			ret_val = EC_VERIFY_ERR;
+	}
+
+	UUT_Close(h);
+	if (ret_val != EC_OK)
+		return ret_val;
+
+	printf("in-process    %8.1f us per write + read (%d)\n",
+	       (BENCH_TimeMs() - start) * 1000.0 / count, count);
+
+	/* The tool is built next to this benchmark */
+	len = readlink("/proc/self/exe", tool, sizeof(tool) - 1);
+	if (len <= 0)
+		return EC_FILE_ERR;
+	tool[len] = '\0';
+	dir = strrchr(tool, '/');
+	snprintf(dir + 1, sizeof(tool) - (dir + 1 - tool), "%s",
+		 BENCH_TOOL_NAME);
+
+	snprintf(cmd, sizeof(cmd),
+		 "%s -silent -port %s -opr rd -addr 0x%x -size %d"
+		 " -file /dev/null > /dev/null", tool, argv[0], BENCH_ADDR,
+		 BENCH_ACCESS_SIZE);
+
+	start = BENCH_TimeMs();
+	for (i = 0; i < BENCH_SHELL_COUNT; i++) {
+		if (system(cmd) != 0)
+			return EC_PORT_ERR;
+	}
+
+	printf("tool per call %8.1f us per read (%d)\n",
+	       (BENCH_TimeMs() - start) * 1000.0 / BENCH_SHELL_COUNT,
+	       BENCH_SHELL_COUNT);
+
+	return EC_OK;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	BENCH_SetCache
+ *
+ * Parameters:	port - port name to cache.
+ * Returns:	FALSE if the cache file could not be written.
+ *---------------------------------------------------------------------------
+ */
+static BOOLEAN BENCH_SetCache(const char *port)
+{
+	FILE	*file_pointer;
+
+	file_pointer = fopen(BENCH_CACHE_FILE, "w");
+	if (file_pointer == NULL)
+		return FALSE;
+
+	fprintf(file_pointer, "%s\n", port);
+	fclose(file_pointer);
+
+	return TRUE;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	BENCH_Open
+ *
+ * Parameters:	argc - number of arguments.
+ *		argv - port, and the number of opens.
+ * Returns:	EXIT_CODE of the first failure.
+ * Side effects: Runs in a temporary directory, so that the port files of
+ *		 the current directory are left as they are.
+ * Description:
+ *	Time UUT_Open() without a port name when the cached port answers,
+ *	and when the cached port is gone and the full scan runs.
+ *---------------------------------------------------------------------------
+ */
+static int BENCH_Open(int argc, char *argv[])
+{
+	static const char	*files[] = BENCH_SCAN_FILES;
+	char			dir[] = "/tmp/uut_bench.XXXXXX";
+	UUT_HANDLE		h;
+	double			start;
+	int			count;
+	int			ret_val = EC_OK;
+	int			i;
+
+	count = (argc > 1) ? atoi(argv[1]) : BENCH_OPEN_COUNT;
+	if (count <= 0)
+		return EC_SIZE_ERR;
+
+	if ((mkdtemp(dir) == NULL) || (chdir(dir) != 0))
+		return EC_FILE_ERR;
+
+	if (!BENCH_SetCache(argv[0]))
+		ret_val = EC_FILE_ERR;
+
+	start = BENCH_TimeMs();
+	for (i = 0; (i < count) && (ret_val == EC_OK); i++) {
+		ret_val = UUT_Open(NULL, BENCH_BAUD_RATE, &h);
+		if (ret_val == EC_OK)
+			UUT_Close(h);
+	}
+
+	if (ret_val == EC_OK) {
+		printf("cache hit  %8.2f ms per open + sync (%d)\n",
+		       (BENCH_TimeMs() - start) / count, count);
+
+		if (!BENCH_SetCache(BENCH_NO_PORT))
+			ret_val = EC_FILE_ERR;
+	}
+
+	if (ret_val == EC_OK) {
+		start   = BENCH_TimeMs();
+		ret_val = UUT_Open(NULL, BENCH_BAUD_RATE, &h);
+		printf("cache miss %8.2f ms, the scan %s\n",
+		       BENCH_TimeMs() - start,
+		       (ret_val == EC_OK) ? "found a device" : "found nothing");
+		if (ret_val == EC_OK)
+			UUT_Close(h);
+		ret_val = EC_OK;
+	}
+
+	for (i = 0; i < (int)(sizeof(files) / sizeof(files[0])); i++)
+		unlink(files[i]);
+	rmdir(dir);
+
+	return ret_val;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	BENCH_Session
+ *
+ * Parameters:	argc       - number of arguments.
+ *		argv       - port, and the benchmark arguments.
+ *		retriesArg - index of the retries argument.
+ *		h          - returned session handle.
+ * Returns:	EXIT_CODE of UUT_Open.
+ * Side effects:
+ * Description:
+ *	Open a session, with packet retries and a short response timeout
+ *	when retries are asked.
+ *---------------------------------------------------------------------------
+ */
+static int BENCH_Session(int argc, char *argv[], int retriesArg,
+			 UUT_HANDLE *h)
+{
+	int	ret_val;
+
+	ret_val = UUT_Open(argv[0], BENCH_BAUD_RATE, h);
+	if ((ret_val == EC_OK) && (argc > retriesArg))
+		ret_val = UUT_SetRetries(*h, (UINT32)atoi(argv[retriesArg]));
+	if ((ret_val == EC_OK) && (argc > retriesArg))
+		ret_val = UUT_SetTimeout(*h, BENCH_RETRY_TIMEOUT);
+	if ((ret_val != EC_OK) && (*h != NULL)) {
+		UUT_Close(*h);
+		*h = NULL;
+	}
+
+	return ret_val;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	BENCH_Vector
+ *
+ * Parameters:	argc - number of arguments.
+ *		argv - port, pipeline depth and packet retries.
+ * Returns:	EXIT_CODE of the first failure.
+ * Side effects: Writes the device memory from BENCH_ADDR on.
+ * Description:
+ *	Time scattered small reads, one call per range and vectored, then
+ *	a vectored write of the same ranges, checked by a vectored read.
+ *	About a third of the ranges touch the previous one, the others
+ *	leave a gap.
+ *---------------------------------------------------------------------------
+ */
+static int BENCH_Vector(int argc, char *argv[])
+{
+	struct UUT_IOVEC	vec[BENCH_VEC_RANGES];
+	UINT8			*wr;
+	UINT8			*rd;
+	UUT_HANDLE		h;
+	UINT32			addr = BENCH_ADDR;
+	UINT32			total = 0;
+	UINT32			i;
+	unsigned int		seed = 1;
+	double			start;
+	int			ret_val;
+
+	for (i = 0; i < BENCH_VEC_RANGES; i++) {
+		vec[i].addr = addr;
+		vec[i].len  = BENCH_VEC_MIN_LEN + (rand_r(&seed) %
+			      (BENCH_VEC_MAX_LEN - BENCH_VEC_MIN_LEN + 1));
+		addr  += vec[i].len;
+		total += vec[i].len;
+		if (rand_r(&seed) % 3 != 0)
+			addr += 1 + (rand_r(&seed) % BENCH_VEC_MAX_GAP);
+	}
+
+	wr = (UINT8 *)malloc(total);
+	rd = (UINT8 *)malloc(total);
+	if ((wr == NULL) || (rd == NULL)) {
+		free(wr);
+		free(rd);
+		return EC_SIZE_ERR;
+	}
+
+	ret_val = BENCH_Session(argc, argv, 2, &h);
+	if ((ret_val == EC_OK) && (argc > 1))
+		ret_val = UUT_SetPipeline(h, (UINT32)atoi(argv[1]));
+	if (ret_val != EC_OK) {
+		free(wr);
+		free(rd);
+		return ret_val;
+	}
+
+	for (i = 0, total = 0; i < BENCH_VEC_RANGES; i++) {
+		vec[i].buf = rd + total;
+		total     += vec[i].len;
+	}
+
+	start = BENCH_TimeMs();
+	for (i = 0; (i < BENCH_VEC_RANGES) && (ret_val == EC_OK); i++)
+		ret_val = UUT_ReadMem(h, vec[i].addr, vec[i].buf, vec[i].len);
+	if (ret_val == EC_OK)
+		printf("read, one call per range %8.1f ms\n",
+		       BENCH_TimeMs() - start);
+
+	if (ret_val == EC_OK) {
+		start   = BENCH_TimeMs();
+		ret_val = UUT_ReadMemV(h, vec, BENCH_VEC_RANGES);
+	}
+	if (ret_val == EC_OK)
+		printf("read, vectored           %8.1f ms\n",
+		       BENCH_TimeMs() - start);
+
+	for (i = 0; i < total; i++)
+		wr[i] = (UINT8)rand_r(&seed);
+	for (i = 0, total = 0; i < BENCH_VEC_RANGES; i++) {
+		vec[i].buf = wr + total;
+		total     += vec[i].len;
+	}
+
+	if (ret_val == EC_OK) {
+		start   = BENCH_TimeMs();
+		ret_val = UUT_WriteMemV(h, vec, BENCH_VEC_RANGES);
+	}
+	if (ret_val == EC_OK)
+		printf("write, vectored          %8.1f ms\n",
+		       BENCH_TimeMs() - start);
+
+	for (i = 0, total = 0; i < BENCH_VEC_RANGES; i++) {
+		vec[i].buf = rd + total;
+		total     += vec[i].len;
+	}
+
+	if (ret_val == EC_OK)
+		ret_val = UUT_ReadMemV(h, vec, BENCH_VEC_RANGES);
+	if ((ret_val == EC_OK) && (memcmp(wr, rd, total) != 0))
+		ret_val = EC_VERIFY_ERR;
+	if (ret_val == EC_OK)
+		printf("%u ranges, %u bytes read back as written\n",
+		       BENCH_VEC_RANGES, total);
+
+	UUT_Close(h);
+	free(wr);
+	free(rd);
+
+	return ret_val;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	BENCH_Progress
+ *
+ * Parameters:	opId  - operation id.
+ *		done  - bytes done so far.
+ *		total - operation size.
+ *		arg   - the BENCH_OPS.
+ * Returns:	none
+ *---------------------------------------------------------------------------
+ */
+static void BENCH_Progress(UINT32 opId, UINT32 done, UINT32 total, void *arg)
+{
+	struct BENCH_OPS	*ops = (struct BENCH_OPS *)arg;
+	UINT32			i;
+
+	(void)total;
+
+	for (i = 0; i < BENCH_NUM_OPS; i++) {
+		if (ops->id[i] == opId)
+			ops->progress[i] = done;
+	}
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	BENCH_Done
+ *
+ * Parameters:	opId   - operation id.
+ *		result - EXIT_CODE of the operation.
+ *		arg    - the BENCH_OPS.
+ * Returns:	none
+ *---------------------------------------------------------------------------
+ */
+static void BENCH_Done(UINT32 opId, int result, void *arg)
+{
+	struct BENCH_OPS	*ops = (struct BENCH_OPS *)arg;
+	UINT32			i;
+
+	for (i = 0; i < BENCH_NUM_OPS; i++) {
+		if (ops->id[i] == opId)
+			ops->result[i] = result;
+	}
+	ops->numDone++;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	BENCH_Async
+ *
+ * Parameters:	argc - number of arguments.
+ *		argv - port, transfer size in KB and packet retries.
+ * Returns:	EXIT_CODE of the first failure.
+ * Side effects: Writes the device memory from BENCH_ADDR on.
+ * Description:
+ *	Submit a write, its read back and a call at once, and poll them to
+ *	the end. Then cancel a running write and a queued one: both must
+ *	end with EC_CANCEL_ERR.
+ *---------------------------------------------------------------------------
+ */
+static int BENCH_Async(int argc, char *argv[])
+{
+	struct UUT_ASYNC_CB	cb;
+	struct BENCH_OPS	ops;
+	UUT_HANDLE		h;
+	UINT8			*wr;
+	UINT8			*rd;
+	UINT8			resp = 0;
+	UINT32			size;
+	UINT32			polls = 0;
+	UINT32			i;
+	double			start;
+	int			ret_val;
+
+	size = 1024 * (UINT32)((argc > 1) ? atoi(argv[1]) :
+			       BENCH_ASYNC_SIZE_KB);
+	if (size == 0)
+		return EC_SIZE_ERR;
+
+	wr = (UINT8 *)malloc(size);
+	rd = (UINT8 *)malloc(size);
+	if ((wr == NULL) || (rd == NULL)) {
+		free(wr);
+		free(rd);
+		return EC_SIZE_ERR;
+	}
+
+	ret_val = BENCH_Session(argc, argv, 2, &h);
+	if (ret_val != EC_OK) {
+		free(wr);
+		free(rd);
+		return ret_val;
+	}
+
+	for (i = 0; i < size; i++)
+		wr[i] = (UINT8)(i * 7);
+
+	memset(&ops, 0, sizeof(ops));
+	cb.progress = BENCH_Progress;
+	cb.done     = BENCH_Done;
+	cb.arg      = &ops;
+
+	start = BENCH_TimeMs();
+	ret_val = UUT_SubmitWrite(h, BENCH_ADDR, wr, size, &cb, &ops.id[0]);
+	if (ret_val == EC_OK)
+		ret_val = UUT_SubmitRead(h, BENCH_ADDR, rd, size, &cb,
+					 &ops.id[1]);
+	if (ret_val == EC_OK)
+		ret_val = UUT_SubmitCall(h, BENCH_ADDR, &resp, &cb,
+					 &ops.id[2]);
+
+	while ((ret_val == EC_OK) && (UUT_Poll(h, BENCH_POLL_MS) > 0))
+		polls++;
+
+	for (i = 0; (i < 3) && (ret_val == EC_OK); i++)
+		ret_val = ops.result[i];
+	if ((ret_val == EC_OK) && (memcmp(wr, rd, size) != 0))
+		ret_val = EC_VERIFY_ERR;
+	if (ret_val == EC_OK)
+		printf("write, read back and call of %u KB: %.1f ms, %u polls\n",
+		       size / 1024, BENCH_TimeMs() - start, polls);
+
+	/* Cancel the write once it runs, and the one queued behind it */
+	memset(&ops, 0, sizeof(ops));
+	if (ret_val == EC_OK)
+		ret_val = UUT_SubmitWrite(h, BENCH_ADDR, wr, size, &cb,
+					  &ops.id[0]);
+	if (ret_val == EC_OK)
+		ret_val = UUT_SubmitWrite(h, BENCH_ADDR, wr, size, &cb,
+					  &ops.id[1]);
+
+	while ((ret_val == EC_OK) && (ops.progress[0] == 0) &&
+	       (UUT_Poll(h, BENCH_POLL_MS) > 0))
+		;
+
+	if (ret_val == EC_OK)
+		ret_val = UUT_Cancel(h, ops.id[0]);
+	if (ret_val == EC_OK)
+		ret_val = UUT_Cancel(h, ops.id[1]);
+
+	while ((ret_val == EC_OK) && (UUT_Poll(h, BENCH_POLL_MS) > 0))
+		;
+
+	if ((ret_val == EC_OK) && ((ops.numDone != 2) ||
+	    (ops.result[0] != EC_CANCEL_ERR) ||
+	    (ops.result[1] != EC_CANCEL_ERR)))
+		ret_val = EC_CANCEL_ERR;
+	if (ret_val == EC_OK)
+		printf("running write cancelled after %u of %u bytes,"
+		       " queued write cancelled\n", ops.progress[0], size);
+
+	UUT_Close(h);
+	free(wr);
+	free(rd);
+
+	return ret_val;
+}
+
+/*---------------------------------------------------------------------------
+ * Function:	main
+ *
+ * Parameters:	argc - number of arguments.
+ *		argv - benchmark name, and its arguments.
+ * Returns:	EXIT_CODE of the benchmark.
+ *---------------------------------------------------------------------------
+ */
+int main(int argc, char *argv[])
+{
+	UINT32	i;
+	int	ret_val;
+
+	for (i = 0; (argc > 2) && (i < BENCH_NUM_MODES); i++) {
+		if (strcmp(argv[1], BenchModes[i].name) != 0)
+			continue;
+
+		ret_val = BenchModes[i].run(argc - 2, argv + 2);
+		if (ret_val != EC_OK)
+			fprintf(stderr, "%s failed, error = %d\n", argv[1],
+				ret_val);
+		return ret_val;
+	}
+
+	fprintf(stderr, "Usage:\n");
+	for (i = 0; i < BENCH_NUM_MODES; i++)
+		fprintf(stderr, "  uut_bench %s %s\n", BenchModes[i].name,
+			BenchModes[i].usage);
+
+	return EC_UNSUPPORTED_CMD_ERR;
+}
@@ -0,0 +1,286 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0
+#
+# Nuvoton UART Update Tool
+#
+# uut_sim.py
+#	Simulated UFPP ROM code devices, on pseudo terminals or TCP, to run
+#	the tool and the benchmarks without boards.
+#
+#	uut_sim.py pty ttySIM0 ttySIM1 ...    links /dev/ttySIMn to a pty
+#	uut_sim.py pty --count 32             /dev/ttySIM0 .. /dev/ttySIM31
+#	uut_sim.py tcp 7001 [--rfc2217]       tcp:127.0.0.1:7001 port
+#
+#	--rtt <ms>       answer every command <ms> after it was received
+#	--ack-loss <pct> drop that share of the WRITE acks
+#	--seed <n>       seed of the dropped acks, for repeatable runs
+#
+#	Pty links need write access to /dev (root). Each device has its own
+#	memory; unwritten bytes read back as the low byte of their address.
+#	Command CRCs are not checked. The command counts of each device,
+#	and the acks dropped, are printed when the simulator stops.
+
+import argparse
+import heapq
+import os
+import pty
+import random
+import signal
+import socket
+import sys
+import threading
+import time
+import tty
+
+UFPP_SYNC = 0x55
+UFPP_SYNC_RESP = 0x5A
+UFPP_WRITE = 0x07
+UFPP_READ = 0x1C
+UFPP_FCALL = 0x70
+UFPP_FCALL_RSLT = 0x73
+UFPP_SET_HIGH_RATE = 0xA0
+
+# Command header: opcode, size - 1, 4 address bytes; then data and CRC
+HDR_SIZE = 6
+CRC_SIZE = 2
+
+IAC, SB, SE, WILL, WONT, DO, DONT = 255, 250, 240, 251, 252, 253, 254
+
+
+def crc16(data):
+	"""CRC-16 (0xA001, initial 0), as lib_crc.c computes it."""
+	crc = 0
+	for b in data:
+		crc ^= b
+		for _ in range(8):
+			crc = (crc >> 1) ^ 0xA001 if crc & 1 else crc >> 1
+	return crc
+
+
+class Device:
+	"""Stop-and-wait UFPP ROM code: one answer per complete command."""
+
+	def __init__(self, name, ack_loss, rng):
+		self.name = name
+		self.mem = {}
+		self.rx = bytearray()
+		self.ack_loss = ack_loss
+		self.rng = rng
+		self.stats = {"sync": 0, "write": 0, "read": 0, "call": 0,
+			      "dropped": 0}
+
+	def feed(self, data):
+		"""Consume received bytes, return the answers to send."""
+		self.rx += data
+		out = bytearray()
+
+		while self.rx:
+			op = self.rx[0]
+			if op == UFPP_SYNC:
+				del self.rx[:1]
+				out.append(UFPP_SYNC_RESP)
+				self.stats["sync"] += 1
+			elif op == UFPP_SET_HIGH_RATE:
+				del self.rx[:1]
+			elif op == UFPP_WRITE:
+				if len(self.rx) < 2:
+					break
+				size = self.rx[1] + 1
+				if len(self.rx) < HDR_SIZE + size + CRC_SIZE:
+					break
+				addr = int.from_bytes(self.rx[2:6], "big")
+				for i in range(size):
+					self.mem[addr + i] = self.rx[HDR_SIZE + i]
+				del self.rx[:HDR_SIZE + size + CRC_SIZE]
+				self.stats["write"] += 1
+				if self.rng.random() * 100 < self.ack_loss:
+					self.stats["dropped"] += 1
+				else:
+					out.append(UFPP_WRITE)
+			elif op == UFPP_READ:
+				if len(self.rx) < HDR_SIZE + CRC_SIZE:
+					break
+				size = self.rx[1] + 1
+				addr = int.from_bytes(self.rx[2:6], "big")
+				del self.rx[:HDR_SIZE + CRC_SIZE]
+				data = bytes(self.mem.get(a, a & 0xFF)
+					     for a in range(addr, addr + size))
+				out.append(UFPP_READ)
+				out += data
+				out += crc16(data).to_bytes(2, "big")
+				self.stats["read"] += 1
+			elif op == UFPP_FCALL:
+				if len(self.rx) < HDR_SIZE + CRC_SIZE:
+					break
+				del self.rx[:HDR_SIZE + CRC_SIZE]
+				out += bytes([UFPP_FCALL, UFPP_FCALL_RSLT, 0])
+				self.stats["call"] += 1
+			else:
+				# Unknown byte, as a line glitch: skip it
+				del self.rx[:1]
+
+		return bytes(out)
+
+
+class DelayedWriter:
+	"""Send each answer rtt after its command arrived, in order."""
+
+	def __init__(self, write, rtt):
+		self.write = write
+		self.rtt = rtt
+		self.queue = []
+		self.seq = 0
+		self.cond = threading.Condition()
+		threading.Thread(target=self.run, daemon=True).start()
+
+	def put(self, data):
+		if self.rtt == 0:
+			self.write(data)
+			return
+		with self.cond:
+			heapq.heappush(self.queue,
+				       (time.monotonic() + self.rtt, self.seq, data))
+			self.seq += 1
+			self.cond.notify()
+
+	def run(self):
+		while True:
+			with self.cond:
+				while not self.queue:
+					self.cond.wait()
+				due, _, data = self.queue[0]
+				wait = due - time.monotonic()
+				if wait > 0:
+					self.cond.wait(wait)
+					continue
+				heapq.heappop(self.queue)
+			self.write(data)
+
+
+def rfc2217_decode(state, data):
+	"""Strip the telnet negotiation, return the serial data bytes."""
+	out = bytearray()
+	for b in data:
+		s = state[0]
+		if s == 0:
+			if b == IAC:
+				state[0] = 1
+			else:
+				out.append(b)
+		elif s == 1:
+			if b == IAC:
+				out.append(IAC)
+				state[0] = 0
+			elif b == SB:
+				state[0] = 3
+			elif b in (WILL, WONT, DO, DONT):
+				state[0] = 2
+			else:
+				state[0] = 0
+		elif s == 2:
+			state[0] = 0
+		elif s == 3:
+			if b == IAC:
+				state[0] = 4
+		elif s == 4:
+			state[0] = 0 if b == SE else 3
+	return bytes(out)
+
+
+def serve_pty(link, args, rng, devices):
+	master, slave = pty.openpty()
+	tty.setraw(slave)
+	try:
+		os.unlink(link)
+	except FileNotFoundError:
+		pass
+	os.symlink(os.ttyname(slave), link)
+
+	dev = Device(link, args.ack_loss, rng)
+	devices.append(dev)
+	writer = DelayedWriter(lambda d: os.write(master, d), args.rtt / 1000)
+	while True:
+		answer = dev.feed(os.read(master, 4096))
+		if answer:
+			writer.put(answer)
+
+
+def serve_tcp(port, args, rng):
+	ls = socket.socket()
+	ls.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+	ls.bind(("127.0.0.1", port))
+	ls.listen(4)
+
+	while True:
+		conn, _ = ls.accept()
+		conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+		dev = Device("tcp:%d" % port, args.ack_loss, rng)
+		writer = DelayedWriter(conn.sendall, args.rtt / 1000)
+		state = [0]
+		while True:
+			data = conn.recv(4096)
+			if not data:
+				break
+			if args.rfc2217:
+				data = rfc2217_decode(state, data)
+			answer = dev.feed(data)
+			if args.rfc2217:
+				answer = answer.replace(b"\xff", b"\xff\xff")
+			if answer:
+				writer.put(answer)
+		print("tcp:%d" % port, dev.stats, flush=True)
+		conn.close()
+
+
+def main():
+	parser = argparse.ArgumentParser(description="UFPP device simulator")
+	parser.add_argument("mode", choices=["pty", "tcp"])
+	parser.add_argument("names", nargs="*",
+			    help="pty names (under /dev unless a path), or the "
+				 "tcp port")
+	parser.add_argument("--count", type=int, default=0,
+			    help="create /dev/ttySIM0 .. ttySIM<count-1>")
+	parser.add_argument("--rfc2217", action="store_true")
+	parser.add_argument("--rtt", type=float, default=0)
+	parser.add_argument("--ack-loss", type=float, default=0)
+	parser.add_argument("--seed", type=int, default=1)
+	args = parser.parse_args()
+
+	rng = random.Random(args.seed)
+
+	if args.mode == "tcp":
+		if len(args.names) != 1:
+			parser.error("tcp takes a single port")
+		serve_tcp(int(args.names[0]), args, rng)
+		return
+
+	links = ["/dev/ttySIM%d" % i for i in range(args.count)]
+	links += [n if "/" in n else "/dev/" + n for n in args.names]
+	if not links:
+		parser.error("no pty to create")
+
+	devices = []
+	for link in links:
+		threading.Thread(target=serve_pty,
+				 args=(link, args, rng, devices),
+				 daemon=True).start()
+
+	print("serving", " ".join(links), flush=True)
+	signal.signal(signal.SIGTERM, lambda *_: sys.exit(0))
+	try:
+		while True:
+			time.sleep(1)
+	except KeyboardInterrupt:
+		pass
+	finally:
+		for link in links:
+			try:
+				os.unlink(link)
+			except OSError:
+				pass
+		for dev in devices:
+			print(dev.name, dev.stats, flush=True)
+
+
+if __name__ == "__main__":
+	main()